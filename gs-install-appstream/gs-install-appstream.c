@@ -59,6 +59,18 @@ gs_install_appstream_move_file (GFile *file, GError **error)
 			return FALSE;
 	}
 
+	/* gnome-software now installs external AppStream files decompressed, so
+	 * remove any older compressed copy of the same file, which would
+	 * otherwise be loaded as well */
+	if (!g_str_has_suffix (cachefn, ".gz")) {
+		g_autofree gchar *compressed_cachefn = g_strconcat (cachefn, ".gz", NULL);
+		if (g_unlink (compressed_cachefn) == -1) {
+			int errn = errno;
+			if (errn != ENOENT)
+				g_debug ("Failed to unlink '%s': %s", compressed_cachefn, g_strerror (errn));
+		}
+	}
+
 	/* do the move, overwriting existing files and setting the permissions
 	 * of the current process (so that should be -rw-r--r--) */
 	if (!g_file_move (file, cachefn_file,
@@ -94,6 +106,17 @@ gs_install_appstream_move_file (GFile *file, GError **error)
 		g_debug ("Failed to stat '%s': %s", cachefn, g_strerror (errn));
 	}
 
+	/* record the hash of the installed contents, so gnome-software can
+	 * skip installing the same contents again */
+	{
+		g_autoptr(GMappedFile) mapped_file = g_mapped_file_new (cachefn, FALSE, NULL);
+		if (mapped_file != NULL) {
+			g_autoptr(GBytes) bytes = g_mapped_file_get_bytes (mapped_file);
+			g_autofree gchar *content_hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+			gs_utils_set_file_content_hash (cachefn_file, content_hash, NULL);
+		}
+	}
+
 	return TRUE;
 }
 
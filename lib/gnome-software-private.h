@@ -14,6 +14,7 @@
 
 #include <gnome-software.h>
 
+#include <gs-app-identity-map.h>
 #include <gs-app-list-private.h>
 #include <gs-app-private.h>
 #include <gs-category-private.h>
@@ -28,6 +28,7 @@
 #include <gs-odrs-provider.h>
 #include <gs-os-release.h>
 #include <gs-plugin.h>
+#include <gs-plugin-change.h>
 #include <gs-plugin-helpers.h>
 #include <gs-plugin-job.h>
 #include <gs-plugin-job-cancel-offline-update.h>
@@ -48,5 +49,6 @@
 #include <gs-plugin-vfuncs.h>
 #include <gs-remote-icon.h>
 #include <gs-rewrite-resources.h>
+#include <gs-size-accountant.h>
 #include <gs-utils.h>
 #include <gs-worker-thread.h>
@@ -0,0 +1,425 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-app-identity-map
+ * @short_description: Process-wide map from unique IDs to #GsApp instances
+ *
+ * Several plugins, and several pages in the UI, can each create their own
+ * #GsApp for the same unique ID. Each of those instances is refined
+ * separately and their states diverge. A #GsAppIdentityMap is owned by the
+ * #GsPluginLoader and lets plugins and jobs find the existing instance for a
+ * unique ID before creating a new one, using gs_app_identity_map_intern().
+ *
+ * The map only holds weak references, so it doesn’t keep any app alive:
+ * once nothing else references an instance, the next app with its unique
+ * ID becomes the new instance.
+ *
+ * The map also remembers which #GsPluginRefineFlags each instance has been
+ * refined with, so that list jobs can avoid refining an app which another
+ * job has already refined. That is forgotten when the app’s state changes,
+ * or for all apps when gs_app_identity_map_invalidate() is called.
+ *
+ * All functions are thread safe.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gs-app-identity-map.h"
+
+/* Stale entries are only removed when the map has doubled in size since it
+ * was last pruned, so that pruning is amortised over the insertions. */
+#define MIN_PRUNE_SIZE 64
+
+typedef struct {
+	GWeakRef app;
+	GsPluginRefineFlags refined_flags;
+	GsAppState refined_state;
+} Entry;
+
+struct _GsAppIdentityMap {
+	GMutex mutex;
+	GHashTable *entries;  /* (mutex mutex) (owned) (element-type utf8 Entry) */
+	guint prune_size;  /* (mutex mutex) */
+	GsAppIdentityMapStats stats;  /* (mutex mutex) */
+};
+
+static void
+entry_free (Entry *entry)
+{
+	g_weak_ref_clear (&entry->app);
+	g_free (entry);
+}
+
+/**
+ * gs_app_identity_map_new:
+ *
+ * Create a new, empty #GsAppIdentityMap.
+ *
+ * Returns: (transfer full): a new #GsAppIdentityMap
+ * Since: 47
+ */
+GsAppIdentityMap *
+gs_app_identity_map_new (void)
+{
+	GsAppIdentityMap *self = g_atomic_rc_box_new0 (GsAppIdentityMap);
+
+	g_mutex_init (&self->mutex);
+	self->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, (GDestroyNotify) entry_free);
+	self->prune_size = MIN_PRUNE_SIZE;
+
+	return self;
+}
+
+/**
+ * gs_app_identity_map_ref:
+ * @self: a #GsAppIdentityMap
+ *
+ * Add a reference to @self.
+ *
+ * Returns: (transfer full): @self
+ * Since: 47
+ */
+GsAppIdentityMap *
+gs_app_identity_map_ref (GsAppIdentityMap *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+
+	return g_atomic_rc_box_acquire (self);
+}
+
+static void
+gs_app_identity_map_clear (GsAppIdentityMap *self)
+{
+	g_hash_table_unref (self->entries);
+	g_mutex_clear (&self->mutex);
+}
+
+/**
+ * gs_app_identity_map_unref:
+ * @self: (transfer full): a #GsAppIdentityMap
+ *
+ * Remove a reference from @self, freeing it if that was the last reference.
+ * The apps in it are not affected.
+ *
+ * Since: 47
+ */
+void
+gs_app_identity_map_unref (GsAppIdentityMap *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_atomic_rc_box_release_full (self, (GDestroyNotify) gs_app_identity_map_clear);
+}
+
+static gboolean
+entry_is_stale_cb (gpointer key,
+                   gpointer value,
+                   gpointer user_data)
+{
+	Entry *entry = value;
+	g_autoptr(GsApp) app = g_weak_ref_get (&entry->app);
+
+	return (app == NULL);
+}
+
+/* Must be called with the mutex held. */
+static void
+maybe_prune (GsAppIdentityMap *self)
+{
+	if (g_hash_table_size (self->entries) < self->prune_size)
+		return;
+
+	g_hash_table_foreach_remove (self->entries, entry_is_stale_cb, NULL);
+	self->prune_size = MAX (MIN_PRUNE_SIZE, g_hash_table_size (self->entries) * 2);
+}
+
+static gboolean
+app_can_be_interned (GsApp *app)
+{
+	return (gs_app_get_unique_id (app) != NULL &&
+		!gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD));
+}
+
+/**
+ * gs_app_identity_map_lookup:
+ * @self: a #GsAppIdentityMap
+ * @unique_id: a unique ID
+ *
+ * Look up the existing instance for @unique_id.
+ *
+ * Returns: (transfer full) (nullable): the #GsApp for @unique_id, or %NULL
+ *   if there is none
+ * Since: 47
+ */
+GsApp *
+gs_app_identity_map_lookup (GsAppIdentityMap *self,
+                            const gchar      *unique_id)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	Entry *entry;
+	GsApp *app;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (unique_id != NULL, NULL);
+
+	locker = g_mutex_locker_new (&self->mutex);
+
+	entry = g_hash_table_lookup (self->entries, unique_id);
+	if (entry == NULL)
+		return NULL;
+
+	/* This doesn’t count towards n_reused, as no app was created which
+	 * the instance could be used in place of. */
+	app = g_weak_ref_get (&entry->app);
+	if (app == NULL)
+		g_hash_table_remove (self->entries, unique_id);
+
+	return app;
+}
+
+/* Fill in the properties of @app which are unset, from @donor. @donor is
+ * typically a partially refined app which a plugin has just created. */
+static void
+merge_app (GsApp *app,
+           GsApp *donor)
+{
+	g_autoptr(GsPlugin) management_plugin = NULL;
+
+	if (gs_app_get_state (app) == GS_APP_STATE_UNKNOWN &&
+	    gs_app_get_state (donor) != GS_APP_STATE_UNKNOWN)
+		gs_app_set_state (app, gs_app_get_state (donor));
+	if (gs_app_get_name (app) == NULL && gs_app_get_name (donor) != NULL)
+		gs_app_set_name (app, GS_APP_QUALITY_LOWEST, gs_app_get_name (donor));
+	if (gs_app_get_summary (app) == NULL && gs_app_get_summary (donor) != NULL)
+		gs_app_set_summary (app, GS_APP_QUALITY_LOWEST, gs_app_get_summary (donor));
+	if (gs_app_get_description (app) == NULL && gs_app_get_description (donor) != NULL)
+		gs_app_set_description (app, GS_APP_QUALITY_LOWEST, gs_app_get_description (donor));
+	if (gs_app_get_version (app) == NULL && gs_app_get_version (donor) != NULL)
+		gs_app_set_version (app, gs_app_get_version (donor));
+	if (gs_app_get_origin (app) == NULL && gs_app_get_origin (donor) != NULL)
+		gs_app_set_origin (app, gs_app_get_origin (donor));
+
+	management_plugin = gs_app_dup_management_plugin (donor);
+	if (management_plugin != NULL && gs_app_has_management_plugin (app, NULL))
+		gs_app_set_management_plugin (app, management_plugin);
+
+	if (!gs_app_has_icons (app) && gs_app_has_icons (donor)) {
+		g_autoptr(GPtrArray) icons = gs_app_dup_icons (donor);
+
+		for (guint i = 0; icons != NULL && i < icons->len; i++)
+			gs_app_add_icon (app, g_ptr_array_index (icons, i));
+	}
+
+	gs_app_subsume_metadata (app, donor);
+}
+
+/**
+ * gs_app_identity_map_intern:
+ * @self: a #GsAppIdentityMap
+ * @app: a #GsApp
+ *
+ * Get the instance for the unique ID of @app.
+ *
+ * If there is no instance yet, @app becomes the instance and is returned.
+ * Otherwise the existing instance is returned, after filling in any of its
+ * properties which are unset from @app, and @app can be discarded.
+ *
+ * Wildcard apps, and apps without a unique ID, are never interned, and are
+ * returned unchanged.
+ *
+ * Returns: (transfer full) (not nullable): the #GsApp instance to use in
+ *   place of @app
+ * Since: 47
+ */
+GsApp *
+gs_app_identity_map_intern (GsAppIdentityMap *self,
+                            GsApp            *app)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GsApp) existing_app = NULL;
+	const gchar *unique_id;
+	Entry *entry;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (GS_IS_APP (app), NULL);
+
+	if (!app_can_be_interned (app))
+		return g_object_ref (app);
+
+	unique_id = gs_app_get_unique_id (app);
+	locker = g_mutex_locker_new (&self->mutex);
+
+	entry = g_hash_table_lookup (self->entries, unique_id);
+	if (entry != NULL)
+		existing_app = g_weak_ref_get (&entry->app);
+
+	if (existing_app == app)
+		return g_steal_pointer (&existing_app);
+
+	if (existing_app != NULL) {
+		self->stats.n_reused++;
+		g_clear_pointer (&locker, g_mutex_locker_free);
+
+		merge_app (existing_app, app);
+		return g_steal_pointer (&existing_app);
+	}
+
+	maybe_prune (self);
+
+	entry = g_new0 (Entry, 1);
+	g_weak_ref_init (&entry->app, app);
+	g_hash_table_replace (self->entries, g_strdup (unique_id), entry);
+	self->stats.n_interned++;
+
+	return g_object_ref (app);
+}
+
+/**
+ * gs_app_identity_map_is_refined:
+ * @self: a #GsAppIdentityMap
+ * @app: a #GsApp
+ * @flags: refine flags which are needed
+ *
+ * Check whether @app is the instance for its unique ID, and has already been
+ * refined with all of @flags since its state last changed. If so, this
+ * counts as a saved refine in the stats.
+ *
+ * Returns: %TRUE if @app doesn’t need refining with @flags
+ * Since: 47
+ */
+gboolean
+gs_app_identity_map_is_refined (GsAppIdentityMap    *self,
+                                GsApp               *app,
+                                GsPluginRefineFlags  flags)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GsApp) existing_app = NULL;
+	Entry *entry;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (GS_IS_APP (app), FALSE);
+
+	if (!app_can_be_interned (app))
+		return FALSE;
+
+	locker = g_mutex_locker_new (&self->mutex);
+
+	entry = g_hash_table_lookup (self->entries, gs_app_get_unique_id (app));
+	if (entry == NULL)
+		return FALSE;
+
+	existing_app = g_weak_ref_get (&entry->app);
+	if (existing_app != app ||
+	    entry->refined_state != gs_app_get_state (app) ||
+	    (entry->refined_flags & flags) != flags)
+		return FALSE;
+
+	self->stats.n_refines_saved++;
+
+	return TRUE;
+}
+
+/**
+ * gs_app_identity_map_add_refined:
+ * @self: a #GsAppIdentityMap
+ * @app: a #GsApp
+ * @flags: refine flags which @app has been refined with
+ *
+ * Record that @app has been refined with @flags, if it’s the instance for its
+ * unique ID.
+ *
+ * Since: 47
+ */
+void
+gs_app_identity_map_add_refined (GsAppIdentityMap    *self,
+                                 GsApp               *app,
+                                 GsPluginRefineFlags  flags)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GsApp) existing_app = NULL;
+	Entry *entry;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (GS_IS_APP (app));
+
+	if (!app_can_be_interned (app))
+		return;
+
+	locker = g_mutex_locker_new (&self->mutex);
+
+	entry = g_hash_table_lookup (self->entries, gs_app_get_unique_id (app));
+	if (entry == NULL)
+		return;
+
+	existing_app = g_weak_ref_get (&entry->app);
+	if (existing_app != app)
+		return;
+
+	/* Anything refined for a previous state is out of date. */
+	if (entry->refined_state != gs_app_get_state (app))
+		entry->refined_flags = 0;
+
+	entry->refined_flags |= flags;
+	entry->refined_state = gs_app_get_state (app);
+}
+
+/**
+ * gs_app_identity_map_invalidate:
+ * @self: a #GsAppIdentityMap
+ *
+ * Forget which flags all the apps in the map have been refined with, for
+ * example because a plugin’s data has been reloaded. The apps stay in the
+ * map.
+ *
+ * Since: 47
+ */
+void
+gs_app_identity_map_invalidate (GsAppIdentityMap *self)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	GHashTableIter iter;
+	gpointer value;
+
+	g_return_if_fail (self != NULL);
+
+	locker = g_mutex_locker_new (&self->mutex);
+
+	g_hash_table_iter_init (&iter, self->entries);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		Entry *entry = value;
+		entry->refined_flags = 0;
+	}
+}
+
+/**
+ * gs_app_identity_map_get_stats:
+ * @self: a #GsAppIdentityMap
+ * @out_stats: (out caller-allocates): return location for the stats
+ *
+ * Get counters for how many allocations and refines the map has saved.
+ *
+ * Since: 47
+ */
+void
+gs_app_identity_map_get_stats (GsAppIdentityMap      *self,
+                               GsAppIdentityMapStats *out_stats)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (out_stats != NULL);
+
+	locker = g_mutex_locker_new (&self->mutex);
+	*out_stats = self->stats;
+}
@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "gs-app.h"
+#include "gs-plugin-types.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GsAppIdentityMap GsAppIdentityMap;
+
+/**
+ * GsAppIdentityMapStats:
+ * @n_interned: number of apps which became the instance for their unique ID
+ * @n_reused: number of times an existing instance was returned in place of
+ *   a newly created app, saving that allocation for the rest of its life
+ * @n_refines_saved: number of apps which didn’t need refining because their
+ *   instance had already been refined with the same flags
+ *
+ * Counters for how effective a #GsAppIdentityMap is being.
+ *
+ * Since: 47
+ */
+typedef struct {
+	guint n_interned;
+	guint n_reused;
+	guint n_refines_saved;
+} GsAppIdentityMapStats;
+
+GsAppIdentityMap	*gs_app_identity_map_new		(void);
+GsAppIdentityMap	*gs_app_identity_map_ref		(GsAppIdentityMap	*self);
+void			 gs_app_identity_map_unref		(GsAppIdentityMap	*self);
+
+GsApp			*gs_app_identity_map_lookup		(GsAppIdentityMap	*self,
+								 const gchar		*unique_id);
+GsApp			*gs_app_identity_map_intern		(GsAppIdentityMap	*self,
+								 GsApp			*app);
+
+gboolean		 gs_app_identity_map_is_refined		(GsAppIdentityMap	*self,
+								 GsApp			*app,
+								 GsPluginRefineFlags	 flags);
+void			 gs_app_identity_map_add_refined	(GsAppIdentityMap	*self,
+								 GsApp			*app,
+								 GsPluginRefineFlags	 flags);
+void			 gs_app_identity_map_invalidate		(GsAppIdentityMap	*self);
+
+void			 gs_app_identity_map_get_stats		(GsAppIdentityMap	*self,
+								 GsAppIdentityMapStats	*out_stats);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsAppIdentityMap, gs_app_identity_map_unref)
+
+G_END_DECLS
@@ -36,6 +36,7 @@ struct _GsAppList
 	GsAppState		 state;
 	guint			 progress;  /* 0–100 inclusive, or %GS_APP_PROGRESS_UNKNOWN */
 	guint			 custom_progress; /* overrides the 'progress', if not %GS_APP_PROGRESS_UNKNOWN */
+	gboolean		 batch_dirty;  /* main thread only; a watched app changed state in the current batch */
 };
 
 G_DEFINE_TYPE (GsAppList, gs_app_list, G_TYPE_OBJECT)
@@ -48,11 +49,18 @@ enum {
 
 enum {
 	SIGNAL_APP_STATE_CHANGED,
+	SIGNAL_APPS_STATE_CHANGED,
 	SIGNAL_LAST
 };
 
 static guint signals [SIGNAL_LAST] = { 0 };
 
+/* While gs_app_list_set_state_many() is notifying about the apps it changed,
+ * lists watching those apps only note that they need updating, and are all
+ * updated once at the end. Main thread only. */
+static guint batch_depth = 0;
+static GPtrArray *batch_dirty_lists = NULL;  /* (element-type GsAppList) (owned) (nullable) */
+
 /**
  * gs_app_list_get_state:
  * @list: A #GsAppList
@@ -131,6 +139,82 @@ gs_app_list_override_progress (GsAppList *list,
 	}
 }
 
+/* Runs in the main thread, with the apps whose state was changed by one call
+ * to gs_app_list_set_state_many(). */
+static gboolean
+app_list_notify_state_many_idle_cb (gpointer user_data)
+{
+	GPtrArray *apps = user_data;
+	g_autoptr(GPtrArray) dirty_lists = NULL;
+
+	if (batch_depth++ == 0)
+		batch_dirty_lists = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (guint i = 0; i < apps->len; i++)
+		gs_app_notify_state (g_ptr_array_index (apps, i));
+
+	if (--batch_depth > 0)
+		return G_SOURCE_REMOVE;
+
+	dirty_lists = g_steal_pointer (&batch_dirty_lists);
+	for (guint i = 0; i < dirty_lists->len; i++) {
+		GsAppList *list = g_ptr_array_index (dirty_lists, i);
+
+		list->batch_dirty = FALSE;
+		gs_app_list_invalidate_state (list);
+		g_signal_emit (list, signals[SIGNAL_APPS_STATE_CHANGED], 0);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * gs_app_list_set_state_many:
+ * @list: a #GsAppList
+ * @state: a #GsAppState
+ *
+ * Set the state of all the apps in @list to @state, as if by calling
+ * gs_app_set_state() on each of them.
+ *
+ * The #GsApp:state notifications for all the apps which changed are then
+ * emitted together, in a single main loop dispatch. Any #GsAppList which is
+ * watching those apps updates its own state once, and emits
+ * #GsAppList::apps-state-changed once instead of emitting
+ * #GsAppList::app-state-changed for each app. Use this when changing the
+ * state of many apps at once, so the UI only has to update once.
+ *
+ * This may be called from any thread.
+ *
+ * Since: 47
+ **/
+void
+gs_app_list_set_state_many (GsAppList  *list,
+                            GsAppState  state)
+{
+	g_autoptr(GPtrArray) apps = NULL;
+	g_autoptr(GPtrArray) changed = NULL;
+
+	g_return_if_fail (GS_IS_APP_LIST (list));
+
+	/* don’t hold the list lock while taking each app’s lock */
+	{
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&list->mutex);
+		apps = g_ptr_array_copy (list->array, (GCopyFunc) g_object_ref, NULL);
+		g_ptr_array_set_free_func (apps, g_object_unref);
+	}
+
+	changed = g_ptr_array_new_with_free_func (g_object_unref);
+	for (guint i = 0; i < apps->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		if (gs_app_set_state_without_notify (app, state))
+			g_ptr_array_add (changed, g_object_ref (app));
+	}
+
+	if (changed->len > 0)
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, app_list_notify_state_many_idle_cb,
+				 g_steal_pointer (&changed), (GDestroyNotify) g_ptr_array_unref);
+}
+
 static void
 gs_app_list_add_watched_for_app (GsAppList *list, GPtrArray *apps, GsApp *app)
 {
@@ -237,6 +321,14 @@ gs_app_list_progress_notify_cb (GsApp *app, GParamSpec *pspec, GsAppList *self)
 static void
 gs_app_list_state_notify_cb (GsApp *app, GParamSpec *pspec, GsAppList *self)
 {
+	if (batch_depth > 0) {
+		if (!self->batch_dirty) {
+			self->batch_dirty = TRUE;
+			g_ptr_array_add (batch_dirty_lists, g_object_ref (self));
+		}
+		return;
+	}
+
 	gs_app_list_invalidate_state (self);
 
 	g_signal_emit (self, signals[SIGNAL_APP_STATE_CHANGED], 0, app);
@@ -994,6 +1086,21 @@ gs_app_list_class_init (GsAppListClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_generic,
 			      G_TYPE_NONE, 1, GS_TYPE_APP);
+
+	/**
+	 * GsAppList::apps-state-changed:
+	 *
+	 * Emitted once in place of #GsAppList::app-state-changed when several
+	 * of the internal #GsApp instances change state together, from
+	 * gs_app_list_set_state_many().
+	 *
+	 * Since: 47
+	 */
+	signals [SIGNAL_APPS_STATE_CHANGED] =
+		g_signal_new ("apps-state-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 }
 
 static void
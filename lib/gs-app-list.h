@@ -86,5 +86,7 @@ void		 gs_app_list_filter		(GsAppList	*list,
 						 gpointer	 user_data);
 void		 gs_app_list_override_progress	(GsAppList	*list,
 						 guint		 progress);
+void		 gs_app_list_set_state_many	(GsAppList	*list,
+						 GsAppState	 state);
 
 G_END_DECLS
@@ -29,5 +29,47 @@ gint		 gs_app_compare_priority	(GsApp		*app1,
 						 GsApp		*app2);
 void		 gs_app_set_icons_state		(GsApp		*app,
 						 GsAppIconsState icons_state);
+void		 gs_app_ensure_key_colors	(GsApp		*app,
+						 GHashTable	*icon_cache);
+gboolean	 gs_app_set_state_without_notify
+						(GsApp		*app,
+						 GsAppState	 state);
+void		 gs_app_notify_state		(GsApp		*app);
+gboolean	 gs_app_license_is_free		(const gchar	*license);
+gchar		**gs_app_dup_metadata_keys	(GsApp		*app);
+
+/**
+ * GsAppVersionHistoryLoader:
+ * @app: a #GsApp
+ * @max_releases: maximum number of releases to load, or 0 for all of them
+ * @data: data passed to gs_app_set_version_history_loader()
+ *
+ * Loads the version history of @app, newest release first.
+ *
+ * This is called without the app’s lock held, possibly from several threads
+ * at once, so must not modify @app.
+ *
+ * Returns: (element-type AsRelease) (transfer container) (nullable): the
+ *   releases, or %NULL if there are none
+ * Since: 47
+ */
+typedef GPtrArray *(*GsAppVersionHistoryLoader) (GsApp		*app,
+						  guint		 max_releases,
+						  GBytes	*data);
+
+void		 gs_app_set_version_history_loader
+						(GsApp		*app,
+						 GsAppVersionHistoryLoader loader,
+						 GBytes		*data);
+gboolean	 gs_app_has_version_history	(GsApp		*app);
+
+typedef struct _GsAppBuilder GsAppBuilder;
+
+GsAppBuilder	*gs_app_builder_new		(const gchar	*id);
+GsApp		*gs_app_builder_get_app		(GsAppBuilder	*builder);
+GsApp		*gs_app_builder_end		(GsAppBuilder	*builder);
+void		 gs_app_builder_free		(GsAppBuilder	*builder);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsAppBuilder, gs_app_builder_free)
 
 G_END_DECLS
@@ -42,6 +42,7 @@
 
 #include "gs-app-collation.h"
 #include "gs-app-private.h"
+#include "gs-debug.h"
 #include "gs-desktop-data.h"
 #include "gs-enums.h"
 #include "gs-icon.h"
@@ -92,6 +93,8 @@ typedef struct
 	gchar			*update_version;
 	gchar			*update_version_ui;
 	gchar			*update_details_markup;
+	gchar			*update_details_raw;  /* (nullable); converted into update_details_markup on first use */
+	GsAppUpdateDetailsFunc	 update_details_func;
 	gboolean		 update_details_set;
 	AsUrgencyKind		 update_urgency;
 	GsAppPermissions        *update_permissions;
@@ -139,6 +142,10 @@ typedef struct
 	GsAppPermissions        *permissions;
 	gboolean		 is_update_downloaded;
 	GPtrArray		*version_history; /* (element-type AsRelease) (nullable) (owned) */
+	GsAppVersionHistoryLoader version_history_loader;  /* (nullable) */
+	GBytes			*version_history_loader_data;  /* (owned) (nullable) */
+	GPtrArray		*latest_releases;  /* (element-type AsRelease) (nullable) (owned); cached from version_history_loader */
+	guint			 latest_releases_max;  /* max_releases which latest_releases was loaded with */
 	GPtrArray		*relations;  /* (nullable) (element-type AsRelation) (owned) */
 	gboolean		 has_translations;
 	GsAppIconsState		 icons_state;
@@ -147,6 +154,7 @@ typedef struct
 	gboolean		 key_color_for_dark_set;
 	GdkRGBA			 key_color_for_dark;
 	gboolean		 mok_key_pending;
+	gboolean		 building;  /* set while owned by a #GsAppBuilder */
 } GsAppPrivate;
 
 typedef enum {
@@ -195,6 +203,14 @@ static GParamSpec *obj_props[PROP_MOK_KEY_PENDING + 1] = { NULL, };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GsApp, gs_app, G_TYPE_OBJECT)
 
+/* Nothing else can see an app while a #GsAppBuilder owns it, so it doesn’t
+ * need locking until it’s published. */
+static inline GMutexLocker *
+gs_app_lock (GsAppPrivate *priv)
+{
+	return priv->building ? NULL : g_mutex_locker_new (&priv->mutex);
+}
+
 static gboolean
 _g_set_strv (gchar ***strv_ptr, gchar **new_strv)
 {
@@ -539,7 +555,7 @@ gs_app_to_string_append (GsApp *app, GString *str)
 
 	klass = GS_APP_GET_CLASS (app);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	g_string_append_printf (str, " [%p]\n", app);
 	gs_app_kv_lpad (str, "kind", as_component_kind_to_string (priv->kind));
@@ -592,6 +608,8 @@ gs_app_to_string_append (GsApp *app, GString *str)
 		gs_app_kv_lpad (str, "update-version-ui", priv->update_version_ui);
 	if (priv->update_details_markup != NULL)
 		gs_app_kv_lpad (str, "update-details-markup", priv->update_details_markup);
+	if (priv->update_details_raw != NULL)
+		gs_app_kv_lpad (str, "update-details-raw", priv->update_details_raw);
 	if (priv->update_urgency != AS_URGENCY_KIND_UNKNOWN) {
 		gs_app_kv_printf (str, "update-urgency", "%u",
 				  priv->update_urgency);
@@ -827,8 +845,13 @@ notify_idle_cb (gpointer data)
 static void
 gs_app_queue_notify (GsApp *app, GParamSpec *pspec)
 {
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	AppNotifyData *notify_data;
 
+	/* nobody can be connected to an app which is still being built */
+	if (priv->building)
+		return;
+
 	notify_data = g_new (AppNotifyData, 1);
 	notify_data->app = g_object_ref (app);
 	notify_data->pspec = pspec;
@@ -867,7 +890,7 @@ gs_app_set_id (GsApp *app, const gchar *id)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (g_set_str (&priv->id, id))
 		priv->unique_id_valid = FALSE;
 }
@@ -1144,7 +1167,7 @@ gs_app_set_progress (GsApp *app, guint percentage)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (priv->progress == percentage)
 		return;
 	if (percentage != GS_APP_PROGRESS_UNKNOWN && percentage > 100) {
@@ -1173,7 +1196,7 @@ gs_app_set_allow_cancel (GsApp *app, gboolean allow_cancel)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (priv->allow_cancel == allow_cancel)
 		return;
 	priv->allow_cancel = allow_cancel;
@@ -1218,12 +1241,35 @@ gs_app_set_pending_action_internal (GsApp *app,
  **/
 void
 gs_app_set_state (GsApp *app, GsAppState state)
+{
+	g_return_if_fail (GS_IS_APP (app));
+
+	if (gs_app_set_state_without_notify (app, state))
+		gs_app_queue_notify (app, obj_props[PROP_STATE]);
+}
+
+/**
+ * gs_app_set_state_without_notify:
+ * @app: a #GsApp
+ * @state: a #GsAppState, e.g. GS_APP_STATE_UPDATABLE_LIVE
+ *
+ * Like gs_app_set_state(), but without queueing a notification of
+ * #GsApp:state. If the state changed, the caller must call
+ * gs_app_notify_state() from the main thread afterwards. This allows
+ * notifications for many apps to be batched together; see
+ * gs_app_list_set_state_many().
+ *
+ * Returns: %TRUE if the state changed
+ * Since: 47
+ **/
+gboolean
+gs_app_set_state_without_notify (GsApp *app, GsAppState state)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
-	g_return_if_fail (GS_IS_APP (app));
+	g_return_val_if_fail (GS_IS_APP (app), FALSE);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (gs_app_set_state_internal (app, state)) {
 		/* since the state changed, and the pending-action refers to
@@ -1238,8 +1284,34 @@ gs_app_set_state (GsApp *app, GsAppState state)
 		}
 		gs_app_set_pending_action_internal (app, action);
 
-		gs_app_queue_notify (app, obj_props[PROP_STATE]);
+		return TRUE;
 	}
+
+	return FALSE;
+}
+
+/**
+ * gs_app_notify_state:
+ * @app: a #GsApp
+ *
+ * Notify #GsApp:state immediately, after it was changed using
+ * gs_app_set_state_without_notify(). This must be called from the main
+ * thread.
+ *
+ * Since: 47
+ **/
+void
+gs_app_notify_state (GsApp *app)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+
+	g_return_if_fail (GS_IS_APP (app));
+
+	/* nobody can be connected to an app which is still being built */
+	if (priv->building)
+		return;
+
+	g_object_notify_by_pspec (G_OBJECT (app), obj_props[PROP_STATE]);
 }
 
 /**
@@ -1286,7 +1358,7 @@ gs_app_set_kind (GsApp *app, AsComponentKind kind)
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* same */
 	if (priv->kind == kind)
@@ -1357,7 +1429,7 @@ gs_app_get_unique_id (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return gs_app_get_unique_id_unlocked (app);
 }
 
@@ -1378,7 +1450,7 @@ gs_app_set_unique_id (GsApp *app, const gchar *unique_id)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* check for sanity */
 	if (!as_utils_data_id_valid (unique_id))
@@ -1424,7 +1496,7 @@ gs_app_set_name (GsApp *app, GsAppQuality quality, const gchar *name)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* only save this if the data is sufficiently high quality */
 	if (quality < priv->name_quality)
@@ -1468,7 +1540,7 @@ gs_app_set_renamed_from (GsApp *app, const gchar *renamed_from)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_str (&priv->renamed_from, renamed_from);
 }
 
@@ -1505,7 +1577,7 @@ gs_app_set_branch (GsApp *app, const gchar *branch)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (g_set_str (&priv->branch, branch))
 		priv->unique_id_valid = FALSE;
 }
@@ -1550,7 +1622,7 @@ gs_app_add_source (GsApp *app, const gchar *source)
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (source != NULL);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* check source doesn't already exist */
 	for (i = 0; i < priv->sources->len; i++) {
@@ -1596,7 +1668,7 @@ gs_app_set_sources (GsApp *app, GPtrArray *sources)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	_g_set_ptr_array (&priv->sources, sources);
 }
 
@@ -1652,7 +1724,7 @@ gs_app_clear_source_ids (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_ptr_array_set_size (priv->source_ids, 0);
 }
 
@@ -1672,7 +1744,7 @@ gs_app_set_source_ids (GsApp *app, GPtrArray *source_ids)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	_g_set_ptr_array (&priv->source_ids, source_ids);
 }
 
@@ -1757,7 +1829,7 @@ gs_app_set_project_group (GsApp *app, const gchar *project_group)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_str (&priv->project_group, project_group);
 }
 
@@ -1776,7 +1848,7 @@ gs_app_set_developer_name (GsApp *app, const gchar *developer_name)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_str (&priv->developer_name, developer_name);
 }
 
@@ -1853,22 +1925,25 @@ gs_app_get_icon_for_size (GsApp       *app,
 	g_return_val_if_fail (size > 0, NULL);
 	g_return_val_if_fail (scale >= 1, NULL);
 
-	g_debug ("Looking for icon for %s, at size %u×%u, with fallback %s",
-		 gs_app_get_id (app), size, scale, fallback_icon_name);
+	gs_debug_if_enabled ("Looking for icon for %s, at size %u×%u, with fallback %s",
+			     gs_app_get_id (app), size, scale, fallback_icon_name);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* See if there’s an icon of the right size, or the first one which is too
 	 * big which could be scaled down. Note that the icons array may be
 	 * lazily created. */
 	for (guint i = 0; priv->icons != NULL && i < priv->icons->len; i++) {
 		GIcon *icon = priv->icons->pdata[i];
-		g_autofree gchar *icon_str = g_icon_to_string (icon);
 		guint icon_width = gs_icon_get_width (icon);
 		guint icon_scale = gs_icon_get_scale (icon);
 
-		g_debug ("\tConsidering icon of type %s (%s), width %u×%u",
-			 G_OBJECT_TYPE_NAME (icon), icon_str, icon_width, icon_scale);
+		/* g_icon_to_string() allocates, so avoid it if it’s not needed */
+		if (gs_debug_get_enabled ()) {
+			g_autofree gchar *icon_str = g_icon_to_string (icon);
+			g_debug ("\tConsidering icon of type %s (%s), width %u×%u",
+				 G_OBJECT_TYPE_NAME (icon), icon_str, icon_width, icon_scale);
+		}
 
 		/* To avoid excessive I/O, the loading of AppStream data does
 		 * not verify the existence of cached icons, which we do now. */
@@ -1959,7 +2034,7 @@ gs_app_get_icons (GsApp *app)
 
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->icons == NULL || priv->icons->len == 0)
 		return NULL;
@@ -1990,7 +2065,7 @@ gs_app_dup_icons (GsApp *app)
 
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->icons == NULL || priv->icons->len == 0)
 		return NULL;
@@ -2021,7 +2096,7 @@ gs_app_has_icons (GsApp *app)
 
 	g_return_val_if_fail (GS_IS_APP (app), FALSE);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	return priv->icons != NULL && priv->icons->len > 0;
 }
@@ -2064,7 +2139,7 @@ gs_app_add_icon (GsApp *app, GIcon *icon)
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (G_IS_ICON (icon));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->icons == NULL)
 		priv->icons = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
@@ -2089,7 +2164,7 @@ gs_app_remove_all_icons (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->icons != NULL)
 		g_ptr_array_set_size (priv->icons, 0);
@@ -2129,7 +2204,7 @@ gs_app_set_agreement (GsApp *app, const gchar *agreement)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_str (&priv->agreement, agreement);
 }
 
@@ -2168,7 +2243,7 @@ gs_app_set_local_file (GsApp *app, GFile *local_file)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_object (&priv->local_file, local_file);
 }
 
@@ -2188,7 +2263,7 @@ gs_app_dup_content_rating (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return (priv->content_rating != NULL) ? g_object_ref (priv->content_rating) : NULL;
 }
 
@@ -2207,7 +2282,7 @@ gs_app_set_content_rating (GsApp *app, AsContentRating *content_rating)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (g_set_object (&priv->content_rating, content_rating))
 		gs_app_queue_notify (app, obj_props[PROP_CONTENT_RATING]);
 }
@@ -2247,7 +2322,7 @@ gs_app_set_runtime (GsApp *app, GsApp *runtime)
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (GS_IS_APP (runtime));
 	g_return_if_fail (app != runtime);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_object (&priv->runtime, runtime);
 
 	/* The runtime adds to the main app’s sizes. */
@@ -2270,7 +2345,7 @@ gs_app_set_action_screenshot (GsApp *app, AsScreenshot *action_screenshot)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_object (&priv->action_screenshot, action_screenshot);
 }
 
@@ -2437,7 +2512,7 @@ gs_app_set_version (GsApp *app, const gchar *version)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (g_set_str (&priv->version, version)) {
 		gs_app_ui_versions_invalidate (app);
@@ -2480,7 +2555,7 @@ gs_app_set_summary (GsApp *app, GsAppQuality quality, const gchar *summary)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* only save this if the data is sufficiently high quality */
 	if (quality < priv->summary_quality)
@@ -2525,7 +2600,7 @@ gs_app_set_description (GsApp *app, GsAppQuality quality, const gchar *descripti
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* only save this if the data is sufficiently high quality */
 	if (quality < priv->description_quality)
@@ -2551,7 +2626,7 @@ gs_app_get_url (GsApp *app, AsUrlKind kind)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->urls == NULL)
 		return NULL;
@@ -2578,7 +2653,7 @@ gs_app_set_url (GsApp *app, AsUrlKind kind, const gchar *url)
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->urls == NULL)
 		priv->urls = g_hash_table_new_full (g_direct_hash, g_direct_equal,
@@ -2613,7 +2688,7 @@ gs_app_get_url_missing (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return priv->url_missing;
 }
 
@@ -2633,7 +2708,7 @@ gs_app_set_url_missing (GsApp *app, const gchar *url)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (g_strcmp0 (priv->url_missing, url) == 0)
 		return;
@@ -2659,7 +2734,7 @@ gs_app_get_launchable (GsApp *app, AsLaunchableKind kind)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return g_hash_table_lookup (priv->launchables,
 				    as_launchable_kind_to_string (kind));
 }
@@ -2682,7 +2757,7 @@ gs_app_set_launchable (GsApp *app, AsLaunchableKind kind, const gchar *launchabl
 	const gchar *key;
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	key = as_launchable_kind_to_string (kind);
 	if (g_hash_table_lookup_extended (priv->launchables, key, NULL, &current_value)) {
 		if (g_strcmp0 ((const gchar *) current_value, launchable) != 0)
@@ -2731,6 +2806,56 @@ gs_app_get_license_is_free (GsApp *app)
 	return priv->license_is_free;
 }
 
+/* Evaluating an SPDX expression means tokenising it and looking each license
+ * up in the list of free ones, but catalogues use the same few hundred
+ * expressions for tens of thousands of components, so the verdicts are
+ * remembered. The number remembered is limited in case of a pathological
+ * catalogue. */
+#define LICENSE_CACHE_MAX_SIZE 4096
+
+static GRWLock license_cache_lock;
+static GHashTable *license_cache = NULL;  /* (owned) (nullable) (element-type utf8 gboolean) (lock license_cache_lock) */
+
+/**
+ * gs_app_license_is_free:
+ * @license: a SPDX license expression
+ *
+ * Gets whether @license is a free software license, as determined by
+ * as_license_is_free_license(), remembering the result for next time.
+ *
+ * This is thread safe.
+ *
+ * Returns: %TRUE if @license is free
+ * Since: 47
+ **/
+gboolean
+gs_app_license_is_free (const gchar *license)
+{
+	gpointer verdict;
+	gboolean is_free;
+
+	g_return_val_if_fail (license != NULL, FALSE);
+
+	g_rw_lock_reader_lock (&license_cache_lock);
+	verdict = (license_cache != NULL) ? g_hash_table_lookup (license_cache, license) : NULL;
+	g_rw_lock_reader_unlock (&license_cache_lock);
+
+	/* stored as is_free + 1, so that %NULL means not cached */
+	if (verdict != NULL)
+		return GPOINTER_TO_INT (verdict) - 1;
+
+	is_free = as_license_is_free_license (license);
+
+	g_rw_lock_writer_lock (&license_cache_lock);
+	if (license_cache == NULL)
+		license_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	if (g_hash_table_size (license_cache) < LICENSE_CACHE_MAX_SIZE)
+		g_hash_table_insert (license_cache, g_strdup (license), GINT_TO_POINTER (is_free + 1));
+	g_rw_lock_writer_unlock (&license_cache_lock);
+
+	return is_free;
+}
+
 /**
  * gs_app_set_license:
  * @app: a #GsApp
@@ -2749,7 +2874,7 @@ gs_app_set_license (GsApp *app, GsAppQuality quality, const gchar *license)
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* only save this if the data is sufficiently high quality */
 	if (quality <= priv->license_quality)
@@ -2758,7 +2883,7 @@ gs_app_set_license (GsApp *app, GsAppQuality quality, const gchar *license)
 		return;
 	priv->license_quality = quality;
 
-	priv->license_is_free = as_license_is_free_license (license);
+	priv->license_is_free = gs_app_license_is_free (license);
 
 	if (g_set_str (&priv->license, license))
 		gs_app_queue_notify (app, obj_props[PROP_LICENSE]);
@@ -2797,7 +2922,7 @@ gs_app_set_summary_missing (GsApp *app, const gchar *summary_missing)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_set_str (&priv->summary_missing, summary_missing);
 }
 
@@ -2886,7 +3011,7 @@ gs_app_set_menu_path (GsApp *app, gchar **menu_path)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	_g_set_strv (&priv->menu_path, menu_path);
 }
 
@@ -2924,7 +3049,7 @@ gs_app_set_origin (GsApp *app, const gchar *origin)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* same */
 	if (g_strcmp0 (origin, priv->origin) == 0)
@@ -2980,7 +3105,7 @@ gs_app_set_origin_appstream (GsApp *app, const gchar *origin_appstream)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* same */
 	if (g_strcmp0 (origin_appstream, priv->origin_appstream) == 0)
@@ -3034,7 +3159,7 @@ gs_app_set_origin_hostname (GsApp *app, const gchar *origin_hostname)
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* same */
 	if (g_strcmp0 (origin_hostname, priv->origin_hostname) == 0)
@@ -3078,7 +3203,7 @@ gs_app_add_screenshot (GsApp *app, AsScreenshot *screenshot)
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (AS_IS_SCREENSHOT (screenshot));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_ptr_array_add (priv->screenshots, g_object_ref (screenshot));
 }
 
@@ -3166,7 +3291,7 @@ gs_app_set_update_version (GsApp *app, const gchar *update_version)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	gs_app_set_update_version_internal (app, update_version);
 	gs_app_queue_notify (app, obj_props[PROP_VERSION]);
 }
@@ -3177,6 +3302,9 @@ gs_app_set_update_version (GsApp *app, const gchar *update_version)
  *
  * Gets the multi-line description for the update as a Pango markup.
  *
+ * If the details were set with gs_app_set_update_details_lazy(), they are
+ * converted to markup now.
+ *
  * Returns: a string, or %NULL for unset
  *
  * Since: 42.0
@@ -3186,6 +3314,18 @@ gs_app_get_update_details_markup (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
+
+	if (priv->update_details_raw != NULL) {
+		g_autoptr(GMutexLocker) locker = gs_app_lock (priv);
+
+		/* check again, as another thread may have converted it */
+		if (priv->update_details_raw != NULL) {
+			g_free (priv->update_details_markup);
+			priv->update_details_markup = priv->update_details_func (priv->update_details_raw);
+			g_clear_pointer (&priv->update_details_raw, g_free);
+		}
+	}
+
 	return priv->update_details_markup;
 }
 
@@ -3207,8 +3347,9 @@ gs_app_set_update_details_markup (GsApp *app,
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	priv->update_details_set = TRUE;
+	g_clear_pointer (&priv->update_details_raw, g_free);
 	g_set_str (&priv->update_details_markup, markup);
 }
 
@@ -3231,8 +3372,9 @@ gs_app_set_update_details_text (GsApp *app,
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	priv->update_details_set = TRUE;
+	g_clear_pointer (&priv->update_details_raw, g_free);
 	if (text == NULL) {
 		g_set_str (&priv->update_details_markup, NULL);
 	} else {
@@ -3242,6 +3384,40 @@ gs_app_set_update_details_text (GsApp *app,
 	}
 }
 
+/**
+ * gs_app_set_update_details_lazy:
+ * @app: a #GsApp
+ * @raw: (nullable): update details in whatever format @func accepts
+ * @func: function to convert @raw into Pango markup
+ *
+ * Sets the multi-line description for the update, deferring its conversion
+ * into markup until gs_app_get_update_details_markup() is first called. This
+ * avoids converting the details of every update in a large OS update when
+ * only a few of them are ever looked at.
+ *
+ * @func may be called from any thread which calls
+ * gs_app_get_update_details_markup().
+ *
+ * See: gs_app_set_update_details_markup()
+ *
+ * Since: 47
+ **/
+void
+gs_app_set_update_details_lazy (GsApp                  *app,
+                                const gchar            *raw,
+                                GsAppUpdateDetailsFunc  func)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_return_if_fail (GS_IS_APP (app));
+	g_return_if_fail (func != NULL);
+	locker = gs_app_lock (priv);
+	priv->update_details_set = TRUE;
+	g_clear_pointer (&priv->update_details_markup, g_free);
+	g_set_str (&priv->update_details_raw, raw);
+	priv->update_details_func = func;
+}
+
 /**
  * gs_app_get_update_details_set:
  * @app: a #GsApp
@@ -3259,7 +3435,7 @@ gs_app_get_update_details_set (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), FALSE);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return priv->update_details_set;
 }
 
@@ -3366,7 +3542,7 @@ gs_app_set_management_plugin (GsApp    *app,
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (management_plugin == NULL || GS_IS_PLUGIN (management_plugin));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* plugins cannot adopt wildcard packages */
 	if (gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD)) {
@@ -3429,7 +3605,7 @@ gs_app_set_rating (GsApp *app, gint rating)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (rating == priv->rating)
 		return;
 	priv->rating = rating;
@@ -3469,7 +3645,7 @@ gs_app_set_review_ratings (GsApp *app, GArray *review_ratings)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	_g_set_array (&priv->review_ratings, review_ratings);
 }
 
@@ -3507,7 +3683,7 @@ gs_app_add_review (GsApp *app, AsReview *review)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (AS_IS_REVIEW (review));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_ptr_array_add (priv->reviews, g_object_ref (review));
 }
 
@@ -3526,7 +3702,7 @@ gs_app_remove_review (GsApp *app, AsReview *review)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	g_ptr_array_remove (priv->reviews, review);
 }
 
@@ -3595,7 +3771,7 @@ gs_app_add_provided_item (GsApp *app, AsProvidedKind kind, const gchar *item)
 	g_return_if_fail (item != NULL);
 	g_return_if_fail (kind != AS_PROVIDED_KIND_UNKNOWN && kind < AS_PROVIDED_KIND_LAST);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	prov = gs_app_get_provided_for_kind (app, kind);
 	if (prov == NULL) {
 		prov = as_provided_new ();
@@ -4136,6 +4312,36 @@ gs_app_get_metadata_variant (GsApp *app, const gchar *key)
 	return g_hash_table_lookup (priv->metadata, key);
 }
 
+/**
+ * gs_app_dup_metadata_keys:
+ * @app: a #GsApp
+ *
+ * Gets the keys of all the metadata set on @app, sorted, so it can be
+ * serialized.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): the keys
+ *
+ * Since: 47
+ **/
+gchar **
+gs_app_dup_metadata_keys (GsApp *app)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GStrvBuilder) builder = g_strv_builder_new ();
+	g_autoptr(GList) keys = NULL;
+
+	g_return_val_if_fail (GS_IS_APP (app), NULL);
+
+	locker = gs_app_lock (priv);
+
+	keys = g_list_sort (g_hash_table_get_keys (priv->metadata), (GCompareFunc) g_strcmp0);
+	for (GList *l = keys; l != NULL; l = l->next)
+		g_strv_builder_add (builder, l->data);
+
+	return g_strv_builder_end (builder);
+}
+
 /**
  * gs_app_set_metadata_variant:
  * @app: a #GsApp
@@ -4157,7 +4363,7 @@ gs_app_set_metadata_variant (GsApp *app, const gchar *key, GVariant *value)
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* if no value, then remove the key */
 	if (value == NULL) {
@@ -4203,7 +4409,7 @@ gs_app_dup_addons (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return (priv->addons != NULL) ? g_object_ref (priv->addons) : NULL;
 }
 
@@ -4230,7 +4436,7 @@ gs_app_add_addons (GsApp     *app,
 	if (gs_app_list_length (addons) == 0)
 		return;
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->addons != NULL)
 		new_addons = gs_app_list_copy (priv->addons);
@@ -4257,7 +4463,7 @@ gs_app_remove_addon (GsApp *app, GsApp *addon)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (GS_IS_APP (addon));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->addons != NULL)
 		gs_app_list_remove (priv->addons, addon);
@@ -4300,7 +4506,7 @@ gs_app_add_related (GsApp *app, GsApp *app2)
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (GS_IS_APP (app2));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* if the app is updatable-live and any related app is not then
 	 * degrade to the offline state */
@@ -4351,7 +4557,7 @@ gs_app_add_history (GsApp *app, GsApp *app2)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (GS_IS_APP (app2));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	gs_app_list_add (priv->history, app2);
 }
 
@@ -4536,7 +4742,7 @@ gs_app_set_categories (GsApp *app, GPtrArray *categories)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (categories != NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	_g_set_ptr_array (&priv->categories, categories);
 }
 
@@ -4556,7 +4762,7 @@ gs_app_add_category (GsApp *app, const gchar *category)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (category != NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (gs_app_has_category (app, category))
 		return;
 	g_ptr_array_add (priv->categories, g_strdup (category));
@@ -4583,7 +4789,7 @@ gs_app_remove_category (GsApp *app, const gchar *category)
 
 	g_return_val_if_fail (GS_IS_APP (app), FALSE);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	for (i = 0; i < priv->categories->len; i++) {
 		tmp = g_ptr_array_index (priv->categories, i);
@@ -4633,21 +4839,19 @@ gs_app_get_is_update_downloaded (GsApp *app)
 	return priv->is_update_downloaded;
 }
 
-static void
-calculate_key_colors (GsApp *app)
+/* Parses the `GnomeSoftware::key-colors` override for @app, if it has one.
+ * Returns %NULL if it doesn’t, or if it couldn’t be parsed. */
+static GArray *
+parse_key_colors_override (GsApp *app)
 {
-	GsAppPrivate *priv = gs_app_get_instance_private (app);
-	g_autoptr(GIcon) icon_small = NULL;
-	g_autoptr(GdkPixbuf) pb_small = NULL;
 	const gchar *overrides_str;
+	g_autoptr(GVariant) overrides = NULL;
+	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GArray) key_colors = NULL;
+	GVariantIter iter;
+	guint8 red, green, blue;
 
-	/* Lazily create the array */
-	if (priv->key_colors == NULL)
-		priv->key_colors = g_array_new (FALSE, FALSE, sizeof (GdkRGBA));
-	priv->user_key_colors = FALSE;
-
-	/* Look for an override first. Parse and use it if possible. This is
-	 * typically specified in the appdata for an app as:
+	/* This is typically specified in the appdata for an app as:
 	 * |[
 	 * <component>
 	 *   <custom>
@@ -4659,55 +4863,53 @@ calculate_key_colors (GsApp *app)
 	 * Note it's ignored when the appstream data defines `<branding/>` colors.
 	 */
 	overrides_str = gs_app_get_metadata_item (app, "GnomeSoftware::key-colors");
-	if (overrides_str != NULL) {
-		g_autoptr(GVariant) overrides = NULL;
-		g_autoptr(GError) local_error = NULL;
-
-		overrides = g_variant_parse (G_VARIANT_TYPE ("a(yyy)"),
-					     overrides_str,
-					     NULL,
-					     NULL,
-					     &local_error);
-
-		if (overrides != NULL && g_variant_n_children (overrides) > 0) {
-			GVariantIter iter;
-			guint8 red, green, blue;
-
-			g_variant_iter_init (&iter, overrides);
-			while (g_variant_iter_loop (&iter, "(yyy)", &red, &green, &blue)) {
-				GdkRGBA rgba;
-				rgba.red = (gdouble) red / 255.0;
-				rgba.green = (gdouble) green / 255.0;
-				rgba.blue = (gdouble) blue / 255.0;
-				rgba.alpha = 1.0;
-				g_array_append_val (priv->key_colors, rgba);
-			}
+	if (overrides_str == NULL)
+		return NULL;
 
-			priv->user_key_colors = TRUE;
+	overrides = g_variant_parse (G_VARIANT_TYPE ("a(yyy)"),
+				     overrides_str,
+				     NULL,
+				     NULL,
+				     &local_error);
 
-			return;
-		} else {
-			g_warning ("Invalid value for GnomeSoftware::key-colors for %s: %s",
-				   gs_app_get_id (app), local_error->message);
-			/* fall through */
-		}
+	if (overrides == NULL || g_variant_n_children (overrides) == 0) {
+		g_warning ("Invalid value for GnomeSoftware::key-colors for %s: %s",
+			   gs_app_get_id (app),
+			   (local_error != NULL) ? local_error->message : "No colors");
+		return NULL;
 	}
 
-	/* Try and load the pixbuf. */
-	icon_small = gs_app_get_icon_for_size (app, 32, 1, NULL);
+	key_colors = g_array_new (FALSE, FALSE, sizeof (GdkRGBA));
 
-	if (icon_small == NULL) {
-		g_debug ("no pixbuf, so no key colors");
-		return;
-	} else if (G_IS_LOADABLE_ICON (icon_small)) {
-		g_autoptr(GInputStream) icon_stream = g_loadable_icon_load (G_LOADABLE_ICON (icon_small), 32, NULL, NULL, NULL);
+	g_variant_iter_init (&iter, overrides);
+	while (g_variant_iter_loop (&iter, "(yyy)", &red, &green, &blue)) {
+		GdkRGBA rgba;
+		rgba.red = (gdouble) red / 255.0;
+		rgba.green = (gdouble) green / 255.0;
+		rgba.blue = (gdouble) blue / 255.0;
+		rgba.alpha = 1.0;
+		g_array_append_val (key_colors, rgba);
+	}
+
+	return g_steal_pointer (&key_colors);
+}
+
+/* Load @icon as a 32×32 pixbuf. This does blocking I/O. */
+static GdkPixbuf *
+load_key_colors_pixbuf (GsApp *app,
+			GIcon *icon)
+{
+	g_autoptr(GdkPixbuf) pb_small = NULL;
+
+	if (G_IS_LOADABLE_ICON (icon)) {
+		g_autoptr(GInputStream) icon_stream = g_loadable_icon_load (G_LOADABLE_ICON (icon), 32, NULL, NULL, NULL);
 		if (icon_stream)
 			pb_small = gdk_pixbuf_new_from_stream_at_scale (icon_stream, 32, 32, TRUE, NULL, NULL);
-	} else if (G_IS_THEMED_ICON (icon_small)) {
+	} else if (G_IS_THEMED_ICON (icon)) {
 		g_autoptr(GtkIconPaintable) icon_paintable = NULL;
 		g_autoptr(GtkIconTheme) theme = get_icon_theme ();
 
-		icon_paintable = gtk_icon_theme_lookup_by_gicon (theme, icon_small,
+		icon_paintable = gtk_icon_theme_lookup_by_gicon (theme, icon,
 								 32, 1,
 								 gtk_get_locale_direction (),
 								 0);
@@ -4722,7 +4924,7 @@ calculate_key_colors (GsApp *app)
 			if (path != NULL) {
 				pb_small = gdk_pixbuf_new_from_file_at_size (path, 32, 32, NULL);
 			} else {
-				const gchar *const *names = g_themed_icon_get_names (G_THEMED_ICON (icon_small));
+				const gchar *const *names = g_themed_icon_get_names (G_THEMED_ICON (icon));
 				for (guint i = 0; names != NULL && names[i] != NULL && pb_small == NULL; i++) {
 					g_autoptr(GError) local_error = NULL;
 					g_autofree gchar *resource_path = NULL;
@@ -4733,20 +4935,95 @@ calculate_key_colors (GsApp *app)
 				}
 			}
 		}
-
 	} else {
-		g_debug ("unsupported pixbuf, so no key colors");
-		return;
+		g_debug ("unsupported pixbuf for %s, so no key colors", gs_app_get_id (app));
+		return NULL;
 	}
 
-	if (pb_small == NULL) {
-		g_debug ("pixbuf couldn’t be loaded, so no key colors");
+	if (pb_small == NULL)
+		g_debug ("pixbuf for %s couldn’t be loaded, so no key colors", gs_app_get_id (app));
+
+	return g_steal_pointer (&pb_small);
+}
+
+/**
+ * gs_app_ensure_key_colors:
+ * @app: a #GsApp
+ * @icon_cache: (nullable) (element-type GIcon GArray): cache of key colors
+ *   which have already been calculated for icons, or %NULL to not use one
+ *
+ * Calculate the key colors for @app from its `GnomeSoftware::key-colors`
+ * override, or from its icon, if they have not already been set.
+ *
+ * This does blocking I/O to load and decode the icon, so must not be called
+ * from the main thread. It is used by #GsPluginJobRefine to service
+ * %GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON for a whole list of apps at once.
+ *
+ * Apps frequently share the same icon (themed fallback icons, or several
+ * components provided by the same package), so pass the same @icon_cache
+ * for all the apps in a list to avoid decoding each icon more than once. It
+ * must be created with g_icon_hash() and g_icon_equal(), and own its keys
+ * and values.
+ *
+ * Since: 47
+ **/
+void
+gs_app_ensure_key_colors (GsApp      *app,
+			  GHashTable *icon_cache)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GArray) key_colors = NULL;
+	g_autoptr(GIcon) icon_small = NULL;
+	gboolean user_key_colors = FALSE;
+
+	g_return_if_fail (GS_IS_APP (app));
+
+	locker = gs_app_lock (priv);
+	if (priv->key_colors != NULL)
 		return;
+	g_clear_pointer (&locker, g_mutex_locker_free);
+
+	/* Look for an override first. Parse and use it if possible. */
+	key_colors = parse_key_colors_override (app);
+	if (key_colors != NULL)
+		user_key_colors = TRUE;
+
+	/* Otherwise, try and load the pixbuf, reusing the results for
+	 * any other app which has the same icon. */
+	if (key_colors == NULL)
+		icon_small = gs_app_get_icon_for_size (app, 32, 1, NULL);
+
+	if (key_colors == NULL && icon_small == NULL) {
+		g_debug ("no pixbuf for %s, so no key colors", gs_app_get_id (app));
+		key_colors = g_array_new (FALSE, FALSE, sizeof (GdkRGBA));
+	} else if (key_colors == NULL) {
+		GArray *cached = (icon_cache != NULL) ? g_hash_table_lookup (icon_cache, icon_small) : NULL;
+
+		if (cached != NULL) {
+			key_colors = g_array_ref (cached);
+		} else {
+			g_autoptr(GdkPixbuf) pb_small = load_key_colors_pixbuf (app, icon_small);
+
+			if (pb_small != NULL)
+				key_colors = gs_calculate_key_colors (pb_small);
+			else
+				key_colors = g_array_new (FALSE, FALSE, sizeof (GdkRGBA));
+
+			if (icon_cache != NULL)
+				g_hash_table_insert (icon_cache, g_object_ref (icon_small), g_array_ref (key_colors));
+		}
 	}
 
-	/* get a list of key colors */
-	g_clear_pointer (&priv->key_colors, g_array_unref);
-	priv->key_colors = gs_calculate_key_colors (pb_small);
+	/* Something else may have set them in the meantime, in which case
+	 * that takes precedence. */
+	locker = gs_app_lock (priv);
+	if (priv->key_colors != NULL)
+		return;
+
+	priv->key_colors = g_steal_pointer (&key_colors);
+	priv->user_key_colors = user_key_colors;
+	gs_app_queue_notify (app, obj_props[PROP_KEY_COLORS]);
 }
 
 /**
@@ -4755,7 +5032,12 @@ calculate_key_colors (GsApp *app)
  *
  * Gets the key colors used in the application icon.
  *
- * Returns: (element-type GdkRGBA) (transfer none): a list
+ * These are calculated when the app is refined with
+ * %GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON, or can be set explicitly with
+ * gs_app_set_key_colors(). Until then, %NULL is returned.
+ *
+ * Returns: (element-type GdkRGBA) (transfer none) (nullable): a list, or %NULL
+ *   if the key colors are not known yet
  *
  * Since: 40
  **/
@@ -4765,9 +5047,6 @@ gs_app_get_key_colors (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 
-	if (priv->key_colors == NULL)
-		calculate_key_colors (app);
-
 	return priv->key_colors;
 }
 
@@ -4787,7 +5066,7 @@ gs_app_set_key_colors (GsApp *app, GArray *key_colors)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (key_colors != NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	priv->user_key_colors = FALSE;
 	if (_g_set_array (&priv->key_colors, key_colors))
 		gs_app_queue_notify (app, obj_props[PROP_KEY_COLORS]);
@@ -5147,7 +5426,7 @@ gs_app_add_quirk (GsApp *app, GsAppQuirk quirk)
 	if ((priv->quirk & quirk) > 0)
 		return;
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	priv->quirk |= quirk;
 	gs_app_queue_notify (app, obj_props[PROP_QUIRK]);
 }
@@ -5172,7 +5451,7 @@ gs_app_remove_quirk (GsApp *app, GsAppQuirk quirk)
 	if ((priv->quirk & quirk) == 0)
 		return;
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	priv->quirk &= ~quirk;
 	gs_app_queue_notify (app, obj_props[PROP_QUIRK]);
 }
@@ -5287,7 +5566,7 @@ gs_app_get_cancellable (GsApp *app)
 
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->cancellable == NULL || g_cancellable_is_cancelled (priv->cancellable)) {
 		cancellable = g_cancellable_new ();
@@ -5315,7 +5594,7 @@ gs_app_peek_cancellable (GsApp *app)
 
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (priv->cancellable)
 		return g_object_ref (priv->cancellable);
 
@@ -5336,7 +5615,7 @@ gs_app_get_pending_action (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), GS_PLUGIN_ACTION_UNKNOWN);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return priv->pending_action;
 }
 
@@ -5354,7 +5633,7 @@ gs_app_set_pending_action (GsApp *app,
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	gs_app_set_pending_action_internal (app, action);
 }
 
@@ -5643,6 +5922,15 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 	}
 }
 
+static void
+clear_version_history_loader (GsAppPrivate *priv)
+{
+	priv->version_history_loader = NULL;
+	g_clear_pointer (&priv->version_history_loader_data, g_bytes_unref);
+	g_clear_pointer (&priv->latest_releases, g_ptr_array_unref);
+	priv->latest_releases_max = 0;
+}
+
 static void
 gs_app_dispose (GObject *object)
 {
@@ -5660,6 +5948,7 @@ gs_app_dispose (GObject *object)
 	g_clear_pointer (&priv->provided, g_ptr_array_unref);
 	g_clear_pointer (&priv->icons, g_ptr_array_unref);
 	g_clear_pointer (&priv->version_history, g_ptr_array_unref);
+	clear_version_history_loader (priv);
 	g_clear_pointer (&priv->relations, g_ptr_array_unref);
 	g_weak_ref_clear (&priv->management_plugin_weak);
 
@@ -5700,6 +5989,7 @@ gs_app_finalize (GObject *object)
 	g_free (priv->update_version);
 	g_free (priv->update_version_ui);
 	g_free (priv->update_details_markup);
+	g_free (priv->update_details_raw);
 	g_hash_table_unref (priv->metadata);
 	g_ptr_array_unref (priv->categories);
 	g_clear_pointer (&priv->key_colors, g_array_unref);
@@ -6318,6 +6608,105 @@ gs_app_new_from_unique_id (const gchar *unique_id)
 	return app;
 }
 
+struct _GsAppBuilder {
+	GsApp *app;  /* (owned) (not nullable) */
+};
+
+/**
+ * gs_app_builder_new:
+ * @id: (nullable): an application ID, or %NULL
+ *
+ * Start building a new #GsApp with the given @id.
+ *
+ * Until it is published with gs_app_builder_end(), the app is only reachable
+ * through the builder, so the usual gs_app_set_*() and gs_app_add_*()
+ * functions can be called on gs_app_builder_get_app() without taking the
+ * app’s lock or queueing property notifications. This makes constructing
+ * large numbers of apps in a plugin noticeably cheaper.
+ *
+ * The app must not be added to a #GsAppList, the plugin cache, or anything
+ * else which another thread may look at, until it has been published.
+ *
+ * Returns: (transfer full): a new #GsAppBuilder
+ * Since: 47
+ */
+GsAppBuilder *
+gs_app_builder_new (const gchar *id)
+{
+	GsAppBuilder *builder = g_new0 (GsAppBuilder, 1);
+	GsAppPrivate *priv;
+
+	builder->app = g_object_new (GS_TYPE_APP, NULL);
+	priv = gs_app_get_instance_private (builder->app);
+	priv->building = TRUE;
+	priv->id = g_strdup (id);
+
+	return builder;
+}
+
+/**
+ * gs_app_builder_get_app:
+ * @builder: a #GsAppBuilder
+ *
+ * Get the app being built, to set its properties.
+ *
+ * Returns: (transfer none) (not nullable): the unpublished app
+ * Since: 47
+ */
+GsApp *
+gs_app_builder_get_app (GsAppBuilder *builder)
+{
+	g_return_val_if_fail (builder != NULL, NULL);
+
+	return builder->app;
+}
+
+/**
+ * gs_app_builder_end:
+ * @builder: (transfer full): a #GsAppBuilder
+ *
+ * Publish the app which @builder was building, and free @builder. From now on
+ * the app is locked and notifies property changes as normal.
+ *
+ * Returns: (transfer full) (not nullable): the finished app
+ * Since: 47
+ */
+GsApp *
+gs_app_builder_end (GsAppBuilder *builder)
+{
+	GsApp *app;
+	GsAppPrivate *priv;
+
+	g_return_val_if_fail (builder != NULL, NULL);
+
+	app = g_steal_pointer (&builder->app);
+	g_free (builder);
+
+	/* Whatever the caller then does to hand @app to another thread (a
+	 * #GTask, a locked cache, a list) provides the memory barrier. */
+	priv = gs_app_get_instance_private (app);
+	priv->building = FALSE;
+
+	return app;
+}
+
+/**
+ * gs_app_builder_free:
+ * @builder: (transfer full): a #GsAppBuilder
+ *
+ * Abandon building an app, and free @builder and the app.
+ *
+ * Since: 47
+ */
+void
+gs_app_builder_free (GsAppBuilder *builder)
+{
+	g_return_if_fail (builder != NULL);
+
+	g_object_unref (builder->app);
+	g_free (builder);
+}
+
 /**
  * gs_app_dup_origin_ui:
  * @app: a #GsApp
@@ -6353,7 +6742,7 @@ gs_app_dup_origin_ui (GsApp *app,
 	}
 
 	priv = gs_app_get_instance_private (app);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (!origin_str) {
 		origin_str = priv->origin_ui;
@@ -6405,7 +6794,7 @@ gs_app_set_origin_ui (GsApp *app,
 	g_return_if_fail (GS_IS_APP (app));
 
 	priv = gs_app_get_instance_private (app);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (origin_ui && !*origin_ui)
 		origin_ui = NULL;
@@ -6547,7 +6936,7 @@ gs_app_dup_permissions (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return priv->permissions ? g_object_ref (priv->permissions) : NULL;
 }
 
@@ -6572,7 +6961,7 @@ gs_app_set_permissions (GsApp *app,
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (permissions == NULL || gs_app_permissions_is_sealed (permissions));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (priv->permissions == permissions)
 		return;
 	g_clear_object (&priv->permissions);
@@ -6601,7 +6990,7 @@ gs_app_dup_update_permissions (GsApp *app)
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return priv->update_permissions ? g_object_ref (priv->update_permissions) : NULL;
 }
 
@@ -6626,7 +7015,7 @@ gs_app_set_update_permissions (GsApp *app,
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (update_permissions == NULL || gs_app_permissions_is_sealed (update_permissions));
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	if (priv->update_permissions != update_permissions) {
 		g_clear_object (&priv->update_permissions);
 		if (update_permissions != NULL)
@@ -6641,6 +7030,9 @@ gs_app_set_update_permissions (GsApp *app,
  * Gets the list of past releases for an application (including the latest
  * one).
  *
+ * If the version history is loaded lazily, this loads all of it. Use
+ * gs_app_get_latest_releases() if only the newest few releases are needed.
+ *
  * Returns: (element-type AsRelease) (transfer container) (nullable): a list, or
  *     %NULL if the version history is not known
  *
@@ -6650,13 +7042,123 @@ GPtrArray *
 gs_app_get_version_history (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
-	g_autoptr(GMutexLocker) locker = NULL;
+	GsAppVersionHistoryLoader loader = NULL;
+	g_autoptr(GBytes) loader_data = NULL;
+	g_autoptr(GPtrArray) version_history = NULL;
+	g_return_val_if_fail (GS_IS_APP (app), NULL);
+
+	{
+		g_autoptr(GMutexLocker) locker = gs_app_lock (priv);
+
+		if (priv->version_history != NULL)
+			return g_ptr_array_ref (priv->version_history);
+		if (priv->version_history_loader == NULL)
+			return NULL;
+
+		loader = priv->version_history_loader;
+		if (priv->version_history_loader_data != NULL)
+			loader_data = g_bytes_ref (priv->version_history_loader_data);
+	}
+
+	/* load outside the lock, as formatting the release descriptions can
+	 * be slow and this is typically called from the main thread */
+	version_history = loader (app, 0, loader_data);
+	if (version_history != NULL && version_history->len == 0)
+		g_clear_pointer (&version_history, g_ptr_array_unref);
+
+	{
+		g_autoptr(GMutexLocker) locker = gs_app_lock (priv);
+
+		/* only store the result if the loader wasn’t replaced meanwhile */
+		if (priv->version_history_loader == loader &&
+		    priv->version_history_loader_data == loader_data) {
+			clear_version_history_loader (priv);
+			_g_set_ptr_array (&priv->version_history, version_history);
+		}
+	}
+
+	return g_steal_pointer (&version_history);
+}
+
+/* Returns a new array holding the first @max_releases of @releases. */
+static GPtrArray *
+copy_newest_releases (GPtrArray *releases,
+                      guint      max_releases)
+{
+	GPtrArray *copy = g_ptr_array_new_full (MIN (max_releases, releases->len), g_object_unref);
+
+	for (guint i = 0; i < releases->len && i < max_releases; i++)
+		g_ptr_array_add (copy, g_object_ref (g_ptr_array_index (releases, i)));
+
+	return copy;
+}
+
+/**
+ * gs_app_get_latest_releases:
+ * @app: a #GsApp
+ * @max_releases: maximum number of releases to return, greater than zero
+ *
+ * Gets the newest @max_releases releases from the version history of @app,
+ * newest first.
+ *
+ * Unlike gs_app_get_version_history(), this doesn’t load the whole version
+ * history if it is loaded lazily, which can be a lot of work for apps with
+ * a long history. The releases it loads are cached, so calling it again with
+ * the same or a smaller @max_releases is cheap.
+ *
+ * Returns: (element-type AsRelease) (transfer container) (nullable): a list, or
+ *     %NULL if the version history is not known
+ *
+ * Since: 47
+ **/
+GPtrArray *
+gs_app_get_latest_releases (GsApp *app,
+                            guint  max_releases)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	GsAppVersionHistoryLoader loader = NULL;
+	g_autoptr(GBytes) loader_data = NULL;
+	g_autoptr(GPtrArray) releases = NULL;
+
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
+	g_return_val_if_fail (max_releases > 0, NULL);
+
+	{
+		g_autoptr(GMutexLocker) locker = gs_app_lock (priv);
+
+		if (priv->version_history != NULL) {
+			return copy_newest_releases (priv->version_history, max_releases);
+		} else if (priv->latest_releases != NULL &&
+			   (max_releases <= priv->latest_releases_max ||
+			    priv->latest_releases->len < priv->latest_releases_max)) {
+			/* enough releases were loaded before, or all there are */
+			return copy_newest_releases (priv->latest_releases, max_releases);
+		} else if (priv->version_history_loader != NULL) {
+			loader = priv->version_history_loader;
+			if (priv->version_history_loader_data != NULL)
+				loader_data = g_bytes_ref (priv->version_history_loader_data);
+		}
+	}
+
+	if (loader == NULL)
+		return NULL;
 
-	locker = g_mutex_locker_new (&priv->mutex);
-	if (priv->version_history == NULL)
+	releases = loader (app, max_releases, loader_data);
+	if (releases == NULL || releases->len == 0)
 		return NULL;
-	return g_ptr_array_ref (priv->version_history);
+
+	{
+		g_autoptr(GMutexLocker) locker = gs_app_lock (priv);
+
+		/* only cache the result if the loader wasn’t replaced meanwhile */
+		if (priv->version_history_loader == loader &&
+		    priv->version_history_loader_data == loader_data) {
+			_g_set_ptr_array (&priv->latest_releases, releases);
+			priv->latest_releases_max = max_releases;
+		}
+	}
+
+	return copy_newest_releases (releases, max_releases);
 }
 
 /**
@@ -6667,6 +7169,8 @@ gs_app_get_version_history (GsApp *app)
  *
  * Set the list of past releases for an application (including the latest one).
  *
+ * This replaces any loader set with gs_app_set_version_history_loader().
+ *
  * Since: 40
  **/
 void
@@ -6679,10 +7183,69 @@ gs_app_set_version_history (GsApp *app, GPtrArray *version_history)
 	if (version_history != NULL && version_history->len == 0)
 		version_history = NULL;
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
+	clear_version_history_loader (priv);
 	_g_set_ptr_array (&priv->version_history, version_history);
 }
 
+/**
+ * gs_app_set_version_history_loader:
+ * @app: a #GsApp
+ * @loader: (nullable): function to load the version history
+ * @data: (nullable): data to pass to @loader
+ *
+ * Set a function to load the version history of @app on demand, rather than
+ * setting it up front with gs_app_set_version_history().
+ *
+ * @loader is called without the app’s lock held. Once it has loaded the whole
+ * history for gs_app_get_version_history(), the result is stored and @loader
+ * and @data are dropped. Until then it may also be called to load the newest
+ * few releases for gs_app_get_latest_releases(), which are cached until a
+ * call asks for more of them.
+ *
+ * @data should hold everything @loader needs, rather than references to
+ * larger objects which would then be kept alive for the lifetime of @app.
+ *
+ * Since: 47
+ **/
+void
+gs_app_set_version_history_loader (GsApp                     *app,
+                                   GsAppVersionHistoryLoader  loader,
+                                   GBytes                    *data)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_return_if_fail (GS_IS_APP (app));
+
+	locker = gs_app_lock (priv);
+	g_clear_pointer (&priv->version_history, g_ptr_array_unref);
+	clear_version_history_loader (priv);
+	priv->version_history_loader = loader;
+	priv->version_history_loader_data = (data != NULL) ? g_bytes_ref (data) : NULL;
+}
+
+/**
+ * gs_app_has_version_history:
+ * @app: a #GsApp
+ *
+ * Gets whether the version history of @app is known, either because it has
+ * been set or because it can be loaded on demand. This doesn’t load it.
+ *
+ * Returns: %TRUE if the version history is known
+ *
+ * Since: 47
+ **/
+gboolean
+gs_app_has_version_history (GsApp *app)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_return_val_if_fail (GS_IS_APP (app), FALSE);
+
+	locker = gs_app_lock (priv);
+	return priv->version_history != NULL || priv->version_history_loader != NULL;
+}
+
 /**
  * gs_app_ensure_icons_downloaded:
  * @app: a #GsApp
@@ -6708,7 +7271,7 @@ gs_app_ensure_icons_downloaded (GsApp *app,
 	g_return_if_fail (GS_IS_APP (app));
 
 	priv = gs_app_get_instance_private (app);
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	/* process all icons */
 	icons = priv->icons;
@@ -6754,7 +7317,7 @@ gs_app_get_relations (GsApp *app)
 
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 	return (priv->relations != NULL) ? g_ptr_array_ref (priv->relations) : NULL;
 }
 
@@ -6778,7 +7341,7 @@ gs_app_add_relation (GsApp      *app,
 	g_return_if_fail (GS_IS_APP (app));
 	g_return_if_fail (AS_IS_RELATION (relation));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->relations == NULL)
 		priv->relations = g_ptr_array_new_with_free_func (g_object_unref);
@@ -6808,7 +7371,7 @@ gs_app_set_relations (GsApp     *app,
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (relations == NULL && priv->relations == NULL)
 		return;
@@ -6859,7 +7422,7 @@ gs_app_set_has_translations (GsApp    *app,
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->has_translations == has_translations)
 		return;
@@ -6938,7 +7501,7 @@ gs_app_set_icons_state (GsApp           *app,
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->icons_state == icons_state)
 		return;
@@ -7019,7 +7582,7 @@ gs_app_set_mok_key_pending (GsApp    *app,
 
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->mutex);
+	locker = gs_app_lock (priv);
 
 	if (priv->mok_key_pending == mok_key_pending)
 		return;
@@ -249,6 +249,20 @@ typedef enum {
  */
 #define GS_APP_PROGRESS_UNKNOWN G_MAXUINT
 
+/**
+ * GsAppUpdateDetailsFunc:
+ * @raw: update details in the format they were provided in
+ *
+ * Converts update details set with gs_app_set_update_details_lazy() into
+ * Pango markup. This is called with the app locked, so must not call any
+ * #GsApp methods.
+ *
+ * Returns: (transfer full) (nullable): Pango markup
+ *
+ * Since: 47
+ */
+typedef gchar *(*GsAppUpdateDetailsFunc) (const gchar *raw);
+
 const gchar 	*gs_app_state_to_string (GsAppState state);
 
 GsApp		*gs_app_new			(const gchar	*id);
@@ -381,6 +395,9 @@ void		 gs_app_set_update_details_markup
 						 const gchar	*markup);
 void		 gs_app_set_update_details_text	(GsApp		*app,
 						 const gchar	*text);
+void		 gs_app_set_update_details_lazy	(GsApp		*app,
+						 const gchar	*raw,
+						 GsAppUpdateDetailsFunc func);
 gboolean	 gs_app_get_update_details_set	(GsApp		*app);
 AsUrgencyKind	 gs_app_get_update_urgency	(GsApp		*app);
 void		 gs_app_set_update_urgency	(GsApp		*app,
@@ -544,6 +561,8 @@ GsAppPermissions *
 void		 gs_app_set_update_permissions	(GsApp		*app,
 						 GsAppPermissions *update_permissions);
 GPtrArray	*gs_app_get_version_history	(GsApp		*app);
+GPtrArray	*gs_app_get_latest_releases	(GsApp		*app,
+						 guint		 max_releases);
 void		 gs_app_set_version_history	(GsApp		*app,
 						 GPtrArray	*version_history);
 void		gs_app_ensure_icons_downloaded	(GsApp		*app,
@@ -13,6 +13,7 @@
 #include <gnome-software.h>
 #include <locale.h>
 
+#include "gs-app-private.h"
 #include "gs-external-appstream-utils.h"
 #include "gs-appstream.h"
 
@@ -34,38 +35,50 @@ gs_appstream_create_app (GsPlugin *plugin,
 			 GError **error)
 {
 	GsApp *app;
+	GsApp *app_unpublished;  /* (unowned) */
+	g_autoptr(GsAppBuilder) builder = NULL;
 	g_autoptr(GsApp) app_new = NULL;
 
 	/* The 'plugin' can be NULL, when creating app for --show-metainfo */
 	g_return_val_if_fail (XB_IS_SILO (silo), NULL);
 	g_return_val_if_fail (XB_IS_NODE (component), NULL);
 
-	app_new = gs_app_new (NULL);
+	/* nothing else can see the app until it’s published, so it can be
+	 * filled in without locking */
+	builder = gs_app_builder_new (NULL);
+	app_unpublished = gs_app_builder_get_app (builder);
 
 	/* refine enough to get the unique ID */
-	if (!gs_appstream_refine_app (plugin, app_new, silo, component,
+	if (!gs_appstream_refine_app (plugin, app_unpublished, silo, component,
 				      GS_PLUGIN_REFINE_FLAGS_REQUIRE_ID,
 				      NULL, appstream_source_file, default_scope, error))
 		return NULL;
 
+	/* look for existing object, before publishing the new one */
+	if (plugin != NULL &&
+	    !gs_app_has_quirk (app_unpublished, GS_APP_QUIRK_IS_WILDCARD)) {
+		app = gs_plugin_cache_lookup (plugin, gs_app_get_unique_id (app_unpublished));
+		if (app != NULL)
+			return app;
+	}
+
+	app_new = gs_app_builder_end (g_steal_pointer (&builder));
+
 	/* never add wildcard apps to the plugin cache, and only add to
 	 * the cache if it’s available */
 	if (gs_app_has_quirk (app_new, GS_APP_QUIRK_IS_WILDCARD) || plugin == NULL)
 		return g_steal_pointer (&app_new);
 
-	if (plugin == NULL)
-		return g_steal_pointer (&app_new);
-
-	/* look for existing object */
-	app = gs_plugin_cache_lookup (plugin, gs_app_get_unique_id (app_new));
-	if (app != NULL)
-		return app;
+	/* another plugin may already have created this app, in which case
+	 * share its instance rather than carrying a second copy around */
+	app = gs_plugin_intern_app (plugin, app_new);
 
 	/* use the temp object we just created */
-	gs_app_set_metadata (app_new, "GnomeSoftware::Creator",
-			     gs_plugin_get_name (plugin));
-	gs_plugin_cache_add (plugin, NULL, app_new);
-	return g_steal_pointer (&app_new);
+	if (app == app_new)
+		gs_app_set_metadata (app, "GnomeSoftware::Creator",
+				     gs_plugin_get_name (plugin));
+	gs_plugin_cache_add (plugin, NULL, app);
+	return app;
 }
 
 /* Helper function to do the equivalent of
@@ -644,6 +657,102 @@ gs_appstream_find_description_and_issues_nodes (XbNode *release_node,
 		*out_issues_node = g_steal_pointer (&issues_node);
 }
 
+/* Whether the <releases> node has any <release> with a version, as the
+ * others are ignored when loading the version history. */
+static gboolean
+gs_appstream_has_versioned_release (XbNode *releases_node)
+{
+	for (g_autoptr(XbNode) n = xb_node_get_child (releases_node); n != NULL; node_set_to_next (&n)) {
+		if (g_strcmp0 (xb_node_get_element (n), "release") == 0 &&
+		    xb_node_get_attr (n, "version") != NULL)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Implements #GsAppVersionHistoryLoader for a <releases> node, which is
+ * exported as XML into @data so the app doesn’t keep the whole silo alive.
+ * Formatting the release descriptions is the expensive part, so it’s only
+ * done for the releases which are asked for. */
+static GPtrArray *
+gs_appstream_load_version_history (GsApp    *app,
+                                   guint     max_releases,
+                                   GBytes   *data)
+{
+	g_autoptr(XbBuilder) builder = xb_builder_new ();
+	g_autoptr(XbBuilderSource) source = xb_builder_source_new ();
+	g_autoptr(XbSilo) silo = NULL;
+	g_autoptr(XbNode) releases_node = NULL;
+	g_autoptr(GPtrArray) version_history = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(XbNode) rels_child = NULL;
+	g_autoptr(XbNode) rels_next = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	/* the text was already normalised when building the original silo */
+	if (!xb_builder_source_load_xml (source, g_bytes_get_data (data, NULL),
+					 XB_BUILDER_SOURCE_FLAG_LITERAL_TEXT, &local_error)) {
+		g_warning ("Failed to load version history for %s: %s",
+			   gs_app_get_unique_id (app), local_error->message);
+		return NULL;
+	}
+	xb_builder_import_source (builder, source);
+	silo = xb_builder_compile (builder, XB_BUILDER_COMPILE_FLAG_NONE, NULL, &local_error);
+	if (silo == NULL) {
+		g_warning ("Failed to load version history for %s: %s",
+			   gs_app_get_unique_id (app), local_error->message);
+		return NULL;
+	}
+	releases_node = xb_silo_get_root (silo);
+	if (releases_node == NULL)
+		return NULL;
+
+	for (rels_child = xb_node_get_child (releases_node);
+	     rels_child != NULL && (max_releases == 0 || version_history->len < max_releases);
+	     g_object_unref (rels_child), rels_child = g_steal_pointer (&rels_next)) {
+		g_autoptr(XbNode) description_node = NULL;
+		g_autoptr(XbNode) issues_node = NULL;
+		g_autoptr(AsRelease) release = NULL;
+		g_autofree gchar *description = NULL;
+		const gchar *version;
+		guint64 timestamp;
+		const gchar *date_str;
+
+		rels_next = xb_node_get_next (rels_child);
+		if (g_strcmp0 (xb_node_get_element (rels_child), "release") != 0)
+			continue;
+
+		version = xb_node_get_attr (rels_child, "version");
+		/* ignore releases with no version */
+		if (version == NULL)
+			continue;
+
+		timestamp = xb_node_get_attr_as_uint (rels_child, "timestamp");
+		date_str = xb_node_get_attr (rels_child, "date");
+
+		/* include updates with or without a description */
+		gs_appstream_find_description_and_issues_nodes (rels_child, &description_node, &issues_node);
+		if (description_node != NULL || issues_node != NULL)
+			description = gs_appstream_format_description (description_node, issues_node);
+
+		release = as_release_new ();
+		as_release_set_version (release, version);
+		if (timestamp != G_MAXUINT64)
+			as_release_set_timestamp (release, timestamp);
+		else if (date_str != NULL)  /* timestamp takes precedence over date */
+			as_release_set_date (release, date_str);
+		if (description != NULL)
+			as_release_set_description (release, description, NULL);
+
+		g_ptr_array_add (version_history, g_steal_pointer (&release));
+	}
+
+	if (version_history->len == 0)
+		return NULL;
+
+	return g_steal_pointer (&version_history);
+}
+
 typedef enum {
 	ELEMENT_KIND_UNKNOWN = -1,
 	ELEMENT_KIND_BRANDING,
@@ -1205,8 +1314,8 @@ gs_appstream_refine_app (GsPlugin *plugin,
 			}
 			break;
 		case ELEMENT_KIND_RELEASES: {
-			g_autoptr(GPtrArray) current_version_history = gs_app_get_version_history (app);
-			gboolean needs_version_history = current_version_history == NULL || current_version_history->len == 0;
+			gboolean needs_version_history = (refine_flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_HISTORY) != 0 &&
+							 !gs_app_has_version_history (app);
 			gboolean needs_update_details = (refine_flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_UPDATE_DETAILS) != 0 &&
 							silo != NULL && gs_app_is_updatable (app);
 			/* set the release date */
@@ -1230,51 +1339,64 @@ gs_appstream_refine_app (GsPlugin *plugin,
 					}
 				}
 			}
-			if (needs_version_history || needs_update_details) {
-				g_autoptr(GPtrArray) version_history = NULL; /* (element-type AsRelease) */
+			/* the releases are only exported when the version history
+			 * is requested, and only parsed when it’s needed, as the
+			 * UI rarely shows more than the newest release */
+			if (needs_version_history && gs_appstream_has_versioned_release (child)) {
+				g_autofree gchar *xml = NULL;
+				g_autoptr(GError) local_error = NULL;
+
+				xml = xb_node_export (child, XB_NODE_EXPORT_FLAG_NONE, &local_error);
+				if (xml != NULL) {
+					g_autoptr(GBytes) data = NULL;
+					gsize xml_len = strlen (xml) + 1;
+
+					data = g_bytes_new_take (g_steal_pointer (&xml), xml_len);
+					gs_app_set_version_history_loader (app, gs_appstream_load_version_history, data);
+				} else {
+					g_debug ("Failed to export releases for %s: %s",
+						 gs_app_get_unique_id (app), local_error->message);
+				}
+			}
+			if (needs_update_details) {
 				g_autoptr(GHashTable) installed = NULL;
 				g_autoptr(GPtrArray) updates_list = NULL;
 				g_autoptr(XbNode) rels_child = NULL;
 				g_autoptr(XbNode) rels_next = NULL;
 				AsUrgencyKind urgency_best = AS_URGENCY_KIND_UNKNOWN;
 				guint i;
-
-				if (needs_update_details) {
-					g_autofree gchar *xpath = NULL;
-					g_autoptr(GPtrArray) releases_inst = NULL;
-					g_autoptr(GError) local_error = NULL;
-
-					installed = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
-					updates_list = g_ptr_array_new_with_free_func (g_object_unref);
-
-					/* find out which releases are already installed */
-					xpath = g_strdup_printf ("component/id[text()='%s']/../releases/*[@version]",
-								 gs_app_get_id (app));
-					releases_inst = xb_silo_query (silo, xpath, 0, &local_error);
-					if (releases_inst == NULL) {
-						if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
-							g_propagate_error (error, g_steal_pointer (&local_error));
-							return FALSE;
-						}
-					} else {
-						for (i = 0; i < releases_inst->len; i++) {
-							XbNode *release = g_ptr_array_index (releases_inst, i);
-							g_hash_table_insert (installed,
-									     (gpointer) xb_node_get_attr (release, "version"),
-									     g_object_ref (release));
-						}
+				g_autofree gchar *xpath = NULL;
+				g_autoptr(GPtrArray) releases_inst = NULL;
+				g_autoptr(GError) local_error = NULL;
+
+				installed = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+				updates_list = g_ptr_array_new_with_free_func (g_object_unref);
+
+				/* find out which releases are already installed */
+				xpath = g_strdup_printf ("component/id[text()='%s']/../releases/*[@version]",
+							 gs_app_get_id (app));
+				releases_inst = xb_silo_query (silo, xpath, 0, &local_error);
+				if (releases_inst == NULL) {
+					if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+						g_propagate_error (error, g_steal_pointer (&local_error));
+						return FALSE;
+					}
+				} else {
+					for (i = 0; i < releases_inst->len; i++) {
+						XbNode *release = g_ptr_array_index (releases_inst, i);
+						g_hash_table_insert (installed,
+								     (gpointer) xb_node_get_attr (release, "version"),
+								     g_object_ref (release));
 					}
-					g_clear_error (&local_error);
 				}
-
-				if (needs_version_history)
-					version_history = g_ptr_array_new_with_free_func (g_object_unref);
+				g_clear_error (&local_error);
 
 				for (i = 0, rels_child = xb_node_get_child (child); rels_child != NULL;
 				     i++, g_object_unref (rels_child), rels_child = g_steal_pointer (&rels_next)) {
 					g_autoptr(XbNode) description_node = NULL;
 					g_autoptr(XbNode) issues_node = NULL;
 					const gchar *version;
+					AsUrgencyKind urgency_tmp;
 
 					rels_next = xb_node_get_next (rels_child);
 					if (g_strcmp0 (xb_node_get_element (rels_child), "release") != 0)
@@ -1285,111 +1407,76 @@ gs_appstream_refine_app (GsPlugin *plugin,
 					if (version == NULL)
 						continue;
 
-					gs_appstream_find_description_and_issues_nodes (rels_child, &description_node, &issues_node);
-
-					if (version_history != NULL) {
-						g_autoptr(AsRelease) release = NULL;
-						g_autofree gchar *description = NULL;
-						guint64 timestamp;
-						const gchar *date_str;
-
-						timestamp = xb_node_get_attr_as_uint (rels_child, "timestamp");
-						date_str = xb_node_get_attr (rels_child, "date");
-
-						/* include updates with or without a description */
-						if (description_node != NULL || issues_node != NULL)
-							description = gs_appstream_format_description (description_node, issues_node);
-
-						release = as_release_new ();
-						as_release_set_version (release, version);
-						if (timestamp != G_MAXUINT64)
-							as_release_set_timestamp (release, timestamp);
-						else if (date_str != NULL)  /* timestamp takes precedence over date */
-							as_release_set_date (release, date_str);
-						if (description != NULL)
-							as_release_set_description (release, description, NULL);
-
-						g_ptr_array_add (version_history, g_steal_pointer (&release));
-					}
-
-					if (needs_update_details) {
-						AsUrgencyKind urgency_tmp;
-
-						/* already installed */
-						if (g_hash_table_lookup (installed, version) != NULL)
-							continue;
+					/* already installed */
+					if (g_hash_table_lookup (installed, version) != NULL)
+						continue;
 
-						/* limit this to three versions backwards if there has never
-						 * been a detected installed version */
-						if (g_hash_table_size (installed) == 0 && i >= 3)
-							continue;
+					/* limit this to three versions backwards if there has never
+					 * been a detected installed version */
+					if (g_hash_table_size (installed) == 0 && i >= 3)
+						continue;
 
-						/* use the 'worst' urgency, e.g. critical over enhancement */
-						urgency_tmp = as_urgency_kind_from_string (xb_node_get_attr (rels_child, "urgency"));
-						if (urgency_tmp > urgency_best)
-							urgency_best = urgency_tmp;
+					/* use the 'worst' urgency, e.g. critical over enhancement */
+					urgency_tmp = as_urgency_kind_from_string (xb_node_get_attr (rels_child, "urgency"));
+					if (urgency_tmp > urgency_best)
+						urgency_best = urgency_tmp;
 
-						/* add updates with a description */
-						if (description_node != NULL || issues_node != NULL)
-							g_ptr_array_add (updates_list, g_object_ref (rels_child));
-					}
+					/* add updates with a description */
+					gs_appstream_find_description_and_issues_nodes (rels_child, &description_node, &issues_node);
+					if (description_node != NULL || issues_node != NULL)
+						g_ptr_array_add (updates_list, g_object_ref (rels_child));
 				}
 
-				if (version_history != NULL && version_history->len > 0)
-					gs_app_set_version_history (app, version_history);
+				/* only set if known */
+				if (urgency_best != AS_URGENCY_KIND_UNKNOWN)
+					gs_app_set_update_urgency (app, urgency_best);
 
-				if (needs_update_details) {
-					/* only set if known */
-					if (urgency_best != AS_URGENCY_KIND_UNKNOWN)
-						gs_app_set_update_urgency (app, urgency_best);
-
-					/* no prefix on each release */
-					if (updates_list->len == 1) {
-						XbNode *release = g_ptr_array_index (updates_list, 0);
+				/* no prefix on each release */
+				if (updates_list->len == 1) {
+					XbNode *release = g_ptr_array_index (updates_list, 0);
+					g_autoptr(XbNode) description_node = NULL;
+					g_autoptr(XbNode) issues_node = NULL;
+					g_autofree gchar *desc = NULL;
+					gs_appstream_find_description_and_issues_nodes (release, &description_node, &issues_node);
+					desc = gs_appstream_format_description (description_node, issues_node);
+					gs_app_set_update_details_markup (app, desc);
+
+				/* get the descriptions with a version prefix */
+				} else if (updates_list->len > 1) {
+					const gchar *version = gs_app_get_version (app);
+					g_autoptr(GString) update_desc = g_string_new ("");
+					for (guint j = 0; j < updates_list->len; j++) {
+						XbNode *release = g_ptr_array_index (updates_list, j);
+						const gchar *release_version = xb_node_get_attr (release, "version");
+						g_autofree gchar *desc = NULL;
 						g_autoptr(XbNode) description_node = NULL;
 						g_autoptr(XbNode) issues_node = NULL;
-						g_autofree gchar *desc = NULL;
+
+						/* use the first release description, then skip the currently installed version and all below it */
+						if (i != 0 && version != NULL && as_vercmp_simple (version, release_version) >= 0)
+							continue;
+
 						gs_appstream_find_description_and_issues_nodes (release, &description_node, &issues_node);
 						desc = gs_appstream_format_description (description_node, issues_node);
-						gs_app_set_update_details_markup (app, desc);
-
-					/* get the descriptions with a version prefix */
-					} else if (updates_list->len > 1) {
-						const gchar *version = gs_app_get_version (app);
-						g_autoptr(GString) update_desc = g_string_new ("");
-						for (guint j = 0; j < updates_list->len; j++) {
-							XbNode *release = g_ptr_array_index (updates_list, j);
-							const gchar *release_version = xb_node_get_attr (release, "version");
-							g_autofree gchar *desc = NULL;
-							g_autoptr(XbNode) description_node = NULL;
-							g_autoptr(XbNode) issues_node = NULL;
-
-							/* use the first release description, then skip the currently installed version and all below it */
-							if (i != 0 && version != NULL && as_vercmp_simple (version, release_version) >= 0)
-								continue;
-
-							gs_appstream_find_description_and_issues_nodes (release, &description_node, &issues_node);
-							desc = gs_appstream_format_description (description_node, issues_node);
-
-							g_string_append_printf (update_desc,
-										"Version %s:\n%s\n\n",
-										xb_node_get_attr (release, "version"),
-										desc);
-						}
 
-						/* remove trailing newlines */
-						if (update_desc->len > 2)
-							g_string_truncate (update_desc, update_desc->len - 2);
-						if (update_desc->len > 0)
-							gs_app_set_update_details_markup (app, update_desc->str);
+						g_string_append_printf (update_desc,
+									"Version %s:\n%s\n\n",
+									xb_node_get_attr (release, "version"),
+									desc);
 					}
 
-					/* if there is no already set update version use the newest */
-					if (gs_app_get_update_version (app) == NULL &&
-					    updates_list->len > 0) {
-						XbNode *release = g_ptr_array_index (updates_list, 0);
-						gs_app_set_update_version (app, xb_node_get_attr (release, "version"));
-					}
+					/* remove trailing newlines */
+					if (update_desc->len > 2)
+						g_string_truncate (update_desc, update_desc->len - 2);
+					if (update_desc->len > 0)
+						gs_app_set_update_details_markup (app, update_desc->str);
+				}
+
+				/* if there is no already set update version use the newest */
+				if (gs_app_get_update_version (app) == NULL &&
+				    updates_list->len > 0) {
+					XbNode *release = g_ptr_array_index (updates_list, 0);
+					gs_app_set_update_version (app, xb_node_get_attr (release, "version"));
 				}
 			}
 			} break;
@@ -2494,6 +2581,35 @@ gs_appstream_get_appstream_data_dirs (void)
 	return appstream_data_dirs;
 }
 
+/* Work out whether each license used in @silo is free now, while the silo is
+ * being loaded, so that refining apps from it doesn’t have to. */
+void
+gs_appstream_warm_license_cache (XbSilo *silo)
+{
+	g_autoptr(GPtrArray) licenses = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+
+	g_return_if_fail (XB_IS_SILO (silo));
+
+	licenses = xb_silo_query (silo, "components/component/project_license", 0, NULL);
+	if (licenses == NULL)
+		return;
+
+	seen = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < licenses->len; i++) {
+		const gchar *license = xb_node_get_text (g_ptr_array_index (licenses, i));
+
+		if (license == NULL || *license == '\0' ||
+		    !g_hash_table_add (seen, (gpointer) license))
+			continue;
+
+		gs_app_license_is_free (license);
+	}
+
+	g_debug ("Checked %u distinct licenses from %u components",
+		 g_hash_table_size (seen), licenses->len);
+}
+
 void
 gs_appstream_add_current_locales (XbBuilder *builder)
 {
@@ -92,6 +92,7 @@ gboolean	 gs_appstream_load_desktop_files	(XbBuilder	*builder,
 							 GCancellable	*cancellable,
 							 GError		**error);
 GPtrArray	*gs_appstream_get_appstream_data_dirs	(void);
+void		 gs_appstream_warm_license_cache	(XbSilo		*silo);
 void		 gs_appstream_add_current_locales	(XbBuilder	*builder);
 void		 gs_appstream_add_data_merge_fixup	(XbBuilder	*builder,
 							 GPtrArray	*appstream_paths,
@@ -9,12 +9,42 @@
 
 #include "config.h"
 
+#include <glib-unix.h>
+#include <signal.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "gs-os-release.h"
 #include "gs-debug.h"
 
+/* Number of records kept per thread in ring buffer mode, and the maximum
+ * length of each part of a record. Longer messages are truncated. */
+#define RING_N_RECORDS 512
+#define RING_DOMAIN_SIZE 24
+#define RING_MESSAGE_SIZE 232
+
+typedef struct {
+	/* Odd while the record is being written, incremented again once it’s
+	 * complete. Readers must check it’s even and unchanged after copying
+	 * the record out. */
+	guint seq;  /* (atomic) */
+	GLogLevelFlags log_level;
+	gint64 real_time_usec;
+	gchar log_domain[RING_DOMAIN_SIZE];
+	gchar message[RING_MESSAGE_SIZE];
+} GsDebugRingRecord;
+
+/* A ring of recent log records for one thread. Only the thread which owns the
+ * ring writes to it, so writing doesn’t need to take any locks. When a thread
+ * exits, its ring is kept (with its records) and reused by the next new
+ * thread, so the number of rings is bounded by the number of threads alive at
+ * once. */
+typedef struct {
+	guint next_index;  /* (atomic) */
+	GsDebugRingRecord records[RING_N_RECORDS];
+} GsDebugRing;
+
 struct _GsDebug
 {
 	GObject		  parent_instance;
@@ -22,71 +52,119 @@ struct _GsDebug
 	gchar		**domains;  /* (owned) (nullable), read-only after construction, guaranteed to be %NULL if empty */
 	gboolean	  verbose;  /* (atomic) */
 	gboolean	  use_time;  /* read-only after construction */
+	gboolean	  ring_enabled;  /* (atomic) */
+	guint		  dump_signal_id;  /* only accessed from the default main context */
 };
 
 G_DEFINE_TYPE (GsDebug, gs_debug, G_TYPE_OBJECT)
 
-static GLogWriterOutput
-gs_log_writer_console (GLogLevelFlags log_level,
-		       const GLogField *fields,
-		       gsize n_fields,
-		       gpointer user_data)
+/* Whether any #GsDebug could currently output a debug message. This is
+ * deliberately global so it can be checked without access to the #GsDebug.
+ * It’s %TRUE until a #GsDebug is created, as the default GLib log writer is
+ * in use until then. */
+static gboolean debug_enabled = TRUE;  /* (atomic) */
+
+static GMutex rings_mutex;
+static GPtrArray *rings = NULL;  /* (owned) (element-type GsDebugRing) (locked-by rings_mutex) */
+static GPtrArray *free_rings = NULL;  /* (owned) (element-type GsDebugRing) (locked-by rings_mutex) */
+
+static void
+ring_release (gpointer data)
 {
-	GsDebug *debug = GS_DEBUG (user_data);
-	gboolean verbose;
-	const gchar * const *domains = NULL;
-	const gchar *log_domain = NULL;
-	const gchar *log_message = NULL;
-	g_autofree gchar *tmp = NULL;
-	g_autoptr(GString) domain = NULL;
+	GsDebugRing *ring = data;
 
-	domains = (const gchar * const *) debug->domains;
-	verbose = g_atomic_int_get (&debug->verbose);
+	g_mutex_lock (&rings_mutex);
+	g_ptr_array_add (free_rings, ring);
+	g_mutex_unlock (&rings_mutex);
+}
 
-	/* check enabled, fast path without parsing fields */
-	if ((log_level == G_LOG_LEVEL_DEBUG ||
-	     log_level == G_LOG_LEVEL_INFO) &&
-	    !verbose &&
-	    debug->domains == NULL)
-		return G_LOG_WRITER_HANDLED;
+static GPrivate thread_ring = G_PRIVATE_INIT (ring_release);
 
-	/* get data from arguments */
-	for (gsize i = 0; i < n_fields; i++) {
-		if (g_strcmp0 (fields[i].key, "MESSAGE") == 0) {
-			log_message = fields[i].value;
-			continue;
-		}
-		if (g_strcmp0 (fields[i].key, "GLIB_DOMAIN") == 0) {
-			log_domain = fields[i].value;
-			continue;
-		}
+static GsDebugRing *
+ring_get_for_thread (void)
+{
+	GsDebugRing *ring = g_private_get (&thread_ring);
+
+	if (G_LIKELY (ring != NULL))
+		return ring;
+
+	g_mutex_lock (&rings_mutex);
+	if (rings == NULL) {
+		rings = g_ptr_array_new_with_free_func (g_free);
+		free_rings = g_ptr_array_new ();
+	}
+	if (free_rings->len > 0) {
+		ring = g_ptr_array_steal_index_fast (free_rings, free_rings->len - 1);
+	} else {
+		ring = g_new0 (GsDebugRing, 1);
+		g_ptr_array_add (rings, ring);
 	}
+	g_mutex_unlock (&rings_mutex);
 
-	/* check enabled, slower path */
-	if ((log_level == G_LOG_LEVEL_DEBUG ||
-	     log_level == G_LOG_LEVEL_INFO) &&
-	    !verbose &&
-	    debug->domains != NULL &&
-	    g_strcmp0 (debug->domains[0], "all") != 0 &&
-	    (log_domain == NULL || !g_strv_contains (domains, log_domain)))
-		return G_LOG_WRITER_HANDLED;
+	g_private_set (&thread_ring, ring);
 
-	/* this is really verbose */
-	if ((g_strcmp0 (log_domain, "dconf") == 0 ||
-	     g_strcmp0 (log_domain, "GLib-GIO") == 0 ||
-	     g_strcmp0 (log_domain, "GLib-Net") == 0 ||
-	     g_strcmp0 (log_domain, "GdkPixbuf") == 0) &&
-	    log_level == G_LOG_LEVEL_DEBUG)
-		return G_LOG_WRITER_HANDLED;
+	return ring;
+}
+
+static void
+ring_append (GLogLevelFlags  log_level,
+             const gchar    *log_domain,
+             const gchar    *log_message)
+{
+	GsDebugRing *ring = ring_get_for_thread ();
+	guint idx = g_atomic_int_get (&ring->next_index);
+	GsDebugRingRecord *record = &ring->records[idx % RING_N_RECORDS];
+	guint seq = g_atomic_int_get (&record->seq);
+
+	g_atomic_int_set (&record->seq, seq + 1);
+
+	record->log_level = log_level;
+	record->real_time_usec = g_get_real_time ();
+	g_strlcpy (record->log_domain, (log_domain != NULL) ? log_domain : "", sizeof (record->log_domain));
+	g_strlcpy (record->message, (log_message != NULL) ? log_message : "", sizeof (record->message));
+
+	g_atomic_int_set (&record->seq, seq + 2);
+	g_atomic_int_set (&ring->next_index, idx + 1);
+}
+
+static void
+update_debug_enabled (GsDebug *debug)
+{
+	g_atomic_int_set (&debug_enabled,
+			  g_atomic_int_get (&debug->verbose) ||
+			  g_atomic_int_get (&debug->ring_enabled) ||
+			  debug->domains != NULL);
+}
+
+static gboolean
+log_domain_is_noisy (const gchar    *log_domain,
+                     GLogLevelFlags  log_level)
+{
+	return ((g_strcmp0 (log_domain, "dconf") == 0 ||
+		 g_strcmp0 (log_domain, "GLib-GIO") == 0 ||
+		 g_strcmp0 (log_domain, "GLib-Net") == 0 ||
+		 g_strcmp0 (log_domain, "GdkPixbuf") == 0) &&
+		log_level == G_LOG_LEVEL_DEBUG);
+}
+
+static void
+print_log_line (GLogLevelFlags  log_level,
+                gint64          real_time_usec,
+                gboolean        use_time,
+                const gchar    *log_domain,
+                const gchar    *log_message)
+{
+	g_autofree gchar *tmp = NULL;
+	g_autoptr(GString) domain = NULL;
 
 	/* time header */
-	if (debug->use_time) {
-		g_autoptr(GDateTime) dt = g_date_time_new_now_utc ();
+	if (use_time) {
+		gint64 msec_of_day = (real_time_usec / 1000) % (24 * 60 * 60 * 1000);
 		tmp = g_strdup_printf ("%02i:%02i:%02i:%03i",
-				       g_date_time_get_hour (dt),
-				       g_date_time_get_minute (dt),
-				       g_date_time_get_second (dt),
-				       g_date_time_get_microsecond (dt) / 1000);
+				       (gint) (msec_of_day / (60 * 60 * 1000)),
+				       (gint) (msec_of_day / (60 * 1000) % 60),
+				       (gint) (msec_of_day / 1000 % 60),
+				       (gint) (msec_of_day % 1000));
 	}
 
 	/* make these shorter */
@@ -135,11 +213,85 @@ gs_log_writer_console (GLogLevelFlags log_level,
 			g_print ("%s\n", log_message);
 		}
 	}
+}
+
+static GLogWriterOutput
+gs_log_writer_console (GLogLevelFlags log_level,
+		       const GLogField *fields,
+		       gsize n_fields,
+		       gpointer user_data)
+{
+	GsDebug *debug = GS_DEBUG (user_data);
+	gboolean verbose;
+	const gchar * const *domains = NULL;
+	const gchar *log_domain = NULL;
+	const gchar *log_message = NULL;
+
+	domains = (const gchar * const *) debug->domains;
+	verbose = g_atomic_int_get (&debug->verbose);
+
+	/* check enabled, fast path without parsing fields */
+	if ((log_level == G_LOG_LEVEL_DEBUG ||
+	     log_level == G_LOG_LEVEL_INFO) &&
+	    !verbose &&
+	    debug->domains == NULL)
+		return G_LOG_WRITER_HANDLED;
+
+	/* get data from arguments */
+	for (gsize i = 0; i < n_fields; i++) {
+		if (g_strcmp0 (fields[i].key, "MESSAGE") == 0) {
+			log_message = fields[i].value;
+			continue;
+		}
+		if (g_strcmp0 (fields[i].key, "GLIB_DOMAIN") == 0) {
+			log_domain = fields[i].value;
+			continue;
+		}
+	}
+
+	/* check enabled, slower path */
+	if ((log_level == G_LOG_LEVEL_DEBUG ||
+	     log_level == G_LOG_LEVEL_INFO) &&
+	    !verbose &&
+	    debug->domains != NULL &&
+	    g_strcmp0 (debug->domains[0], "all") != 0 &&
+	    (log_domain == NULL || !g_strv_contains (domains, log_domain)))
+		return G_LOG_WRITER_HANDLED;
+
+	/* this is really verbose */
+	if (log_domain_is_noisy (log_domain, log_level))
+		return G_LOG_WRITER_HANDLED;
+
+	print_log_line (log_level, g_get_real_time (), debug->use_time, log_domain, log_message);
 
 	/* success */
 	return G_LOG_WRITER_HANDLED;
 }
 
+/* Store the message in the ring buffer for the current thread, rather than
+ * writing it out. This doesn’t take any locks (except the first time it’s
+ * called on each thread) or do any I/O. */
+static void
+gs_log_writer_ring (GLogLevelFlags log_level,
+		    const GLogField *fields,
+		    gsize n_fields)
+{
+	const gchar *log_domain = NULL;
+	const gchar *log_message = NULL;
+
+	for (gsize i = 0; i < n_fields; i++) {
+		if (g_strcmp0 (fields[i].key, "MESSAGE") == 0)
+			log_message = fields[i].value;
+		else if (g_strcmp0 (fields[i].key, "GLIB_DOMAIN") == 0)
+			log_domain = fields[i].value;
+	}
+
+	if (log_domain_is_noisy (log_domain, log_level))
+		return;
+
+	ring_append (log_level, log_domain, log_message);
+}
+
 static GLogWriterOutput
 gs_log_writer_journald (GLogLevelFlags log_level,
                         const GLogField *fields,
@@ -177,6 +329,20 @@ gs_debug_log_writer (GLogLevelFlags log_level,
 		     gsize n_fields,
 		     gpointer user_data)
 {
+	GsDebug *debug = GS_DEBUG (user_data);
+
+	/* In ring buffer mode, debug messages are only kept in memory until
+	 * they’re dumped, and more important messages are kept for context
+	 * as well as being output as normal. */
+	if (g_atomic_int_get (&debug->ring_enabled)) {
+		gs_log_writer_ring (log_level, fields, n_fields);
+
+		if ((log_level == G_LOG_LEVEL_DEBUG ||
+		     log_level == G_LOG_LEVEL_INFO) &&
+		    !g_atomic_int_get (&debug->verbose))
+			return G_LOG_WRITER_HANDLED;
+	}
+
 	if (g_log_writer_is_journald (fileno (stderr)))
 		return gs_log_writer_journald (log_level, fields, n_fields, user_data);
 	else
@@ -188,7 +354,9 @@ gs_debug_finalize (GObject *object)
 {
 	GsDebug *debug = GS_DEBUG (object);
 
+	g_clear_handle_id (&debug->dump_signal_id, g_source_remove);
 	g_clear_pointer (&debug->domains, g_strfreev);
+	g_atomic_int_set (&debug_enabled, TRUE);
 
 	G_OBJECT_CLASS (gs_debug_parent_class)->finalize (object);
 }
@@ -237,6 +405,8 @@ gs_debug_new (gchar    **domains,
 	debug->verbose = verbose;
 	debug->use_time = use_time;
 
+	update_debug_enabled (debug);
+
 	return g_steal_pointer (&debug);
 }
 
@@ -254,6 +424,7 @@ gs_debug_new_from_environment (void)
 {
 	g_auto(GStrv) domains = NULL;
 	gboolean verbose, use_time;
+	g_autoptr(GsDebug) debug = NULL;
 
 	if (g_getenv ("G_MESSAGES_DEBUG") != NULL) {
 		domains = g_strsplit (g_getenv ("G_MESSAGES_DEBUG"), " ", -1);
@@ -264,7 +435,12 @@ gs_debug_new_from_environment (void)
 	verbose = (g_getenv ("GS_DEBUG") != NULL);
 	use_time = (g_getenv ("GS_DEBUG_NO_TIME") == NULL);
 
-	return gs_debug_new (g_steal_pointer (&domains), verbose, use_time);
+	debug = gs_debug_new (g_steal_pointer (&domains), verbose, use_time);
+
+	if (g_getenv ("GS_DEBUG_RING") != NULL)
+		gs_debug_set_ring_buffer (debug, TRUE);
+
+	return g_steal_pointer (&debug);
 }
 
 /**
@@ -286,8 +462,13 @@ gs_debug_set_verbose (GsDebug  *self,
 
 	/* If we’re changing from !verbose → verbose, print OS information.
 	 * This is helpful in verbose logs when people file bug reports. */
-	if (g_atomic_int_compare_and_exchange (&self->verbose, !verbose, verbose) &&
-	    verbose) {
+	if (g_atomic_int_compare_and_exchange (&self->verbose, !verbose, verbose)) {
+		update_debug_enabled (self);
+	} else {
+		return;
+	}
+
+	if (verbose) {
 		g_autoptr(GsOsRelease) os_release = NULL;
 		g_autoptr(GError) error = NULL;
 
@@ -303,3 +484,188 @@ gs_debug_set_verbose (GsDebug  *self,
 		}
 	}
 }
+
+typedef struct {
+	gint64 real_time_usec;
+	GLogLevelFlags log_level;
+	gchar log_domain[RING_DOMAIN_SIZE];
+	gchar message[RING_MESSAGE_SIZE];
+} RingDumpRecord;
+
+static gint
+ring_dump_record_cmp (gconstpointer a,
+                      gconstpointer b)
+{
+	const RingDumpRecord *record_a = a;
+	const RingDumpRecord *record_b = b;
+
+	if (record_a->real_time_usec < record_b->real_time_usec)
+		return -1;
+	if (record_a->real_time_usec > record_b->real_time_usec)
+		return 1;
+	return 0;
+}
+
+/**
+ * gs_debug_dump_ring_buffer:
+ * @self: a #GsDebug
+ *
+ * Write the contents of the ring buffers of all threads to stderr, oldest
+ * first, interleaved by time.
+ *
+ * Records which are being overwritten while the dump happens are skipped, so
+ * the threads writing them never have to wait.
+ *
+ * This does nothing if ring buffer mode has never been enabled. It can be
+ * called at any time, from any thread.
+ *
+ * Since: 47
+ */
+void
+gs_debug_dump_ring_buffer (GsDebug *self)
+{
+	g_autoptr(GArray) records = NULL;
+	g_autoptr(GString) str = NULL;
+
+	g_return_if_fail (GS_IS_DEBUG (self));
+
+	records = g_array_new (FALSE, FALSE, sizeof (RingDumpRecord));
+
+	g_mutex_lock (&rings_mutex);
+	for (guint i = 0; rings != NULL && i < rings->len; i++) {
+		GsDebugRing *ring = g_ptr_array_index (rings, i);
+
+		for (guint j = 0; j < RING_N_RECORDS; j++) {
+			GsDebugRingRecord *record = &ring->records[j];
+			RingDumpRecord copy;
+			guint seq_before, seq_after;
+
+			seq_before = g_atomic_int_get (&record->seq);
+			if (seq_before == 0 || (seq_before % 2) != 0)
+				continue;
+
+			copy.real_time_usec = record->real_time_usec;
+			copy.log_level = record->log_level;
+			memcpy (copy.log_domain, record->log_domain, sizeof (copy.log_domain));
+			memcpy (copy.message, record->message, sizeof (copy.message));
+
+			seq_after = g_atomic_int_get (&record->seq);
+			if (seq_before != seq_after)
+				continue;
+
+			copy.log_domain[sizeof (copy.log_domain) - 1] = '\0';
+			copy.message[sizeof (copy.message) - 1] = '\0';
+			g_array_append_val (records, copy);
+		}
+	}
+	g_mutex_unlock (&rings_mutex);
+
+	g_array_sort (records, ring_dump_record_cmp);
+
+	str = g_string_new (NULL);
+	g_string_append_printf (str, "---- %u buffered log messages ----\n", records->len);
+
+	for (guint i = 0; i < records->len; i++) {
+		const RingDumpRecord *record = &g_array_index (records, RingDumpRecord, i);
+		gint64 msec_of_day = (record->real_time_usec / 1000) % (24 * 60 * 60 * 1000);
+
+		g_string_append_printf (str, "%02i:%02i:%02i:%03i %s %s%s\n",
+					(gint) (msec_of_day / (60 * 60 * 1000)),
+					(gint) (msec_of_day / (60 * 1000) % 60),
+					(gint) (msec_of_day / 1000 % 60),
+					(gint) (msec_of_day % 1000),
+					record->log_domain,
+					(record->log_level & (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING)) ? "WARNING: " : "",
+					record->message);
+	}
+
+	g_string_append (str, "---- end of buffered log messages ----\n");
+
+	fputs (str->str, stderr);
+	fflush (stderr);
+}
+
+static gpointer
+dump_thread_cb (gpointer user_data)
+{
+	g_autoptr(GsDebug) self = GS_DEBUG (user_data);
+
+	gs_debug_dump_ring_buffer (self);
+
+	return NULL;
+}
+
+static gboolean
+dump_signal_cb (gpointer user_data)
+{
+	GsDebug *self = GS_DEBUG (user_data);
+
+	/* Format and write the dump in a separate thread, so a large dump to a
+	 * slow terminal doesn’t block the main thread. */
+	g_thread_unref (g_thread_new ("gs-debug-dump", dump_thread_cb, g_object_ref (self)));
+
+	return G_SOURCE_CONTINUE;
+}
+
+/**
+ * gs_debug_set_ring_buffer:
+ * @self: a #GsDebug
+ * @enabled: whether to enable ring buffer mode
+ *
+ * Enable or disable ring buffer mode.
+ *
+ * In ring buffer mode, debug and info messages are stored in a fixed-size
+ * in-memory ring buffer for each thread, rather than being formatted and
+ * written out as they are logged. This keeps the cost of debug logging low
+ * enough that it can be left enabled, and the most recent messages can be
+ * retrieved with gs_debug_dump_ring_buffer() when something goes wrong.
+ * Warnings and errors are stored in the ring buffer for context, but are
+ * still written out immediately too.
+ *
+ * While ring buffer mode is enabled, sending `SIGUSR1` to the process will
+ * dump the ring buffers to stderr.
+ *
+ * This must be called from the thread which runs the global default main
+ * context.
+ *
+ * Since: 47
+ */
+void
+gs_debug_set_ring_buffer (GsDebug  *self,
+                          gboolean  enabled)
+{
+	g_return_if_fail (GS_IS_DEBUG (self));
+
+	if (!g_atomic_int_compare_and_exchange (&self->ring_enabled, !enabled, enabled))
+		return;
+
+	update_debug_enabled (self);
+
+	if (enabled)
+		self->dump_signal_id = g_unix_signal_add (SIGUSR1, dump_signal_cb, self);
+	else
+		g_clear_handle_id (&self->dump_signal_id, g_source_remove);
+}
+
+/**
+ * gs_debug_get_enabled:
+ *
+ * Get whether debug messages could currently be output by any #GsDebug.
+ *
+ * g_debug() formats its message before the log writer gets a chance to
+ * discard it, so code which logs a lot from hot paths, or which has to build
+ * its arguments specially for logging, can check this first to avoid doing
+ * work which would be thrown away. If no #GsDebug has been created, this
+ * always returns %TRUE.
+ *
+ * This can be called at any time, from any thread.
+ *
+ * Returns: %TRUE if debug messages may be output, %FALSE if they definitely
+ *     won’t be
+ * Since: 47
+ */
+gboolean
+gs_debug_get_enabled (void)
+{
+	return g_atomic_int_get (&debug_enabled);
+}
@@ -23,5 +23,24 @@ GsDebug		*gs_debug_new		(gchar		**domains,
 GsDebug		*gs_debug_new_from_environment	(void);
 void		 gs_debug_set_verbose	(GsDebug	*self,
 					 gboolean	 verbose);
+void		 gs_debug_set_ring_buffer	(GsDebug	*self,
+						 gboolean	 enabled);
+void		 gs_debug_dump_ring_buffer	(GsDebug	*self);
+
+gboolean	 gs_debug_get_enabled	(void);
+
+/**
+ * gs_debug_if_enabled:
+ * @...: format string and arguments, as for g_debug()
+ *
+ * Log a debug message with g_debug(), but only evaluate and format the
+ * arguments if gs_debug_get_enabled() returns %TRUE.
+ *
+ * Since: 47
+ */
+#define gs_debug_if_enabled(...) G_STMT_START { \
+	if (gs_debug_get_enabled ()) \
+		g_debug (__VA_ARGS__); \
+} G_STMT_END
 
 G_END_DECLS
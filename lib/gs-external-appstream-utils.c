@@ -26,6 +26,14 @@
  * the async refresh function will only complete once the last download is
  * complete.
  *
+ * Downloaded files are decompressed and validated before being published to
+ * the cache, so the appstream plugin can map them directly rather than
+ * decompressing them on every silo rebuild. Published files are identified
+ * by the hash of their decompressed contents (see
+ * gs_utils_publish_file_contents()), and a download whose contents haven’t
+ * changed is not published again, so it doesn’t trigger the appstream
+ * plugin’s file monitors.
+ *
  * Progress data is reported via a callback, and gives the total progress of all
  * parallel downloads. Internally this is done by updating #ProgressTuple
  * structs as each download progresses. A periodic timeout callback sums these
@@ -49,6 +57,7 @@
  */
 
 #include <errno.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
@@ -132,6 +141,8 @@ typedef struct {
 	gchar *url;  /* (not nullable) (owned) */
 	GTask *task;  /* (not nullable) (owned) */
 	GFile *output_file;  /* (not nullable) (owned) */
+	GFile *target_file;  /* (not nullable) (owned) */
+	gchar *compressed_target_path;  /* (nullable) (owned) */
 	ProgressTuple *progress_tuple;  /* (not nullable) */
 	SoupSession *soup_session;  /* (not nullable) (owned) */
 	gboolean system_wide;
@@ -139,6 +150,7 @@ typedef struct {
 	/* In-progress data. */
 	gchar *last_etag;  /* (nullable) (owned) */
 	GDateTime *last_modified_date;  /* (nullable) (owned) */
+	gchar *new_etag;  /* (nullable) (owned) */
 } DownloadAppStreamData;
 
 static void
@@ -147,9 +159,12 @@ download_appstream_data_free (DownloadAppStreamData *data)
 	g_free (data->url);
 	g_clear_object (&data->task);
 	g_clear_object (&data->output_file);
+	g_clear_object (&data->target_file);
+	g_free (data->compressed_target_path);
 	g_clear_object (&data->soup_session);
 	g_free (data->last_etag);
 	g_clear_pointer (&data->last_modified_date, g_date_time_unref);
+	g_free (data->new_etag);
 	g_free (data);
 }
 
@@ -181,10 +196,12 @@ refresh_url_async (GSettings           *settings,
 {
 	g_autoptr(GTask) task = NULL;
 	g_autofree gchar *basename = NULL;
+	g_autofree gchar *published_basename = NULL;
 	g_autofree gchar *basename_url = g_path_get_basename (url);
 	/* make sure different uris with same basenames differ */
 	g_autofree gchar *hash = NULL;
 	g_autofree gchar *target_file_path = NULL;
+	g_autofree gchar *compressed_target_path = NULL;
 	g_autoptr(GFile) target_file = NULL;
 	g_autoptr(GFile) tmp_file_parent = NULL;
 	g_autoptr(GFile) tmp_file = NULL;
@@ -207,21 +224,37 @@ refresh_url_async (GSettings           *settings,
 	}
 	basename = g_strdup_printf ("%s-%s", hash, basename_url);
 
+	/* The file is published decompressed. */
+	if (g_str_has_suffix (basename, ".gz"))
+		published_basename = g_strndup (basename, strlen (basename) - strlen (".gz"));
+	else
+		published_basename = g_strdup (basename);
+
 	/* Are we downloading for the user, or the system? */
 	system_wide = g_settings_get_boolean (settings, "external-appstream-system-wide");
 
 	/* Check cache file age. */
 	if (system_wide) {
-		target_file_path = gs_external_appstream_utils_get_file_cache_path (basename);
+		target_file_path = gs_external_appstream_utils_get_file_cache_path (published_basename);
 	} else {
 		g_autofree gchar *legacy_file_path = NULL;
 
 		target_file_path = g_build_filename (g_get_user_data_dir (),
 						     "swcatalog",
 						     "xml",
-						     basename,
+						     published_basename,
 						     NULL);
 
+		/* An older compressed copy of the file is removed once the
+		 * decompressed one has been published. The system-wide one is
+		 * removed by gnome-software-install-appstream. */
+		if (g_strcmp0 (basename, published_basename) != 0)
+			compressed_target_path = g_build_filename (g_get_user_data_dir (),
+								   "swcatalog",
+								   "xml",
+								   basename,
+								   NULL);
+
 		/* Delete an old file, from a legacy location */
 		legacy_file_path = g_build_filename (g_get_user_data_dir (),
 						     "app-info",
@@ -247,13 +280,15 @@ refresh_url_async (GSettings           *settings,
 		return;
 	}
 
-	/* If downloading system wide, write the download contents into a
-	 * temporary file that will be copied into the system location later. */
-	if (system_wide) {
+	/* Write the download contents into a temporary file, which will be
+	 * decompressed, validated and then published to the target location
+	 * if its contents have changed. */
+	{
+		g_autofree gchar *tmp_basename = g_strconcat (basename, ".download", NULL);
 		g_autofree gchar *tmp_file_path = NULL;
 
 		tmp_file_path = gs_utils_get_cache_filename ("external-appstream",
-							     basename,
+							     tmp_basename,
 							     GS_UTILS_CACHE_FLAG_WRITEABLE |
 							     GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
 							     &local_error);
@@ -263,8 +298,6 @@ refresh_url_async (GSettings           *settings,
 		}
 
 		tmp_file = g_file_new_for_path (tmp_file_path);
-	} else {
-		tmp_file = g_object_ref (target_file);
 	}
 
 	gs_app_set_summary_missing (app_dl,
@@ -275,6 +308,8 @@ refresh_url_async (GSettings           *settings,
 	data->url = g_strdup (url);
 	data->task = g_object_ref (task);
 	data->output_file = g_object_ref (tmp_file);
+	data->target_file = g_object_ref (target_file);
+	data->compressed_target_path = g_steal_pointer (&compressed_target_path);
 	data->progress_tuple = progress_tuple;
 	data->soup_session = g_object_ref (soup_session);
 	data->system_wide = system_wide;
@@ -283,7 +318,7 @@ refresh_url_async (GSettings           *settings,
 	/* Create the destination file’s directory.
 	 * FIXME: This should be made async; it hasn’t done for now as it’s
 	 * likely to be fast. */
-	tmp_file_parent = g_file_get_parent (tmp_file);
+	tmp_file_parent = g_file_get_parent (system_wide ? tmp_file : target_file);
 
 	if (tmp_file_parent != NULL &&
 	    !g_file_make_directory_with_parents (tmp_file_parent, cancellable, &local_error) &&
@@ -296,7 +331,7 @@ refresh_url_async (GSettings           *settings,
 
 	/* Query the ETag and modification date of the target file, if the file already exists. For
 	 * system-wide installations, this is the ETag of the AppStream file installed system-wide.
-	 * For local installations, this is just the local output file. */
+	 * For local installations, this is the AppStream file in the user’s data directory. */
 	data->last_etag = gs_utils_get_file_etag (target_file, &data->last_modified_date, cancellable);
 	g_debug ("Queried ETag of file %s: %s", g_file_peek_path (target_file), data->last_etag);
 
@@ -344,6 +379,11 @@ download_replace_file_cb (GObject      *source_object,
 				  g_steal_pointer (&task));
 }
 
+static void publish_thread_cb (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable);
+
 static void
 download_stream_cb (GObject      *source_object,
                     GAsyncResult *result,
@@ -351,17 +391,15 @@ download_stream_cb (GObject      *source_object,
 {
 	SoupSession *soup_session = SOUP_SESSION (source_object);
 	g_autoptr(GTask) task = g_steal_pointer (&user_data);
-	GCancellable *cancellable = g_task_get_cancellable (task);
 	DownloadAppStreamData *data = g_task_get_task_data (task);
 	g_autoptr(GError) local_error = NULL;
-	g_autofree gchar *new_etag = NULL;
 
-	if (!gs_download_stream_finish (soup_session, result, &new_etag, NULL, &local_error)) {
-		if (data->system_wide && g_error_matches (local_error, GS_DOWNLOAD_ERROR, GS_DOWNLOAD_ERROR_NOT_MODIFIED)) {
+	if (!gs_download_stream_finish (soup_session, result, &data->new_etag, NULL, &local_error)) {
+		if (g_error_matches (local_error, GS_DOWNLOAD_ERROR, GS_DOWNLOAD_ERROR_NOT_MODIFIED)) {
 			g_debug ("External AppStream file not modified, removing temporary download file %s",
 				 g_file_peek_path (data->output_file));
 
-			/* System-wide installs should delete the empty file created when preparing to
+			/* Delete the empty file created when preparing to
 			 * download the external AppStream file. */
 			g_file_delete_async (data->output_file, G_PRIORITY_LOW, NULL, NULL, NULL);
 			g_task_return_boolean (task, TRUE);
@@ -382,20 +420,165 @@ download_stream_cb (GObject      *source_object,
 
 	g_debug ("Downloaded appstream file %s", g_file_peek_path (data->output_file));
 
-	gs_utils_set_file_etag (data->output_file, new_etag, cancellable);
+	/* Decompressing, hashing and installing the file are all blocking. */
+	g_task_run_in_thread (task, publish_thread_cb);
+}
+
+/* Returns the decompressed contents of @file, which must be an AppStream
+ * XML file, optionally gzip compressed. */
+static GBytes *
+load_appstream_contents (GFile         *file,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+	g_autoptr(GBytes) bytes = NULL;
+	const guint8 *data;
+	gsize data_len;
+
+	bytes = g_file_load_bytes (file, cancellable, NULL, error);
+	if (bytes == NULL)
+		return NULL;
+
+	data = g_bytes_get_data (bytes, &data_len);
+
+	/* gzip magic number */
+	if (data_len >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+		g_autoptr(GZlibDecompressor) decompressor = NULL;
+		g_autoptr(GInputStream) memory_stream = NULL;
+		g_autoptr(GInputStream) converter_stream = NULL;
+		g_autoptr(GOutputStream) output_stream = NULL;
+
+		decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+		memory_stream = g_memory_input_stream_new_from_bytes (bytes);
+		converter_stream = g_converter_input_stream_new (memory_stream, G_CONVERTER (decompressor));
+		output_stream = g_memory_output_stream_new_resizable ();
+
+		if (g_output_stream_splice (output_stream, converter_stream,
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+					    cancellable, error) < 0)
+			return NULL;
+
+		g_clear_pointer (&bytes, g_bytes_unref);
+		bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (output_stream));
+		data = g_bytes_get_data (bytes, &data_len);
+	}
+
+	/* Don’t publish anything which the appstream plugin would ignore. */
+	if (data_len == 0 ||
+	    g_strstr_len ((const gchar *) data, data_len, "<components") == NULL) {
+		g_set_error_literal (error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_INVALID_DATA,
+				     "Not an AppStream XML file");
+		return NULL;
+	}
+
+	return g_steal_pointer (&bytes);
+}
+
+static void
+publish_thread_cb (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+	DownloadAppStreamData *data = task_data;
+	g_autoptr(GBytes) contents = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	contents = load_appstream_contents (data->output_file, cancellable, &local_error);
+	g_file_delete (data->output_file, NULL, NULL);
+
+	if (contents == NULL) {
+		g_task_return_new_error (task,
+					 GS_EXTERNAL_APPSTREAM_ERROR,
+					 GS_EXTERNAL_APPSTREAM_ERROR_DOWNLOADING,
+					 "Invalid external AppStream file downloaded from %s: %s",
+					 data->url, local_error->message);
+		return;
+	}
 
 	if (data->system_wide) {
+		g_autofree gchar *content_hash = NULL;
+		g_autofree gchar *installed_content_hash = NULL;
+		g_autofree gchar *basename = NULL;
+		g_autofree gchar *install_file_path = NULL;
+		g_autoptr(GFile) install_file = NULL;
+
+		/* Installing the file needs authorisation, so avoid it if
+		 * the installed file is already up to date. The hash of the
+		 * installed file is set by gnome-software-install-appstream. */
+		content_hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, contents);
+		installed_content_hash = gs_utils_get_file_content_hash (data->target_file, cancellable);
+
+		if (g_strcmp0 (content_hash, installed_content_hash) == 0) {
+			g_debug ("External AppStream file %s unchanged, not installing it",
+				 g_file_peek_path (data->target_file));
+			g_task_return_boolean (task, TRUE);
+			return;
+		}
+
+		basename = g_file_get_basename (data->target_file);
+		install_file_path = gs_utils_get_cache_filename ("external-appstream",
+								 basename,
+								 GS_UTILS_CACHE_FLAG_WRITEABLE |
+								 GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+								 &local_error);
+		if (install_file_path == NULL) {
+			g_task_return_error (task, g_steal_pointer (&local_error));
+			return;
+		}
+
+		install_file = g_file_new_for_path (install_file_path);
+		if (!g_file_replace_contents (install_file,
+					      g_bytes_get_data (contents, NULL),
+					      g_bytes_get_size (contents),
+					      NULL, FALSE,
+					      G_FILE_CREATE_PRIVATE | G_FILE_CREATE_REPLACE_DESTINATION,
+					      NULL, cancellable, &local_error)) {
+			g_task_return_error (task, g_steal_pointer (&local_error));
+			return;
+		}
+
+		gs_utils_set_file_etag (install_file, data->new_etag, cancellable);
+
 		/* install file systemwide */
-		if (!gs_external_appstream_install (g_file_peek_path (data->output_file),
+		if (!gs_external_appstream_install (install_file_path,
 						    cancellable,
 						    &local_error)) {
+			g_file_delete (install_file, NULL, NULL);
 			g_task_return_new_error (task,
 						 GS_EXTERNAL_APPSTREAM_ERROR,
 						 GS_EXTERNAL_APPSTREAM_ERROR_INSTALLING_ON_SYSTEM,
 						 "Error installing external AppStream file on system: %s", local_error->message);
 			return;
 		}
-		g_debug ("Installed appstream file %s", g_file_peek_path (data->output_file));
+		g_debug ("Installed appstream file %s", install_file_path);
+	} else {
+		gboolean changed = FALSE;
+
+		if (!gs_utils_publish_file_contents (data->target_file, contents,
+						     NULL, &changed,
+						     cancellable, &local_error)) {
+			g_task_return_error (task, g_steal_pointer (&local_error));
+			return;
+		}
+
+		/* Changing the ETag would also notify file monitors. */
+		if (g_strcmp0 (data->new_etag, data->last_etag) != 0)
+			gs_utils_set_file_etag (data->target_file, data->new_etag, cancellable);
+
+		if (data->compressed_target_path != NULL &&
+		    g_unlink (data->compressed_target_path) == -1) {
+			int errn = errno;
+			if (errn != ENOENT)
+				g_debug ("Failed to unlink '%s': %s", data->compressed_target_path, g_strerror (errn));
+		}
+
+		g_debug ("%s appstream file %s",
+			 changed ? "Published" : "Unchanged",
+			 g_file_peek_path (data->target_file));
 	}
 
 	g_task_return_boolean (task, TRUE);
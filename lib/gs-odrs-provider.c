@@ -70,6 +70,7 @@ struct _GsOdrsProvider
 	gchar		*user_hash;  /* (not nullable) (owned) */
 	gchar		*review_server;  /* (not nullable) (owned) */
 	GArray		*ratings;  /* (element-type GsOdrsRating) (mutex ratings_mutex) (owned) (nullable) */
+	gchar		*ratings_hash;  /* (mutex ratings_mutex) (owned) (nullable); hash of the file @ratings was loaded from */
 	GMutex		 ratings_mutex;
 	guint64		 max_cache_age_secs;
 	guint		 n_results_max;
@@ -122,11 +123,39 @@ gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
 	JsonObjectIter iter;
 	g_autoptr(GArray) new_ratings = NULL;
 	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autofree gchar *ratings_hash = NULL;
 	g_autoptr(GError) local_error = NULL;
 
+	mapped_file = g_mapped_file_new (filename, FALSE, &local_error);
+	if (mapped_file == NULL) {
+		g_set_error (error,
+			     GS_ODRS_PROVIDER_ERROR,
+			     GS_ODRS_PROVIDER_ERROR_PARSING_DATA,
+			     "Error parsing ODRS data: %s", local_error->message);
+		return FALSE;
+	}
+
+	/* The ratings file is a few megabytes of JSON, and is usually
+	 * unchanged when it’s refreshed, so don’t parse it again if it’s
+	 * what was loaded last time. */
+	bytes = g_mapped_file_get_bytes (mapped_file);
+	ratings_hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+
+	locker = g_mutex_locker_new (&self->ratings_mutex);
+	if (self->ratings != NULL && g_strcmp0 (self->ratings_hash, ratings_hash) == 0) {
+		g_debug ("ODRS ratings in ‘%s’ unchanged, not reloading them", filename);
+		return TRUE;
+	}
+	g_clear_pointer (&locker, g_mutex_locker_free);
+
 	/* parse the data and find the success */
 	json_parser = json_parser_new_immutable ();
-	if (!json_parser_load_from_mapped_file (json_parser, filename, &local_error)) {
+	if (!json_parser_load_from_data (json_parser,
+					 g_bytes_get_data (bytes, NULL),
+					 g_bytes_get_size (bytes),
+					 &local_error)) {
 		g_set_error (error,
 			     GS_ODRS_PROVIDER_ERROR,
 			     GS_ODRS_PROVIDER_ERROR_PARSING_DATA,
@@ -178,6 +207,8 @@ gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
 	locker = g_mutex_locker_new (&self->ratings_mutex);
 	g_clear_pointer (&self->ratings, g_array_unref);
 	self->ratings = g_steal_pointer (&new_ratings);
+	g_free (self->ratings_hash);
+	self->ratings_hash = g_steal_pointer (&ratings_hash);
 
 	return TRUE;
 }
@@ -1185,6 +1216,7 @@ gs_odrs_provider_finalize (GObject *object)
 	g_free (self->distro);
 	g_free (self->review_server);
 	g_clear_pointer (&self->ratings, g_array_unref);
+	g_free (self->ratings_hash);
 	g_mutex_clear (&self->ratings_mutex);
 
 	G_OBJECT_CLASS (gs_odrs_provider_parent_class)->finalize (object);
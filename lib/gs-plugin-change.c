@@ -0,0 +1,308 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-plugin-change
+ * @title: GsPluginChange
+ * @include: gnome-software.h
+ * @stability: Unstable
+ * @short_description: Description of what changed when a plugin reloads
+ *
+ * A #GsPluginChange says which apps were affected when a plugin notices the
+ * system changing underneath it, so that the UI can refresh only those rather
+ * than everything. Apps are identified by their unique ID, or by the origin
+ * they come from.
+ *
+ * A change can also cover everything, which is what gs_plugin_reload() uses,
+ * and which is always a safe thing to report when a plugin can’t tell what
+ * changed. Merging anything with such a change results in another change
+ * which covers everything.
+ *
+ * A #GsPluginChange is not thread safe. It must not be modified after it has
+ * been passed to gs_plugin_reload_for_change().
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gs-plugin-change.h"
+
+struct _GsPluginChange
+{
+	GObject		 parent_instance;
+
+	gboolean	 all;
+	GPtrArray	*unique_ids;  /* (owned) (element-type utf8) */
+	GPtrArray	*origins;  /* (owned) (element-type utf8) */
+};
+
+G_DEFINE_TYPE (GsPluginChange, gs_plugin_change, G_TYPE_OBJECT)
+
+static void
+gs_plugin_change_finalize (GObject *object)
+{
+	GsPluginChange *self = GS_PLUGIN_CHANGE (object);
+
+	g_ptr_array_unref (self->unique_ids);
+	g_ptr_array_unref (self->origins);
+
+	G_OBJECT_CLASS (gs_plugin_change_parent_class)->finalize (object);
+}
+
+static void
+gs_plugin_change_class_init (GsPluginChangeClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = gs_plugin_change_finalize;
+}
+
+static void
+gs_plugin_change_init (GsPluginChange *self)
+{
+	self->unique_ids = g_ptr_array_new_with_free_func (g_free);
+	self->origins = g_ptr_array_new_with_free_func (g_free);
+}
+
+/**
+ * gs_plugin_change_new:
+ *
+ * Creates a new change which doesn’t affect any apps yet. Add the affected
+ * apps using gs_plugin_change_add_unique_id() and
+ * gs_plugin_change_add_origin().
+ *
+ * Returns: (transfer full): a new #GsPluginChange
+ *
+ * Since: 47
+ **/
+GsPluginChange *
+gs_plugin_change_new (void)
+{
+	return g_object_new (GS_TYPE_PLUGIN_CHANGE, NULL);
+}
+
+/**
+ * gs_plugin_change_new_all:
+ *
+ * Creates a new change which affects all apps.
+ *
+ * Returns: (transfer full): a new #GsPluginChange
+ *
+ * Since: 47
+ **/
+GsPluginChange *
+gs_plugin_change_new_all (void)
+{
+	GsPluginChange *self = gs_plugin_change_new ();
+	self->all = TRUE;
+	return self;
+}
+
+static void
+add_unique_string (GPtrArray   *array,
+                   const gchar *str)
+{
+	if (!g_ptr_array_find_with_equal_func (array, str, g_str_equal, NULL))
+		g_ptr_array_add (array, g_strdup (str));
+}
+
+/**
+ * gs_plugin_change_add_unique_id:
+ * @self: a #GsPluginChange
+ * @unique_id: unique ID of an affected app, which may contain wildcards
+ *
+ * Adds an app to the change. This does nothing if @self already affects all
+ * apps.
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_change_add_unique_id (GsPluginChange *self,
+                                const gchar    *unique_id)
+{
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (self));
+	g_return_if_fail (unique_id != NULL);
+
+	if (!self->all)
+		add_unique_string (self->unique_ids, unique_id);
+}
+
+/**
+ * gs_plugin_change_add_origin:
+ * @self: a #GsPluginChange
+ * @origin: an origin, such as a repository or flatpak remote name
+ *
+ * Adds all the apps from @origin to the change. This does nothing if @self
+ * already affects all apps.
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_change_add_origin (GsPluginChange *self,
+                             const gchar    *origin)
+{
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (self));
+	g_return_if_fail (origin != NULL);
+
+	if (!self->all)
+		add_unique_string (self->origins, origin);
+}
+
+/**
+ * gs_plugin_change_merge:
+ * @self: a #GsPluginChange
+ * @other: another #GsPluginChange
+ *
+ * Adds everything affected by @other to @self.
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_change_merge (GsPluginChange *self,
+                        GsPluginChange *other)
+{
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (self));
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (other));
+
+	if (self->all)
+		return;
+
+	if (other->all) {
+		self->all = TRUE;
+		g_ptr_array_set_size (self->unique_ids, 0);
+		g_ptr_array_set_size (self->origins, 0);
+		return;
+	}
+
+	for (guint i = 0; i < other->unique_ids->len; i++)
+		add_unique_string (self->unique_ids, g_ptr_array_index (other->unique_ids, i));
+	for (guint i = 0; i < other->origins->len; i++)
+		add_unique_string (self->origins, g_ptr_array_index (other->origins, i));
+}
+
+/**
+ * gs_plugin_change_is_all:
+ * @self: a #GsPluginChange
+ *
+ * Gets whether the change affects all apps, in which case everything which
+ * depends on the plugins should be reloaded.
+ *
+ * Returns: %TRUE if all apps are affected
+ *
+ * Since: 47
+ **/
+gboolean
+gs_plugin_change_is_all (GsPluginChange *self)
+{
+	g_return_val_if_fail (GS_IS_PLUGIN_CHANGE (self), TRUE);
+	return self->all;
+}
+
+/**
+ * gs_plugin_change_is_empty:
+ * @self: a #GsPluginChange
+ *
+ * Gets whether the change affects no apps at all.
+ *
+ * Returns: %TRUE if no apps are affected
+ *
+ * Since: 47
+ **/
+gboolean
+gs_plugin_change_is_empty (GsPluginChange *self)
+{
+	g_return_val_if_fail (GS_IS_PLUGIN_CHANGE (self), FALSE);
+	return !self->all && self->unique_ids->len == 0 && self->origins->len == 0;
+}
+
+/**
+ * gs_plugin_change_get_unique_ids:
+ * @self: a #GsPluginChange
+ *
+ * Gets the unique IDs of the apps which were affected. This is empty if
+ * the change affects all apps.
+ *
+ * Returns: (transfer none) (element-type utf8): unique IDs
+ *
+ * Since: 47
+ **/
+GPtrArray *
+gs_plugin_change_get_unique_ids (GsPluginChange *self)
+{
+	g_return_val_if_fail (GS_IS_PLUGIN_CHANGE (self), NULL);
+	return self->unique_ids;
+}
+
+/**
+ * gs_plugin_change_get_origins:
+ * @self: a #GsPluginChange
+ *
+ * Gets the origins whose apps were affected. This is empty if the change
+ * affects all apps.
+ *
+ * Returns: (transfer none) (element-type utf8): origins
+ *
+ * Since: 47
+ **/
+GPtrArray *
+gs_plugin_change_get_origins (GsPluginChange *self)
+{
+	g_return_val_if_fail (GS_IS_PLUGIN_CHANGE (self), NULL);
+	return self->origins;
+}
+
+/**
+ * gs_plugin_change_affects_app:
+ * @self: a #GsPluginChange
+ * @app: a #GsApp
+ *
+ * Gets whether @app is affected by the change, either because the change
+ * affects all apps, or because it lists @app’s unique ID or origin.
+ *
+ * Returns: %TRUE if @app is affected
+ *
+ * Since: 47
+ **/
+gboolean
+gs_plugin_change_affects_app (GsPluginChange *self,
+                              GsApp          *app)
+{
+	const gchar *unique_id;
+	const gchar *origin;
+
+	g_return_val_if_fail (GS_IS_PLUGIN_CHANGE (self), TRUE);
+	g_return_val_if_fail (GS_IS_APP (app), TRUE);
+
+	if (self->all)
+		return TRUE;
+
+	unique_id = gs_app_get_unique_id (app);
+	if (unique_id != NULL) {
+		for (guint i = 0; i < self->unique_ids->len; i++) {
+			if (as_utils_data_id_equal (unique_id, g_ptr_array_index (self->unique_ids, i)))
+				return TRUE;
+		}
+	}
+
+	origin = gs_app_get_origin (app);
+	if (origin != NULL &&
+	    g_ptr_array_find_with_equal_func (self->origins, origin, g_str_equal, NULL))
+		return TRUE;
+
+	/* apps from the distribution catalogue may be known by the name of
+	 * the catalogue rather than the repository they’re installed from */
+	origin = gs_app_get_origin_appstream (app);
+	if (origin != NULL &&
+	    g_ptr_array_find_with_equal_func (self->origins, origin, g_str_equal, NULL))
+		return TRUE;
+
+	return FALSE;
+}
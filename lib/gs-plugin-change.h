@@ -0,0 +1,38 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "gs-app.h"
+
+G_BEGIN_DECLS
+
+#define GS_TYPE_PLUGIN_CHANGE (gs_plugin_change_get_type ())
+
+G_DECLARE_FINAL_TYPE (GsPluginChange, gs_plugin_change, GS, PLUGIN_CHANGE, GObject)
+
+GsPluginChange		*gs_plugin_change_new			(void);
+GsPluginChange		*gs_plugin_change_new_all		(void);
+
+void			 gs_plugin_change_add_unique_id		(GsPluginChange	*self,
+								 const gchar	*unique_id);
+void			 gs_plugin_change_add_origin		(GsPluginChange	*self,
+								 const gchar	*origin);
+void			 gs_plugin_change_merge			(GsPluginChange	*self,
+								 GsPluginChange	*other);
+
+gboolean		 gs_plugin_change_is_all		(GsPluginChange	*self);
+gboolean		 gs_plugin_change_is_empty		(GsPluginChange	*self);
+GPtrArray		*gs_plugin_change_get_unique_ids	(GsPluginChange	*self);
+GPtrArray		*gs_plugin_change_get_origins		(GsPluginChange	*self);
+gboolean		 gs_plugin_change_affects_app		(GsPluginChange	*self,
+								 GsApp		*app);
+
+G_END_DECLS
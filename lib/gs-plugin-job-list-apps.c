@@ -45,6 +45,7 @@
 #include "gs-plugin-job-private.h"
 #include "gs-plugin-job-refine.h"
 #include "gs-plugin-private.h"
+#include "gs-plugin-trace.h"
 #include "gs-plugin-types.h"
 #include "gs-profiler.h"
 #include "gs-utils.h"
@@ -61,6 +62,9 @@ struct _GsPluginJobListApps
 	GsAppList *merged_list;  /* (owned) (nullable) */
 	GError *saved_error;  /* (owned) (nullable) */
 	guint n_pending_ops;
+	gint64 begin_time_usec;  /* for recording plugin calls */
+	GsAppList *already_refined_list;  /* (owned) (nullable); not passed to the refine job */
+	GsPluginRefineFlags refine_flags;
 
 	/* Results. */
 	GsAppList *result_list;  /* (owned) (nullable) */
@@ -87,6 +91,7 @@ gs_plugin_job_list_apps_dispose (GObject *object)
 	g_assert (self->merged_list == NULL);
 	g_assert (self->saved_error == NULL);
 	g_assert (self->n_pending_ops == 0);
+	g_assert (self->already_refined_list == NULL);
 
 	g_clear_object (&self->result_list);
 	g_clear_object (&self->query);
@@ -267,6 +272,7 @@ gs_plugin_job_list_apps_run_async (GsPluginJob         *job,
 	 * initialised to 1 until all the operations are started */
 	self->n_pending_ops = 1;
 	self->merged_list = gs_app_list_new ();
+	self->begin_time_usec = g_get_monotonic_time ();
 	plugins = gs_plugin_loader_get_plugins (plugin_loader);
 
 #ifdef HAVE_SYSPROF
@@ -309,12 +315,21 @@ plugin_list_apps_cb (GObject      *source_object,
 	GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
 	g_autoptr(GTask) task = G_TASK (user_data);
 	GsPluginJobListApps *self = g_task_get_source_object (task);
+	GsPluginLoader *plugin_loader = g_task_get_task_data (task);
 	g_autoptr(GsAppList) plugin_apps = NULL;
 	g_autoptr(GError) local_error = NULL;
 
 	plugin_apps = plugin_class->list_apps_finish (plugin, result, &local_error);
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
+	if (plugin_apps != NULL && gs_plugin_loader_get_recording (plugin_loader)) {
+		g_autofree gchar *query_key = (self->query != NULL) ? gs_plugin_trace_query_to_key (self->query) : NULL;
+
+		gs_plugin_loader_record_call (plugin_loader, plugin, GS_PLUGIN_TRACE_CALL_LIST_APPS,
+					      query_key, plugin_apps,
+					      g_get_monotonic_time () - self->begin_time_usec);
+	}
+
 	if (plugin_apps != NULL)
 		gs_app_list_add_list (self->merged_list, plugin_apps);
 
@@ -383,11 +398,38 @@ finish_op (GTask  *task,
 		refine_flags |= GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE;
 	}
 
+	/* Apps which are the shared instance for their unique ID may already
+	 * have been refined with these flags by another job (for example, the
+	 * same app listed on two pages), so don’t refine those again. */
+	if (merged_list != NULL &&
+	    gs_app_list_length (merged_list) > 0 &&
+	    refine_flags != GS_PLUGIN_REFINE_FLAGS_NONE) {
+		GsAppIdentityMap *identity_map = gs_plugin_loader_get_app_identity_map (plugin_loader);
+		g_autoptr(GsAppList) to_refine_list = gs_app_list_new ();
+
+		self->already_refined_list = gs_app_list_new ();
+		for (guint i = 0; i < gs_app_list_length (merged_list); i++) {
+			GsApp *app = gs_app_list_index (merged_list, i);
+
+			if (gs_app_identity_map_is_refined (identity_map, app, refine_flags))
+				gs_app_list_add (self->already_refined_list, app);
+			else
+				gs_app_list_add (to_refine_list, app);
+		}
+
+		g_debug ("%u of %u apps already refined",
+			 gs_app_list_length (self->already_refined_list),
+			 gs_app_list_length (merged_list));
+
+		g_set_object (&merged_list, to_refine_list);
+	}
+
 	if (merged_list != NULL &&
 	    gs_app_list_length (merged_list) > 0 &&
 	    refine_flags != GS_PLUGIN_REFINE_FLAGS_NONE) {
 		g_autoptr(GsPluginJob) refine_job = NULL;
 
+		self->refine_flags = refine_flags;
 		refine_job = gs_plugin_job_refine_new (merged_list,
 						       refine_flags |
 						       GS_PLUGIN_REFINE_FLAGS_DISABLE_FILTERING);
@@ -397,6 +439,13 @@ finish_op (GTask  *task,
 						    g_object_ref (task));
 	} else {
 		g_debug ("No apps to refine");
+
+		if (self->already_refined_list != NULL) {
+			g_autoptr(GsAppList) already_refined_list = g_steal_pointer (&self->already_refined_list);
+
+			gs_app_list_add_list (merged_list, already_refined_list);
+		}
+
 		finish_task (task, merged_list);
 	}
 }
@@ -410,6 +459,7 @@ refine_cb (GObject      *source_object,
 	g_autoptr(GTask) task = G_TASK (user_data);
 	GsPluginJobListApps *self = g_task_get_source_object (task);
 	g_autoptr(GsAppList) new_list = NULL;
+	g_autoptr(GsAppList) already_refined_list = g_steal_pointer (&self->already_refined_list);
 	g_autoptr(GError) local_error = NULL;
 
 	new_list = gs_plugin_loader_job_process_finish (plugin_loader, result, &local_error);
@@ -420,6 +470,18 @@ refine_cb (GObject      *source_object,
 		return;
 	}
 
+	/* remember which apps are now refined, so other jobs can skip them */
+	for (guint i = 0; i < gs_app_list_length (new_list); i++) {
+		gs_app_identity_map_add_refined (gs_plugin_loader_get_app_identity_map (plugin_loader),
+						 gs_app_list_index (new_list, i),
+						 self->refine_flags);
+	}
+
+	/* the merged list is in plugin completion order anyway, until
+	 * finish_task() sorts it, so appending these is fine */
+	if (already_refined_list != NULL)
+		gs_app_list_add_list (new_list, already_refined_list);
+
 	finish_task (task, new_list);
 }
 
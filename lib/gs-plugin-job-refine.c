@@ -34,7 +34,8 @@
  *
  * Internally, the #GsPluginClass.refine_async() functions are called on all
  * the plugins in series, and in series with calls to
- * gs_odrs_provider_refine_async() and gs_rewrite_resources_async().
+ * gs_odrs_provider_refine_async(), gs_rewrite_resources_async() and
+ * refine_key_colors_async().
  * Once all of those calls are finished,
  * zero or more recursive calls to run_refine_internal_async() are made in
  * parallel to do a similar refine process on the addons, runtime and related
@@ -45,6 +46,14 @@
  * refer to locally cached resources, rather than HTTP/HTTPS URIs for images
  * (for example).
  *
+ * The call to refine_key_colors_async() calculates the key colors of the app
+ * icons in a worker thread if %GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON is set, so
+ * that gs_app_get_key_colors() never has to load an icon on the main thread.
+ *
+ * Which plugins are called, and which of the calls after them are made, only
+ * depends on the #GsPluginRefineFlags, so it is worked out once per set of
+ * flags as a #GsRefinePlan and cached by the #GsPluginLoader.
+ *
  * FIXME: Ideally, the #GsPluginClass.refine_async() calls would happen in
  * parallel, but this cannot be the case until the results of the refine_async()
  * call in one plugin don’t depend on the results of refine_async() in another.
@@ -62,7 +71,8 @@
  *           |                       |             v  gs_odrs_provider_refine_async()              |
  *           |                       |             |                v                  gs_rewrite_resources_async()
  *           |                       |             |                |                              v
- *           |                       |             |                |                              |
+ *           |                       |             |                |                  refine_key_colors_async()
+ *           |                       |             |                |                              v
  *           \-----------------------+-------------+----------------+------------------------------/
  *                                         |
  *                            finish_refine_internal_op()
@@ -96,7 +106,9 @@
 #include "gs-plugin-private.h"
 #include "gs-plugin-job-private.h"
 #include "gs-plugin-job-refine.h"
+#include "gs-plugin-trace.h"
 #include "gs-profiler.h"
+#include "gs-refine-plan.h"
 #include "gs-utils.h"
 
 struct _GsPluginJobRefine
@@ -233,6 +245,9 @@ static void odrs_provider_refine_cb (GObject      *source_object,
 static void rewrite_resources_cb (GObject      *source_object,
                                   GAsyncResult *result,
                                   gpointer      user_data);
+static void refine_key_colors_cb (GObject      *source_object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data);
 static void finish_refine_internal_op (GTask  *task,
                                        GError *error);
 static void recursive_internal_refine_cb (GObject      *source_object,
@@ -249,12 +264,14 @@ typedef struct {
 	GsPluginLoader *plugin_loader;  /* (not nullable) (owned) */
 	GsAppList *list;  /* (not nullable) (owned) */
 	GsPluginRefineFlags flags;
+	GsRefinePlan *plan;  /* (not nullable) (owned) */
 
 	/* In-progress data. */
 	guint n_pending_ops;
 	guint n_pending_recursions;
-	guint next_plugin_index;
-	guint next_plugin_order;
+	guint next_group;
+	gboolean stages_started;
+	gint64 plugin_begin_time_usec;  /* for recording plugin calls */
 
 #ifdef HAVE_SYSPROF
 	gint64 plugin_begin_time_nsec;
@@ -269,6 +286,7 @@ refine_internal_data_free (RefineInternalData *data)
 {
 	g_clear_object (&data->plugin_loader);
 	g_clear_object (&data->list);
+	g_clear_pointer (&data->plan, gs_refine_plan_unref);
 
 	g_assert (data->n_pending_ops == 0);
 	g_assert (data->n_pending_recursions == 0);
@@ -282,6 +300,71 @@ refine_internal_data_free (RefineInternalData *data)
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (RefineInternalData, refine_internal_data_free)
 
+static void
+refine_key_colors_thread_cb (GTask        *task,
+                             gpointer      source_object,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+	GsAppList *list = GS_APP_LIST (task_data);
+	g_autoptr(GHashTable) icon_cache = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	/* Apps often share an icon, so only decode each one once. */
+	icon_cache = g_hash_table_new_full (g_icon_hash, (GEqualFunc) g_icon_equal,
+					    g_object_unref, (GDestroyNotify) g_array_unref);
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error)) {
+			g_task_return_error (task, g_steal_pointer (&local_error));
+			return;
+		}
+
+		gs_app_ensure_key_colors (app, icon_cache);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Calculate the key colors for all the apps in @list which don’t have them
+ * yet, in a worker thread, as doing so requires loading their icons. */
+static void
+refine_key_colors_async (GsAppList           *list,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(GsAppList) pending_list = gs_app_list_new ();
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, refine_key_colors_async);
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+
+		if (gs_app_get_key_colors (app) == NULL)
+			gs_app_list_add (pending_list, app);
+	}
+
+	if (gs_app_list_length (pending_list) == 0) {
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	g_task_set_task_data (task, g_steal_pointer (&pending_list), g_object_unref);
+	g_task_run_in_thread (task, refine_key_colors_thread_cb);
+}
+
+static gboolean
+refine_key_colors_finish (GAsyncResult  *result,
+                          GError       **error)
+{
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 static void
 run_refine_internal_async (GsPluginJobRefine   *self,
                            GsPluginLoader      *plugin_loader,
@@ -291,12 +374,9 @@ run_refine_internal_async (GsPluginJobRefine   *self,
                            GAsyncReadyCallback  callback,
                            gpointer             user_data)
 {
-	GPtrArray *plugins;  /* (element-type GsPlugin) */
 	g_autoptr(GTask) task = NULL;
 	RefineInternalData *data;
 	g_autoptr(RefineInternalData) data_owned = NULL;
-	gboolean anything_ran = FALSE;
-	g_autoptr(GError) local_error = NULL;
 
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_source_tag (task, run_refine_internal_async);
@@ -305,6 +385,8 @@ run_refine_internal_async (GsPluginJobRefine   *self,
 	data->plugin_loader = g_object_ref (plugin_loader);
 	data->list = g_object_ref (list);
 	data->flags = flags;
+	data->plan = gs_plugin_loader_get_refine_plan (plugin_loader, flags);
+	data->plugin_begin_time_usec = g_get_monotonic_time ();
 #ifdef HAVE_SYSPROF
 	data->plugin_begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
 #endif
@@ -313,59 +395,13 @@ run_refine_internal_async (GsPluginJobRefine   *self,
 	/* try to adopt each app with a plugin */
 	gs_plugin_loader_run_adopt (plugin_loader, list);
 
-	data->n_pending_ops = 0;
-	data->next_plugin_order = 0;
-
-	/* run each plugin
-	 *
-	 * FIXME: For now, we have to run these vfuncs sequentially rather than
-	 * all in parallel. This is because there are still dependencies between
-	 * some of the plugins, where the code to refine an app in one plugin
-	 * depends on the results of refining it in another plugin first.
-	 *
-	 * Eventually, the plugins should all be changed/removed so that they
-	 * can operate independently. At that point, this code can be reverted
-	 * so that the refine_async() vfuncs are called in parallel. */
-	plugins = gs_plugin_loader_get_plugins (plugin_loader);
-
-	for (guint i = 0; i < plugins->len; i++) {
-		GsPlugin *plugin = g_ptr_array_index (plugins, i);
-		GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
-
-		if (gs_plugin_get_order (plugin) > data->next_plugin_order) {
-			if (!anything_ran)
-				data->next_plugin_order = gs_plugin_get_order (plugin);
-			else
-				return;
-		}
-
-		if (!gs_plugin_get_enabled (plugin))
-			continue;
-		if (plugin_class->refine_async == NULL)
-			continue;
-
-		/* at least one plugin supports this vfunc */
-		anything_ran = TRUE;
-
-		/* Handle cancellation */
-		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error))
-			break;
-
-		/* FIXME: The next refine_async() call is made in
-		 * finish_refine_internal_op(). */
-		data->next_plugin_index = i + 1;
-
-		/* run the batched plugin symbol */
-		data->n_pending_ops++;
-		plugin_class->refine_async (plugin, list, flags,
-					    cancellable, plugin_refine_cb, g_object_ref (task));
-	}
-
-	if (!anything_ran)
+	if (gs_refine_plan_get_n_groups (data->plan) == 0)
 		g_debug ("no plugin could handle refining apps");
 
-	data->n_pending_ops++;
-	finish_refine_internal_op (task, g_steal_pointer (&local_error));
+	/* The plugin groups and the stages after them are started from
+	 * finish_refine_internal_op(), each once the previous one is done. */
+	data->n_pending_ops = 1;
+	finish_refine_internal_op (task, NULL);
 }
 
 static void
@@ -377,9 +413,9 @@ plugin_refine_cb (GObject      *source_object,
 	g_autoptr(GTask) task = g_steal_pointer (&user_data);
 	GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
 	g_autoptr(GError) local_error = NULL;
+	RefineInternalData *data = g_task_get_task_data (task);
 #ifdef HAVE_SYSPROF
 	GsPluginJobRefine *self = g_task_get_source_object (task);
-	RefineInternalData *data = g_task_get_task_data (task);
 #endif
 
 	GS_PROFILER_ADD_MARK_TAKE (PluginJobRefine,
@@ -400,6 +436,14 @@ plugin_refine_cb (GObject      *source_object,
 
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
+	if (gs_plugin_loader_get_recording (data->plugin_loader)) {
+		g_autofree gchar *flags_str = g_strdup_printf ("%u", (guint) data->flags);
+
+		gs_plugin_loader_record_call (data->plugin_loader, plugin, GS_PLUGIN_TRACE_CALL_REFINE,
+					      flags_str, data->list,
+					      g_get_monotonic_time () - data->plugin_begin_time_usec);
+	}
+
 	finish_refine_internal_op (task, NULL);
 }
 
@@ -440,6 +484,24 @@ rewrite_resources_cb (GObject      *source_object,
 	finish_refine_internal_op (task, g_steal_pointer (&local_error));
 }
 
+static void
+refine_key_colors_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+	g_autoptr(GTask) task = g_steal_pointer (&user_data);
+	g_autoptr(GError) local_error = NULL;
+
+	if (!refine_key_colors_finish (result, &local_error) &&
+	    !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+	    !g_error_matches (local_error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_CANCELLED)) {
+		g_debug ("Calculating key colors failed when refining apps: %s",
+			 local_error->message);
+		g_clear_error (&local_error);
+	}
+	finish_refine_internal_op (task, g_steal_pointer (&local_error));
+}
+
 /* @error is (transfer full) if non-NULL */
 static void
 finish_refine_internal_op (GTask  *task,
@@ -452,10 +514,8 @@ finish_refine_internal_op (GTask  *task,
 	GsPluginLoader *plugin_loader = data->plugin_loader;
 	GsAppList *list = data->list;
 	GsPluginRefineFlags flags = data->flags;
-	GsOdrsProvider *odrs_provider;
-	GsOdrsProviderRefineFlags odrs_refine_flags = 0;
-	GPtrArray *plugins;  /* (element-type GsPlugin) */
-	gboolean anything_ran = FALSE;
+	GsRefinePlan *plan = data->plan;
+	GsRefinePlanStages stages = gs_refine_plan_get_stages (plan);
 
 	if (data->error == NULL && error_owned != NULL) {
 		data->error = g_steal_pointer (&error_owned);
@@ -466,6 +526,7 @@ finish_refine_internal_op (GTask  *task,
 	g_assert (data->n_pending_ops > 0);
 	data->n_pending_ops--;
 
+	data->plugin_begin_time_usec = g_get_monotonic_time ();
 #ifdef HAVE_SYSPROF
 	data->plugin_begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
 #endif
@@ -473,73 +534,74 @@ finish_refine_internal_op (GTask  *task,
 	if (data->n_pending_ops > 0)
 		return;
 
-	/* We reach this line after all plugins of a certain order ran, and now
-	 * we need to run the next set of plugins. */
-	data->next_plugin_order++;
-
-	plugins = gs_plugin_loader_get_plugins (plugin_loader);
-
-	for (guint i = data->next_plugin_index; i < plugins->len; i++) {
-		GsPlugin *plugin = g_ptr_array_index (plugins, i);
-		GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
+	/* Run the next group of plugins, now that all the plugins of the
+	 * previous group have finished.
+	 *
+	 * FIXME: For now, the groups have to run sequentially rather than
+	 * all in parallel. This is because there are still dependencies between
+	 * some of the plugins, where the code to refine an app in one plugin
+	 * depends on the results of refining it in another plugin first.
+	 *
+	 * Eventually, the plugins should all be changed/removed so that they
+	 * can operate independently. At that point, this code can be reverted
+	 * so that the refine_async() vfuncs are called in parallel. */
+	while (data->error == NULL &&
+	       data->next_group < gs_refine_plan_get_n_groups (plan)) {
+		GPtrArray *group = gs_refine_plan_get_group (plan, data->next_group++);
 
-		if (gs_plugin_get_order (plugin) > data->next_plugin_order) {
-			if (!anything_ran)
-				data->next_plugin_order = gs_plugin_get_order (plugin);
-			else
-				return;
-		}
+		if (g_cancellable_set_error_if_cancelled (cancellable, &data->error))
+			break;
 
-		if (!gs_plugin_get_enabled (plugin))
-			continue;
-		if (plugin_class->refine_async == NULL)
-			continue;
-		if (gs_plugin_get_order (plugin) < data->next_plugin_order)
-			continue;
+		for (guint i = 0; i < group->len; i++) {
+			GsPlugin *plugin = g_ptr_array_index (group, i);
 
-		/* at least one plugin supports this vfunc */
-		anything_ran = TRUE;
+			/* the plan may predate a plugin being disabled */
+			if (!gs_plugin_get_enabled (plugin))
+				continue;
 
-		/* FIXME: The next refine_async() call is made in
-		 * finish_refine_internal_op(). */
-		data->next_plugin_index = i + 1;
+			data->n_pending_ops++;
+			GS_PLUGIN_GET_CLASS (plugin)->refine_async (plugin, list, flags,
+								    cancellable, plugin_refine_cb, g_object_ref (task));
+		}
 
-		/* run the batched plugin symbol */
-		data->n_pending_ops++;
-		plugin_class->refine_async (plugin, list, flags,
-					    cancellable, plugin_refine_cb, g_object_ref (task));
+		if (data->n_pending_ops > 0)
+			return;
 	}
 
-	if (data->next_plugin_index == plugins->len) {
-		/* Avoid the ODRS and rewrite refines being run multiple times. */
-		data->next_plugin_index++;
+	if (data->error == NULL && !data->stages_started) {
+		data->stages_started = TRUE;
 
 		/* Add ODRS data if needed */
-		odrs_provider = gs_plugin_loader_get_odrs_provider (plugin_loader);
+		if (stages & GS_REFINE_PLAN_STAGE_ODRS) {
+			GsOdrsProvider *odrs_provider = gs_plugin_loader_get_odrs_provider (plugin_loader);
+
+			if (odrs_provider != NULL) {
+				data->n_pending_ops++;
+				gs_odrs_provider_refine_async (odrs_provider, list,
+							       gs_refine_plan_get_odrs_flags (plan),
+							       cancellable, odrs_provider_refine_cb, g_object_ref (task));
+			}
+		}
 
-		if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS)
-			odrs_refine_flags |= GS_ODRS_PROVIDER_REFINE_FLAGS_GET_REVIEWS;
-		if (flags & (GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEW_RATINGS |
-			     GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING))
-			odrs_refine_flags |= GS_ODRS_PROVIDER_REFINE_FLAGS_GET_RATINGS;
+		/* Rewrite app CSS if needed. */
+		if (stages & GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES) {
+			data->n_pending_ops++;
+			gs_rewrite_resources_async (list, cancellable, rewrite_resources_cb, g_object_ref (task));
+		}
 
-		if (odrs_provider != NULL && odrs_refine_flags != 0) {
+		/* Calculate key colors from the icons if needed. */
+		if (stages & GS_REFINE_PLAN_STAGE_KEY_COLORS) {
 			data->n_pending_ops++;
-			gs_odrs_provider_refine_async (odrs_provider, list, odrs_refine_flags,
-						       cancellable, odrs_provider_refine_cb, g_object_ref (task));
+			refine_key_colors_async (list, cancellable, refine_key_colors_cb, g_object_ref (task));
 		}
 
-		/* Rewrite app CSS if needed. */
-		data->n_pending_ops++;
-		gs_rewrite_resources_async (list, cancellable, rewrite_resources_cb, g_object_ref (task));
+		if (data->n_pending_ops > 0)
+			return;
 	}
 
-	if (data->n_pending_ops > 0)
-		return;
-
 	/* At this point, all the plugin->refine() calls are complete and the
-	 * gs_odrs_provider_refine_async() and gs_rewrite_resources_async()
-	 * calls are also complete. If an error
+	 * gs_odrs_provider_refine_async(), gs_rewrite_resources_async() and
+	 * refine_key_colors_async() calls are also complete. If an error
 	 * occurred during those calls, return with it now rather than
 	 * proceeding to the recursive calls below. */
 	if (data->error != NULL) {
@@ -548,10 +610,11 @@ finish_refine_internal_op (GTask  *task,
 	}
 
 	/* filter any wildcard apps left in the list */
-	gs_app_list_filter (list, app_is_non_wildcard, NULL);
+	if (stages & GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS)
+		gs_app_list_filter (list, app_is_non_wildcard, NULL);
 
 	/* ensure these are sorted by score */
-	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS) {
+	if (stages & GS_REFINE_PLAN_STAGE_SORT_REVIEWS) {
 		GPtrArray *reviews;
 		for (guint i = 0; i < gs_app_list_length (list); i++) {
 			GsApp *app = gs_app_list_index (list, i);
@@ -565,13 +628,9 @@ finish_refine_internal_op (GTask  *task,
 	data->n_pending_recursions = 1;
 
 	/* refine addons one layer deep */
-	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_ADDONS) {
+	if (stages & GS_REFINE_PLAN_STAGE_ADDONS) {
 		g_autoptr(GsAppList) addons_list = gs_app_list_new ();
-		GsPluginRefineFlags addons_flags = flags;
-
-		addons_flags &= ~(GS_PLUGIN_REFINE_FLAGS_REQUIRE_ADDONS |
-				  GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS |
-				  GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEW_RATINGS);
+		GsPluginRefineFlags addons_flags = gs_refine_plan_get_recursion_flags (plan, GS_REFINE_PLAN_STAGE_ADDONS);
 
 		for (guint i = 0; i < gs_app_list_length (list); i++) {
 			GsApp *app = gs_app_list_index (list, i);
@@ -586,7 +645,7 @@ finish_refine_internal_op (GTask  *task,
 			}
 		}
 
-		if (gs_app_list_length (addons_list) > 0 && addons_flags != 0) {
+		if (gs_app_list_length (addons_list) > 0) {
 			data->n_pending_recursions++;
 			run_refine_internal_async (self, plugin_loader,
 						   addons_list, addons_flags,
@@ -596,11 +655,9 @@ finish_refine_internal_op (GTask  *task,
 	}
 
 	/* also do runtime */
-	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_RUNTIME) {
+	if (stages & GS_REFINE_PLAN_STAGE_RUNTIMES) {
 		g_autoptr(GsAppList) runtimes_list = gs_app_list_new ();
-		GsPluginRefineFlags runtimes_flags = flags;
-
-		runtimes_flags &= ~GS_PLUGIN_REFINE_FLAGS_REQUIRE_RUNTIME;
+		GsPluginRefineFlags runtimes_flags = gs_refine_plan_get_recursion_flags (plan, GS_REFINE_PLAN_STAGE_RUNTIMES);
 
 		for (guint i = 0; i < gs_app_list_length (list); i++) {
 			GsApp *app = gs_app_list_index (list, i);
@@ -610,7 +667,7 @@ finish_refine_internal_op (GTask  *task,
 				gs_app_list_add (runtimes_list, runtime);
 		}
 
-		if (gs_app_list_length (runtimes_list) > 0 && runtimes_flags != 0) {
+		if (gs_app_list_length (runtimes_list) > 0) {
 			data->n_pending_recursions++;
 			run_refine_internal_async (self, plugin_loader,
 						   runtimes_list, runtimes_flags,
@@ -620,11 +677,9 @@ finish_refine_internal_op (GTask  *task,
 	}
 
 	/* also do related packages one layer deep */
-	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_RELATED) {
+	if (stages & GS_REFINE_PLAN_STAGE_RELATED) {
 		g_autoptr(GsAppList) related_list = gs_app_list_new ();
-		GsPluginRefineFlags related_flags = flags;
-
-		related_flags &= ~GS_PLUGIN_REFINE_FLAGS_REQUIRE_RELATED;
+		GsPluginRefineFlags related_flags = gs_refine_plan_get_recursion_flags (plan, GS_REFINE_PLAN_STAGE_RELATED);
 
 		for (guint i = 0; i < gs_app_list_length (list); i++) {
 			GsApp *app = gs_app_list_index (list, i);
@@ -638,7 +693,7 @@ finish_refine_internal_op (GTask  *task,
 			}
 		}
 
-		if (gs_app_list_length (related_list) > 0 && related_flags != 0) {
+		if (gs_app_list_length (related_list) > 0) {
 			data->n_pending_recursions++;
 			run_refine_internal_async (self, plugin_loader,
 						   related_list, related_flags,
@@ -9,7 +9,11 @@
 
 #include "config.h"
 
+#include <fcntl.h>
 #include <locale.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <appstream.h>
@@ -24,6 +28,7 @@
 #include "gs-app-list-private.h"
 #include "gs-category-manager.h"
 #include "gs-category-private.h"
+#include "gs-debug.h"
 #include "gs-external-appstream-utils.h"
 #include "gs-ioprio.h"
 #include "gs-os-release.h"
@@ -32,6 +37,7 @@
 #include "gs-plugin-event.h"
 #include "gs-plugin-job-private.h"
 #include "gs-plugin-private.h"
+#include "gs-plugin-trace.h"
 #include "gs-profiler.h"
 #include "gs-utils.h"
 
@@ -72,6 +78,7 @@ struct _GsPluginLoader
 	guint			 updates_changed_id;
 	guint			 updates_changed_cnt;
 	guint			 reload_id;
+	GsPluginChange		*reload_change;  /* (owned) (nullable); what the pending ::reload is for */
 	GHashTable		*disallow_updates;	/* GsPlugin : const char *name */
 
 	GNetworkMonitor		*network_monitor;
@@ -87,6 +94,15 @@ struct _GsPluginLoader
 
 	GDBusConnection		*session_bus_connection;  /* (owned); (not nullable) after setup */
 	GDBusConnection		*system_bus_connection;  /* (owned); (not nullable) after setup */
+
+	GMutex			 trace_mutex;
+	GOutputStream		*trace_stream;  /* (owned) (nullable); set at construction, written with trace_mutex held */
+
+	struct _AdoptTable	*adopt_table;  /* (owned) (nullable); built at the end of setup */
+	GsAppIdentityMap	*app_identity_map;  /* (owned) (not nullable); shared with all plugins */
+
+	GMutex			 refine_plans_mutex;
+	GHashTable		*refine_plans;  /* (owned) (mutex refine_plans_mutex) (element-type GsPluginRefineFlags GsRefinePlan) */
 };
 
 static void gs_plugin_loader_monitor_network (GsPluginLoader *plugin_loader);
@@ -110,6 +126,7 @@ enum {
 	SIGNAL_PENDING_APPS_CHANGED,
 	SIGNAL_UPDATES_CHANGED,
 	SIGNAL_RELOAD,
+	SIGNAL_CHANGED,
 	SIGNAL_BASIC_AUTH_START,
 	SIGNAL_ASK_UNTRUSTED,
 	SIGNAL_LAST
@@ -469,6 +486,355 @@ gs_plugin_error_handle_failure (GsPluginLoaderHelper *helper,
 	return TRUE;
 }
 
+/**
+ * gs_plugin_loader_get_app_identity_map:
+ * @plugin_loader: a #GsPluginLoader
+ *
+ * Get the identity map shared by @plugin_loader and all its plugins, which
+ * keeps one #GsApp instance per unique ID alive while anything uses it.
+ *
+ * This function is intended to be used by internal gnome-software code.
+ *
+ * Returns: (transfer none) (not nullable): the identity map
+ * Since: 47
+ */
+GsAppIdentityMap *
+gs_plugin_loader_get_app_identity_map (GsPluginLoader *plugin_loader)
+{
+	g_return_val_if_fail (GS_IS_PLUGIN_LOADER (plugin_loader), NULL);
+
+	return plugin_loader->app_identity_map;
+}
+
+/**
+ * gs_plugin_loader_get_refine_plan:
+ * @plugin_loader: a #GsPluginLoader
+ * @flags: flags for the refine
+ *
+ * Get the plan for refining apps with @flags using the loaded plugins. Plans
+ * are only worked out once for each set of flags, and are dropped again if
+ * the set of enabled plugins changes.
+ *
+ * This function is intended to be used by internal gnome-software code.
+ *
+ * Returns: (transfer full) (not nullable): the refine plan
+ * Since: 47
+ */
+GsRefinePlan *
+gs_plugin_loader_get_refine_plan (GsPluginLoader      *plugin_loader,
+                                  GsPluginRefineFlags  flags)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	GsRefinePlan *plan;
+
+	g_return_val_if_fail (GS_IS_PLUGIN_LOADER (plugin_loader), NULL);
+
+	locker = g_mutex_locker_new (&plugin_loader->refine_plans_mutex);
+
+	plan = g_hash_table_lookup (plugin_loader->refine_plans, GUINT_TO_POINTER (flags));
+	if (plan == NULL) {
+		plan = gs_refine_plan_new (plugin_loader->plugins, flags);
+		g_hash_table_insert (plugin_loader->refine_plans, GUINT_TO_POINTER (flags), plan);
+	}
+
+	return gs_refine_plan_ref (plan);
+}
+
+static void
+gs_plugin_loader_invalidate_refine_plans (GsPluginLoader *plugin_loader)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&plugin_loader->refine_plans_mutex);
+	g_hash_table_remove_all (plugin_loader->refine_plans);
+}
+
+/**
+ * gs_plugin_loader_get_recording:
+ * @plugin_loader: a #GsPluginLoader
+ *
+ * Get whether plugin calls are being recorded to a trace file, which is the
+ * case if `GS_PLUGIN_RECORD_TRACE` was set in the environment when
+ * @plugin_loader was created.
+ *
+ * Callers of gs_plugin_loader_record_call() can check this first to avoid
+ * building its arguments unnecessarily.
+ *
+ * This function is intended to be used by internal gnome-software code.
+ *
+ * Returns: %TRUE if plugin calls are being recorded
+ * Since: 47
+ */
+gboolean
+gs_plugin_loader_get_recording (GsPluginLoader *plugin_loader)
+{
+	g_return_val_if_fail (GS_IS_PLUGIN_LOADER (plugin_loader), FALSE);
+
+	return (plugin_loader->trace_stream != NULL);
+}
+
+static gboolean
+write_trace_node (GOutputStream  *stream,
+                  JsonNode       *node,
+                  GError        **error)
+{
+	g_autofree gchar *line = NULL;
+	gsize line_len;
+
+	line = json_to_string (node, FALSE);
+	line_len = strlen (line);
+	line[line_len] = '\n';
+
+	/* the nul terminator is overwritten by the newline */
+	return g_output_stream_write_all (stream, line, line_len + 1, NULL, NULL, error);
+}
+
+/**
+ * gs_plugin_loader_record_call:
+ * @plugin_loader: a #GsPluginLoader
+ * @plugin: the plugin which was called
+ * @call_name: name of the vfunc which was called, such as
+ *   %GS_PLUGIN_TRACE_CALL_LIST_APPS
+ * @input: (nullable): a string identifying the input to the call, which is
+ *   used to match it when replaying
+ * @apps: (nullable): the apps returned or refined by the call
+ * @duration_usec: how long the call took, in microseconds
+ *
+ * Record a completed plugin vfunc call to the trace file, along with the
+ * current properties of each of @apps. The trace can be replayed by the
+ * replay plugin to benchmark the loader and UI without the services the
+ * plugins normally talk to. The trace format is documented in
+ * gs-plugin-trace.c.
+ *
+ * This does nothing if gs_plugin_loader_get_recording() returns %FALSE. It
+ * can be called from any thread.
+ *
+ * This function is intended to be used by internal gnome-software code.
+ *
+ * Since: 47
+ */
+void
+gs_plugin_loader_record_call (GsPluginLoader *plugin_loader,
+                              GsPlugin       *plugin,
+                              const gchar    *call_name,
+                              const gchar    *input,
+                              GsAppList      *apps,
+                              gint64          duration_usec)
+{
+	g_autoptr(JsonBuilder) builder = NULL;
+	g_autoptr(JsonNode) call_node = NULL;
+	g_autoptr(GPtrArray) app_nodes = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	g_return_if_fail (GS_IS_PLUGIN_LOADER (plugin_loader));
+	g_return_if_fail (GS_IS_PLUGIN (plugin));
+	g_return_if_fail (call_name != NULL);
+	g_return_if_fail (apps == NULL || GS_IS_APP_LIST (apps));
+
+	if (plugin_loader->trace_stream == NULL)
+		return;
+
+	app_nodes = g_ptr_array_new_with_free_func ((GDestroyNotify) json_node_unref);
+
+	builder = json_builder_new ();
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "call");
+	json_builder_add_string_value (builder, call_name);
+	json_builder_set_member_name (builder, "plugin");
+	json_builder_add_string_value (builder, gs_plugin_get_name (plugin));
+	json_builder_set_member_name (builder, "input");
+	json_builder_add_string_value (builder, (input != NULL) ? input : "");
+	json_builder_set_member_name (builder, "duration-usec");
+	json_builder_add_int_value (builder, duration_usec);
+	json_builder_set_member_name (builder, "apps");
+	json_builder_begin_array (builder);
+	for (guint i = 0; apps != NULL && i < gs_app_list_length (apps); i++) {
+		GsApp *app = gs_app_list_index (apps, i);
+		const gchar *unique_id = gs_app_get_unique_id (app);
+		g_autoptr(JsonBuilder) app_builder = NULL;
+
+		/* apps without a unique ID can’t be matched up on replay */
+		if (unique_id == NULL)
+			continue;
+
+		json_builder_add_string_value (builder, unique_id);
+
+		app_builder = json_builder_new ();
+		json_builder_begin_object (app_builder);
+		json_builder_set_member_name (app_builder, "app");
+		json_builder_add_value (app_builder, gs_plugin_trace_app_to_node (app));
+		json_builder_end_object (app_builder);
+		g_ptr_array_add (app_nodes, json_builder_get_root (app_builder));
+	}
+	json_builder_end_array (builder);
+	json_builder_end_object (builder);
+	call_node = json_builder_get_root (builder);
+
+	/* write the call and then the app snapshots, in one go so that they
+	 * aren’t interleaved with other calls */
+	locker = g_mutex_locker_new (&plugin_loader->trace_mutex);
+
+	if (!write_trace_node (plugin_loader->trace_stream, call_node, &local_error)) {
+		g_debug ("Failed to record plugin call: %s", local_error->message);
+		return;
+	}
+
+	for (guint i = 0; i < app_nodes->len; i++) {
+		if (!write_trace_node (plugin_loader->trace_stream, g_ptr_array_index (app_nodes, i), &local_error)) {
+			g_debug ("Failed to record app: %s", local_error->message);
+			return;
+		}
+	}
+}
+
+/* The adoption dispatch table routes each unmanaged app to the plugins which
+ * might adopt it, rather than offering it to every plugin. It’s built once
+ * setup is complete, from what each plugin declared it can adopt (see
+ * gs_plugin_add_adopt_bundle_kind()), and is read-only afterwards.
+ *
+ * Each mask is a set of indices into @entries, which are in plugin order, so
+ * apps are offered to the candidate plugins in the same order as before. */
+typedef struct {
+	GsPlugin		*plugin;  /* (unowned) */
+	GsPluginAdoptAppFunc	 adopt_app_func;
+} AdoptEntry;
+
+typedef struct {
+	gchar			*prefix;  /* (owned) */
+	guint64			 mask;
+} AdoptIdPrefix;
+
+typedef struct _AdoptTable {
+	GArray			*entries;  /* (element-type AdoptEntry) (owned) */
+	GArray			*id_prefixes;  /* (element-type AdoptIdPrefix) (owned) */
+	guint64			 fallback_mask;  /* plugins which declared nothing */
+	guint64			 bundle_kind_masks[AS_BUNDLE_KIND_LAST];
+	guint64			 component_kind_masks[AS_COMPONENT_KIND_LAST];
+} AdoptTable;
+
+static void
+adopt_id_prefix_clear (AdoptIdPrefix *id_prefix)
+{
+	g_free (id_prefix->prefix);
+}
+
+static void
+adopt_table_free (AdoptTable *table)
+{
+	g_array_unref (table->entries);
+	g_array_unref (table->id_prefixes);
+	g_free (table);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (AdoptTable, adopt_table_free)
+
+static AdoptTable *
+adopt_table_new (GsPluginLoader *plugin_loader)
+{
+	g_autoptr(AdoptTable) table = g_new0 (AdoptTable, 1);
+	guint n_fallback = 0;
+
+	table->entries = g_array_new (FALSE, FALSE, sizeof (AdoptEntry));
+	table->id_prefixes = g_array_new (FALSE, FALSE, sizeof (AdoptIdPrefix));
+	g_array_set_clear_func (table->id_prefixes, (GDestroyNotify) adopt_id_prefix_clear);
+
+	for (guint i = 0; i < plugin_loader->plugins->len; i++) {
+		GsPlugin *plugin = g_ptr_array_index (plugin_loader->plugins, i);
+		AdoptEntry entry = { plugin, NULL };
+		GArray *bundle_kinds, *component_kinds;
+		GPtrArray *id_prefixes;
+		guint64 bit;
+
+		entry.adopt_app_func = gs_plugin_get_symbol (plugin, "gs_plugin_adopt_app");
+		if (entry.adopt_app_func == NULL)
+			continue;
+
+		/* fall back to offering every app to every plugin */
+		if (table->entries->len >= 64) {
+			g_debug ("too many plugins for the adoption dispatch table");
+			return NULL;
+		}
+
+		bit = G_GUINT64_CONSTANT (1) << table->entries->len;
+		g_array_append_val (table->entries, entry);
+
+		if (!gs_plugin_get_adopt_declarations (plugin, &bundle_kinds, &component_kinds, &id_prefixes)) {
+			table->fallback_mask |= bit;
+			n_fallback++;
+			continue;
+		}
+
+		for (guint j = 0; bundle_kinds != NULL && j < bundle_kinds->len; j++) {
+			AsBundleKind bundle_kind = g_array_index (bundle_kinds, AsBundleKind, j);
+			if (bundle_kind < AS_BUNDLE_KIND_LAST)
+				table->bundle_kind_masks[bundle_kind] |= bit;
+		}
+		for (guint j = 0; component_kinds != NULL && j < component_kinds->len; j++) {
+			AsComponentKind component_kind = g_array_index (component_kinds, AsComponentKind, j);
+			if (component_kind < AS_COMPONENT_KIND_LAST)
+				table->component_kind_masks[component_kind] |= bit;
+		}
+		for (guint j = 0; id_prefixes != NULL && j < id_prefixes->len; j++) {
+			AdoptIdPrefix id_prefix = { g_strdup (g_ptr_array_index (id_prefixes, j)), bit };
+			g_array_append_val (table->id_prefixes, id_prefix);
+		}
+	}
+
+	g_debug ("built adoption dispatch table for %u plugins, %u of which are offered every app",
+		 table->entries->len, n_fallback);
+
+	return g_steal_pointer (&table);
+}
+
+static guint64
+adopt_table_get_candidates (AdoptTable *table,
+                            GsApp      *app)
+{
+	AsBundleKind bundle_kind = gs_app_get_bundle_kind (app);
+	AsComponentKind component_kind = gs_app_get_kind (app);
+	const gchar *id = gs_app_get_id (app);
+	guint64 mask = table->fallback_mask;
+
+	if (bundle_kind < AS_BUNDLE_KIND_LAST)
+		mask |= table->bundle_kind_masks[bundle_kind];
+	if (component_kind < AS_COMPONENT_KIND_LAST)
+		mask |= table->component_kind_masks[component_kind];
+
+	for (guint i = 0; id != NULL && i < table->id_prefixes->len; i++) {
+		const AdoptIdPrefix *id_prefix = &g_array_index (table->id_prefixes, AdoptIdPrefix, i);
+		if (g_str_has_prefix (id, id_prefix->prefix))
+			mask |= id_prefix->mask;
+	}
+
+	return mask;
+}
+
+static void
+adopt_table_adopt_app (AdoptTable *table,
+                       GsApp      *app)
+{
+	guint64 mask = adopt_table_get_candidates (table, app);
+
+	for (guint i = 0; i < table->entries->len && (mask >> i) != 0; i++) {
+		const AdoptEntry *entry = &g_array_index (table->entries, AdoptEntry, i);
+
+		if (!(mask & (G_GUINT64_CONSTANT (1) << i)))
+			continue;
+
+		/* disabled plugins shouldn't be checked */
+		if (!gs_plugin_get_enabled (entry->plugin))
+			continue;
+
+		entry->adopt_app_func (entry->plugin, app);
+
+		if (!gs_app_has_management_plugin (app, NULL)) {
+			gs_debug_if_enabled ("%s adopted %s",
+					     gs_plugin_get_name (entry->plugin),
+					     gs_app_get_unique_id (app));
+			return;
+		}
+	}
+}
+
 /**
  * gs_plugin_loader_run_adopt:
  * @plugin_loader: a #GsPluginLoader
@@ -477,6 +843,9 @@ gs_plugin_error_handle_failure (GsPluginLoaderHelper *helper,
  * Call the gs_plugin_adopt_app() function on each plugin on each app in @list
  * to try and find the plugin which should manage each app.
  *
+ * Once setup is complete, each app is only offered to the plugins which
+ * declared they might adopt it, and to the plugins which declared nothing.
+ *
  * This function is intended to be used by internal gnome-software code.
  *
  * Since: 42
@@ -487,13 +856,7 @@ gs_plugin_loader_run_adopt (GsPluginLoader *plugin_loader, GsAppList *list)
 	guint i;
 	guint j;
 
-	/* go through each plugin in order */
-	for (i = 0; i < plugin_loader->plugins->len; i++) {
-		GsPluginAdoptAppFunc adopt_app_func = NULL;
-		GsPlugin *plugin = g_ptr_array_index (plugin_loader->plugins, i);
-		adopt_app_func = gs_plugin_get_symbol (plugin, "gs_plugin_adopt_app");
-		if (adopt_app_func == NULL)
-			continue;
+	if (plugin_loader->adopt_table != NULL) {
 		for (j = 0; j < gs_app_list_length (list); j++) {
 			GsApp *app = gs_app_list_index (list, j);
 
@@ -502,12 +865,31 @@ gs_plugin_loader_run_adopt (GsPluginLoader *plugin_loader, GsAppList *list)
 			if (!gs_app_has_management_plugin (app, NULL))
 				continue;
 
-			adopt_app_func (plugin, app);
+			adopt_table_adopt_app (plugin_loader->adopt_table, app);
+		}
+	} else {
+		/* go through each plugin in order */
+		for (i = 0; i < plugin_loader->plugins->len; i++) {
+			GsPluginAdoptAppFunc adopt_app_func = NULL;
+			GsPlugin *plugin = g_ptr_array_index (plugin_loader->plugins, i);
+			adopt_app_func = gs_plugin_get_symbol (plugin, "gs_plugin_adopt_app");
+			if (adopt_app_func == NULL)
+				continue;
+			for (j = 0; j < gs_app_list_length (list); j++) {
+				GsApp *app = gs_app_list_index (list, j);
+
+				if (gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD))
+					continue;
+				if (!gs_app_has_management_plugin (app, NULL))
+					continue;
+
+				adopt_app_func (plugin, app);
 
-			if (!gs_app_has_management_plugin (app, NULL)) {
-				g_debug ("%s adopted %s",
-					 gs_plugin_get_name (plugin),
-					 gs_app_get_unique_id (app));
+				if (!gs_app_has_management_plugin (app, NULL)) {
+					gs_debug_if_enabled ("%s adopted %s",
+							     gs_plugin_get_name (plugin),
+							     gs_app_get_unique_id (app));
+				}
 			}
 		}
 	}
@@ -519,7 +901,7 @@ gs_plugin_loader_run_adopt (GsPluginLoader *plugin_loader, GsAppList *list)
 		if (!gs_app_has_management_plugin (app, NULL))
 			continue;
 
-		g_debug ("nothing adopted %s", gs_app_get_unique_id (app));
+		gs_debug_if_enabled ("nothing adopted %s", gs_app_get_unique_id (app));
 	}
 }
 
@@ -1460,6 +1842,9 @@ gs_plugin_loader_job_updates_changed_cb (GsPlugin *plugin,
 {
 	plugin_loader->updates_changed_cnt++;
 
+	/* app states may have changed underneath the refined apps */
+	gs_app_identity_map_invalidate (plugin_loader->app_identity_map);
+
 	/* Schedule emit of updates changed when no job is active.
 	   This helps to avoid a race condition when a plugin calls
 	   updates-changed at the end of the job, but the job is
@@ -1472,9 +1857,15 @@ static gboolean
 gs_plugin_loader_reload_delay_cb (gpointer user_data)
 {
 	GsPluginLoader *plugin_loader = GS_PLUGIN_LOADER (user_data);
+	g_autoptr(GsPluginChange) change = g_steal_pointer (&plugin_loader->reload_change);
+
+	if (change == NULL)
+		change = gs_plugin_change_new_all ();
 
 	/* notify shells */
-	g_debug ("emitting ::reload");
+	g_debug ("emitting ::changed and ::reload for %s",
+		 gs_plugin_change_is_all (change) ? "all apps" : "some apps");
+	g_signal_emit (plugin_loader, signals[SIGNAL_CHANGED], 0, change);
 	g_signal_emit (plugin_loader, signals[SIGNAL_RELOAD], 0);
 	plugin_loader->reload_id = 0;
 
@@ -1482,12 +1873,29 @@ gs_plugin_loader_reload_delay_cb (gpointer user_data)
 	return FALSE;
 }
 
+/* Always emitted by the plugin just before #GsPlugin::reload, so this
+ * accumulates the changes which the next #GsPluginLoader::reload is for,
+ * including those which arrive while it’s already scheduled. */
+static void
+gs_plugin_loader_plugin_changed_cb (GsPlugin       *plugin,
+                                    GsPluginChange *change,
+                                    GsPluginLoader *plugin_loader)
+{
+	if (plugin_loader->reload_change == NULL)
+		plugin_loader->reload_change = gs_plugin_change_new ();
+	gs_plugin_change_merge (plugin_loader->reload_change, change);
+}
+
 static void
 gs_plugin_loader_reload_cb (GsPlugin *in_plugin,
 			    GsPluginLoader *plugin_loader)
 {
 	if (plugin_loader->reload_id != 0)
 		return;
+
+	/* anything refined before the reload may now be stale */
+	gs_app_identity_map_invalidate (plugin_loader->app_identity_map);
+
 	/* Let also the plugins know that the reload had been initiated;
 	   The GsPluginClass::reload is a signal function, but its default
 	   implementation can be used to notify the plugin. */
@@ -1540,6 +1948,9 @@ gs_plugin_loader_open_plugin (GsPluginLoader *plugin_loader,
 	g_signal_connect (plugin, "updates-changed",
 			  G_CALLBACK (gs_plugin_loader_job_updates_changed_cb),
 			  plugin_loader);
+	g_signal_connect (plugin, "changed",
+			  G_CALLBACK (gs_plugin_loader_plugin_changed_cb),
+			  plugin_loader);
 	g_signal_connect (plugin, "reload",
 			  G_CALLBACK (gs_plugin_loader_reload_cb),
 			  plugin_loader);
@@ -1564,6 +1975,7 @@ gs_plugin_loader_open_plugin (GsPluginLoader *plugin_loader,
 	gs_plugin_set_language (plugin, plugin_loader->language);
 	gs_plugin_set_scale (plugin, gs_plugin_loader_get_scale (plugin_loader));
 	gs_plugin_set_network_monitor (plugin, plugin_loader->network_monitor);
+	gs_plugin_set_app_identity_map (plugin, plugin_loader->app_identity_map);
 	g_debug ("opened plugin %s: %s", filename, gs_plugin_get_name (plugin));
 
 	/* add to array */
@@ -1578,6 +1990,7 @@ gs_plugin_loader_remove_all_plugins (GsPluginLoader *plugin_loader)
 		g_signal_handlers_disconnect_by_data (plugin, plugin_loader);
 	}
 
+	g_clear_pointer (&plugin_loader->adopt_table, adopt_table_free);
 	g_ptr_array_set_size (plugin_loader->plugins, 0);
 }
 
@@ -1765,6 +2178,7 @@ plugin_shutdown_cb (GObject      *source_object,
 			 gs_plugin_get_name (plugin),
 			 local_error->message);
 		gs_plugin_set_enabled (plugin, FALSE);
+		gs_plugin_loader_invalidate_refine_plans (data->plugin_loader);
 	}
 
 	/* Indicate this plugin has finished shutting down. */
@@ -1797,6 +2211,211 @@ gs_plugin_loader_find_plugins (const gchar *path, GError **error)
 	return g_steal_pointer (&fns);
 }
 
+/* Upper bound on the amount of cached icons to prefetch, as there may be a
+ * lot of them and only the ones on the first page are needed quickly. */
+#define PREFETCH_ICONS_MAX_BYTES (16 * 1024 * 1024)
+
+/* Don’t prefetch unless there’s at least this much memory available, plus
+ * the size of the files being prefetched, so as not to evict more useful
+ * pages under memory pressure. */
+#define PREFETCH_MIN_AVAILABLE_MEMORY_BYTES ((guint64) 512 * 1024 * 1024)
+
+typedef struct {
+	guint n_files;
+	guint64 n_bytes;
+	guint64 n_bytes_resident;
+} PrefetchStats;
+
+/* Get the amount of memory which can be used without swapping, or 0 if it’s
+ * not known. */
+static guint64
+get_available_memory_bytes (void)
+{
+	g_autofree gchar *meminfo = NULL;
+	const gchar *line;
+
+	if (!g_file_get_contents ("/proc/meminfo", &meminfo, NULL, NULL))
+		return 0;
+
+	line = strstr (meminfo, "MemAvailable:");
+	if (line == NULL)
+		return 0;
+
+	return g_ascii_strtoull (line + strlen ("MemAvailable:"), NULL, 10) * 1024;
+}
+
+/* Ask the kernel to start reading @filename into the page cache, without
+ * waiting for it to do so. Count how much of it was already resident, to
+ * tell whether this was a cold or warm start. */
+static void
+prefetch_file (const gchar   *filename,
+               PrefetchStats *stats)
+{
+	int fd;
+	struct stat statbuf;
+	long page_size = sysconf (_SC_PAGESIZE);
+
+	fd = open (filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (fstat (fd, &statbuf) != 0 || !S_ISREG (statbuf.st_mode) || statbuf.st_size == 0) {
+		close (fd);
+		return;
+	}
+
+	if (page_size > 0) {
+		gsize n_pages = (statbuf.st_size + page_size - 1) / page_size;
+		void *addr = mmap (NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+		if (addr != MAP_FAILED) {
+			g_autofree unsigned char *vec = g_malloc (n_pages);
+
+			/* the vec type differs between Linux and the BSDs */
+			if (mincore (addr, statbuf.st_size, (gpointer) vec) == 0) {
+				for (gsize i = 0; i < n_pages; i++) {
+					if (vec[i] & 1)
+						stats->n_bytes_resident += page_size;
+				}
+			}
+			munmap (addr, statbuf.st_size);
+		}
+	}
+
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise (fd, 0, statbuf.st_size, POSIX_FADV_WILLNEED);
+#endif
+	close (fd);
+
+	stats->n_files++;
+	stats->n_bytes += statbuf.st_size;
+}
+
+/* List the files which are read on the first queries after startup: the
+ * xmlb silos of each plugin (appstream and one per flatpak installation),
+ * the ODRS ratings, and as many cached icons as fit in the budget. */
+static GPtrArray *
+get_prefetch_filenames (void)
+{
+	g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) cache_roots = g_ptr_array_new_with_free_func (g_free);
+	const gchar *tmp;
+	guint64 icons_size = 0;
+
+	/* this matches the locations used by gs_utils_get_cache_filename() */
+	tmp = g_getenv ("GS_SELF_TEST_CACHEDIR");
+	if (tmp != NULL) {
+		g_ptr_array_add (cache_roots, g_strdup (tmp));
+	} else {
+		g_ptr_array_add (cache_roots, g_build_filename (LOCALSTATEDIR, "cache", "gnome-software", NULL));
+		g_ptr_array_add (cache_roots, g_build_filename (g_get_user_cache_dir (), "gnome-software", NULL));
+	}
+
+	for (guint i = 0; i < cache_roots->len; i++) {
+		const gchar *cache_root = g_ptr_array_index (cache_roots, i);
+		g_autoptr(GDir) dir = g_dir_open (cache_root, 0, NULL);
+		g_autoptr(GDir) icons_dir = NULL;
+		g_autofree gchar *icons_path = NULL;
+		const gchar *kind;
+		const gchar *icon_name;
+
+		if (dir == NULL)
+			continue;
+
+		while ((kind = g_dir_read_name (dir)) != NULL)
+			g_ptr_array_add (filenames, g_build_filename (cache_root, kind, "components.xmlb", NULL));
+
+		g_ptr_array_add (filenames, g_build_filename (cache_root, "odrs", "ratings.json", NULL));
+
+		icons_path = g_build_filename (cache_root, "icons", NULL);
+		icons_dir = g_dir_open (icons_path, 0, NULL);
+		while (icons_dir != NULL &&
+		       icons_size < PREFETCH_ICONS_MAX_BYTES &&
+		       (icon_name = g_dir_read_name (icons_dir)) != NULL) {
+			g_autofree gchar *icon_path = g_build_filename (icons_path, icon_name, NULL);
+			GStatBuf statbuf;
+
+			if (g_stat (icon_path, &statbuf) != 0 || !S_ISREG (statbuf.st_mode))
+				continue;
+
+			icons_size += statbuf.st_size;
+			g_ptr_array_add (filenames, g_steal_pointer (&icon_path));
+		}
+	}
+
+	return g_steal_pointer (&filenames);
+}
+
+static void
+prefetch_caches_thread_cb (GTask        *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
+{
+	g_autoptr(GPtrArray) filenames = NULL;
+	PrefetchStats stats = { 0, };
+	guint64 available_memory;
+	guint percent_resident;
+	gint64 begin_time_usec = g_get_monotonic_time ();
+#ifdef HAVE_SYSPROF
+	gint64 begin_time_nsec G_GNUC_UNUSED = SYSPROF_CAPTURE_CURRENT_TIME;
+#endif
+
+	available_memory = get_available_memory_bytes ();
+	if (available_memory != 0 && available_memory < PREFETCH_MIN_AVAILABLE_MEMORY_BYTES) {
+		g_debug ("Skipping cache prefetch as only %" G_GUINT64_FORMAT " MiB of memory is available",
+			 available_memory / 1024 / 1024);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	filenames = get_prefetch_filenames ();
+
+	for (guint i = 0; i < filenames->len; i++) {
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		/* stop if the prefetched data is growing too large for the
+		 * available memory */
+		if (available_memory != 0 &&
+		    stats.n_bytes + PREFETCH_MIN_AVAILABLE_MEMORY_BYTES > available_memory)
+			break;
+
+		prefetch_file (g_ptr_array_index (filenames, i), &stats);
+	}
+
+	percent_resident = (stats.n_bytes > 0) ? MIN (100, stats.n_bytes_resident * 100 / stats.n_bytes) : 100;
+
+	g_debug ("Prefetched %u cache files (%" G_GUINT64_FORMAT " KiB, %u%% already cached, %s start) in %" G_GINT64_FORMAT "μs",
+		 stats.n_files, stats.n_bytes / 1024, percent_resident,
+		 (percent_resident >= 90) ? "warm" : "cold",
+		 g_get_monotonic_time () - begin_time_usec);
+
+	GS_PROFILER_ADD_MARK_TAKE (PluginLoaderPrefetchCaches,
+				   begin_time_nsec,
+				   g_strdup_printf ("prefetch-caches (%s)", (percent_resident >= 90) ? "warm" : "cold"),
+				   g_strdup_printf ("%u files, %" G_GUINT64_FORMAT " KiB, %u%% already cached",
+						    stats.n_files, stats.n_bytes / 1024, percent_resident));
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Start reading the cache files which plugins will need for their first
+ * queries into the page cache, in parallel with plugin setup. On a cold
+ * start, this avoids those files being faulted in page by page on the query
+ * path. This is purely advisory, so nothing waits for it to complete. */
+static void
+prefetch_caches_async (GsPluginLoader *plugin_loader,
+                       GCancellable   *cancellable)
+{
+	g_autoptr(GTask) task = NULL;
+
+	task = g_task_new (plugin_loader, cancellable, NULL, NULL);
+	g_task_set_source_tag (task, prefetch_caches_async);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+	g_task_run_in_thread (task, prefetch_caches_thread_cb);
+}
+
 typedef struct {
 	guint n_pending;
 	gchar **allowlist;
@@ -1880,6 +2499,9 @@ gs_plugin_loader_setup_async (GsPluginLoader      *plugin_loader,
 		return;
 	}
 
+	/* Warm up the page cache while plugins are being set up. */
+	prefetch_caches_async (plugin_loader, cancellable);
+
 	/* Setup data closure. */
 	setup_data = setup_data_owned = g_new0 (SetupData, 1);
 	setup_data->allowlist = g_strdupv ((gchar **) allowlist);
@@ -2242,6 +2864,14 @@ finish_setup_op (GTask *task)
 		return;
 	}
 
+	/* route apps to be adopted by what each plugin declared it can adopt */
+	g_clear_pointer (&plugin_loader->adopt_table, adopt_table_free);
+	plugin_loader->adopt_table = adopt_table_new (plugin_loader);
+
+	/* the enabled plugins are now known, so any refine plans made while
+	 * setting up are out of date */
+	gs_plugin_loader_invalidate_refine_plans (plugin_loader);
+
 	/* Mark setup as complete as it’s now safe for other jobs to be
 	 * processed. Indeed, the final step in setup is to refine the install
 	 * queue apps, which requires @setup_complete to be %TRUE. */
@@ -2442,6 +3072,7 @@ gs_plugin_loader_dispose (GObject *object)
 		/* Shut down all the plugins first. */
 		gs_plugin_loader_shutdown (plugin_loader, NULL);
 
+		g_clear_pointer (&plugin_loader->adopt_table, adopt_table_free);
 		g_clear_pointer (&plugin_loader->plugins, g_ptr_array_unref);
 	}
 	if (plugin_loader->updates_changed_id != 0) {
@@ -2476,6 +3107,7 @@ gs_plugin_loader_dispose (GObject *object)
 	g_clear_object (&plugin_loader->job_manager);
 	g_clear_object (&plugin_loader->category_manager);
 	g_clear_object (&plugin_loader->odrs_provider);
+	g_clear_object (&plugin_loader->reload_change);
 	g_clear_object (&plugin_loader->setup_complete_cancellable);
 	g_clear_object (&plugin_loader->pending_apps_cancellable);
 
@@ -2499,9 +3131,17 @@ gs_plugin_loader_finalize (GObject *object)
 	g_ptr_array_unref (plugin_loader->file_monitors);
 	g_hash_table_unref (plugin_loader->events_by_id);
 	g_hash_table_unref (plugin_loader->disallow_updates);
+	gs_app_identity_map_unref (plugin_loader->app_identity_map);
+	g_hash_table_unref (plugin_loader->refine_plans);
+
+	if (plugin_loader->trace_stream != NULL)
+		g_output_stream_close (plugin_loader->trace_stream, NULL, NULL);
+	g_clear_object (&plugin_loader->trace_stream);
 
 	g_mutex_clear (&plugin_loader->pending_apps_mutex);
 	g_mutex_clear (&plugin_loader->events_by_id_mutex);
+	g_mutex_clear (&plugin_loader->trace_mutex);
+	g_mutex_clear (&plugin_loader->refine_plans_mutex);
 
 	G_OBJECT_CLASS (gs_plugin_loader_parent_class)->finalize (object);
 }
@@ -2617,6 +3257,14 @@ gs_plugin_loader_class_init (GsPluginLoaderClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
+	/* Emitted just before ::reload when that was caused by plugins, with
+	 * a #GsPluginChange saying which apps it is for. Handlers of ::reload
+	 * should assume that everything changed if this wasn’t emitted. */
+	signals [SIGNAL_CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, GS_TYPE_PLUGIN_CHANGE);
 	signals [SIGNAL_BASIC_AUTH_START] =
 		g_signal_new ("basic-auth-start",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -2682,6 +3330,10 @@ gs_plugin_loader_init (GsPluginLoader *plugin_loader)
 	plugin_loader->setup_complete_cancellable = g_cancellable_new ();
 	plugin_loader->scale = 1;
 	plugin_loader->plugins = g_ptr_array_new_with_free_func (g_object_unref);
+	plugin_loader->app_identity_map = gs_app_identity_map_new ();
+	g_mutex_init (&plugin_loader->refine_plans_mutex);
+	plugin_loader->refine_plans = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							     NULL, (GDestroyNotify) gs_refine_plan_unref);
 	plugin_loader->pending_apps = NULL;
 	plugin_loader->queued_ops_pool = g_thread_pool_new (gs_plugin_loader_process_in_thread_pool_cb,
 						   plugin_loader,
@@ -2786,6 +3438,22 @@ gs_plugin_loader_init (GsPluginLoader *plugin_loader)
 	for (i = 0; projects[i] != NULL; i++)
 		g_debug ("compatible-project: %s", projects[i]);
 	plugin_loader->compatible_projects = projects;
+
+	/* record plugin calls so they can be replayed by the replay plugin */
+	g_mutex_init (&plugin_loader->trace_mutex);
+	tmp = g_getenv ("GS_PLUGIN_RECORD_TRACE");
+	if (tmp != NULL) {
+		g_autoptr(GFile) trace_file = g_file_new_for_path (tmp);
+
+		g_clear_error (&local_error);
+		plugin_loader->trace_stream = G_OUTPUT_STREAM (g_file_replace (trace_file, NULL, FALSE,
+									      G_FILE_CREATE_REPLACE_DESTINATION,
+									      NULL, &local_error));
+		if (plugin_loader->trace_stream == NULL)
+			g_warning ("Failed to open plugin trace file ‘%s’: %s", tmp, local_error->message);
+		else
+			g_debug ("Recording plugin trace to %s", tmp);
+	}
 }
 
 /**
@@ -12,11 +12,13 @@
 #include <glib-object.h>
 
 #include "gs-app.h"
+#include "gs-app-identity-map.h"
 #include "gs-category.h"
 #include "gs-category-manager.h"
 #include "gs-odrs-provider.h"
 #include "gs-plugin-event.h"
 #include "gs-plugin.h"
+#include "gs-refine-plan.h"
 
 G_BEGIN_DECLS
 
@@ -124,4 +126,16 @@ void		 gs_plugin_loader_run_adopt		(GsPluginLoader *plugin_loader,
 							 GsAppList *list);
 void		 gs_plugin_loader_emit_updates_changed	(GsPluginLoader *self);
 
+GsAppIdentityMap *gs_plugin_loader_get_app_identity_map	(GsPluginLoader *plugin_loader);
+GsRefinePlan	*gs_plugin_loader_get_refine_plan	(GsPluginLoader *plugin_loader,
+							 GsPluginRefineFlags flags);
+
+gboolean	 gs_plugin_loader_get_recording		(GsPluginLoader *plugin_loader);
+void		 gs_plugin_loader_record_call		(GsPluginLoader *plugin_loader,
+							 GsPlugin *plugin,
+							 const gchar *call_name,
+							 const gchar *input,
+							 GsAppList *apps,
+							 gint64 duration_usec);
+
 G_END_DECLS
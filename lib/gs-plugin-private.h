@@ -12,6 +12,7 @@
 #include <glib-object.h>
 #include <gmodule.h>
 
+#include "gs-app-identity-map.h"
 #include "gs-plugin.h"
 
 G_BEGIN_DECLS
@@ -43,6 +44,10 @@ void		 gs_plugin_set_auth_array		(GsPlugin	*plugin,
 							 GPtrArray	*auth_array);
 GPtrArray	*gs_plugin_get_rules			(GsPlugin	*plugin,
 							 GsPluginRule	 rule);
+gboolean	 gs_plugin_get_adopt_declarations	(GsPlugin	*plugin,
+							 GArray		**out_bundle_kinds,
+							 GArray		**out_component_kinds,
+							 GPtrArray	**out_id_prefixes);
 gpointer	 gs_plugin_get_symbol			(GsPlugin	*plugin,
 							 const gchar	*function_name);
 void		 gs_plugin_interactive_inc		(GsPlugin	*plugin);
@@ -50,5 +55,7 @@ void		 gs_plugin_interactive_dec		(GsPlugin	*plugin);
 gchar		*gs_plugin_refine_flags_to_string	(GsPluginRefineFlags refine_flags);
 void		 gs_plugin_set_network_monitor		(GsPlugin		*plugin,
 							 GNetworkMonitor	*monitor);
+void		 gs_plugin_set_app_identity_map		(GsPlugin		*plugin,
+							 GsAppIdentityMap	*app_identity_map);
 
 G_END_DECLS
@@ -0,0 +1,824 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-plugin-trace
+ * @short_description: Serialization helpers for recorded plugin traces
+ *
+ * A plugin trace records the calls made to plugin vfuncs by a
+ * #GsPluginLoader, along with their results and how long they took, so that
+ * they can later be replayed by the `replay` plugin without needing the
+ * services (PackageKit, flatpak remotes, snapd, fwupd, …) which the original
+ * plugins talked to.
+ *
+ * A trace is a file of newline-separated JSON objects, written with
+ * `GS_PLUGIN_RECORD_TRACE=/path/to/trace` set in the environment. Each line
+ * is either a call record:
+ * |[
+ * { "call": "list-apps", "plugin": "flatpak", "input": "is-installed=1",
+ *   "duration-usec": 12345, "apps": [ "user/flatpak/flathub/org.gnome.Maps/stable" ] }
+ * ]|
+ * or an app record, containing a snapshot of an app’s properties as they were
+ * after the call which preceded it:
+ * |[
+ * { "app": { "id": "org.gnome.Maps", "name": "Maps", … } }
+ * ]|
+ *
+ * If an app appears in several app records, the last one is the most
+ * refined.
+ *
+ * These functions are used to convert #GsApps and #GsAppQuerys to and from
+ * their representations in the trace.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+
+#include "gs-app-collation.h"
+#include "gs-app-permissions.h"
+#include "gs-app-private.h"
+#include "gs-icon.h"
+#include "gs-plugin-trace.h"
+#include "gs-remote-icon.h"
+
+static void
+append_tristate (GString            *str,
+                 const gchar        *name,
+                 GsAppQueryTristate  value)
+{
+	if (value != GS_APP_QUERY_TRISTATE_UNSET)
+		g_string_append_printf (str, "%s=%d;", name, (gint) value);
+}
+
+static void
+append_strv (GString             *str,
+             const gchar         *name,
+             const gchar * const *strv)
+{
+	if (strv == NULL)
+		return;
+
+	g_string_append_printf (str, "%s=", name);
+	for (gsize i = 0; strv[i] != NULL; i++)
+		g_string_append_printf (str, "%s%s", (i > 0) ? "," : "", strv[i]);
+	g_string_append_c (str, ';');
+}
+
+/**
+ * gs_plugin_trace_query_to_key:
+ * @query: a #GsAppQuery
+ *
+ * Build a string which identifies the search criteria of @query, so that a
+ * recorded #GsPluginClass.list_apps_async call can be matched with a later
+ * call with an equivalent query.
+ *
+ * Sort and filter functions can’t be represented, and are ignored. They are
+ * applied to the results by the job, not by plugins, so don’t affect the
+ * recorded results.
+ *
+ * Returns: (transfer full): a key for @query
+ * Since: 47
+ */
+gchar *
+gs_plugin_trace_query_to_key (GsAppQuery *query)
+{
+	g_autoptr(GString) str = g_string_new ("");
+	GsCategory *category;
+	GsApp *alternate_of;
+	GDateTime *released_since;
+	const gchar *provides_tag = NULL;
+	GsAppQueryProvidesType provides_type;
+
+	g_return_val_if_fail (GS_IS_APP_QUERY (query), NULL);
+
+	append_strv (str, "provides-files", gs_app_query_get_provides_files (query));
+	released_since = gs_app_query_get_released_since (query);
+	if (released_since != NULL)
+		g_string_append_printf (str, "released-since=%" G_GINT64_FORMAT ";",
+					g_date_time_to_unix (released_since));
+	append_tristate (str, "is-curated", gs_app_query_get_is_curated (query));
+	append_tristate (str, "is-featured", gs_app_query_get_is_featured (query));
+	category = gs_app_query_get_category (query);
+	if (category != NULL)
+		g_string_append_printf (str, "category=%s;", gs_category_get_id (category));
+	append_tristate (str, "is-installed", gs_app_query_get_is_installed (query));
+	append_strv (str, "deployment-featured", gs_app_query_get_deployment_featured (query));
+	append_strv (str, "developers", gs_app_query_get_developers (query));
+	append_strv (str, "keywords", gs_app_query_get_keywords (query));
+	alternate_of = gs_app_query_get_alternate_of (query);
+	if (alternate_of != NULL)
+		g_string_append_printf (str, "alternate-of=%s;", gs_app_get_unique_id (alternate_of));
+	provides_type = gs_app_query_get_provides (query, &provides_tag);
+	if (provides_type != GS_APP_QUERY_PROVIDES_UNKNOWN)
+		g_string_append_printf (str, "provides=%u:%s;", (guint) provides_type, provides_tag);
+	if (gs_app_query_get_license_type (query) != GS_APP_QUERY_LICENSE_ANY)
+		g_string_append_printf (str, "license-type=%u;", (guint) gs_app_query_get_license_type (query));
+	if (gs_app_query_get_developer_verified_type (query) != GS_APP_QUERY_DEVELOPER_VERIFIED_ANY)
+		g_string_append_printf (str, "developer-verified-type=%u;", (guint) gs_app_query_get_developer_verified_type (query));
+	append_tristate (str, "is-for-update", gs_app_query_get_is_for_update (query));
+	append_tristate (str, "is-historical-update", gs_app_query_get_is_historical_update (query));
+	append_tristate (str, "is-source", gs_app_query_get_is_source (query));
+
+	return g_string_free (g_steal_pointer (&str), FALSE);
+}
+
+static void
+add_string_member (JsonBuilder *builder,
+                   const gchar *name,
+                   const gchar *value)
+{
+	if (value == NULL)
+		return;
+
+	json_builder_set_member_name (builder, name);
+	json_builder_add_string_value (builder, value);
+}
+
+static void
+add_size_member (JsonBuilder *builder,
+                 const gchar *name,
+                 GsSizeType   size_type,
+                 guint64      size_bytes)
+{
+	if (size_type != GS_SIZE_TYPE_VALID)
+		return;
+
+	json_builder_set_member_name (builder, name);
+	json_builder_add_int_value (builder, (gint64) size_bytes);
+}
+
+static void
+add_icon (JsonBuilder *builder,
+          GIcon       *icon)
+{
+	json_builder_begin_object (builder);
+
+	if (GS_IS_REMOTE_ICON (icon)) {
+		add_string_member (builder, "remote", gs_remote_icon_get_uri (GS_REMOTE_ICON (icon)));
+	} else if (G_IS_FILE_ICON (icon)) {
+		g_autofree gchar *path = g_file_get_path (g_file_icon_get_file (G_FILE_ICON (icon)));
+		add_string_member (builder, "file", path);
+	} else if (G_IS_THEMED_ICON (icon)) {
+		add_string_member (builder, "themed", g_themed_icon_get_names (G_THEMED_ICON (icon))[0]);
+	}
+
+	json_builder_set_member_name (builder, "width");
+	json_builder_add_int_value (builder, gs_icon_get_width (icon));
+	json_builder_set_member_name (builder, "height");
+	json_builder_add_int_value (builder, gs_icon_get_height (icon));
+	json_builder_set_member_name (builder, "scale");
+	json_builder_add_int_value (builder, gs_icon_get_scale (icon));
+
+	json_builder_end_object (builder);
+}
+
+static void
+add_strv_member (JsonBuilder     *builder,
+                 const gchar     *name,
+                 const GPtrArray *array)
+{
+	json_builder_set_member_name (builder, name);
+	json_builder_begin_array (builder);
+	for (guint i = 0; array != NULL && i < array->len; i++)
+		json_builder_add_string_value (builder, g_ptr_array_index (array, i));
+	json_builder_end_array (builder);
+}
+
+static void
+add_permissions_member (JsonBuilder      *builder,
+                        const gchar      *name,
+                        GsAppPermissions *permissions)
+{
+	if (permissions == NULL)
+		return;
+
+	json_builder_set_member_name (builder, name);
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "flags");
+	json_builder_add_int_value (builder, gs_app_permissions_get_flags (permissions));
+	add_strv_member (builder, "filesystem-read", gs_app_permissions_get_filesystem_read (permissions));
+	add_strv_member (builder, "filesystem-full", gs_app_permissions_get_filesystem_full (permissions));
+	json_builder_end_object (builder);
+}
+
+static void
+add_content_rating_member (JsonBuilder     *builder,
+                           AsContentRating *content_rating)
+{
+	g_autofree const gchar **rating_ids = NULL;
+
+	if (content_rating == NULL)
+		return;
+
+	json_builder_set_member_name (builder, "content-rating");
+	json_builder_begin_object (builder);
+	add_string_member (builder, "kind", as_content_rating_get_kind (content_rating));
+	json_builder_set_member_name (builder, "values");
+	json_builder_begin_object (builder);
+
+	/* unset values are treated as `none` anyway */
+	rating_ids = as_content_rating_get_all_rating_ids ();
+	for (gsize i = 0; rating_ids[i] != NULL; i++) {
+		AsContentRatingValue value = as_content_rating_get_value (content_rating, rating_ids[i]);
+
+		if (value != AS_CONTENT_RATING_VALUE_UNKNOWN &&
+		    value != AS_CONTENT_RATING_VALUE_NONE)
+			add_string_member (builder, rating_ids[i], as_content_rating_value_to_string (value));
+	}
+
+	json_builder_end_object (builder);
+	json_builder_end_object (builder);
+}
+
+static void
+add_screenshot (JsonBuilder  *builder,
+                AsScreenshot *screenshot)
+{
+	GPtrArray *images = as_screenshot_get_images (screenshot);
+	GPtrArray *videos = as_screenshot_get_videos (screenshot);
+
+	json_builder_begin_object (builder);
+	add_string_member (builder, "caption", as_screenshot_get_caption (screenshot));
+
+	json_builder_set_member_name (builder, "images");
+	json_builder_begin_array (builder);
+	for (guint i = 0; images != NULL && i < images->len; i++) {
+		AsImage *image = g_ptr_array_index (images, i);
+
+		json_builder_begin_object (builder);
+		add_string_member (builder, "url", as_image_get_url (image));
+		add_string_member (builder, "kind", as_image_kind_to_string (as_image_get_kind (image)));
+		json_builder_set_member_name (builder, "width");
+		json_builder_add_int_value (builder, as_image_get_width (image));
+		json_builder_set_member_name (builder, "height");
+		json_builder_add_int_value (builder, as_image_get_height (image));
+		json_builder_set_member_name (builder, "scale");
+		json_builder_add_int_value (builder, as_image_get_scale (image));
+		json_builder_end_object (builder);
+	}
+	json_builder_end_array (builder);
+
+	json_builder_set_member_name (builder, "videos");
+	json_builder_begin_array (builder);
+	for (guint i = 0; videos != NULL && i < videos->len; i++) {
+		AsVideo *video = g_ptr_array_index (videos, i);
+
+		json_builder_begin_object (builder);
+		add_string_member (builder, "url", as_video_get_url (video));
+		add_string_member (builder, "codec", as_video_codec_kind_to_string (as_video_get_codec_kind (video)));
+		add_string_member (builder, "container", as_video_container_kind_to_string (as_video_get_container_kind (video)));
+		json_builder_set_member_name (builder, "width");
+		json_builder_add_int_value (builder, as_video_get_width (video));
+		json_builder_set_member_name (builder, "height");
+		json_builder_add_int_value (builder, as_video_get_height (video));
+		json_builder_end_object (builder);
+	}
+	json_builder_end_array (builder);
+
+	json_builder_end_object (builder);
+}
+
+static JsonNode *app_to_node (GsApp    *app,
+                              gboolean  with_children);
+
+static void
+add_app_list_member (JsonBuilder *builder,
+                     const gchar *name,
+                     GsAppList   *list)
+{
+	json_builder_set_member_name (builder, name);
+	json_builder_begin_array (builder);
+	for (guint i = 0; list != NULL && i < gs_app_list_length (list); i++)
+		json_builder_add_value (builder, app_to_node (gs_app_list_index (list, i), FALSE));
+	json_builder_end_array (builder);
+}
+
+/**
+ * gs_plugin_trace_app_to_node:
+ * @app: a #GsApp
+ *
+ * Serialize the refined state of @app, for storing in an app record of a
+ * plugin trace.
+ *
+ * This covers everything plugins set when refining an app, apart from its
+ * version history, reviews and key colours, which are loaded separately.
+ * Related apps and addons are serialized inline, without their own related
+ * apps and addons.
+ *
+ * Returns: (transfer full): a JSON object node for @app
+ * Since: 47
+ */
+JsonNode *
+gs_plugin_trace_app_to_node (GsApp *app)
+{
+	g_return_val_if_fail (GS_IS_APP (app), NULL);
+
+	return app_to_node (app, TRUE);
+}
+
+static JsonNode *
+app_to_node (GsApp    *app,
+             gboolean  with_children)
+{
+	g_autoptr(JsonBuilder) builder = json_builder_new ();
+	g_autoptr(GPtrArray) icons = NULL;
+	g_autoptr(AsContentRating) content_rating = NULL;
+	g_autoptr(GsAppPermissions) permissions = NULL;
+	g_autoptr(GsAppPermissions) update_permissions = NULL;
+	g_auto(GStrv) metadata_keys = NULL;
+	GPtrArray *screenshots;
+	GsSizeType size_type;
+	guint64 size_bytes;
+	guint64 quirks = 0;
+
+	json_builder_begin_object (builder);
+
+	add_string_member (builder, "id", gs_app_get_id (app));
+	add_string_member (builder, "kind", as_component_kind_to_string (gs_app_get_kind (app)));
+	add_string_member (builder, "scope", as_component_scope_to_string (gs_app_get_scope (app)));
+	add_string_member (builder, "bundle-kind", as_bundle_kind_to_string (gs_app_get_bundle_kind (app)));
+	add_string_member (builder, "origin", gs_app_get_origin (app));
+	add_string_member (builder, "origin-appstream", gs_app_get_origin_appstream (app));
+	add_string_member (builder, "branch", gs_app_get_branch (app));
+	json_builder_set_member_name (builder, "state");
+	json_builder_add_int_value (builder, gs_app_get_state (app));
+	add_string_member (builder, "name", gs_app_get_name (app));
+	add_string_member (builder, "summary", gs_app_get_summary (app));
+	add_string_member (builder, "description", gs_app_get_description (app));
+	add_string_member (builder, "version", gs_app_get_version (app));
+	add_string_member (builder, "update-version", gs_app_get_update_version (app));
+	add_string_member (builder, "update-details", gs_app_get_update_details_markup (app));
+	if (gs_app_get_update_urgency (app) != AS_URGENCY_KIND_UNKNOWN)
+		add_string_member (builder, "update-urgency", as_urgency_kind_to_string (gs_app_get_update_urgency (app)));
+	add_string_member (builder, "license", gs_app_get_license (app));
+	add_string_member (builder, "developer-name", gs_app_get_developer_name (app));
+	add_string_member (builder, "project-group", gs_app_get_project_group (app));
+
+	json_builder_set_member_name (builder, "urls");
+	json_builder_begin_object (builder);
+	for (AsUrlKind kind = AS_URL_KIND_UNKNOWN + 1; kind < AS_URL_KIND_LAST; kind++)
+		add_string_member (builder, as_url_kind_to_string (kind), gs_app_get_url (app, kind));
+	json_builder_end_object (builder);
+
+	json_builder_set_member_name (builder, "release-date");
+	json_builder_add_int_value (builder, gs_app_get_release_date (app));
+	json_builder_set_member_name (builder, "install-date");
+	json_builder_add_int_value (builder, gs_app_get_install_date (app));
+	json_builder_set_member_name (builder, "kudos");
+	json_builder_add_int_value (builder, gs_app_get_kudos (app));
+
+	for (guint64 quirk = 1; quirk < GS_APP_QUIRK_LAST; quirk <<= 1) {
+		if (gs_app_has_quirk (app, (GsAppQuirk) quirk))
+			quirks |= quirk;
+	}
+	json_builder_set_member_name (builder, "quirks");
+	json_builder_add_int_value (builder, quirks);
+
+	size_type = gs_app_get_size_installed (app, &size_bytes);
+	add_size_member (builder, "size-installed", size_type, size_bytes);
+	size_type = gs_app_get_size_download (app, &size_bytes);
+	add_size_member (builder, "size-download", size_type, size_bytes);
+
+	add_strv_member (builder, "sources", gs_app_get_sources (app));
+	add_strv_member (builder, "source-ids", gs_app_get_source_ids (app));
+	add_strv_member (builder, "categories", gs_app_get_categories (app));
+
+	/* metadata values are printed with their types, so they can be parsed
+	 * back into the same #GVariant types */
+	metadata_keys = gs_app_dup_metadata_keys (app);
+	json_builder_set_member_name (builder, "metadata");
+	json_builder_begin_object (builder);
+	for (gsize i = 0; metadata_keys[i] != NULL; i++) {
+		GVariant *value = gs_app_get_metadata_variant (app, metadata_keys[i]);
+		g_autofree gchar *value_str = NULL;
+
+		if (value == NULL)
+			continue;
+
+		value_str = g_variant_print (value, TRUE);
+		add_string_member (builder, metadata_keys[i], value_str);
+	}
+	json_builder_end_object (builder);
+
+	icons = gs_app_dup_icons (app);
+	json_builder_set_member_name (builder, "icons");
+	json_builder_begin_array (builder);
+	for (guint i = 0; icons != NULL && i < icons->len; i++)
+		add_icon (builder, g_ptr_array_index (icons, i));
+	json_builder_end_array (builder);
+
+	screenshots = gs_app_get_screenshots (app);
+	json_builder_set_member_name (builder, "screenshots");
+	json_builder_begin_array (builder);
+	for (guint i = 0; i < screenshots->len; i++)
+		add_screenshot (builder, g_ptr_array_index (screenshots, i));
+	json_builder_end_array (builder);
+
+	content_rating = gs_app_dup_content_rating (app);
+	add_content_rating_member (builder, content_rating);
+
+	permissions = gs_app_dup_permissions (app);
+	add_permissions_member (builder, "permissions", permissions);
+	update_permissions = gs_app_dup_update_permissions (app);
+	add_permissions_member (builder, "update-permissions", update_permissions);
+
+	if (with_children) {
+		g_autoptr(GsAppList) addons = gs_app_dup_addons (app);
+
+		add_app_list_member (builder, "related", gs_app_get_related (app));
+		add_app_list_member (builder, "addons", addons);
+	}
+
+	json_builder_end_object (builder);
+
+	return json_builder_get_root (builder);
+}
+
+static GIcon *
+icon_from_object (JsonObject *object)
+{
+	g_autoptr(GIcon) icon = NULL;
+
+	if (json_object_has_member (object, "remote")) {
+		icon = gs_remote_icon_new (json_object_get_string_member (object, "remote"));
+	} else if (json_object_has_member (object, "file")) {
+		g_autoptr(GFile) file = g_file_new_for_path (json_object_get_string_member (object, "file"));
+		icon = g_file_icon_new (file);
+	} else if (json_object_has_member (object, "themed")) {
+		icon = g_themed_icon_new (json_object_get_string_member (object, "themed"));
+	} else {
+		return NULL;
+	}
+
+	gs_icon_set_width (icon, json_object_get_int_member_with_default (object, "width", 0));
+	gs_icon_set_height (icon, json_object_get_int_member_with_default (object, "height", 0));
+	gs_icon_set_scale (icon, json_object_get_int_member_with_default (object, "scale", 1));
+
+	return g_steal_pointer (&icon);
+}
+
+static GsAppPermissions *
+permissions_from_object (JsonObject *object)
+{
+	g_autoptr(GsAppPermissions) permissions = gs_app_permissions_new ();
+	JsonArray *array;
+
+	gs_app_permissions_set_flags (permissions, json_object_get_int_member_with_default (object, "flags", 0));
+
+	array = json_object_get_array_member (object, "filesystem-read");
+	for (guint i = 0; array != NULL && i < json_array_get_length (array); i++)
+		gs_app_permissions_add_filesystem_read (permissions, json_array_get_string_element (array, i));
+	array = json_object_get_array_member (object, "filesystem-full");
+	for (guint i = 0; array != NULL && i < json_array_get_length (array); i++)
+		gs_app_permissions_add_filesystem_full (permissions, json_array_get_string_element (array, i));
+
+	gs_app_permissions_seal (permissions);
+
+	return g_steal_pointer (&permissions);
+}
+
+static AsContentRating *
+content_rating_from_object (JsonObject *object)
+{
+	g_autoptr(AsContentRating) content_rating = as_content_rating_new ();
+	JsonObject *values;
+	const gchar *kind;
+
+	kind = json_object_get_string_member_with_default (object, "kind", NULL);
+	if (kind != NULL)
+		as_content_rating_set_kind (content_rating, kind);
+
+	values = json_object_get_object_member (object, "values");
+	if (values != NULL) {
+		JsonObjectIter iter;
+		const gchar *rating_id;
+		JsonNode *value_node;
+
+		json_object_iter_init (&iter, values);
+		while (json_object_iter_next (&iter, &rating_id, &value_node)) {
+			as_content_rating_add_attribute (content_rating, rating_id,
+							 as_content_rating_value_from_string (json_node_get_string (value_node)));
+		}
+	}
+
+	return g_steal_pointer (&content_rating);
+}
+
+static AsScreenshot *
+screenshot_from_object (JsonObject *object)
+{
+	g_autoptr(AsScreenshot) screenshot = as_screenshot_new ();
+	const gchar *caption;
+	JsonArray *array;
+
+	caption = json_object_get_string_member_with_default (object, "caption", NULL);
+	if (caption != NULL)
+		as_screenshot_set_caption (screenshot, caption, NULL);
+
+	array = json_object_get_array_member (object, "images");
+	for (guint i = 0; array != NULL && i < json_array_get_length (array); i++) {
+		JsonObject *image_object = json_array_get_object_element (array, i);
+		g_autoptr(AsImage) image = as_image_new ();
+
+		as_image_set_url (image, json_object_get_string_member_with_default (image_object, "url", NULL));
+		as_image_set_kind (image, as_image_kind_from_string (json_object_get_string_member_with_default (image_object, "kind", NULL)));
+		as_image_set_width (image, json_object_get_int_member_with_default (image_object, "width", 0));
+		as_image_set_height (image, json_object_get_int_member_with_default (image_object, "height", 0));
+		as_image_set_scale (image, json_object_get_int_member_with_default (image_object, "scale", 1));
+		as_screenshot_add_image (screenshot, image);
+	}
+
+	array = json_object_get_array_member (object, "videos");
+	for (guint i = 0; array != NULL && i < json_array_get_length (array); i++) {
+		JsonObject *video_object = json_array_get_object_element (array, i);
+		g_autoptr(AsVideo) video = as_video_new ();
+
+		as_video_set_url (video, json_object_get_string_member_with_default (video_object, "url", NULL));
+		as_video_set_codec_kind (video, as_video_codec_kind_from_string (json_object_get_string_member_with_default (video_object, "codec", NULL)));
+		as_video_set_container_kind (video, as_video_container_kind_from_string (json_object_get_string_member_with_default (video_object, "container", NULL)));
+		as_video_set_width (video, json_object_get_int_member_with_default (video_object, "width", 0));
+		as_video_set_height (video, json_object_get_int_member_with_default (video_object, "height", 0));
+		as_screenshot_add_video (screenshot, video);
+	}
+
+	return g_steal_pointer (&screenshot);
+}
+
+/* Build apps from an array of serialized apps, such as the related apps or
+ * addons of another app */
+static GsAppList *
+app_list_from_array (JsonArray  *array,
+                     GError    **error)
+{
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+
+	for (guint i = 0; array != NULL && i < json_array_get_length (array); i++) {
+		g_autoptr(GsApp) app = gs_app_new (NULL);
+
+		if (!gs_plugin_trace_app_apply_node (app, json_array_get_element (array, i), error))
+			return NULL;
+
+		gs_app_list_add (list, app);
+	}
+
+	return g_steal_pointer (&list);
+}
+
+/**
+ * gs_plugin_trace_app_apply_node:
+ * @app: a #GsApp
+ * @node: a JSON object node, as returned by gs_plugin_trace_app_to_node()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Set the properties of @app from a serialized app in a plugin trace.
+ *
+ * The properties which make up the unique ID of @app are only set if they’re
+ * not already set, so this can be used to refine an existing app as well as
+ * to build a new one.
+ *
+ * Returns: %TRUE on success, %FALSE if @node is not a valid serialized app
+ * Since: 47
+ */
+gboolean
+gs_plugin_trace_app_apply_node (GsApp     *app,
+                                JsonNode  *node,
+                                GError   **error)
+{
+	JsonObject *object;
+	const gchar *str;
+	gint64 size;
+
+	g_return_val_if_fail (GS_IS_APP (app), FALSE);
+	g_return_val_if_fail (node != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (!JSON_NODE_HOLDS_OBJECT (node)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Serialized app is not an object");
+		return FALSE;
+	}
+
+	object = json_node_get_object (node);
+
+	/* Unique ID components */
+	str = json_object_get_string_member_with_default (object, "id", NULL);
+	if (str != NULL && gs_app_get_id (app) == NULL)
+		gs_app_set_id (app, str);
+	str = json_object_get_string_member_with_default (object, "kind", NULL);
+	if (str != NULL && gs_app_get_kind (app) == AS_COMPONENT_KIND_UNKNOWN)
+		gs_app_set_kind (app, as_component_kind_from_string (str));
+	str = json_object_get_string_member_with_default (object, "scope", NULL);
+	if (str != NULL && gs_app_get_scope (app) == AS_COMPONENT_SCOPE_UNKNOWN)
+		gs_app_set_scope (app, as_component_scope_from_string (str));
+	str = json_object_get_string_member_with_default (object, "bundle-kind", NULL);
+	if (str != NULL && gs_app_get_bundle_kind (app) == AS_BUNDLE_KIND_UNKNOWN)
+		gs_app_set_bundle_kind (app, as_bundle_kind_from_string (str));
+	str = json_object_get_string_member_with_default (object, "origin", NULL);
+	if (str != NULL && gs_app_get_origin (app) == NULL)
+		gs_app_set_origin (app, str);
+	str = json_object_get_string_member_with_default (object, "branch", NULL);
+	if (str != NULL && gs_app_get_branch (app) == NULL)
+		gs_app_set_branch (app, str);
+
+	/* Everything else */
+	str = json_object_get_string_member_with_default (object, "origin-appstream", NULL);
+	if (str != NULL)
+		gs_app_set_origin_appstream (app, str);
+	if (json_object_has_member (object, "state") &&
+	    gs_app_get_state (app) == GS_APP_STATE_UNKNOWN)
+		gs_app_set_state (app, json_object_get_int_member (object, "state"));
+	str = json_object_get_string_member_with_default (object, "name", NULL);
+	if (str != NULL)
+		gs_app_set_name (app, GS_APP_QUALITY_NORMAL, str);
+	str = json_object_get_string_member_with_default (object, "summary", NULL);
+	if (str != NULL)
+		gs_app_set_summary (app, GS_APP_QUALITY_NORMAL, str);
+	str = json_object_get_string_member_with_default (object, "description", NULL);
+	if (str != NULL)
+		gs_app_set_description (app, GS_APP_QUALITY_NORMAL, str);
+	str = json_object_get_string_member_with_default (object, "version", NULL);
+	if (str != NULL)
+		gs_app_set_version (app, str);
+	str = json_object_get_string_member_with_default (object, "update-version", NULL);
+	if (str != NULL)
+		gs_app_set_update_version (app, str);
+	str = json_object_get_string_member_with_default (object, "license", NULL);
+	if (str != NULL)
+		gs_app_set_license (app, GS_APP_QUALITY_NORMAL, str);
+	str = json_object_get_string_member_with_default (object, "developer-name", NULL);
+	if (str != NULL)
+		gs_app_set_developer_name (app, str);
+	str = json_object_get_string_member_with_default (object, "project-group", NULL);
+	if (str != NULL)
+		gs_app_set_project_group (app, str);
+	str = json_object_get_string_member_with_default (object, "update-details", NULL);
+	if (str != NULL && !gs_app_get_update_details_set (app))
+		gs_app_set_update_details_markup (app, str);
+	str = json_object_get_string_member_with_default (object, "update-urgency", NULL);
+	if (str != NULL)
+		gs_app_set_update_urgency (app, as_urgency_kind_from_string (str));
+
+	if (json_object_has_member (object, "urls") &&
+	    json_object_get_object_member (object, "urls") != NULL) {
+		JsonObject *urls = json_object_get_object_member (object, "urls");
+		JsonObjectIter iter;
+		const gchar *kind_str;
+		JsonNode *url_node;
+
+		json_object_iter_init (&iter, urls);
+		while (json_object_iter_next (&iter, &kind_str, &url_node)) {
+			AsUrlKind kind = as_url_kind_from_string (kind_str);
+
+			if (kind != AS_URL_KIND_UNKNOWN)
+				gs_app_set_url (app, kind, json_node_get_string (url_node));
+		}
+	}
+
+	if (json_object_get_int_member_with_default (object, "release-date", 0) != 0)
+		gs_app_set_release_date (app, json_object_get_int_member (object, "release-date"));
+	if (json_object_get_int_member_with_default (object, "install-date", 0) != 0)
+		gs_app_set_install_date (app, json_object_get_int_member (object, "install-date"));
+	if (json_object_get_int_member_with_default (object, "kudos", 0) != 0) {
+		guint64 kudos = json_object_get_int_member (object, "kudos");
+
+		for (guint i = 0; i < 64; i++) {
+			if (kudos & ((guint64) 1 << i))
+				gs_app_add_kudo (app, (GsAppKudo) ((guint64) 1 << i));
+		}
+	}
+	if (json_object_get_int_member_with_default (object, "quirks", 0) != 0) {
+		guint64 quirks = json_object_get_int_member (object, "quirks");
+
+		for (guint i = 0; i < 64; i++) {
+			if (quirks & ((guint64) 1 << i))
+				gs_app_add_quirk (app, (GsAppQuirk) ((guint64) 1 << i));
+		}
+	}
+
+	size = json_object_get_int_member_with_default (object, "size-installed", -1);
+	if (size >= 0)
+		gs_app_set_size_installed (app, GS_SIZE_TYPE_VALID, size);
+	size = json_object_get_int_member_with_default (object, "size-download", -1);
+	if (size >= 0)
+		gs_app_set_size_download (app, GS_SIZE_TYPE_VALID, size);
+
+	if (json_object_has_member (object, "sources")) {
+		JsonArray *array = json_object_get_array_member (object, "sources");
+
+		for (guint i = 0; array != NULL && i < json_array_get_length (array); i++)
+			gs_app_add_source (app, json_array_get_string_element (array, i));
+	}
+
+	if (json_object_has_member (object, "source-ids")) {
+		JsonArray *array = json_object_get_array_member (object, "source-ids");
+
+		for (guint i = 0; array != NULL && i < json_array_get_length (array); i++)
+			gs_app_add_source_id (app, json_array_get_string_element (array, i));
+	}
+
+	if (json_object_has_member (object, "categories")) {
+		JsonArray *array = json_object_get_array_member (object, "categories");
+
+		for (guint i = 0; array != NULL && i < json_array_get_length (array); i++)
+			gs_app_add_category (app, json_array_get_string_element (array, i));
+	}
+
+	if (json_object_has_member (object, "icons") && !gs_app_has_icons (app)) {
+		JsonArray *array = json_object_get_array_member (object, "icons");
+
+		for (guint i = 0; array != NULL && i < json_array_get_length (array); i++) {
+			g_autoptr(GIcon) icon = icon_from_object (json_array_get_object_element (array, i));
+
+			if (icon != NULL)
+				gs_app_add_icon (app, icon);
+		}
+	}
+
+	if (json_object_has_member (object, "metadata") &&
+	    json_object_get_object_member (object, "metadata") != NULL) {
+		JsonObject *metadata = json_object_get_object_member (object, "metadata");
+		JsonObjectIter iter;
+		const gchar *key;
+		JsonNode *value_node;
+
+		json_object_iter_init (&iter, metadata);
+		while (json_object_iter_next (&iter, &key, &value_node)) {
+			g_autoptr(GVariant) value = NULL;
+			g_autoptr(GError) local_error = NULL;
+
+			value = g_variant_parse (NULL, json_node_get_string (value_node), NULL, NULL, &local_error);
+			if (value == NULL) {
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Invalid metadata value for %s: %s",
+					     key, local_error->message);
+				return FALSE;
+			}
+
+			gs_app_set_metadata_variant (app, key, value);
+		}
+	}
+
+	if (json_object_has_member (object, "screenshots") && gs_app_get_screenshots (app)->len == 0) {
+		JsonArray *array = json_object_get_array_member (object, "screenshots");
+
+		for (guint i = 0; array != NULL && i < json_array_get_length (array); i++) {
+			g_autoptr(AsScreenshot) screenshot = screenshot_from_object (json_array_get_object_element (array, i));
+			gs_app_add_screenshot (app, screenshot);
+		}
+	}
+
+	if (json_object_has_member (object, "content-rating")) {
+		g_autoptr(AsContentRating) content_rating = NULL;
+
+		content_rating = content_rating_from_object (json_object_get_object_member (object, "content-rating"));
+		gs_app_set_content_rating (app, content_rating);
+	}
+
+	if (json_object_has_member (object, "permissions")) {
+		g_autoptr(GsAppPermissions) permissions = NULL;
+
+		permissions = permissions_from_object (json_object_get_object_member (object, "permissions"));
+		gs_app_set_permissions (app, permissions);
+	}
+	if (json_object_has_member (object, "update-permissions")) {
+		g_autoptr(GsAppPermissions) update_permissions = NULL;
+
+		update_permissions = permissions_from_object (json_object_get_object_member (object, "update-permissions"));
+		gs_app_set_update_permissions (app, update_permissions);
+	}
+
+	if (json_object_has_member (object, "related") &&
+	    gs_app_list_length (gs_app_get_related (app)) == 0) {
+		g_autoptr(GsAppList) related = NULL;
+
+		related = app_list_from_array (json_object_get_array_member (object, "related"), error);
+		if (related == NULL)
+			return FALSE;
+		for (guint i = 0; i < gs_app_list_length (related); i++)
+			gs_app_add_related (app, gs_app_list_index (related, i));
+	}
+
+	if (json_object_has_member (object, "addons")) {
+		g_autoptr(GsAppList) existing_addons = gs_app_dup_addons (app);
+
+		if (existing_addons == NULL || gs_app_list_length (existing_addons) == 0) {
+			g_autoptr(GsAppList) addons = NULL;
+
+			addons = app_list_from_array (json_object_get_array_member (object, "addons"), error);
+			if (addons == NULL)
+				return FALSE;
+			gs_app_add_addons (app, addons);
+		}
+	}
+
+	return TRUE;
+}
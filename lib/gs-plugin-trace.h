@@ -0,0 +1,43 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+
+#include "gs-app.h"
+#include "gs-app-query.h"
+
+G_BEGIN_DECLS
+
+/**
+ * GS_PLUGIN_TRACE_CALL_LIST_APPS:
+ *
+ * Name of a #GsPluginClass.list_apps_async call in a plugin trace.
+ *
+ * Since: 47
+ */
+#define GS_PLUGIN_TRACE_CALL_LIST_APPS "list-apps"
+
+/**
+ * GS_PLUGIN_TRACE_CALL_REFINE:
+ *
+ * Name of a #GsPluginClass.refine_async call in a plugin trace.
+ *
+ * Since: 47
+ */
+#define GS_PLUGIN_TRACE_CALL_REFINE "refine"
+
+gchar		*gs_plugin_trace_query_to_key	(GsAppQuery	*query);
+JsonNode	*gs_plugin_trace_app_to_node	(GsApp		*app);
+gboolean	 gs_plugin_trace_app_apply_node	(GsApp		*app,
+						 JsonNode	*node,
+						 GError		**error);
+
+G_END_DECLS
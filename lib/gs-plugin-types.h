@@ -102,7 +102,7 @@ typedef enum {
  * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_SIZE:		Require the installed and download sizes
  * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING:		Require the rating
  * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_VERSION:		Require the version
- * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_HISTORY:		Require the history
+ * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_HISTORY:		Require the history, including the version history
  * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_SETUP_ACTION:	Require enough to install or remove the package
  * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_UPDATE_DETAILS:	Require update details
  * @GS_PLUGIN_REFINE_FLAGS_REQUIRE_ORIGIN:		Require the origin
@@ -59,6 +59,10 @@ GType		 gs_plugin_query_type			(void);
  *
  * If a plugin can adopt this app then it should call
  * gs_app_set_management_plugin() on @app.
+ *
+ * Plugins should declare what they can adopt from their init function, using
+ * gs_plugin_add_adopt_bundle_kind() and related functions, so that they are
+ * only offered apps they might adopt.
  **/
 void		 gs_plugin_adopt_app			(GsPlugin	*plugin,
 							 GsApp		*app);
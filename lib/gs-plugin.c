@@ -36,6 +36,7 @@
 #include <gdk/gdk.h>
 #include <string.h>
 
+#include "gs-app-identity-map.h"
 #include "gs-app-list-private.h"
 #include "gs-download-utils.h"
 #include "gs-enums.h"
@@ -44,13 +45,26 @@
 #include "gs-plugin.h"
 #include "gs-utils.h"
 
+/* The per-plugin cache is split into shards by key hash, each with its own
+ * lock, so that jobs refining apps in parallel on several threads rarely wait
+ * for each other to use it. Lookups only take a reader lock. */
+#define CACHE_N_SHARDS 16
+
 typedef struct
 {
-	GHashTable		*cache;
-	GMutex			 cache_mutex;
+	GRWLock			 lock;
+	GHashTable		*apps;  /* (owned) (lock lock) (element-type utf8 GsApp) */
+} GsPluginCacheShard;
+
+typedef struct
+{
+	GsPluginCacheShard	 cache[CACHE_N_SHARDS];
 	GModule			*module;
 	GsPluginFlags		 flags;
 	GPtrArray		*rules[GS_PLUGIN_RULE_LAST];
+	GArray			*adopt_bundle_kinds;	/* (element-type AsBundleKind) (nullable) */
+	GArray			*adopt_component_kinds;	/* (element-type AsComponentKind) (nullable) */
+	GPtrArray		*adopt_id_prefixes;	/* (element-type utf8) (nullable) */
 	GHashTable		*vfuncs;		/* string:pointer */
 	GMutex			 vfuncs_mutex;
 	gboolean		 enabled;
@@ -65,6 +79,7 @@ typedef struct
 	guint			 timer_id;
 	GMutex			 timer_mutex;
 	GNetworkMonitor		*network_monitor;
+	GsAppIdentityMap	*app_identity_map;	/* (owned) (nullable) */
 
 	GDBusConnection		*session_bus_connection;  /* (owned) (not nullable) */
 	GDBusConnection		*system_bus_connection;  /* (owned) (not nullable) */
@@ -86,6 +101,7 @@ enum {
 	SIGNAL_UPDATES_CHANGED,
 	SIGNAL_STATUS_CHANGED,
 	SIGNAL_RELOAD,
+	SIGNAL_CHANGED,
 	SIGNAL_REPORT_EVENT,
 	SIGNAL_ALLOW_UPDATES,
 	SIGNAL_BASIC_AUTH_START,
@@ -244,6 +260,9 @@ gs_plugin_finalize (GObject *object)
 
 	for (i = 0; i < GS_PLUGIN_RULE_LAST; i++)
 		g_ptr_array_unref (priv->rules[i]);
+	g_clear_pointer (&priv->adopt_bundle_kinds, g_array_unref);
+	g_clear_pointer (&priv->adopt_component_kinds, g_array_unref);
+	g_clear_pointer (&priv->adopt_id_prefixes, g_ptr_array_unref);
 
 	if (priv->timer_id > 0)
 		g_source_remove (priv->timer_id);
@@ -252,9 +271,12 @@ gs_plugin_finalize (GObject *object)
 	g_free (priv->language);
 	if (priv->network_monitor != NULL)
 		g_object_unref (priv->network_monitor);
-	g_hash_table_unref (priv->cache);
+	g_clear_pointer (&priv->app_identity_map, gs_app_identity_map_unref);
+	for (guint i = 0; i < CACHE_N_SHARDS; i++) {
+		g_hash_table_unref (priv->cache[i].apps);
+		g_rw_lock_clear (&priv->cache[i].lock);
+	}
 	g_hash_table_unref (priv->vfuncs);
-	g_mutex_clear (&priv->cache_mutex);
 	g_mutex_clear (&priv->interactive_mutex);
 	g_mutex_clear (&priv->timer_mutex);
 	g_mutex_clear (&priv->vfuncs_mutex);
@@ -562,6 +584,27 @@ gs_plugin_set_network_monitor (GsPlugin *plugin, GNetworkMonitor *monitor)
 	g_set_object (&priv->network_monitor, monitor);
 }
 
+/**
+ * gs_plugin_set_app_identity_map:
+ * @plugin: a #GsPlugin
+ * @app_identity_map: (nullable): a #GsAppIdentityMap
+ *
+ * Sets the map which gs_plugin_intern_app() uses to share #GsApp instances
+ * between plugins. This is owned by the #GsPluginLoader.
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_set_app_identity_map (GsPlugin         *plugin,
+                                GsAppIdentityMap *app_identity_map)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+
+	g_clear_pointer (&priv->app_identity_map, gs_app_identity_map_unref);
+	if (app_identity_map != NULL)
+		priv->app_identity_map = gs_app_identity_map_ref (app_identity_map);
+}
+
 /**
  * gs_plugin_get_network_available:
  * @plugin: a #GsPlugin
@@ -675,6 +718,125 @@ gs_plugin_get_rules (GsPlugin *plugin, GsPluginRule rule)
 	return priv->rules[rule];
 }
 
+/**
+ * gs_plugin_add_adopt_bundle_kind:
+ * @plugin: a #GsPlugin
+ * @bundle_kind: an #AsBundleKind, e.g. %AS_BUNDLE_KIND_FLATPAK
+ *
+ * Declares that gs_plugin_adopt_app() may adopt apps with @bundle_kind.
+ *
+ * Once a plugin has declared anything it can adopt, using this function,
+ * gs_plugin_add_adopt_component_kind() or gs_plugin_add_adopt_id_prefix(),
+ * its gs_plugin_adopt_app() is only called for apps which match at least one
+ * of the declarations. Plugins which declare nothing are offered every app.
+ *
+ * This should be called from the plugin’s init function, like
+ * gs_plugin_add_rule().
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_add_adopt_bundle_kind (GsPlugin     *plugin,
+                                 AsBundleKind  bundle_kind)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+
+	g_return_if_fail (GS_IS_PLUGIN (plugin));
+
+	if (priv->adopt_bundle_kinds == NULL)
+		priv->adopt_bundle_kinds = g_array_new (FALSE, FALSE, sizeof (AsBundleKind));
+	g_array_append_val (priv->adopt_bundle_kinds, bundle_kind);
+}
+
+/**
+ * gs_plugin_add_adopt_component_kind:
+ * @plugin: a #GsPlugin
+ * @component_kind: an #AsComponentKind, e.g. %AS_COMPONENT_KIND_FIRMWARE
+ *
+ * Declares that gs_plugin_adopt_app() may adopt apps of @component_kind.
+ *
+ * See gs_plugin_add_adopt_bundle_kind().
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_add_adopt_component_kind (GsPlugin        *plugin,
+                                    AsComponentKind  component_kind)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+
+	g_return_if_fail (GS_IS_PLUGIN (plugin));
+
+	if (priv->adopt_component_kinds == NULL)
+		priv->adopt_component_kinds = g_array_new (FALSE, FALSE, sizeof (AsComponentKind));
+	g_array_append_val (priv->adopt_component_kinds, component_kind);
+}
+
+/**
+ * gs_plugin_add_adopt_id_prefix:
+ * @plugin: a #GsPlugin
+ * @prefix: (not nullable): a prefix of app IDs, e.g. "io.snapcraft."
+ *
+ * Declares that gs_plugin_adopt_app() may adopt apps whose ID starts with
+ * @prefix.
+ *
+ * See gs_plugin_add_adopt_bundle_kind().
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_add_adopt_id_prefix (GsPlugin    *plugin,
+                               const gchar *prefix)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+
+	g_return_if_fail (GS_IS_PLUGIN (plugin));
+	g_return_if_fail (prefix != NULL && *prefix != '\0');
+
+	if (priv->adopt_id_prefixes == NULL)
+		priv->adopt_id_prefixes = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (priv->adopt_id_prefixes, g_strdup (prefix));
+}
+
+/**
+ * gs_plugin_get_adopt_declarations:
+ * @plugin: a #GsPlugin
+ * @out_bundle_kinds: (out) (transfer none) (nullable) (optional): return
+ *   location for the declared bundle kinds
+ * @out_component_kinds: (out) (transfer none) (nullable) (optional): return
+ *   location for the declared component kinds
+ * @out_id_prefixes: (out) (transfer none) (nullable) (optional): return
+ *   location for the declared ID prefixes
+ *
+ * Gets what the plugin has declared it can adopt. Each array is %NULL if
+ * nothing of that type was declared.
+ *
+ * Returns: %TRUE if the plugin declared anything, %FALSE if it should be
+ *   offered every app
+ * Since: 47
+ **/
+gboolean
+gs_plugin_get_adopt_declarations (GsPlugin   *plugin,
+                                  GArray    **out_bundle_kinds,
+                                  GArray    **out_component_kinds,
+                                  GPtrArray **out_id_prefixes)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+
+	g_return_val_if_fail (GS_IS_PLUGIN (plugin), FALSE);
+
+	if (out_bundle_kinds != NULL)
+		*out_bundle_kinds = priv->adopt_bundle_kinds;
+	if (out_component_kinds != NULL)
+		*out_component_kinds = priv->adopt_component_kinds;
+	if (out_id_prefixes != NULL)
+		*out_id_prefixes = priv->adopt_id_prefixes;
+
+	return (priv->adopt_bundle_kinds != NULL ||
+		priv->adopt_component_kinds != NULL ||
+		priv->adopt_id_prefixes != NULL);
+}
+
 /**
  * gs_plugin_check_distro_id:
  * @plugin: a #GsPlugin
@@ -1225,15 +1387,30 @@ gs_plugin_updates_changed (GsPlugin *plugin)
 			 weak_ref_new (plugin), (GDestroyNotify) weak_ref_free);
 }
 
+typedef struct {
+	GWeakRef plugin_weak;
+	GsPluginChange *change;  /* (owned) */
+} ReloadData;
+
+static void
+reload_data_free (ReloadData *data)
+{
+	g_weak_ref_clear (&data->plugin_weak);
+	g_object_unref (data->change);
+	g_free (data);
+}
+
 static gboolean
 gs_plugin_reload_cb (gpointer user_data)
 {
-	GWeakRef *plugin_weak = user_data;
+	ReloadData *data = user_data;
 	g_autoptr(GsPlugin) plugin = NULL;
 
-	plugin = g_weak_ref_get (plugin_weak);
-	if (plugin != NULL)
+	plugin = g_weak_ref_get (&data->plugin_weak);
+	if (plugin != NULL) {
+		g_signal_emit (plugin, signals[SIGNAL_CHANGED], 0, data->change);
 		g_signal_emit (plugin, signals[SIGNAL_RELOAD], 0);
+	}
 
 	return G_SOURCE_REMOVE;
 }
@@ -1246,16 +1423,63 @@ gs_plugin_reload_cb (gpointer user_data)
  * reload after a small delay, causing mush flashing, wailing and
  * gnashing of teeth.
  *
- * Plugins should not call this unless absolutely required.
+ * Plugins should not call this unless absolutely required, and should use
+ * gs_plugin_reload_for_change() instead if they can tell which apps changed.
  *
  * Since: 3.22
  **/
 void
 gs_plugin_reload (GsPlugin *plugin)
 {
-	g_debug ("emitting %s::reload in idle", gs_plugin_get_name (plugin));
+	g_autoptr(GsPluginChange) change = gs_plugin_change_new_all ();
+	gs_plugin_reload_for_change (plugin, change);
+}
+
+/**
+ * gs_plugin_reload_for_change:
+ * @plugin: a #GsPlugin
+ * @change: a #GsPluginChange describing which apps changed
+ *
+ * Like gs_plugin_reload(), but lets the UI refresh only the apps affected by
+ * @change rather than everything. The #GsPlugin::changed signal is emitted
+ * with @change just before #GsPlugin::reload.
+ *
+ * @change must not be modified after this is called. Empty changes are
+ * ignored.
+ *
+ * This may be called from any thread.
+ *
+ * Since: 47
+ **/
+void
+gs_plugin_reload_for_change (GsPlugin       *plugin,
+                             GsPluginChange *change)
+{
+	ReloadData *data;
+
+	g_return_if_fail (GS_IS_PLUGIN (plugin));
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (change));
+
+	if (gs_plugin_change_is_empty (change))
+		return;
+
+	g_debug ("emitting %s::reload in idle (%s)", gs_plugin_get_name (plugin),
+		 gs_plugin_change_is_all (change) ? "all apps" : "some apps");
+
+	data = g_new0 (ReloadData, 1);
+	g_weak_ref_init (&data->plugin_weak, plugin);
+	data->change = g_object_ref (change);
 	g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, gs_plugin_reload_cb,
-			 weak_ref_new (plugin), (GDestroyNotify) weak_ref_free);
+			 data, (GDestroyNotify) reload_data_free);
+}
+
+/* Keys which are equal have equal hashes, so always end up in the same
+ * shard, even when they are data IDs containing wildcards. */
+static GsPluginCacheShard *
+gs_plugin_cache_get_shard (GsPluginPrivate *priv,
+                           const gchar     *key)
+{
+	return &priv->cache[as_utils_data_id_hash (key) % CACHE_N_SHARDS];
 }
 
 /**
@@ -1273,14 +1497,16 @@ GsApp *
 gs_plugin_cache_lookup (GsPlugin *plugin, const gchar *key)
 {
 	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+	GsPluginCacheShard *shard;
 	GsApp *app;
-	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GRWLockReaderLocker) locker = NULL;
 
 	g_return_val_if_fail (GS_IS_PLUGIN (plugin), NULL);
 	g_return_val_if_fail (key != NULL, NULL);
 
-	locker = g_mutex_locker_new (&priv->cache_mutex);
-	app = g_hash_table_lookup (priv->cache, key);
+	shard = gs_plugin_cache_get_shard (priv, key);
+	locker = g_rw_lock_reader_locker_new (&shard->lock);
+	app = g_hash_table_lookup (shard->apps, key);
 	if (app == NULL)
 		return NULL;
 	return g_object_ref (app);
@@ -1304,23 +1530,28 @@ gs_plugin_cache_lookup_by_state (GsPlugin *plugin,
 				 GsAppState state)
 {
 	GsPluginPrivate *priv;
-	GHashTableIter iter;
-	gpointer value;
-	g_autoptr(GMutexLocker) locker = NULL;
 
 	g_return_if_fail (GS_IS_PLUGIN (plugin));
 	g_return_if_fail (GS_IS_APP_LIST (list));
 
 	priv = gs_plugin_get_instance_private (plugin);
-	locker = g_mutex_locker_new (&priv->cache_mutex);
-
-	g_hash_table_iter_init (&iter, priv->cache);
-	while (g_hash_table_iter_next (&iter, NULL, &value)) {
-		GsApp *app = value;
 
-		if (state == GS_APP_STATE_UNKNOWN ||
-		    state == gs_app_get_state (app))
-			gs_app_list_add (list, app);
+	/* Only one shard is locked at a time, so lookups and additions in
+	 * the others can carry on meanwhile. */
+	for (guint i = 0; i < CACHE_N_SHARDS; i++) {
+		GsPluginCacheShard *shard = &priv->cache[i];
+		g_autoptr(GRWLockReaderLocker) locker = g_rw_lock_reader_locker_new (&shard->lock);
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, shard->apps);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			GsApp *app = value;
+
+			if (state == GS_APP_STATE_UNKNOWN ||
+			    state == gs_app_get_state (app))
+				gs_app_list_add (list, app);
+		}
 	}
 }
 
@@ -1337,13 +1568,15 @@ void
 gs_plugin_cache_remove (GsPlugin *plugin, const gchar *key)
 {
 	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
-	g_autoptr(GMutexLocker) locker = NULL;
+	GsPluginCacheShard *shard;
+	g_autoptr(GRWLockWriterLocker) locker = NULL;
 
 	g_return_if_fail (GS_IS_PLUGIN (plugin));
 	g_return_if_fail (key != NULL);
 
-	locker = g_mutex_locker_new (&priv->cache_mutex);
-	g_hash_table_remove (priv->cache, key);
+	shard = gs_plugin_cache_get_shard (priv, key);
+	locker = g_rw_lock_writer_locker_new (&shard->lock);
+	g_hash_table_remove (shard->apps, key);
 }
 
 /**
@@ -1361,13 +1594,12 @@ void
 gs_plugin_cache_add (GsPlugin *plugin, const gchar *key, GsApp *app)
 {
 	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
-	g_autoptr(GMutexLocker) locker = NULL;
+	GsPluginCacheShard *shard;
+	g_autoptr(GRWLockWriterLocker) locker = NULL;
 
 	g_return_if_fail (GS_IS_PLUGIN (plugin));
 	g_return_if_fail (GS_IS_APP (app));
 
-	locker = g_mutex_locker_new (&priv->cache_mutex);
-
 	/* the user probably doesn't want to do this */
 	if (gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD)) {
 		g_warning ("adding wildcard app %s to plugin cache",
@@ -1380,9 +1612,48 @@ gs_plugin_cache_add (GsPlugin *plugin, const gchar *key, GsApp *app)
 
 	g_return_if_fail (key != NULL);
 
-	if (g_hash_table_lookup (priv->cache, key) == app)
+	shard = gs_plugin_cache_get_shard (priv, key);
+	locker = g_rw_lock_writer_locker_new (&shard->lock);
+
+	if (g_hash_table_lookup (shard->apps, key) == app)
 		return;
-	g_hash_table_insert (priv->cache, g_strdup (key), g_object_ref (app));
+	g_hash_table_insert (shard->apps, g_strdup (key), g_object_ref (app));
+}
+
+/**
+ * gs_plugin_intern_app:
+ * @plugin: a #GsPlugin
+ * @app: a newly created #GsApp
+ *
+ * Get the process-wide instance for the unique ID of @app, which may have
+ * been created by another plugin or job.
+ *
+ * Plugins should call this after creating an app and setting enough of its
+ * properties to give it a unique ID, and use the returned app in place of
+ * @app. If there was already an instance for the unique ID, any of its
+ * properties which are unset are filled in from @app, and @app can be
+ * discarded. Otherwise @app is returned.
+ *
+ * Wildcard apps are returned unchanged.
+ *
+ * Returns: (transfer full) (not nullable): the #GsApp to use
+ *
+ * Since: 47
+ **/
+GsApp *
+gs_plugin_intern_app (GsPlugin *plugin,
+                      GsApp    *app)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+
+	g_return_val_if_fail (GS_IS_PLUGIN (plugin), NULL);
+	g_return_val_if_fail (GS_IS_APP (app), NULL);
+
+	/* not loaded by a #GsPluginLoader */
+	if (priv->app_identity_map == NULL)
+		return g_object_ref (app);
+
+	return gs_app_identity_map_intern (priv->app_identity_map, app);
 }
 
 /**
@@ -1403,12 +1674,13 @@ void
 gs_plugin_cache_invalidate (GsPlugin *plugin)
 {
 	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
-	g_autoptr(GMutexLocker) locker = NULL;
 
 	g_return_if_fail (GS_IS_PLUGIN (plugin));
 
-	locker = g_mutex_locker_new (&priv->cache_mutex);
-	g_hash_table_remove_all (priv->cache);
+	for (guint i = 0; i < CACHE_N_SHARDS; i++) {
+		g_autoptr(GRWLockWriterLocker) locker = g_rw_lock_writer_locker_new (&priv->cache[i].lock);
+		g_hash_table_remove_all (priv->cache[i].apps);
+	}
 }
 
 /**
@@ -1424,22 +1696,12 @@ gs_plugin_cache_invalidate (GsPlugin *plugin)
 GsAppList *
 gs_plugin_list_cached (GsPlugin *plugin)
 {
-	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
-	GsAppList *list = NULL;
-	GHashTableIter iter;
-	gpointer value = NULL;
-	g_autoptr(GMutexLocker) locker = NULL;
+	GsAppList *list;
 
 	g_return_val_if_fail (GS_IS_PLUGIN (plugin), NULL);
 
-	locker = g_mutex_locker_new (&priv->cache_mutex);
 	list = gs_app_list_new ();
-
-	g_hash_table_iter_init (&iter, priv->cache);
-	while (g_hash_table_iter_next (&iter, NULL, &value)) {
-		GsApp *app = value;
-		gs_app_list_add (list, app);
-	}
+	gs_plugin_cache_lookup_by_state (plugin, list, GS_APP_STATE_UNKNOWN);
 
 	return list;
 }
@@ -1832,6 +2094,21 @@ gs_plugin_class_init (GsPluginClass *klass)
 			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
 
+	/**
+	 * GsPlugin::changed:
+	 * @plugin: the #GsPlugin
+	 * @change: a #GsPluginChange saying which apps changed
+	 *
+	 * Emitted just before #GsPlugin::reload, to say what the reload is for.
+	 *
+	 * Since: 47
+	 */
+	signals [SIGNAL_CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, GS_TYPE_PLUGIN_CHANGE);
+
 	signals [SIGNAL_REPORT_EVENT] =
 		g_signal_new ("report-event",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -1879,13 +2156,15 @@ gs_plugin_init (GsPlugin *plugin)
 
 	priv->enabled = TRUE;
 	priv->scale = 1;
-	priv->cache = g_hash_table_new_full ((GHashFunc) as_utils_data_id_hash,
-					     (GEqualFunc) as_utils_data_id_equal,
-					     g_free,
-					     (GDestroyNotify) g_object_unref);
+	for (i = 0; i < CACHE_N_SHARDS; i++) {
+		priv->cache[i].apps = g_hash_table_new_full ((GHashFunc) as_utils_data_id_hash,
+							     (GEqualFunc) as_utils_data_id_equal,
+							     g_free,
+							     (GDestroyNotify) g_object_unref);
+		g_rw_lock_init (&priv->cache[i].lock);
+	}
 	priv->vfuncs = g_hash_table_new_full (g_str_hash, g_str_equal,
 					      g_free, NULL);
-	g_mutex_init (&priv->cache_mutex);
 	g_mutex_init (&priv->interactive_mutex);
 	g_mutex_init (&priv->timer_mutex);
 	g_mutex_init (&priv->vfuncs_mutex);
@@ -1990,10 +2269,7 @@ gs_plugin_update_cache_state_for_repository (GsPlugin *plugin,
 					     GsApp *repository)
 {
 	GsPluginPrivate *priv;
-	GHashTableIter iter;
-	g_autoptr(GMutexLocker) locker = NULL;
 	g_autoptr(GsPlugin) repo_plugin = NULL;
-	gpointer value;
 	const gchar *repo_id;
 	GsAppState repo_state;
 
@@ -2005,27 +2281,34 @@ gs_plugin_update_cache_state_for_repository (GsPlugin *plugin,
 	repo_state = gs_app_get_state (repository);
 	repo_plugin = gs_app_dup_management_plugin (repository);
 
-	locker = g_mutex_locker_new (&priv->cache_mutex);
-
-	g_hash_table_iter_init (&iter, priv->cache);
-	while (g_hash_table_iter_next (&iter, NULL, &value)) {
-		GsApp *app = value;
-		GsAppState app_state = gs_app_get_state (app);
-		g_autoptr(GsPlugin) app_plugin = gs_app_dup_management_plugin (app);
-
-		if (app_plugin != repo_plugin ||
-		    gs_app_get_scope (app) != gs_app_get_scope (repository) ||
-		    gs_app_get_bundle_kind (app) != gs_app_get_bundle_kind (repository))
-			continue;
-
-		if (((app_state == GS_APP_STATE_AVAILABLE &&
-		    repo_state != GS_APP_STATE_INSTALLED) ||
-		    (app_state == GS_APP_STATE_UNAVAILABLE &&
-		    repo_state == GS_APP_STATE_INSTALLED)) &&
-		    g_strcmp0 (gs_app_get_origin (app), repo_id) == 0) {
-			/* First reset the state, because move from 'available' to 'unavailable' is not correct */
-			gs_app_set_state (app, GS_APP_STATE_UNKNOWN);
-			gs_app_set_state (app, repo_state == GS_APP_STATE_INSTALLED ? GS_APP_STATE_AVAILABLE : GS_APP_STATE_UNAVAILABLE);
+	/* Setting the states doesn’t change the cache, so a reader lock is
+	 * enough. */
+	for (guint i = 0; i < CACHE_N_SHARDS; i++) {
+		GsPluginCacheShard *shard = &priv->cache[i];
+		g_autoptr(GRWLockReaderLocker) locker = g_rw_lock_reader_locker_new (&shard->lock);
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, shard->apps);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			GsApp *app = value;
+			GsAppState app_state = gs_app_get_state (app);
+			g_autoptr(GsPlugin) app_plugin = gs_app_dup_management_plugin (app);
+
+			if (app_plugin != repo_plugin ||
+			    gs_app_get_scope (app) != gs_app_get_scope (repository) ||
+			    gs_app_get_bundle_kind (app) != gs_app_get_bundle_kind (repository))
+				continue;
+
+			if (((app_state == GS_APP_STATE_AVAILABLE &&
+			    repo_state != GS_APP_STATE_INSTALLED) ||
+			    (app_state == GS_APP_STATE_UNAVAILABLE &&
+			    repo_state == GS_APP_STATE_INSTALLED)) &&
+			    g_strcmp0 (gs_app_get_origin (app), repo_id) == 0) {
+				/* First reset the state, because move from 'available' to 'unavailable' is not correct */
+				gs_app_set_state (app, GS_APP_STATE_UNKNOWN);
+				gs_app_set_state (app, repo_state == GS_APP_STATE_INSTALLED ? GS_APP_STATE_AVAILABLE : GS_APP_STATE_UNAVAILABLE);
+			}
 		}
 	}
 }
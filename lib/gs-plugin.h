@@ -17,6 +17,7 @@
 #include "gs-app-list.h"
 #include "gs-app-query.h"
 #include "gs-category.h"
+#include "gs-plugin-change.h"
 #include "gs-plugin-event.h"
 #include "gs-plugin-types.h"
 
@@ -385,6 +386,12 @@ const gchar	*gs_plugin_get_language			(GsPlugin	*plugin);
 void		 gs_plugin_add_rule			(GsPlugin	*plugin,
 							 GsPluginRule	 rule,
 							 const gchar	*name);
+void		 gs_plugin_add_adopt_bundle_kind	(GsPlugin	*plugin,
+							 AsBundleKind	 bundle_kind);
+void		 gs_plugin_add_adopt_component_kind	(GsPlugin	*plugin,
+							 AsComponentKind component_kind);
+void		 gs_plugin_add_adopt_id_prefix		(GsPlugin	*plugin,
+							 const gchar	*prefix);
 
 /* helpers */
 gboolean	 gs_plugin_check_distro_id		(GsPlugin	*plugin,
@@ -401,6 +408,8 @@ void		 gs_plugin_cache_remove			(GsPlugin	*plugin,
 							 const gchar	*key);
 void		 gs_plugin_cache_invalidate		(GsPlugin	*plugin);
 GsAppList	*gs_plugin_list_cached			(GsPlugin	*plugin);
+GsApp		*gs_plugin_intern_app			(GsPlugin	*plugin,
+							 GsApp		*app);
 void		 gs_plugin_status_update		(GsPlugin	*plugin,
 							 GsApp		*app,
 							 GsPluginStatus	 status);
@@ -447,6 +456,8 @@ gboolean	 gs_plugin_app_launch_filtered_finish	(GsPlugin	*plugin,
 							 GError		**error);
 void		 gs_plugin_updates_changed		(GsPlugin	*plugin);
 void		 gs_plugin_reload			(GsPlugin	*plugin);
+void		 gs_plugin_reload_for_change		(GsPlugin	*plugin,
+							 GsPluginChange	*change);
 const gchar	*gs_plugin_status_to_string		(GsPluginStatus	 status);
 void		 gs_plugin_report_event			(GsPlugin	*plugin,
 							 GsPluginEvent	*event);
@@ -0,0 +1,285 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-refine-plan
+ * @short_description: The steps a refine job takes for a set of flags
+ *
+ * Which plugins a #GsPluginJobRefine calls, in which groups, and which of the
+ * stages after the plugins it runs, depend only on the loaded plugins and on
+ * the #GsPluginRefineFlags. A #GsRefinePlan works that out once so that it
+ * doesn’t have to be recomputed for each of the many refines which use the
+ * same flags. Plans are cached by the #GsPluginLoader; see
+ * gs_plugin_loader_get_refine_plan().
+ *
+ * Plugins are split into groups with the same gs_plugin_get_order(). The
+ * plugins in a group are run in parallel, and each group is run after the
+ * previous one has finished.
+ *
+ * A plan is immutable once created, so can be shared between threads.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gs-plugin.h"
+#include "gs-refine-plan.h"
+
+struct _GsRefinePlan {
+	GsPluginRefineFlags flags;
+	GPtrArray *groups;  /* (owned) (element-type GPtrArray<GsPlugin>) */
+	GsRefinePlanStages stages;
+	GsOdrsProviderRefineFlags odrs_flags;
+	GsPluginRefineFlags addons_flags;
+	GsPluginRefineFlags runtimes_flags;
+	GsPluginRefineFlags related_flags;
+};
+
+/**
+ * gs_refine_plan_new:
+ * @plugins: (element-type GsPlugin): all the loaded plugins, sorted by order
+ * @flags: flags for the refine
+ *
+ * Work out the plan for refining apps with @flags. Plugins which are disabled
+ * or which don’t implement #GsPluginClass.refine_async are left out.
+ *
+ * Returns: (transfer full): a new #GsRefinePlan
+ * Since: 47
+ */
+GsRefinePlan *
+gs_refine_plan_new (GPtrArray           *plugins,
+                    GsPluginRefineFlags  flags)
+{
+	GsRefinePlan *self = g_atomic_rc_box_new0 (GsRefinePlan);
+	GPtrArray *group = NULL;
+	guint group_order = 0;
+
+	g_return_val_if_fail (plugins != NULL, NULL);
+
+	self->flags = flags;
+	self->groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+
+	for (guint i = 0; i < plugins->len; i++) {
+		GsPlugin *plugin = g_ptr_array_index (plugins, i);
+
+		if (!gs_plugin_get_enabled (plugin))
+			continue;
+		if (GS_PLUGIN_GET_CLASS (plugin)->refine_async == NULL)
+			continue;
+
+		if (group == NULL || gs_plugin_get_order (plugin) != group_order) {
+			group = g_ptr_array_new_with_free_func (g_object_unref);
+			group_order = gs_plugin_get_order (plugin);
+			g_ptr_array_add (self->groups, group);
+		}
+
+		g_ptr_array_add (group, g_object_ref (plugin));
+	}
+
+	/* these always run, as they depend on the apps rather than the flags */
+	self->stages = GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES |
+		       GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS;
+
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS)
+		self->odrs_flags |= GS_ODRS_PROVIDER_REFINE_FLAGS_GET_REVIEWS;
+	if (flags & (GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEW_RATINGS |
+		     GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING))
+		self->odrs_flags |= GS_ODRS_PROVIDER_REFINE_FLAGS_GET_RATINGS;
+	if (self->odrs_flags != 0)
+		self->stages |= GS_REFINE_PLAN_STAGE_ODRS;
+
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON)
+		self->stages |= GS_REFINE_PLAN_STAGE_KEY_COLORS;
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS)
+		self->stages |= GS_REFINE_PLAN_STAGE_SORT_REVIEWS;
+
+	/* addons are refined one layer deep, without their reviews */
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_ADDONS) {
+		self->addons_flags = flags & ~(GS_PLUGIN_REFINE_FLAGS_REQUIRE_ADDONS |
+					       GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS |
+					       GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEW_RATINGS);
+		if (self->addons_flags != 0)
+			self->stages |= GS_REFINE_PLAN_STAGE_ADDONS;
+	}
+
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_RUNTIME) {
+		self->runtimes_flags = flags & ~GS_PLUGIN_REFINE_FLAGS_REQUIRE_RUNTIME;
+		if (self->runtimes_flags != 0)
+			self->stages |= GS_REFINE_PLAN_STAGE_RUNTIMES;
+	}
+
+	/* related apps are refined one layer deep */
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_RELATED) {
+		self->related_flags = flags & ~GS_PLUGIN_REFINE_FLAGS_REQUIRE_RELATED;
+		if (self->related_flags != 0)
+			self->stages |= GS_REFINE_PLAN_STAGE_RELATED;
+	}
+
+	return self;
+}
+
+/**
+ * gs_refine_plan_ref:
+ * @self: a #GsRefinePlan
+ *
+ * Add a reference to @self.
+ *
+ * Returns: (transfer full): @self
+ * Since: 47
+ */
+GsRefinePlan *
+gs_refine_plan_ref (GsRefinePlan *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+
+	return g_atomic_rc_box_acquire (self);
+}
+
+static void
+gs_refine_plan_clear (GsRefinePlan *self)
+{
+	g_ptr_array_unref (self->groups);
+}
+
+/**
+ * gs_refine_plan_unref:
+ * @self: (transfer full): a #GsRefinePlan
+ *
+ * Remove a reference from @self, freeing it if that was the last reference.
+ *
+ * Since: 47
+ */
+void
+gs_refine_plan_unref (GsRefinePlan *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_atomic_rc_box_release_full (self, (GDestroyNotify) gs_refine_plan_clear);
+}
+
+/**
+ * gs_refine_plan_get_flags:
+ * @self: a #GsRefinePlan
+ *
+ * Get the flags the plan was made for.
+ *
+ * Returns: the refine flags
+ * Since: 47
+ */
+GsPluginRefineFlags
+gs_refine_plan_get_flags (GsRefinePlan *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->flags;
+}
+
+/**
+ * gs_refine_plan_get_n_groups:
+ * @self: a #GsRefinePlan
+ *
+ * Get the number of groups of plugins to run, one after the other.
+ *
+ * Returns: the number of groups, possibly zero
+ * Since: 47
+ */
+guint
+gs_refine_plan_get_n_groups (GsRefinePlan *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->groups->len;
+}
+
+/**
+ * gs_refine_plan_get_group:
+ * @self: a #GsRefinePlan
+ * @idx: index of the group, less than gs_refine_plan_get_n_groups()
+ *
+ * Get the plugins in group @idx, which are run in parallel.
+ *
+ * Returns: (transfer none) (element-type GsPlugin) (not nullable): the
+ *   plugins in the group, never empty
+ * Since: 47
+ */
+GPtrArray *
+gs_refine_plan_get_group (GsRefinePlan *self,
+                          guint         idx)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (idx < self->groups->len, NULL);
+
+	return g_ptr_array_index (self->groups, idx);
+}
+
+/**
+ * gs_refine_plan_get_stages:
+ * @self: a #GsRefinePlan
+ *
+ * Get the stages to run after all the plugins have run.
+ *
+ * Returns: the stages
+ * Since: 47
+ */
+GsRefinePlanStages
+gs_refine_plan_get_stages (GsRefinePlan *self)
+{
+	g_return_val_if_fail (self != NULL, GS_REFINE_PLAN_STAGE_NONE);
+
+	return self->stages;
+}
+
+/**
+ * gs_refine_plan_get_odrs_flags:
+ * @self: a #GsRefinePlan
+ *
+ * Get the flags to pass to gs_odrs_provider_refine_async(), if
+ * %GS_REFINE_PLAN_STAGE_ODRS is in the plan’s stages.
+ *
+ * Returns: the ODRS refine flags
+ * Since: 47
+ */
+GsOdrsProviderRefineFlags
+gs_refine_plan_get_odrs_flags (GsRefinePlan *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->odrs_flags;
+}
+
+/**
+ * gs_refine_plan_get_recursion_flags:
+ * @self: a #GsRefinePlan
+ * @stage: %GS_REFINE_PLAN_STAGE_ADDONS, %GS_REFINE_PLAN_STAGE_RUNTIMES or
+ *   %GS_REFINE_PLAN_STAGE_RELATED
+ *
+ * Get the flags to refine the apps found by the recursive @stage with.
+ *
+ * Returns: the refine flags, or zero if @stage is not in the plan
+ * Since: 47
+ */
+GsPluginRefineFlags
+gs_refine_plan_get_recursion_flags (GsRefinePlan       *self,
+                                    GsRefinePlanStages  stage)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	switch (stage) {
+	case GS_REFINE_PLAN_STAGE_ADDONS:
+		return self->addons_flags;
+	case GS_REFINE_PLAN_STAGE_RUNTIMES:
+		return self->runtimes_flags;
+	case GS_REFINE_PLAN_STAGE_RELATED:
+		return self->related_flags;
+	default:
+		g_return_val_if_reached (0);
+	}
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "gs-odrs-provider.h"
+#include "gs-plugin-types.h"
+
+G_BEGIN_DECLS
+
+/**
+ * GsRefinePlanStages:
+ * @GS_REFINE_PLAN_STAGE_NONE: No stages
+ * @GS_REFINE_PLAN_STAGE_ODRS: Get ratings or reviews from the ODRS provider
+ * @GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES: Rewrite app CSS to refer to cached resources
+ * @GS_REFINE_PLAN_STAGE_KEY_COLORS: Calculate the key colors of the icons
+ * @GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS: Remove wildcard apps from the results
+ * @GS_REFINE_PLAN_STAGE_SORT_REVIEWS: Sort each app’s reviews by score
+ * @GS_REFINE_PLAN_STAGE_ADDONS: Refine the apps’ addons
+ * @GS_REFINE_PLAN_STAGE_RUNTIMES: Refine the apps’ runtimes
+ * @GS_REFINE_PLAN_STAGE_RELATED: Refine the apps’ related apps
+ *
+ * The stages which a refine runs after all the plugins have refined the apps.
+ * The last three are recursive refines of other apps, each with their own
+ * flags from gs_refine_plan_get_recursion_flags().
+ *
+ * Since: 47
+ */
+typedef enum {
+	GS_REFINE_PLAN_STAGE_NONE		= 0,
+	GS_REFINE_PLAN_STAGE_ODRS		= 1 << 0,
+	GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES	= 1 << 1,
+	GS_REFINE_PLAN_STAGE_KEY_COLORS		= 1 << 2,
+	GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS	= 1 << 3,
+	GS_REFINE_PLAN_STAGE_SORT_REVIEWS	= 1 << 4,
+	GS_REFINE_PLAN_STAGE_ADDONS		= 1 << 5,
+	GS_REFINE_PLAN_STAGE_RUNTIMES		= 1 << 6,
+	GS_REFINE_PLAN_STAGE_RELATED		= 1 << 7,
+} GsRefinePlanStages;
+
+typedef struct _GsRefinePlan GsRefinePlan;
+
+GsRefinePlan		*gs_refine_plan_new			(GPtrArray		*plugins,
+								 GsPluginRefineFlags	 flags);
+GsRefinePlan		*gs_refine_plan_ref			(GsRefinePlan		*self);
+void			 gs_refine_plan_unref			(GsRefinePlan		*self);
+
+GsPluginRefineFlags	 gs_refine_plan_get_flags		(GsRefinePlan		*self);
+guint			 gs_refine_plan_get_n_groups		(GsRefinePlan		*self);
+GPtrArray		*gs_refine_plan_get_group		(GsRefinePlan		*self,
+								 guint			 idx);
+GsRefinePlanStages	 gs_refine_plan_get_stages		(GsRefinePlan		*self);
+GsOdrsProviderRefineFlags gs_refine_plan_get_odrs_flags		(GsRefinePlan		*self);
+GsPluginRefineFlags	 gs_refine_plan_get_recursion_flags	(GsRefinePlan		*self,
+								 GsRefinePlanStages	 stage);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsRefinePlan, gs_refine_plan_unref)
+
+G_END_DECLS
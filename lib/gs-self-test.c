@@ -9,6 +9,8 @@
 
 #include "config.h"
 
+#include <glib/gstdio.h>
+
 #include "gnome-software-private.h"
 
 #include "gs-debug.h"
@@ -107,6 +109,7 @@ gs_utils_cache_func (void)
 {
 	g_autofree gchar *fn1 = NULL;
 	g_autofree gchar *fn2 = NULL;
+	g_autofree gchar *cachedir = NULL;
 	g_autoptr(GError) error = NULL;
 
 	fn1 = gs_utils_get_cache_filename ("test",
@@ -129,6 +132,81 @@ gs_utils_cache_func (void)
 	g_assert_cmpstr (fn2, !=, NULL);
 	g_assert (g_str_has_prefix (fn2, g_get_user_cache_dir ()));
 	g_assert (g_str_has_suffix (fn2, "test/295099f59d12b3eb0b955325fcb699cd23792a89-baz"));
+	g_assert_true (g_file_set_contents (fn2, "", 0, NULL));
+
+	/* emptying the cache is noticed, even though the directory is kept
+	 * open between calls */
+	g_clear_pointer (&fn2, g_free);
+	fn2 = gs_utils_get_cache_filename ("test",
+					   "http://www.foo.bar/baz",
+					   GS_UTILS_CACHE_FLAG_WRITEABLE |
+					   GS_UTILS_CACHE_FLAG_USE_HASH |
+					   GS_UTILS_CACHE_FLAG_ENSURE_EMPTY |
+					   GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					   &error);
+	g_assert_no_error (error);
+	g_assert_false (g_file_test (fn2, G_FILE_TEST_EXISTS));
+	cachedir = g_path_get_dirname (fn2);
+	g_assert_true (g_file_test (cachedir, G_FILE_TEST_IS_DIR));
+
+	/* as is the directory being removed by something else */
+	g_assert_true (gs_utils_rmtree (cachedir, &error));
+	g_assert_no_error (error);
+	g_clear_pointer (&fn1, g_free);
+	fn1 = gs_utils_get_cache_filename ("test",
+					   "http://www.foo.bar/baz",
+					   GS_UTILS_CACHE_FLAG_WRITEABLE |
+					   GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					   &error);
+	g_assert_no_error (error);
+	g_assert_true (g_file_test (cachedir, G_FILE_TEST_IS_DIR));
+}
+
+static void
+gs_utils_publish_file_contents_func (void)
+{
+	gboolean changed = FALSE;
+	g_autofree gchar *fn = NULL;
+	g_autofree gchar *hash1 = NULL;
+	g_autofree gchar *hash2 = NULL;
+	g_autofree gchar *contents = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GBytes) bytes1 = g_bytes_new_static ("one", 3);
+	g_autoptr(GBytes) bytes2 = g_bytes_new_static ("two", 3);
+	g_autoptr(GError) error = NULL;
+
+	fn = gs_utils_get_cache_filename ("test",
+					  "publish",
+					  GS_UTILS_CACHE_FLAG_WRITEABLE |
+					  GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					  &error);
+	g_assert_no_error (error);
+	g_unlink (fn);
+	file = g_file_new_for_path (fn);
+
+	/* new file */
+	g_assert_true (gs_utils_publish_file_contents (file, bytes1, &hash1, &changed, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_true (changed);
+	g_assert_nonnull (hash1);
+
+	/* same contents again */
+	g_assert_true (gs_utils_publish_file_contents (file, bytes1, &hash2, &changed, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_false (changed);
+	g_assert_cmpstr (hash1, ==, hash2);
+	g_clear_pointer (&hash2, g_free);
+
+	/* different contents */
+	g_assert_true (gs_utils_publish_file_contents (file, bytes2, &hash2, &changed, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_true (changed);
+	g_assert_cmpstr (hash1, !=, hash2);
+	g_assert_true (g_file_get_contents (fn, &contents, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_cmpstr (contents, ==, "two");
+
+	g_unlink (fn);
 }
 
 static void
@@ -692,6 +770,136 @@ gs_app_progress_clamping_func (void)
 	}
 }
 
+static guint version_history_loader_n_calls = 0;
+
+/* Loads @max_releases (or all of them if it’s zero) of the number of releases
+ * given in @data, counting the calls */
+static GPtrArray *
+version_history_loader_cb (GsApp    *app,
+                           guint     max_releases,
+                           GBytes   *data)
+{
+	guint n_total = *((const guint *) g_bytes_get_data (data, NULL));
+	guint n_releases = (max_releases == 0) ? n_total : MIN (max_releases, n_total);
+	GPtrArray *releases = g_ptr_array_new_with_free_func (g_object_unref);
+
+	version_history_loader_n_calls++;
+
+	/* the app isn’t locked while loading, so this must not deadlock */
+	g_assert_true (gs_app_has_version_history (app));
+
+	for (guint i = 0; i < n_releases; i++) {
+		g_autoptr(AsRelease) release = as_release_new ();
+		g_autofree gchar *version = g_strdup_printf ("1.%u", n_total - i);
+		as_release_set_version (release, version);
+		g_ptr_array_add (releases, g_steal_pointer (&release));
+	}
+
+	return releases;
+}
+
+static void
+gs_app_version_history_loader_func (void)
+{
+	g_autoptr(GsApp) app = gs_app_new ("gnome-software.desktop");
+	g_autoptr(GPtrArray) latest = NULL;
+	g_autoptr(GPtrArray) version_history = NULL;
+	g_autoptr(GBytes) data = NULL;
+	const guint n_releases = 10;
+
+	version_history_loader_n_calls = 0;
+
+	g_assert_false (gs_app_has_version_history (app));
+	g_assert_null (gs_app_get_latest_releases (app, 2));
+
+	data = g_bytes_new (&n_releases, sizeof (n_releases));
+	gs_app_set_version_history_loader (app, version_history_loader_cb, data);
+	g_assert_true (gs_app_has_version_history (app));
+	g_assert_cmpuint (version_history_loader_n_calls, ==, 0);
+
+	/* only the newest releases are loaded */
+	latest = gs_app_get_latest_releases (app, 2);
+	g_assert_nonnull (latest);
+	g_assert_cmpuint (latest->len, ==, 2);
+	g_assert_cmpstr (as_release_get_version (g_ptr_array_index (latest, 0)), ==, "1.10");
+	g_assert_cmpuint (version_history_loader_n_calls, ==, 1);
+	g_clear_pointer (&latest, g_ptr_array_unref);
+
+	/* the newest releases are cached for later calls asking for as many
+	 * or fewer, but not for more */
+	latest = gs_app_get_latest_releases (app, 2);
+	g_assert_cmpuint (latest->len, ==, 2);
+	g_clear_pointer (&latest, g_ptr_array_unref);
+	latest = gs_app_get_latest_releases (app, 1);
+	g_assert_cmpuint (latest->len, ==, 1);
+	g_assert_cmpstr (as_release_get_version (g_ptr_array_index (latest, 0)), ==, "1.10");
+	g_clear_pointer (&latest, g_ptr_array_unref);
+	g_assert_cmpuint (version_history_loader_n_calls, ==, 1);
+
+	latest = gs_app_get_latest_releases (app, 3);
+	g_assert_cmpuint (latest->len, ==, 3);
+	g_clear_pointer (&latest, g_ptr_array_unref);
+	g_assert_cmpuint (version_history_loader_n_calls, ==, 2);
+
+	/* the whole history is loaded once, and then cached */
+	version_history = gs_app_get_version_history (app);
+	g_assert_nonnull (version_history);
+	g_assert_cmpuint (version_history->len, ==, 10);
+	g_assert_cmpuint (version_history_loader_n_calls, ==, 3);
+	g_clear_pointer (&version_history, g_ptr_array_unref);
+
+	version_history = gs_app_get_version_history (app);
+	g_assert_cmpuint (version_history->len, ==, 10);
+	latest = gs_app_get_latest_releases (app, 3);
+	g_assert_cmpuint (latest->len, ==, 3);
+	g_assert_cmpstr (as_release_get_version (g_ptr_array_index (latest, 2)), ==, "1.8");
+	g_assert_cmpuint (version_history_loader_n_calls, ==, 3);
+}
+
+static void
+gs_app_license_func (void)
+{
+	/* the second time round, the verdicts come from the cache */
+	for (guint i = 0; i < 2; i++) {
+		g_autoptr(GsApp) app1 = gs_app_new ("app1");
+		g_autoptr(GsApp) app2 = gs_app_new ("app2");
+
+		gs_app_set_license (app1, GS_APP_QUALITY_NORMAL, "GPL-2.0-or-later AND MIT");
+		g_assert_true (gs_app_get_license_is_free (app1));
+		gs_app_set_license (app2, GS_APP_QUALITY_NORMAL, "LicenseRef-proprietary");
+		g_assert_false (gs_app_get_license_is_free (app2));
+	}
+}
+
+static guint update_details_n_converted = 0;
+
+static gchar *
+update_details_upper_cb (const gchar *raw)
+{
+	update_details_n_converted++;
+	return g_ascii_strup (raw, -1);
+}
+
+static void
+gs_app_update_details_func (void)
+{
+	g_autoptr(GsApp) app = gs_app_new ("app");
+
+	/* not converted until it’s asked for, and then only once */
+	gs_app_set_update_details_lazy (app, "fixed a bug", update_details_upper_cb);
+	g_assert_true (gs_app_get_update_details_set (app));
+	g_assert_cmpuint (update_details_n_converted, ==, 0);
+	g_assert_cmpstr (gs_app_get_update_details_markup (app), ==, "FIXED A BUG");
+	g_assert_cmpstr (gs_app_get_update_details_markup (app), ==, "FIXED A BUG");
+	g_assert_cmpuint (update_details_n_converted, ==, 1);
+
+	/* setting the markup directly drops any pending conversion */
+	gs_app_set_update_details_lazy (app, "fixed another bug", update_details_upper_cb);
+	gs_app_set_update_details_text (app, "<b>");
+	g_assert_cmpstr (gs_app_get_update_details_markup (app), ==, "&lt;b&gt;");
+	g_assert_cmpuint (update_details_n_converted, ==, 1);
+}
+
 static void
 gs_app_list_wildcard_dedupe_func (void)
 {
@@ -777,6 +985,92 @@ gs_app_list_performance_func (void)
 	g_print ("%.2fms ", g_timer_elapsed (timer, NULL) * 1000);
 }
 
+static void
+gs_app_builder_fill (GsApp *app,
+		     guint  i)
+{
+	g_autofree gchar *name = g_strdup_printf ("App %u", i);
+
+	gs_app_set_kind (app, AS_COMPONENT_KIND_DESKTOP_APP);
+	gs_app_set_scope (app, AS_COMPONENT_SCOPE_SYSTEM);
+	gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_FLATPAK);
+	gs_app_set_branch (app, "stable");
+	gs_app_set_origin (app, "flathub");
+	gs_app_set_name (app, GS_APP_QUALITY_NORMAL, name);
+	gs_app_set_summary (app, GS_APP_QUALITY_NORMAL, "A summary");
+	gs_app_set_description (app, GS_APP_QUALITY_NORMAL, "A longer description");
+	gs_app_set_version (app, "1.0");
+	gs_app_set_license (app, GS_APP_QUALITY_NORMAL, "GPL-2.0-or-later");
+	gs_app_set_state (app, GS_APP_STATE_AVAILABLE);
+	gs_app_add_category (app, "Utility");
+	gs_app_add_source (app, name);
+	gs_app_add_quirk (app, GS_APP_QUIRK_PROVENANCE);
+	gs_app_set_size_download (app, GS_SIZE_TYPE_VALID, 1024);
+}
+
+static void
+gs_app_builder_notify_cb (GObject    *object,
+			  GParamSpec *pspec,
+			  gpointer    user_data)
+{
+	guint *n_notifies = user_data;
+
+	(*n_notifies)++;
+}
+
+static void
+gs_app_builder_func (void)
+{
+	guint n_apps = g_test_perf () ? 50000 : 500;
+	g_autoptr(GPtrArray) apps = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_autoptr(GPtrArray) built_apps = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_autoptr(GTimer) timer = g_timer_new ();
+	gdouble elapsed_setters, elapsed_builder;
+	guint n_notifies = 0;
+
+	/* with the setters on a published app */
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		GsApp *app = gs_app_new (id);
+
+		gs_app_builder_fill (app, i);
+		g_ptr_array_add (apps, app);
+	}
+	elapsed_setters = g_timer_elapsed (timer, NULL);
+
+	/* with a builder */
+	g_timer_start (timer);
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		g_autoptr(GsAppBuilder) builder = gs_app_builder_new (id);
+
+		gs_app_builder_fill (gs_app_builder_get_app (builder), i);
+		g_ptr_array_add (built_apps, gs_app_builder_end (g_steal_pointer (&builder)));
+	}
+	elapsed_builder = g_timer_elapsed (timer, NULL);
+
+	g_test_minimized_result (elapsed_builder, "built %u apps in %.2fms, versus %.2fms using setters",
+				 n_apps, elapsed_builder * 1000, elapsed_setters * 1000);
+
+	/* both ways give the same apps */
+	for (guint i = 0; i < n_apps; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		GsApp *built_app = g_ptr_array_index (built_apps, i);
+
+		g_assert_cmpstr (gs_app_get_unique_id (built_app), ==, gs_app_get_unique_id (app));
+		g_assert_cmpstr (gs_app_get_name (built_app), ==, gs_app_get_name (app));
+		g_assert_cmpint (gs_app_get_state (built_app), ==, gs_app_get_state (app));
+	}
+
+	/* a published app notifies again */
+	gs_test_flush_main_context ();
+	g_signal_connect (g_ptr_array_index (built_apps, 0), "notify::state",
+			  G_CALLBACK (gs_app_builder_notify_cb), &n_notifies);
+	gs_app_set_state (g_ptr_array_index (built_apps, 0), GS_APP_STATE_INSTALLING);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (n_notifies, ==, 1);
+}
+
 static void
 gs_app_list_related_func (void)
 {
@@ -797,6 +1091,416 @@ gs_app_list_related_func (void)
 	g_assert_cmpint (gs_app_list_get_progress (list), ==, 50);
 }
 
+static void
+app_list_count_signal_cb (GsAppList *list,
+                          gpointer   user_data)
+{
+	guint *n_emissions = user_data;
+	(*n_emissions)++;
+}
+
+static void
+app_list_count_app_signal_cb (GsAppList *list,
+                              GsApp     *app,
+                              gpointer   user_data)
+{
+	guint *n_emissions = user_data;
+	(*n_emissions)++;
+}
+
+static void
+gs_app_list_set_state_many_func (void)
+{
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	guint n_app_state_changed = 0;
+	guint n_apps_state_changed = 0;
+
+	gs_app_list_add_flag (list, GS_APP_LIST_FLAG_WATCH_APPS);
+	g_signal_connect (list, "app-state-changed",
+			  G_CALLBACK (app_list_count_app_signal_cb), &n_app_state_changed);
+	g_signal_connect (list, "apps-state-changed",
+			  G_CALLBACK (app_list_count_signal_cb), &n_apps_state_changed);
+
+	for (guint i = 0; i < 100; i++) {
+		g_autofree gchar *id = g_strdup_printf ("app%u", i);
+		g_autoptr(GsApp) app = gs_app_new (id);
+		gs_app_set_state (app, GS_APP_STATE_AVAILABLE);
+		gs_app_list_add (list, app);
+	}
+	gs_test_flush_main_context ();
+	n_app_state_changed = 0;
+
+	/* the states change straight away, but the list is told once */
+	gs_app_list_set_state_many (list, GS_APP_STATE_INSTALLING);
+	for (guint i = 0; i < gs_app_list_length (list); i++)
+		g_assert_cmpint (gs_app_get_state (gs_app_list_index (list, i)), ==, GS_APP_STATE_INSTALLING);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (n_app_state_changed, ==, 0);
+	g_assert_cmpuint (n_apps_state_changed, ==, 1);
+	g_assert_cmpint (gs_app_list_get_state (list), ==, GS_APP_STATE_INSTALLING);
+
+	/* nothing changes, so nothing is emitted */
+	gs_app_list_set_state_many (list, GS_APP_STATE_INSTALLING);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (n_apps_state_changed, ==, 1);
+
+	/* individual changes are still reported individually */
+	gs_app_set_state (gs_app_list_index (list, 0), GS_APP_STATE_INSTALLED);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (n_app_state_changed, ==, 1);
+	g_assert_cmpuint (n_apps_state_changed, ==, 1);
+}
+
+static void
+gs_app_identity_map_func (void)
+{
+	g_autoptr(GsAppIdentityMap) map = gs_app_identity_map_new ();
+	g_autoptr(GsApp) app1 = gs_app_new ("org.example.Shared");
+	g_autoptr(GsApp) app2 = gs_app_new ("org.example.Shared");
+	g_autoptr(GsApp) wildcard = gs_app_new ("org.example.Shared");
+	g_autoptr(GsApp) interned1 = NULL;
+	g_autoptr(GsApp) interned2 = NULL;
+	g_autoptr(GsApp) interned3 = NULL;
+	g_autoptr(GsApp) looked_up = NULL;
+	GsAppIdentityMapStats stats;
+
+	/* two plugins create the same app; the second gets the first
+	 * instance, with the properties it knew about merged in */
+	gs_app_set_name (app1, GS_APP_QUALITY_NORMAL, "Shared");
+	gs_app_set_version (app2, "1.0");
+	gs_app_set_state (app2, GS_APP_STATE_AVAILABLE);
+
+	interned1 = gs_app_identity_map_intern (map, app1);
+	g_assert_true (interned1 == app1);
+	interned2 = gs_app_identity_map_intern (map, app2);
+	g_assert_true (interned2 == app1);
+	g_assert_cmpstr (gs_app_get_name (interned2), ==, "Shared");
+	g_assert_cmpstr (gs_app_get_version (interned2), ==, "1.0");
+	g_assert_cmpint (gs_app_get_state (interned2), ==, GS_APP_STATE_AVAILABLE);
+
+	/* wildcards are never interned */
+	gs_app_add_quirk (wildcard, GS_APP_QUIRK_IS_WILDCARD);
+	interned3 = gs_app_identity_map_intern (map, wildcard);
+	g_assert_true (interned3 == wildcard);
+
+	/* refining is remembered for the instance, for a superset of flags */
+	g_assert_false (gs_app_identity_map_is_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON));
+	gs_app_identity_map_add_refined (map, app1,
+					 GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON |
+					 GS_PLUGIN_REFINE_FLAGS_REQUIRE_VERSION);
+	g_assert_true (gs_app_identity_map_is_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON));
+	g_assert_false (gs_app_identity_map_is_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_SIZE));
+
+	/* but not for other instances with the same unique ID */
+	g_assert_false (gs_app_identity_map_is_refined (map, app2, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON));
+
+	/* and it’s forgotten when the state changes, or on invalidation */
+	gs_app_set_state (app1, GS_APP_STATE_INSTALLING);
+	g_assert_false (gs_app_identity_map_is_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON));
+	gs_app_identity_map_add_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON);
+	g_assert_true (gs_app_identity_map_is_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON));
+	gs_app_identity_map_invalidate (map);
+	g_assert_false (gs_app_identity_map_is_refined (map, app1, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON));
+
+	/* looking up an instance isn’t a reuse, as nothing was allocated */
+	looked_up = gs_app_identity_map_lookup (map, gs_app_get_unique_id (app1));
+	g_assert_true (looked_up == app1);
+	g_clear_object (&looked_up);
+
+	gs_app_identity_map_get_stats (map, &stats);
+	g_assert_cmpuint (stats.n_interned, ==, 1);
+	g_assert_cmpuint (stats.n_reused, ==, 1);
+	g_assert_cmpuint (stats.n_refines_saved, ==, 2);
+
+	/* the map doesn’t keep apps alive */
+	g_clear_object (&interned1);
+	g_clear_object (&interned2);
+	g_clear_object (&app1);
+	looked_up = gs_app_identity_map_lookup (map, gs_app_get_unique_id (app2));
+	g_assert_null (looked_up);
+}
+
+/* A plugin which can refine, for gs_refine_plan_func(). It never has to
+ * actually refine anything, as plans are only generated, not run. */
+#define GS_TYPE_TEST_REFINE_PLUGIN (gs_test_refine_plugin_get_type ())
+G_DECLARE_FINAL_TYPE (GsTestRefinePlugin, gs_test_refine_plugin, GS, TEST_REFINE_PLUGIN, GsPlugin)
+
+struct _GsTestRefinePlugin {
+	GsPlugin parent;
+};
+
+G_DEFINE_TYPE (GsTestRefinePlugin, gs_test_refine_plugin, GS_TYPE_PLUGIN)
+
+static void
+gs_test_refine_plugin_refine_async (GsPlugin            *plugin,
+                                    GsAppList           *list,
+                                    GsPluginRefineFlags  flags,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+	g_assert_not_reached ();
+}
+
+static void
+gs_test_refine_plugin_class_init (GsTestRefinePluginClass *klass)
+{
+	GS_PLUGIN_CLASS (klass)->refine_async = gs_test_refine_plugin_refine_async;
+}
+
+static void
+gs_test_refine_plugin_init (GsTestRefinePlugin *self)
+{
+}
+
+/* A plugin which can’t refine. */
+#define GS_TYPE_TEST_PLAIN_PLUGIN (gs_test_plain_plugin_get_type ())
+G_DECLARE_FINAL_TYPE (GsTestPlainPlugin, gs_test_plain_plugin, GS, TEST_PLAIN_PLUGIN, GsPlugin)
+
+struct _GsTestPlainPlugin {
+	GsPlugin parent;
+};
+
+G_DEFINE_TYPE (GsTestPlainPlugin, gs_test_plain_plugin, GS_TYPE_PLUGIN)
+
+static void
+gs_test_plain_plugin_class_init (GsTestPlainPluginClass *klass)
+{
+}
+
+static void
+gs_test_plain_plugin_init (GsTestPlainPlugin *self)
+{
+}
+
+static GsPlugin *
+add_test_plugin (GPtrArray   *plugins,
+                 GType        type,
+                 const gchar *name,
+                 guint        order)
+{
+	GsPlugin *plugin = g_object_new (type, NULL);
+
+	gs_plugin_set_name (plugin, name);
+	gs_plugin_set_order (plugin, order);
+	g_ptr_array_add (plugins, plugin);
+
+	return plugin;
+}
+
+static void
+gs_refine_plan_func (void)
+{
+	g_autoptr(GPtrArray) plugins = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(GsRefinePlan) plan = NULL;
+	GPtrArray *group;
+
+	/* plugins are sorted by order, as in the loader */
+	add_test_plugin (plugins, GS_TYPE_TEST_REFINE_PLUGIN, "first", 0);
+	add_test_plugin (plugins, GS_TYPE_TEST_REFINE_PLUGIN, "second", 0);
+	add_test_plugin (plugins, GS_TYPE_TEST_PLAIN_PLUGIN, "plain", 1);
+	gs_plugin_set_enabled (add_test_plugin (plugins, GS_TYPE_TEST_REFINE_PLUGIN, "disabled", 1), FALSE);
+	add_test_plugin (plugins, GS_TYPE_TEST_REFINE_PLUGIN, "last", 2);
+
+	/* plugins with the same order are grouped, and those which can’t
+	 * refine are left out, as are groups with nothing left in them */
+	plan = gs_refine_plan_new (plugins, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ID);
+	g_assert_cmpuint (gs_refine_plan_get_flags (plan), ==, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ID);
+	g_assert_cmpuint (gs_refine_plan_get_n_groups (plan), ==, 2);
+	group = gs_refine_plan_get_group (plan, 0);
+	g_assert_cmpuint (group->len, ==, 2);
+	g_assert_cmpstr (gs_plugin_get_name (g_ptr_array_index (group, 0)), ==, "first");
+	g_assert_cmpstr (gs_plugin_get_name (g_ptr_array_index (group, 1)), ==, "second");
+	group = gs_refine_plan_get_group (plan, 1);
+	g_assert_cmpuint (group->len, ==, 1);
+	g_assert_cmpstr (gs_plugin_get_name (g_ptr_array_index (group, 0)), ==, "last");
+
+	/* only the stages which don’t depend on the flags run for minimal flags */
+	g_assert_cmpuint (gs_refine_plan_get_stages (plan), ==,
+			  GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES |
+			  GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS);
+	g_clear_pointer (&plan, gs_refine_plan_unref);
+
+	/* reviews are fetched and sorted, and addons refined without them */
+	plan = gs_refine_plan_new (plugins,
+				   GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON |
+				   GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS |
+				   GS_PLUGIN_REFINE_FLAGS_REQUIRE_ADDONS);
+	g_assert_cmpuint (gs_refine_plan_get_stages (plan), ==,
+			  GS_REFINE_PLAN_STAGE_ODRS |
+			  GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES |
+			  GS_REFINE_PLAN_STAGE_KEY_COLORS |
+			  GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS |
+			  GS_REFINE_PLAN_STAGE_SORT_REVIEWS |
+			  GS_REFINE_PLAN_STAGE_ADDONS);
+	g_assert_cmpuint (gs_refine_plan_get_odrs_flags (plan), ==, GS_ODRS_PROVIDER_REFINE_FLAGS_GET_REVIEWS);
+	g_assert_cmpuint (gs_refine_plan_get_recursion_flags (plan, GS_REFINE_PLAN_STAGE_ADDONS), ==,
+			  GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON);
+	g_assert_cmpuint (gs_refine_plan_get_recursion_flags (plan, GS_REFINE_PLAN_STAGE_RUNTIMES), ==, 0);
+	g_clear_pointer (&plan, gs_refine_plan_unref);
+
+	/* ratings don’t need the reviews sorting */
+	plan = gs_refine_plan_new (plugins,
+				   GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING |
+				   GS_PLUGIN_REFINE_FLAGS_REQUIRE_RELATED);
+	g_assert_cmpuint (gs_refine_plan_get_stages (plan), ==,
+			  GS_REFINE_PLAN_STAGE_ODRS |
+			  GS_REFINE_PLAN_STAGE_REWRITE_RESOURCES |
+			  GS_REFINE_PLAN_STAGE_FILTER_WILDCARDS |
+			  GS_REFINE_PLAN_STAGE_RELATED);
+	g_assert_cmpuint (gs_refine_plan_get_odrs_flags (plan), ==, GS_ODRS_PROVIDER_REFINE_FLAGS_GET_RATINGS);
+	g_clear_pointer (&plan, gs_refine_plan_unref);
+
+	/* a recursion with nothing left to refine is skipped */
+	plan = gs_refine_plan_new (plugins, GS_PLUGIN_REFINE_FLAGS_REQUIRE_RUNTIME);
+	g_assert_false (gs_refine_plan_get_stages (plan) & GS_REFINE_PLAN_STAGE_RUNTIMES);
+}
+
+static void
+gs_plugin_cache_func (void)
+{
+	g_autoptr(GsPlugin) plugin = g_object_new (GS_TYPE_TEST_PLAIN_PLUGIN, NULL);
+	g_autoptr(GsAppList) installed = gs_app_list_new ();
+	g_autoptr(GsAppList) cached = NULL;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GsApp) wildcard_match = NULL;
+	const guint n_apps = 100;
+
+	/* enough apps to end up in every shard */
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		g_autoptr(GsApp) new_app = gs_app_new (id);
+
+		gs_app_set_scope (new_app, AS_COMPONENT_SCOPE_SYSTEM);
+		gs_app_set_bundle_kind (new_app, AS_BUNDLE_KIND_FLATPAK);
+		gs_app_set_branch (new_app, "stable");
+		gs_app_set_state (new_app, (i % 2 == 0) ? GS_APP_STATE_INSTALLED : GS_APP_STATE_AVAILABLE);
+		gs_plugin_cache_add (plugin, NULL, new_app);
+	}
+
+	cached = gs_plugin_list_cached (plugin);
+	g_assert_cmpuint (gs_app_list_length (cached), ==, n_apps);
+	gs_plugin_cache_lookup_by_state (plugin, installed, GS_APP_STATE_INSTALLED);
+	g_assert_cmpuint (gs_app_list_length (installed), ==, n_apps / 2);
+
+	/* a key with wildcards finds the same app as its full unique ID */
+	app = gs_plugin_cache_lookup (plugin, "system/flatpak/*/org.example.App7/stable");
+	g_assert_nonnull (app);
+	wildcard_match = gs_plugin_cache_lookup (plugin, "*/*/*/org.example.App7/*");
+	g_assert_true (wildcard_match == app);
+
+	gs_plugin_cache_remove (plugin, gs_app_get_unique_id (app));
+	g_clear_object (&wildcard_match);
+	wildcard_match = gs_plugin_cache_lookup (plugin, "*/*/*/org.example.App7/*");
+	g_assert_null (wildcard_match);
+
+	gs_plugin_cache_invalidate (plugin);
+	g_clear_object (&cached);
+	cached = gs_plugin_list_cached (plugin);
+	g_assert_cmpuint (gs_app_list_length (cached), ==, 0);
+}
+
+static void
+gs_size_accountant_func (void)
+{
+	g_autoptr(GsSizeAccountant) accountant = NULL;
+	g_autoptr(GsSizeAccountant) reloaded = NULL;
+	g_autoptr(GsApp) app = gs_app_new ("org.example.Measured");
+	g_autoptr(GsApp) app_unrecorded = gs_app_new ("org.example.Unmeasured");
+	g_autoptr(GError) error = NULL;
+	g_auto(GStrv) stale_keys = NULL;
+	g_autofree gchar *tmp_root = NULL;
+	g_autofree gchar *filename = NULL;
+	guint64 size_bytes = 0;
+	GVariant *measured;
+
+	tmp_root = g_dir_make_tmp ("gnome-software-size-accountant-test-XXXXXX", &error);
+	g_assert_no_error (error);
+	filename = g_build_filename (tmp_root, "sizes.ini", NULL);
+
+	/* nothing is recorded to start with */
+	accountant = gs_size_accountant_new (filename);
+	g_assert_false (gs_size_accountant_apply (accountant, "org.example.Unmeasured", app_unrecorded));
+	g_assert_cmpint (gs_app_get_size_user_data (app_unrecorded, NULL), ==, GS_SIZE_TYPE_UNKNOWN);
+
+	/* records are only written out when saved */
+	gs_size_accountant_record (accountant, "org.example.Measured", 1000, 200);
+	g_assert_false (g_file_test (filename, G_FILE_TEST_EXISTS));
+
+	/* records survive being reloaded from disk */
+	gs_size_accountant_save (accountant);
+	g_assert_true (g_file_test (filename, G_FILE_TEST_EXISTS));
+	reloaded = gs_size_accountant_new (filename);
+	g_assert_true (gs_size_accountant_apply (reloaded, "org.example.Measured", app));
+	g_assert_cmpint (gs_app_get_size_user_data (app, &size_bytes), ==, GS_SIZE_TYPE_VALID);
+	g_assert_cmpuint (size_bytes, ==, 1000);
+	g_assert_cmpint (gs_app_get_size_cache_data (app, &size_bytes), ==, GS_SIZE_TYPE_VALID);
+	g_assert_cmpuint (size_bytes, ==, 200);
+	measured = gs_app_get_metadata_variant (app, GS_SIZE_ACCOUNTANT_MEASURED_METADATA);
+	g_assert_nonnull (measured);
+	g_assert_cmpuint (g_variant_get_uint64 (measured), <=, g_get_real_time () / G_USEC_PER_SEC);
+
+	/* a newer record replaces the sizes on the app */
+	gs_size_accountant_record (reloaded, "org.example.Measured", 3000, 0);
+	g_assert_true (gs_size_accountant_apply (reloaded, "org.example.Measured", app));
+	g_assert_cmpint (gs_app_get_size_user_data (app, &size_bytes), ==, GS_SIZE_TYPE_VALID);
+	g_assert_cmpuint (size_bytes, ==, 3000);
+
+	/* only records older than the maximum age are stale */
+	stale_keys = gs_size_accountant_dup_stale_keys (reloaded, G_MAXUINT32);
+	g_assert_cmpuint (g_strv_length (stale_keys), ==, 0);
+	g_clear_pointer (&stale_keys, g_strfreev);
+
+	/* removed records are gone */
+	gs_size_accountant_remove (reloaded, "org.example.Measured");
+	g_assert_false (gs_size_accountant_apply (reloaded, "org.example.Measured", app));
+
+	gs_utils_rmtree (tmp_root, NULL);
+}
+
+static void
+gs_plugin_change_func (void)
+{
+	g_autoptr(GsPluginChange) change = gs_plugin_change_new ();
+	g_autoptr(GsPluginChange) other = gs_plugin_change_new ();
+	g_autoptr(GsPluginChange) all = gs_plugin_change_new_all ();
+	g_autoptr(GsApp) app_by_id = gs_app_new ("org.example.Changed");
+	g_autoptr(GsApp) app_by_origin = gs_app_new ("org.example.FromRepo");
+	g_autoptr(GsApp) app_unaffected = gs_app_new ("org.example.Unchanged");
+
+	gs_app_set_scope (app_by_id, AS_COMPONENT_SCOPE_SYSTEM);
+	gs_app_set_bundle_kind (app_by_id, AS_BUNDLE_KIND_FLATPAK);
+	gs_app_set_origin (app_by_id, "flathub");
+	gs_app_set_branch (app_by_id, "stable");
+	gs_app_set_origin (app_by_origin, "updates-testing");
+	gs_app_set_origin (app_unaffected, "fedora");
+
+	/* a new change affects nothing */
+	g_assert_true (gs_plugin_change_is_empty (change));
+	g_assert_false (gs_plugin_change_is_all (change));
+	g_assert_false (gs_plugin_change_affects_app (change, app_by_id));
+
+	/* apps are matched by unique ID, with wildcards, or by origin */
+	gs_plugin_change_add_unique_id (change, "system/flatpak/flathub/org.example.Changed/*");
+	gs_plugin_change_add_unique_id (change, "system/flatpak/flathub/org.example.Changed/*");
+	gs_plugin_change_add_origin (other, "updates-testing");
+	gs_plugin_change_merge (change, other);
+	g_assert_false (gs_plugin_change_is_empty (change));
+	g_assert_cmpuint (gs_plugin_change_get_unique_ids (change)->len, ==, 1);
+	g_assert_cmpuint (gs_plugin_change_get_origins (change)->len, ==, 1);
+	g_assert_true (gs_plugin_change_affects_app (change, app_by_id));
+	g_assert_true (gs_plugin_change_affects_app (change, app_by_origin));
+	g_assert_false (gs_plugin_change_affects_app (change, app_unaffected));
+
+	/* merging with everything affects everything */
+	gs_plugin_change_merge (change, all);
+	g_assert_true (gs_plugin_change_is_all (change));
+	g_assert_cmpuint (gs_plugin_change_get_unique_ids (change)->len, ==, 0);
+	g_assert_true (gs_plugin_change_affects_app (change, app_unaffected));
+	gs_plugin_change_add_origin (change, "fedora");
+	g_assert_cmpuint (gs_plugin_change_get_origins (change)->len, ==, 0);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -809,17 +1513,28 @@ main (int argc, char **argv)
 	g_test_add_func ("/gnome-software/lib/utils{wilson}", gs_utils_wilson_func);
 	g_test_add_func ("/gnome-software/lib/utils{error}", gs_utils_error_func);
 	g_test_add_func ("/gnome-software/lib/utils{cache}", gs_utils_cache_func);
+	g_test_add_func ("/gnome-software/lib/utils{publish-file-contents}", gs_utils_publish_file_contents_func);
 	g_test_add_func ("/gnome-software/lib/utils{append-kv}", gs_utils_append_kv_func);
 	g_test_add_func ("/gnome-software/lib/os-release", gs_os_release_func);
 	g_test_add_func ("/gnome-software/lib/app", gs_app_func);
 	g_test_add_func ("/gnome-software/lib/app/progress-clamping", gs_app_progress_clamping_func);
+	g_test_add_func ("/gnome-software/lib/app/version-history-loader", gs_app_version_history_loader_func);
 	g_test_add_func ("/gnome-software/lib/app{addons}", gs_app_addons_func);
 	g_test_add_func ("/gnome-software/lib/app{unique-id}", gs_app_unique_id_func);
 	g_test_add_data_func ("/gnome-software/lib/app{thread}", debug, gs_app_thread_func);
+	g_test_add_func ("/gnome-software/lib/app{license}", gs_app_license_func);
+	g_test_add_func ("/gnome-software/lib/app{update-details}", gs_app_update_details_func);
 	g_test_add_func ("/gnome-software/lib/app{list}", gs_app_list_func);
 	g_test_add_func ("/gnome-software/lib/app{list-wildcard-dedupe}", gs_app_list_wildcard_dedupe_func);
 	g_test_add_func ("/gnome-software/lib/app{list-performance}", gs_app_list_performance_func);
+	g_test_add_func ("/gnome-software/lib/app{builder}", gs_app_builder_func);
 	g_test_add_func ("/gnome-software/lib/app{list-related}", gs_app_list_related_func);
+	g_test_add_func ("/gnome-software/lib/app{list-set-state-many}", gs_app_list_set_state_many_func);
+	g_test_add_func ("/gnome-software/lib/app{identity-map}", gs_app_identity_map_func);
+	g_test_add_func ("/gnome-software/lib/plugin{cache}", gs_plugin_cache_func);
+	g_test_add_func ("/gnome-software/lib/refine-plan", gs_refine_plan_func);
+	g_test_add_func ("/gnome-software/lib/size-accountant", gs_size_accountant_func);
+	g_test_add_func ("/gnome-software/lib/plugin{change}", gs_plugin_change_func);
 	g_test_add_func ("/gnome-software/lib/plugin", gs_plugin_func);
 	g_test_add_func ("/gnome-software/lib/plugin{download-rewrite}", gs_plugin_download_rewrite_func);
 
@@ -0,0 +1,296 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-size-accountant
+ * @short_description: A persistent record of how much storage apps use
+ *
+ * Working out how much user data and cache data an installed app has means
+ * walking its data directories, which can take seconds for a large app. Doing
+ * that every time the storage tile or dialog is shown makes them slow.
+ *
+ * #GsSizeAccountant keeps the last measured sizes for each app, and when they
+ * were measured, in a key file in the cache directory. Plugins measure apps in
+ * the background (after installing or updating them, and periodically for
+ * records which have gone stale) and record the results with
+ * gs_size_accountant_record(), then write them to disk with
+ * gs_size_accountant_save() once the whole batch has been measured. When
+ * refining, they call gs_size_accountant_apply() to set the recorded sizes on
+ * an app straight away.
+ *
+ * Records are identified by a key chosen by the plugin, typically the app ID.
+ *
+ * All methods are thread safe.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "gs-size-accountant.h"
+
+struct _GsSizeAccountant
+{
+	GObject		 parent;
+
+	gchar		*filename;  /* (owned) (not nullable) */
+	GMutex		 mutex;
+	GKeyFile	*key_file;  /* (owned) (mutex mutex) (nullable); loaded on first use */
+	gboolean	 dirty;  /* (mutex mutex); TRUE if @key_file has unsaved changes */
+};
+
+G_DEFINE_TYPE (GsSizeAccountant, gs_size_accountant, G_TYPE_OBJECT)
+
+static void
+gs_size_accountant_finalize (GObject *object)
+{
+	GsSizeAccountant *self = GS_SIZE_ACCOUNTANT (object);
+
+	/* don’t lose records which the plugin didn’t get round to saving */
+	gs_size_accountant_save (self);
+
+	g_free (self->filename);
+	g_clear_pointer (&self->key_file, g_key_file_unref);
+	g_mutex_clear (&self->mutex);
+
+	G_OBJECT_CLASS (gs_size_accountant_parent_class)->finalize (object);
+}
+
+static void
+gs_size_accountant_class_init (GsSizeAccountantClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = gs_size_accountant_finalize;
+}
+
+static void
+gs_size_accountant_init (GsSizeAccountant *self)
+{
+	g_mutex_init (&self->mutex);
+}
+
+/**
+ * gs_size_accountant_new:
+ * @filename: the key file to keep the records in; it doesn’t have to exist yet
+ *
+ * Create a new #GsSizeAccountant.
+ *
+ * Returns: (transfer full): a new #GsSizeAccountant
+ * Since: 47
+ */
+GsSizeAccountant *
+gs_size_accountant_new (const gchar *filename)
+{
+	GsSizeAccountant *self;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	self = g_object_new (GS_TYPE_SIZE_ACCOUNTANT, NULL);
+	self->filename = g_strdup (filename);
+
+	return self;
+}
+
+/* Must be called with the mutex held. */
+static GKeyFile *
+ensure_key_file (GsSizeAccountant *self)
+{
+	g_autoptr(GError) local_error = NULL;
+
+	if (self->key_file != NULL)
+		return self->key_file;
+
+	self->key_file = g_key_file_new ();
+	if (!g_key_file_load_from_file (self->key_file, self->filename, G_KEY_FILE_NONE, &local_error) &&
+	    !g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		g_debug ("Ignoring size records in %s: %s", self->filename, local_error->message);
+
+	return self->key_file;
+}
+
+/**
+ * gs_size_accountant_apply:
+ * @self: a #GsSizeAccountant
+ * @key: the key for the record
+ * @app: the app to set the sizes on
+ *
+ * Set the user data and cache data sizes of @app from the record for @key, if
+ * there is one, and set %GS_SIZE_ACCOUNTANT_MEASURED_METADATA to when they
+ * were measured.
+ *
+ * Returns: %TRUE if there was a record, %FALSE otherwise
+ * Since: 47
+ */
+gboolean
+gs_size_accountant_apply (GsSizeAccountant *self,
+                          const gchar      *key,
+                          GsApp            *app)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GVariant) measured_variant = NULL;
+	GKeyFile *key_file;
+	guint64 size_user_data, size_cache_data, measured;
+
+	g_return_val_if_fail (GS_IS_SIZE_ACCOUNTANT (self), FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (GS_IS_APP (app), FALSE);
+
+	locker = g_mutex_locker_new (&self->mutex);
+	key_file = ensure_key_file (self);
+
+	if (!g_key_file_has_group (key_file, key))
+		return FALSE;
+
+	size_user_data = g_key_file_get_uint64 (key_file, key, "user-data", NULL);
+	size_cache_data = g_key_file_get_uint64 (key_file, key, "cache-data", NULL);
+	measured = g_key_file_get_uint64 (key_file, key, "measured", NULL);
+	g_clear_pointer (&locker, g_mutex_locker_free);
+
+	measured_variant = g_variant_ref_sink (g_variant_new_uint64 (measured));
+
+	gs_app_set_size_user_data (app, GS_SIZE_TYPE_VALID, size_user_data);
+	gs_app_set_size_cache_data (app, GS_SIZE_TYPE_VALID, size_cache_data);
+	/* metadata is never overwritten, so clear the previous time first */
+	gs_app_set_metadata_variant (app, GS_SIZE_ACCOUNTANT_MEASURED_METADATA, NULL);
+	gs_app_set_metadata_variant (app, GS_SIZE_ACCOUNTANT_MEASURED_METADATA, measured_variant);
+
+	return TRUE;
+}
+
+/**
+ * gs_size_accountant_record:
+ * @self: a #GsSizeAccountant
+ * @key: the key for the record
+ * @size_user_data: user data size, in bytes
+ * @size_cache_data: cache data size, in bytes
+ *
+ * Record the sizes just measured for @key, replacing any previous record.
+ *
+ * The record is not written to disk until gs_size_accountant_save() is
+ * called, so that measuring a batch of apps rewrites the file only once.
+ *
+ * Since: 47
+ */
+void
+gs_size_accountant_record (GsSizeAccountant *self,
+                           const gchar      *key,
+                           guint64           size_user_data,
+                           guint64           size_cache_data)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	GKeyFile *key_file;
+
+	g_return_if_fail (GS_IS_SIZE_ACCOUNTANT (self));
+	g_return_if_fail (key != NULL);
+
+	locker = g_mutex_locker_new (&self->mutex);
+	key_file = ensure_key_file (self);
+
+	g_key_file_set_uint64 (key_file, key, "user-data", size_user_data);
+	g_key_file_set_uint64 (key_file, key, "cache-data", size_cache_data);
+	g_key_file_set_uint64 (key_file, key, "measured", (guint64) (g_get_real_time () / G_USEC_PER_SEC));
+
+	self->dirty = TRUE;
+}
+
+/**
+ * gs_size_accountant_remove:
+ * @self: a #GsSizeAccountant
+ * @key: the key for the record
+ *
+ * Remove the record for @key, for example because the app has been
+ * uninstalled. It’s not an error if there is no record.
+ *
+ * As with gs_size_accountant_record(), the change is not written to disk
+ * until gs_size_accountant_save() is called.
+ *
+ * Since: 47
+ */
+void
+gs_size_accountant_remove (GsSizeAccountant *self,
+                           const gchar      *key)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	g_return_if_fail (GS_IS_SIZE_ACCOUNTANT (self));
+	g_return_if_fail (key != NULL);
+
+	locker = g_mutex_locker_new (&self->mutex);
+
+	if (g_key_file_remove_group (ensure_key_file (self), key, NULL))
+		self->dirty = TRUE;
+}
+
+/**
+ * gs_size_accountant_save:
+ * @self: a #GsSizeAccountant
+ *
+ * Write the records to disk, if they have changed since they were last
+ * saved. Failure is not fatal, as the sizes can always be measured again, so
+ * it’s only logged.
+ *
+ * Since: 47
+ */
+void
+gs_size_accountant_save (GsSizeAccountant *self)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	g_return_if_fail (GS_IS_SIZE_ACCOUNTANT (self));
+
+	locker = g_mutex_locker_new (&self->mutex);
+
+	if (!self->dirty)
+		return;
+
+	if (!g_key_file_save_to_file (self->key_file, self->filename, &local_error))
+		g_debug ("Failed to save size records to %s: %s", self->filename, local_error->message);
+	self->dirty = FALSE;
+}
+
+/**
+ * gs_size_accountant_dup_stale_keys:
+ * @self: a #GsSizeAccountant
+ * @max_age_secs: how old a record can be before it’s stale, in seconds
+ *
+ * Get the keys of the records which were measured more than @max_age_secs
+ * ago, so they can be measured again.
+ *
+ * Returns: (transfer full) (not nullable): the stale keys, possibly empty
+ * Since: 47
+ */
+GStrv
+gs_size_accountant_dup_stale_keys (GsSizeAccountant *self,
+                                   guint64           max_age_secs)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GStrvBuilder) builder = g_strv_builder_new ();
+	g_auto(GStrv) groups = NULL;
+	GKeyFile *key_file;
+	guint64 now = (guint64) (g_get_real_time () / G_USEC_PER_SEC);
+
+	g_return_val_if_fail (GS_IS_SIZE_ACCOUNTANT (self), NULL);
+
+	locker = g_mutex_locker_new (&self->mutex);
+	key_file = ensure_key_file (self);
+	groups = g_key_file_get_groups (key_file, NULL);
+
+	for (gsize i = 0; groups[i] != NULL; i++) {
+		guint64 measured = g_key_file_get_uint64 (key_file, groups[i], "measured", NULL);
+
+		if (measured > now || now - measured > max_age_secs)
+			g_strv_builder_add (builder, groups[i]);
+	}
+
+	return g_strv_builder_end (builder);
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "gs-app.h"
+
+G_BEGIN_DECLS
+
+/**
+ * GS_SIZE_ACCOUNTANT_MEASURED_METADATA:
+ *
+ * The #GsApp metadata key which gs_size_accountant_apply() sets to the time
+ * the app’s data sizes were measured, as a `t` #GVariant of seconds since the
+ * Unix epoch.
+ *
+ * Since: 47
+ */
+#define GS_SIZE_ACCOUNTANT_MEASURED_METADATA "GnomeSoftware::size-data-measured"
+
+#define GS_TYPE_SIZE_ACCOUNTANT (gs_size_accountant_get_type ())
+
+G_DECLARE_FINAL_TYPE (GsSizeAccountant, gs_size_accountant, GS, SIZE_ACCOUNTANT, GObject)
+
+GsSizeAccountant	*gs_size_accountant_new			(const gchar		*filename);
+
+gboolean		 gs_size_accountant_apply		(GsSizeAccountant	*self,
+								 const gchar		*key,
+								 GsApp			*app);
+void			 gs_size_accountant_record		(GsSizeAccountant	*self,
+								 const gchar		*key,
+								 guint64		 size_user_data,
+								 guint64		 size_cache_data);
+void			 gs_size_accountant_remove		(GsSizeAccountant	*self,
+								 const gchar		*key);
+void			 gs_size_accountant_save		(GsSizeAccountant	*self);
+GStrv			 gs_size_accountant_dup_stale_keys	(GsSizeAccountant	*self,
+								 guint64		 max_age_secs);
+
+G_END_DECLS
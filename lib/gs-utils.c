@@ -21,9 +21,12 @@
 #include "config.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <math.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <glib/gi18n-lib.h>
 #include <glib/gstdio.h>
 #include <json-glib/json-glib.h>
@@ -103,22 +106,107 @@ gs_utils_get_file_age (GFile *file)
 	return (guint) (now - mtime);
 }
 
-static gchar *
-gs_utils_filename_array_return_newest (GPtrArray *array)
+static guint64
+get_age_from_stat (const struct stat *st)
 {
-	const gchar *filename_best = NULL;
-	guint age_lowest = G_MAXUINT;
-	guint i;
-	for (i = 0; i < array->len; i++) {
-		const gchar *fn = g_ptr_array_index (array, i);
-		g_autoptr(GFile) file = g_file_new_for_path (fn);
-		guint64 age_tmp = gs_utils_get_file_age (file);
-		if (age_tmp < age_lowest) {
-			age_lowest = age_tmp;
-			filename_best = fn;
-		}
+	guint64 now = (guint64) g_get_real_time () / G_USEC_PER_SEC;
+	guint64 mtime = (guint64) st->st_mtime;
+
+	if (mtime > now)
+		return G_MAXUINT64;
+	return now - mtime;
+}
+
+/* What is known about the directories for one cache kind. This is immutable
+ * once created, so can be used from several threads without locking; when
+ * the directories change, it’s replaced in @cache_dirs. */
+typedef struct {
+	gchar	*user_dir;  /* (owned) */
+	gint	 user_dirfd;  /* (owned); -1 if it didn’t exist */
+	gint	 system_dirfd;  /* (owned); -1 if it didn’t exist */
+} GsCacheDir;
+
+static GMutex cache_dirs_mutex;
+static GHashTable *cache_dirs = NULL;  /* (owned) (element-type filename GsCacheDir) (nullable); keyed by user_dir */
+
+static gint
+open_dir (const gchar *path)
+{
+	return open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+static void
+gs_cache_dir_clear (GsCacheDir *cache_dir)
+{
+	g_free (cache_dir->user_dir);
+	if (cache_dir->user_dirfd >= 0)
+		close (cache_dir->user_dirfd);
+	if (cache_dir->system_dirfd >= 0)
+		close (cache_dir->system_dirfd);
+}
+
+static void
+gs_cache_dir_unref (GsCacheDir *cache_dir)
+{
+	g_atomic_rc_box_release_full (cache_dir, (GDestroyNotify) gs_cache_dir_clear);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsCacheDir, gs_cache_dir_unref)
+
+/* Gets the cache directory for @kind, opening its directories if this is the
+ * first time it’s been asked for. If @refresh is set, any existing
+ * #GsCacheDir is replaced, as the directories are known to have changed. */
+static GsCacheDir *
+gs_cache_dir_lookup (const gchar *user_dir,
+                     const gchar *kind,
+                     gboolean     refresh)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache_dirs_mutex);
+	GsCacheDir *cache_dir;
+
+	if (cache_dirs == NULL)
+		cache_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						    (GDestroyNotify) gs_cache_dir_unref);
+
+	cache_dir = refresh ? NULL : g_hash_table_lookup (cache_dirs, user_dir);
+	if (cache_dir == NULL) {
+		g_autofree gchar *system_dir = g_build_filename (LOCALSTATEDIR,
+								 "cache",
+								 "gnome-software",
+								 kind,
+								 NULL);
+
+		cache_dir = g_atomic_rc_box_new0 (GsCacheDir);
+		cache_dir->user_dir = g_strdup (user_dir);
+		cache_dir->user_dirfd = open_dir (user_dir);
+		cache_dir->system_dirfd = open_dir (system_dir);
+		g_hash_table_replace (cache_dirs, cache_dir->user_dir, cache_dir);
 	}
-	return g_strdup (filename_best);
+
+	return g_atomic_rc_box_acquire (cache_dir);
+}
+
+/* Forgets about the directories for @user_dir, so they are looked at again
+ * the next time they’re needed. */
+static void
+gs_cache_dir_invalidate (const gchar *user_dir)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache_dirs_mutex);
+
+	if (cache_dirs != NULL)
+		g_hash_table_remove (cache_dirs, user_dir);
+}
+
+/* Whether the user cache directory which was opened still exists, rather than
+ * having been deleted since. */
+static gboolean
+gs_cache_dir_user_dir_exists (GsCacheDir *cache_dir)
+{
+	struct stat st;
+
+	return (cache_dir->user_dirfd >= 0 &&
+		fstat (cache_dir->user_dirfd, &st) == 0 &&
+		st.st_nlink > 0);
 }
 
 /**
@@ -138,6 +226,10 @@ gs_utils_filename_array_return_newest (GPtrArray *array)
  * If there is more than one match, the file that has been modified last is
  * returned.
  *
+ * The cache directories for each @kind are opened once and kept open, so
+ * looking up many files of the same @kind is cheap. Whether the system cache
+ * for @kind exists is only checked the first time @kind is used.
+ *
  * If a plugin requests a file to be saved in the cache it is the plugins
  * responsibility to remove the file when it is no longer valid or is too old
  * -- gnome-software will not ever clean the cache for the plugin.
@@ -157,13 +249,15 @@ gs_utils_get_cache_filename (const gchar *kind,
 	const gchar *tmp;
 	g_autofree gchar *basename = NULL;
 	g_autofree gchar *cachedir = NULL;
-	g_autoptr(GFile) cachedir_file = NULL;
-	g_autoptr(GPtrArray) candidates = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GsCacheDir) cache_dir = NULL;
 	g_autoptr(GError) local_error = NULL;
+	struct stat system_st;
 
 	/* in the self tests */
 	tmp = g_getenv ("GS_SELF_TEST_CACHEDIR");
 	if (tmp != NULL) {
+		g_autoptr(GFile) cachedir_file = NULL;
+
 		cachedir = g_build_filename (tmp, kind, NULL);
 		cachedir_file = g_file_new_for_path (cachedir);
 
@@ -187,45 +281,67 @@ gs_utils_get_cache_filename (const gchar *kind,
 		basename = g_path_get_basename (resource);
 	}
 
-	/* not writable, so try the system cache first */
-	if (!(flags & GS_UTILS_CACHE_FLAG_WRITEABLE)) {
-		g_autofree gchar *cachefn = NULL;
-		cachefn = g_build_filename (LOCALSTATEDIR,
-					    "cache",
-					    "gnome-software",
-		                            kind,
-					    basename,
-					    NULL);
-		if (g_file_test (cachefn, G_FILE_TEST_EXISTS)) {
-			g_ptr_array_add (candidates,
-					 g_steal_pointer (&cachefn));
-		}
-	}
-
-	/* create the cachedir in a per-release location, creating
-	 * if it does not already exist */
 	cachedir = g_build_filename (g_get_user_cache_dir (),
 				     "gnome-software",
 				     kind,
 				     NULL);
-	cachedir_file = g_file_new_for_path (cachedir);
-	if (g_file_query_exists (cachedir_file, NULL) &&
-	    flags & GS_UTILS_CACHE_FLAG_ENSURE_EMPTY) {
-		if (!gs_utils_rmtree (cachedir, error))
+
+	/* clear out the per-user cache */
+	if (flags & GS_UTILS_CACHE_FLAG_ENSURE_EMPTY) {
+		gs_cache_dir_invalidate (cachedir);
+		if (g_file_test (cachedir, G_FILE_TEST_EXISTS) &&
+		    !gs_utils_rmtree (cachedir, error))
 			return NULL;
 	}
+
+	cache_dir = gs_cache_dir_lookup (cachedir, kind, FALSE);
+
+	/* create the per-user cache directory if it does not already exist */
 	if ((flags & GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY) &&
-	    !g_file_query_exists (cachedir_file, NULL) &&
-	    !g_file_make_directory_with_parents (cachedir_file, NULL, error))
-		return NULL;
-	g_ptr_array_add (candidates, g_build_filename (cachedir, basename, NULL));
+	    !gs_cache_dir_user_dir_exists (cache_dir)) {
+		g_autoptr(GFile) cachedir_file = g_file_new_for_path (cachedir);
+
+		if (!g_file_make_directory_with_parents (cachedir_file, NULL, &local_error) &&
+		    !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS)) {
+			g_propagate_error (error, g_steal_pointer (&local_error));
+			return NULL;
+		}
+
+		g_clear_pointer (&cache_dir, gs_cache_dir_unref);
+		cache_dir = gs_cache_dir_lookup (cachedir, kind, TRUE);
+	}
+
+	/* not writable, so try the system cache first, and return the newest
+	 * of it and the per-user cache */
+	if (!(flags & GS_UTILS_CACHE_FLAG_WRITEABLE) &&
+	    cache_dir->system_dirfd >= 0 &&
+	    fstatat (cache_dir->system_dirfd, basename, &system_st, 0) == 0) {
+		struct stat user_st;
+		gint user_dirfd = cache_dir->user_dirfd;
+		g_autofd gint new_user_dirfd = -1;
+
+		/* the per-user cache may have been created or deleted by
+		 * something which didn’t ask for it to be */
+		if (!gs_cache_dir_user_dir_exists (cache_dir)) {
+			new_user_dirfd = open_dir (cachedir);
+			user_dirfd = new_user_dirfd;
+			if (user_dirfd >= 0 || cache_dir->user_dirfd >= 0)
+				gs_cache_dir_invalidate (cachedir);
+		}
 
-	/* common case: we only have one option */
-	if (candidates->len == 1)
-		return g_strdup (g_ptr_array_index (candidates, 0));
+		if (user_dirfd < 0 ||
+		    fstatat (user_dirfd, basename, &user_st, 0) != 0 ||
+		    get_age_from_stat (&user_st) >= get_age_from_stat (&system_st)) {
+			return g_build_filename (LOCALSTATEDIR,
+						 "cache",
+						 "gnome-software",
+						 kind,
+						 basename,
+						 NULL);
+		}
+	}
 
-	/* return the newest (i.e. one with least age) */
-	return gs_utils_filename_array_return_newest (candidates);
+	return g_build_filename (cachedir, basename, NULL);
 }
 
 /**
@@ -1632,6 +1748,160 @@ gs_utils_set_file_etag (GFile        *file,
 	return TRUE;
 }
 
+#define METADATA_CONTENT_HASH_ATTRIBUTE "xattr::gnome-software::content-hash"
+
+/**
+ * gs_utils_get_file_content_hash:
+ * @file: a file to get the content hash for
+ * @cancellable: (nullable): an optional #GCancellable or %NULL
+ *
+ * Gets the SHA-256 hash of the contents of @file, as recorded when it was
+ * last written by gs_utils_publish_file_contents().
+ *
+ * Returns: (nullable) (transfer full): The content hash stored for the
+ *    @file, or %NULL, when the file does not exist, no hash is stored for
+ *    it or other error occurs.
+ *
+ * Since: 47
+ **/
+gchar *
+gs_utils_get_file_content_hash (GFile        *file,
+                                GCancellable *cancellable)
+{
+	g_autoptr(GFileInfo) info = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (file), NULL);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+
+	info = g_file_query_info (file, METADATA_CONTENT_HASH_ATTRIBUTE, G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+	if (info == NULL)
+		return NULL;
+
+	return g_strdup (g_file_info_get_attribute_string (info, METADATA_CONTENT_HASH_ATTRIBUTE));
+}
+
+/**
+ * gs_utils_set_file_content_hash:
+ * @file: a file to set the content hash for
+ * @content_hash: a SHA-256 hash of the contents of @file
+ * @cancellable: (nullable): an optional #GCancellable or %NULL
+ *
+ * Records @content_hash against @file, so it can be read back with
+ * gs_utils_get_file_content_hash(). This is useful when @file was written
+ * somewhere else before being moved into place.
+ *
+ * Returns: whether succeeded.
+ *
+ * Since: 47
+ **/
+gboolean
+gs_utils_set_file_content_hash (GFile        *file,
+                                const gchar  *content_hash,
+                                GCancellable *cancellable)
+{
+	g_autoptr(GError) local_error = NULL;
+
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+	g_return_val_if_fail (content_hash != NULL, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	if (!g_file_set_attribute_string (file, METADATA_CONTENT_HASH_ATTRIBUTE, content_hash, G_FILE_QUERY_INFO_NONE, cancellable, &local_error)) {
+		g_debug ("Error setting attribute ‘%s’ on file ‘%s’: %s",
+			 METADATA_CONTENT_HASH_ATTRIBUTE, g_file_peek_path (file), local_error->message);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Compare @contents with what’s on disk, for file systems which don’t
+ * support extended attributes. */
+static gboolean
+file_has_contents (GFile  *file,
+                   GBytes *contents)
+{
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GBytes) mapped_bytes = NULL;
+
+	mapped_file = g_mapped_file_new (g_file_peek_path (file), FALSE, NULL);
+	if (mapped_file == NULL)
+		return FALSE;
+
+	mapped_bytes = g_mapped_file_get_bytes (mapped_file);
+
+	return g_bytes_equal (mapped_bytes, contents);
+}
+
+/**
+ * gs_utils_publish_file_contents:
+ * @file: the file to write
+ * @contents: the new contents for @file
+ * @out_content_hash: (out) (transfer full) (optional): return location for
+ *   the SHA-256 hash of @contents, or %NULL to ignore
+ * @out_changed: (out) (optional): return location for whether @file was
+ *   written, or %NULL to ignore
+ * @cancellable: (nullable): an optional #GCancellable or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Atomically replaces the contents of @file with @contents, unless @file
+ * already has exactly those contents.
+ *
+ * The file is identified by the SHA-256 hash of its contents, which is
+ * stored alongside it and can be read back with
+ * gs_utils_get_file_content_hash(). Publishing the same contents twice
+ * leaves @file untouched, so readers of @file (and file monitors on its
+ * directory) never see a change when nothing has changed.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ *
+ * Since: 47
+ **/
+gboolean
+gs_utils_publish_file_contents (GFile         *file,
+                                GBytes        *contents,
+                                gchar        **out_content_hash,
+                                gboolean      *out_changed,
+                                GCancellable  *cancellable,
+                                GError       **error)
+{
+	g_autofree gchar *content_hash = NULL;
+	g_autofree gchar *old_content_hash = NULL;
+	gboolean changed = FALSE;
+	gconstpointer data;
+	gsize data_len;
+
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+	g_return_val_if_fail (contents != NULL, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	content_hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, contents);
+	old_content_hash = gs_utils_get_file_content_hash (file, cancellable);
+
+	if (old_content_hash != NULL ?
+	    g_strcmp0 (old_content_hash, content_hash) != 0 :
+	    !file_has_contents (file, contents)) {
+		data = g_bytes_get_data (contents, &data_len);
+
+		/* this writes to a temporary file and renames it over @file */
+		if (!g_file_replace_contents (file, data, data_len,
+					      NULL, FALSE,
+					      G_FILE_CREATE_REPLACE_DESTINATION,
+					      NULL, cancellable, error))
+			return FALSE;
+
+		gs_utils_set_file_content_hash (file, content_hash, cancellable);
+		changed = TRUE;
+	}
+
+	if (out_content_hash != NULL)
+		*out_content_hash = g_steal_pointer (&content_hash);
+	if (out_changed != NULL)
+		*out_changed = changed;
+
+	return TRUE;
+}
+
 /**
  * gs_utils_get_upgrade_background:
  * @version: (nullable): version string of the upgrade (which must be non-empty
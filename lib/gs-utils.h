@@ -145,6 +145,17 @@ gchar *		 gs_utils_get_file_etag		(GFile			*file,
 gboolean	 gs_utils_set_file_etag		(GFile			*file,
 						 const gchar		*etag,
 						 GCancellable		*cancellable);
+gchar *		 gs_utils_get_file_content_hash	(GFile			*file,
+						 GCancellable		*cancellable);
+gboolean	 gs_utils_set_file_content_hash	(GFile			*file,
+						 const gchar		*content_hash,
+						 GCancellable		*cancellable);
+gboolean	 gs_utils_publish_file_contents	(GFile			*file,
+						 GBytes			*contents,
+						 gchar			**out_content_hash,
+						 gboolean		*out_changed,
+						 GCancellable		*cancellable,
+						 GError			**error);
 
 gchar		*gs_utils_get_upgrade_background (const gchar		*version);
 
@@ -0,0 +1,103 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+
+#include "gnome-software-private.h"
+
+/* Test program which measures how long gs_utils_get_cache_filename() takes
+ * for the sorts of lookups the UI makes when loading icons and screenshots.
+ * It uses a temporary user cache directory, half of whose files exist, and
+ * prints the time per lookup for each combination of flags.
+ *
+ * Usage: profile-cache-filename [N_LOOKUPS] */
+
+#define DEFAULT_N_LOOKUPS 10000
+#define N_RESOURCES 500
+
+static void
+run_lookups (const gchar       *description,
+             const gchar       *kind,
+             GsUtilsCacheFlags  flags,
+             guint              n_lookups)
+{
+	gint64 start_time_usec, duration_usec;
+
+	start_time_usec = g_get_monotonic_time ();
+
+	for (guint i = 0; i < n_lookups; i++) {
+		g_autofree gchar *resource = g_strdup_printf ("https://example.com/screenshots/%u.png", i % N_RESOURCES);
+		g_autofree gchar *filename = NULL;
+		g_autoptr(GError) local_error = NULL;
+
+		filename = gs_utils_get_cache_filename (kind, resource, flags, &local_error);
+		g_assert_no_error (local_error);
+		g_assert_nonnull (filename);
+	}
+
+	duration_usec = g_get_monotonic_time () - start_time_usec;
+
+	g_print ("%s\t%u\t%" G_GINT64_FORMAT "\t%.2f\n",
+		 description, n_lookups, duration_usec / 1000,
+		 (gdouble) duration_usec / n_lookups);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	g_autofree gchar *tmp_dir = NULL;
+	g_autoptr(GError) local_error = NULL;
+	guint n_lookups = DEFAULT_N_LOOKUPS;
+
+	setlocale (LC_ALL, "");
+
+	if (argc > 1)
+		n_lookups = MAX (1, g_ascii_strtoull (argv[1], NULL, 10));
+
+	tmp_dir = g_dir_make_tmp ("profile-cache-filename-XXXXXX", &local_error);
+	g_assert_no_error (local_error);
+	g_setenv ("XDG_CACHE_HOME", tmp_dir, TRUE);
+	g_unsetenv ("GS_SELF_TEST_CACHEDIR");
+
+	/* populate half of the cache */
+	for (guint i = 0; i < N_RESOURCES; i += 2) {
+		g_autofree gchar *resource = g_strdup_printf ("https://example.com/screenshots/%u.png", i);
+		g_autofree gchar *filename = NULL;
+
+		filename = gs_utils_get_cache_filename ("screenshots/112x63", resource,
+							GS_UTILS_CACHE_FLAG_WRITEABLE |
+							GS_UTILS_CACHE_FLAG_USE_HASH |
+							GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+							&local_error);
+		g_assert_no_error (local_error);
+		g_file_set_contents (filename, "", 0, &local_error);
+		g_assert_no_error (local_error);
+	}
+
+	g_print ("lookup\t\tcalls\tms\tµs/call\n");
+
+	run_lookups ("read-only", "screenshots/112x63",
+		     GS_UTILS_CACHE_FLAG_USE_HASH, n_lookups);
+	run_lookups ("writable", "screenshots/112x63",
+		     GS_UTILS_CACHE_FLAG_WRITEABLE |
+		     GS_UTILS_CACHE_FLAG_USE_HASH, n_lookups);
+	run_lookups ("create-dir", "screenshots/112x63",
+		     GS_UTILS_CACHE_FLAG_WRITEABLE |
+		     GS_UTILS_CACHE_FLAG_USE_HASH |
+		     GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY, n_lookups);
+	run_lookups ("no-hash", "icons/64x64",
+		     GS_UTILS_CACHE_FLAG_NONE, n_lookups);
+
+	if (!gs_utils_rmtree (tmp_dir, &local_error))
+		g_warning ("Failed to remove %s: %s", tmp_dir, local_error->message);
+
+	return 0;
+}
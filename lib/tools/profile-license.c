@@ -0,0 +1,93 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <appstream.h>
+#include <glib.h>
+#include <locale.h>
+
+#include "gnome-software-private.h"
+
+/* Test program which measures how long it takes to set the licenses of many
+ * apps, as happens when refining a large catalogue. The licenses are drawn
+ * from a few hundred SPDX expressions, as in real catalogues. For comparison,
+ * it also prints how long it takes to evaluate each expression directly with
+ * as_license_is_free_license().
+ *
+ * Usage: profile-license [N_APPS] */
+
+#define DEFAULT_N_APPS 50000
+
+static const gchar *license_ids[] = {
+	"GPL-2.0-or-later", "GPL-3.0-or-later", "LGPL-2.1-or-later", "MIT",
+	"Apache-2.0", "BSD-3-Clause", "MPL-2.0", "CC0-1.0", "LicenseRef-proprietary",
+	"GPL-2.0-only", "LGPL-3.0-only", "Zlib", "ISC", "AGPL-3.0-or-later",
+	"CC-BY-SA-4.0", "Unlicense", "BSL-1.0",
+};
+
+static GPtrArray *
+build_licenses (void)
+{
+	GPtrArray *licenses = g_ptr_array_new_with_free_func (g_free);
+
+	for (gsize i = 0; i < G_N_ELEMENTS (license_ids); i++) {
+		g_ptr_array_add (licenses, g_strdup (license_ids[i]));
+
+		for (gsize j = 0; j < G_N_ELEMENTS (license_ids); j++) {
+			if (i == j)
+				continue;
+			g_ptr_array_add (licenses, g_strdup_printf ("%s AND %s", license_ids[i], license_ids[j]));
+			if (j % 2 == 0)
+				g_ptr_array_add (licenses, g_strdup_printf ("(%s OR %s) AND %s",
+									    license_ids[i], license_ids[j],
+									    license_ids[(i + j) % G_N_ELEMENTS (license_ids)]));
+		}
+	}
+
+	return licenses;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	g_autoptr(GPtrArray) licenses = NULL;
+	g_autoptr(GPtrArray) apps = g_ptr_array_new_with_free_func (g_object_unref);
+	guint n_apps = DEFAULT_N_APPS;
+	guint n_free = 0;
+	gint64 start_time_usec, direct_usec, set_usec;
+
+	setlocale (LC_ALL, "");
+
+	if (argc > 1)
+		n_apps = MAX (1, g_ascii_strtoull (argv[1], NULL, 10));
+
+	licenses = build_licenses ();
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		g_ptr_array_add (apps, gs_app_new (id));
+	}
+
+	start_time_usec = g_get_monotonic_time ();
+	for (guint i = 0; i < n_apps; i++)
+		n_free += as_license_is_free_license (g_ptr_array_index (licenses, i % licenses->len));
+	direct_usec = g_get_monotonic_time () - start_time_usec;
+
+	start_time_usec = g_get_monotonic_time ();
+	for (guint i = 0; i < n_apps; i++)
+		gs_app_set_license (g_ptr_array_index (apps, i), GS_APP_QUALITY_NORMAL,
+				    g_ptr_array_index (licenses, i % licenses->len));
+	set_usec = g_get_monotonic_time () - start_time_usec;
+
+	g_print ("%u apps, %u distinct licenses, %u free\n", n_apps, licenses->len, n_free);
+	g_print ("as_license_is_free_license()\t%" G_GINT64_FORMAT " ms\t%.2f µs/call\n",
+		 direct_usec / 1000, (gdouble) direct_usec / n_apps);
+	g_print ("gs_app_set_license()\t\t%" G_GINT64_FORMAT " ms\t%.2f µs/call\n",
+		 set_usec / 1000, (gdouble) set_usec / n_apps);
+
+	return 0;
+}
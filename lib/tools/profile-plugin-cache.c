@@ -0,0 +1,153 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <glib.h>
+#include <locale.h>
+
+#include "gnome-software-private.h"
+
+/* Test program which measures how well the per-plugin app cache scales when
+ * it’s used from several threads at once, as it is when several jobs refine
+ * apps in parallel. Each thread mostly looks up apps, with some additions and
+ * the occasional gs_plugin_cache_lookup_by_state(), and the total number of
+ * operations per second is printed for each number of threads.
+ *
+ * Usage: profile-plugin-cache [N_APPS [DURATION_SECS]] */
+
+#define DEFAULT_N_APPS 5000
+#define DEFAULT_DURATION_SECS 2
+#define MAX_THREADS 16
+
+/* GsPlugin is abstract, so the benchmark needs its own subclass. */
+#define GS_TYPE_PROFILE_PLUGIN (gs_profile_plugin_get_type ())
+G_DECLARE_FINAL_TYPE (GsProfilePlugin, gs_profile_plugin, GS, PROFILE_PLUGIN, GsPlugin)
+
+struct _GsProfilePlugin {
+	GsPlugin parent;
+};
+
+G_DEFINE_TYPE (GsProfilePlugin, gs_profile_plugin, GS_TYPE_PLUGIN)
+
+static void
+gs_profile_plugin_class_init (GsProfilePluginClass *klass)
+{
+}
+
+static void
+gs_profile_plugin_init (GsProfilePlugin *self)
+{
+}
+
+typedef struct {
+	GsPlugin *plugin;  /* (unowned) */
+	GPtrArray *apps;  /* (unowned) (element-type GsApp) */
+	gint64 end_time_usec;
+	guint64 n_ops;  /* output */
+} ThreadData;
+
+static gpointer
+thread_cb (gpointer user_data)
+{
+	ThreadData *data = user_data;
+	GRand *rand = g_rand_new ();
+
+	while (g_get_monotonic_time () < data->end_time_usec) {
+		/* batch the operations between clock reads */
+		for (guint i = 0; i < 1000; i++) {
+			GsApp *app = g_ptr_array_index (data->apps, g_rand_int_range (rand, 0, data->apps->len));
+			guint32 op = g_rand_int_range (rand, 0, 1000);
+
+			if (op == 0) {
+				g_autoptr(GsAppList) list = gs_app_list_new ();
+				gs_plugin_cache_lookup_by_state (data->plugin, list, GS_APP_STATE_INSTALLED);
+			} else if (op < 100) {
+				gs_plugin_cache_add (data->plugin, NULL, app);
+			} else {
+				g_autoptr(GsApp) cached = gs_plugin_cache_lookup (data->plugin, gs_app_get_unique_id (app));
+			}
+		}
+
+		data->n_ops += 1000;
+	}
+
+	g_rand_free (rand);
+
+	return NULL;
+}
+
+static guint64
+run_threads (GsPlugin  *plugin,
+             GPtrArray *apps,
+             guint      n_threads,
+             guint      duration_secs)
+{
+	ThreadData data[MAX_THREADS] = { { NULL, }, };
+	GThread *threads[MAX_THREADS] = { NULL, };
+	gint64 end_time_usec = g_get_monotonic_time () + duration_secs * G_USEC_PER_SEC;
+	guint64 n_ops = 0;
+
+	for (guint i = 0; i < n_threads; i++) {
+		data[i].plugin = plugin;
+		data[i].apps = apps;
+		data[i].end_time_usec = end_time_usec;
+		threads[i] = g_thread_new ("profile-plugin-cache", thread_cb, &data[i]);
+	}
+
+	for (guint i = 0; i < n_threads; i++) {
+		g_thread_join (threads[i]);
+		n_ops += data[i].n_ops;
+	}
+
+	return n_ops / duration_secs;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+	g_autoptr(GsPlugin) plugin = NULL;
+	g_autoptr(GPtrArray) apps = g_ptr_array_new_with_free_func (g_object_unref);
+	guint n_apps = DEFAULT_N_APPS;
+	guint duration_secs = DEFAULT_DURATION_SECS;
+	guint64 single_thread_ops = 0;
+
+	setlocale (LC_ALL, "");
+
+	if (argc > 1)
+		n_apps = MAX (1, g_ascii_strtoull (argv[1], NULL, 10));
+	if (argc > 2)
+		duration_secs = MAX (1, g_ascii_strtoull (argv[2], NULL, 10));
+
+	plugin = g_object_new (GS_TYPE_PROFILE_PLUGIN, NULL);
+
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		GsApp *app = gs_app_new (id);
+
+		gs_app_set_scope (app, AS_COMPONENT_SCOPE_SYSTEM);
+		gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_FLATPAK);
+		gs_app_set_state (app, (i % 4 == 0) ? GS_APP_STATE_INSTALLED : GS_APP_STATE_AVAILABLE);
+		gs_plugin_cache_add (plugin, NULL, app);
+		g_ptr_array_add (apps, app);
+	}
+
+	g_print ("%u cached apps, %u s per run\n", n_apps, duration_secs);
+	g_print ("threads\tops/s\t\tspeedup\n");
+
+	for (guint n_threads = 1; n_threads <= MIN (MAX_THREADS, 2 * g_get_num_processors ()); n_threads *= 2) {
+		guint64 ops = run_threads (plugin, apps, n_threads, duration_secs);
+
+		if (n_threads == 1)
+			single_thread_ops = ops;
+
+		g_print ("%u\t%" G_GUINT64_FORMAT "\t%.2f\n",
+			 n_threads, ops, (gdouble) ops / MAX (single_thread_ops, 1));
+	}
+
+	return 0;
+}
@@ -43,6 +43,8 @@ struct _GsPluginAppstream
 	AsComponentScope	 default_scope;
 	GSettings		*settings;
 
+	GThreadPool		*refine_pool;  /* (owned) (nullable) */
+
 	GPtrArray		*file_monitors; /* (owned) (element-type GFileMonitor) */
 	/* The stamps help to avoid locking the silo lock in the main thread
 	   and also to detect changes while loading other appstream data. */
@@ -55,6 +57,11 @@ G_DEFINE_TYPE (GsPluginAppstream, gs_plugin_appstream, GS_TYPE_PLUGIN)
 #define assert_in_worker(self) \
 	g_assert (gs_worker_thread_is_in_worker_context (self->worker))
 
+/* Refine lists longer than this are split into chunks of this many apps,
+ * which are refined in parallel in @refine_pool. */
+#define REFINE_CHUNK_SIZE 200
+#define REFINE_MAX_THREADS 4
+
 static void
 gs_plugin_appstream_dispose (GObject *object)
 {
@@ -67,6 +74,10 @@ gs_plugin_appstream_dispose (GObject *object)
 	g_clear_object (&self->settings);
 	g_rw_lock_clear (&self->silo_lock);
 	g_clear_object (&self->worker);
+	if (self->refine_pool != NULL) {
+		g_thread_pool_free (self->refine_pool, FALSE, TRUE);
+		self->refine_pool = NULL;
+	}
 	g_clear_pointer (&self->file_monitors, g_ptr_array_unref);
 
 	G_OBJECT_CLASS (gs_plugin_appstream_parent_class)->dispose (object);
@@ -221,6 +232,29 @@ gs_plugin_appstream_media_baseurl_cb (XbBuilderFixup *self,
 	return TRUE;
 }
 
+/* Catalogue files are conventionally named after the origin of the apps in
+ * them, such as `fedora.xml.gz`. Returns %NULL for files which aren’t
+ * catalogues, such as installed metainfo and desktop files. */
+static gchar *
+gs_plugin_appstream_get_catalog_origin (GFile *file)
+{
+	const gchar *suffixes[] = { ".xml.gz", ".yml.gz", ".xml", ".yml" };
+	g_autofree gchar *basename = g_file_get_basename (file);
+
+	if (basename == NULL ||
+	    g_str_has_suffix (basename, ".appdata.xml") ||
+	    g_str_has_suffix (basename, ".metainfo.xml"))
+		return NULL;
+
+	for (gsize i = 0; i < G_N_ELEMENTS (suffixes); i++) {
+		if (g_str_has_suffix (basename, suffixes[i]) &&
+		    strlen (basename) > strlen (suffixes[i]))
+			return g_strndup (basename, strlen (basename) - strlen (suffixes[i]));
+	}
+
+	return NULL;
+}
+
 static void
 gs_plugin_appstream_file_monitor_changed_cb (GFileMonitor *monitor,
 					     GFile *file,
@@ -229,7 +263,27 @@ gs_plugin_appstream_file_monitor_changed_cb (GFileMonitor *monitor,
 					     gpointer user_data)
 {
 	GsPluginAppstream *self = user_data;
+	g_autofree gchar *origin = NULL;
+	g_autoptr(GsPluginChange) change = NULL;
+
 	g_atomic_int_inc (&self->file_monitor_stamp);
+
+	/* The silo is reloaded lazily, but tell the UI which apps may now
+	 * have different metadata. Installed metainfo and desktop files
+	 * change when apps are installed or removed, which the packaging
+	 * plugins already report. */
+	if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+	    event_type != G_FILE_MONITOR_EVENT_CREATED &&
+	    event_type != G_FILE_MONITOR_EVENT_DELETED)
+		return;
+
+	origin = gs_plugin_appstream_get_catalog_origin (file);
+	if (origin == NULL)
+		return;
+
+	change = gs_plugin_change_new ();
+	gs_plugin_change_add_origin (change, origin);
+	gs_plugin_reload_for_change (GS_PLUGIN (self), change);
 }
 
 static void
@@ -725,6 +779,8 @@ gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
 
 	g_clear_object (&n);
 
+	gs_appstream_warm_license_cache (self->silo);
+
 	self->silo_installed_by_desktopid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 	self->silo_installed_by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
@@ -780,17 +836,12 @@ gs_plugin_appstream_reload (GsPlugin *plugin)
 	GsPluginAppstream *self;
 	g_autoptr(GsAppList) list = NULL;
 	g_autoptr(GRWLockWriterLocker) writer_locker = NULL;
-	guint sz;
 
 	g_return_if_fail (GS_IS_PLUGIN_APPSTREAM (plugin));
 
+	/* to ensure the app states are refined */
 	list = gs_plugin_list_cached (plugin);
-	sz = gs_app_list_length (list);
-	for (guint i = 0; i < sz; i++) {
-		GsApp *app = gs_app_list_index (list, i);
-		/* to ensure the app states are refined */
-		gs_app_set_state (app, GS_APP_STATE_UNKNOWN);
-	}
+	gs_app_list_set_state_many (list, GS_APP_STATE_UNKNOWN);
 
 	self = GS_PLUGIN_APPSTREAM (plugin);
 	writer_locker = g_rw_lock_writer_locker_new (&self->silo_lock);
@@ -1006,24 +1057,22 @@ gs_plugin_appstream_set_compulsory_quirk (GsApp *app, XbNode *component)
 	}
 }
 
+/* The caller must hold @silo_lock as a reader. */
 static gboolean
 gs_plugin_appstream_refine_state (GsPluginAppstream  *self,
                                   GsApp              *app,
                                   GError            **error)
 {
-	g_autoptr(GRWLockReaderLocker) locker = NULL;
-
 	/* Ignore apps with no ID */
 	if (gs_app_get_id (app) == NULL)
 		return TRUE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
-
 	if (g_hash_table_contains (self->silo_installed_by_id, gs_app_get_id (app)))
 		gs_app_set_state (app, GS_APP_STATE_INSTALLED);
 	return TRUE;
 }
 
+/* The caller must hold @silo_lock as a reader. */
 static gboolean
 gs_plugin_refine_from_id (GsPluginAppstream    *self,
                           GsApp                *app,
@@ -1035,15 +1084,12 @@ gs_plugin_refine_from_id (GsPluginAppstream    *self,
 {
 	const gchar *id, *origin;
 	GPtrArray *components;
-	g_autoptr(GRWLockReaderLocker) locker = NULL;
 
 	/* not enough info to find */
 	id = gs_app_get_id (app);
 	if (id == NULL)
 		return TRUE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
-
 	origin = gs_app_get_origin_appstream (app);
 
 	/* look in AppStream then fall back to AppData */
@@ -1074,6 +1120,7 @@ gs_plugin_refine_from_id (GsPluginAppstream    *self,
 	return TRUE;
 }
 
+/* The caller must hold @silo_lock as a reader. */
 static gboolean
 gs_plugin_refine_from_pkgname (GsPluginAppstream    *self,
                                GsApp                *app,
@@ -1090,12 +1137,9 @@ gs_plugin_refine_from_pkgname (GsPluginAppstream    *self,
 	/* find all apps when matching any prefixes */
 	for (guint j = 0; j < sources->len; j++) {
 		const gchar *pkgname = g_ptr_array_index (sources, j);
-		g_autoptr(GRWLockReaderLocker) locker = NULL;
 		g_autoptr(GString) xpath = g_string_new (NULL);
 		g_autoptr(XbNode) component = NULL;
 
-		locker = g_rw_lock_reader_locker_new (&self->silo_lock);
-
 		/* prefer actual apps and then fallback to anything else */
 		xb_string_append_union (xpath, "components/component[@type='desktop-application']/pkgname[text()='%s']/..", pkgname);
 		xb_string_append_union (xpath, "components/component[@type='console-application']/pkgname[text()='%s']/..", pkgname);
@@ -1157,6 +1201,157 @@ static gboolean refine_wildcard (GsPluginAppstream    *self,
                                  GCancellable         *cancellable,
                                  GError              **error);
 
+/* Refine a single non-wildcard @app from the silo. The caller must hold
+ * @silo_lock as a reader, and the silo must be valid.
+ *
+ * This may be called from @worker or from @refine_pool. */
+static gboolean
+refine_app (GsPluginAppstream    *self,
+            GsApp                *app,
+            GsPluginRefineFlags   flags,
+            GHashTable           *apps_by_id,
+            GHashTable           *apps_by_origin_and_id,
+            GError              **error)
+{
+	gboolean found = FALSE;
+
+	/* find by ID then fall back to package name */
+	if (!gs_plugin_refine_from_id (self, app, flags, apps_by_id, apps_by_origin_and_id, &found, error))
+		return FALSE;
+	if (!found &&
+	    !gs_plugin_refine_from_pkgname (self, app, flags, error))
+		return FALSE;
+
+	return TRUE;
+}
+
+typedef struct {
+	/* Input data. */
+	GsPluginAppstream *self;  /* (unowned) */
+	GsPluginRefineFlags flags;
+	GHashTable *apps_by_id;  /* (unowned) */
+	GHashTable *apps_by_origin_and_id;  /* (unowned) */
+	GCancellable *cancellable;  /* (unowned) (nullable) */
+
+	/* In-progress data. */
+	GMutex mutex;
+	GCond cond;
+	guint n_pending_chunks;  /* (locked-by mutex) */
+
+	/* Output data. */
+	GError *error;  /* (owned) (nullable) (locked-by mutex) */
+} RefineParallelData;
+
+typedef struct {
+	RefineParallelData *parallel_data;  /* (unowned) */
+	GPtrArray *apps;  /* (owned) (element-type GsApp) */
+} RefineChunk;
+
+/* Run in @refine_pool. */
+static void
+refine_chunk_cb (gpointer data,
+                 gpointer user_data)
+{
+	RefineChunk *chunk = data;
+	RefineParallelData *parallel_data = chunk->parallel_data;
+	g_autoptr(GError) local_error = NULL;
+
+	for (guint i = 0; i < chunk->apps->len; i++) {
+		GsApp *app = g_ptr_array_index (chunk->apps, i);
+
+		/* Stop early if another chunk failed. This is racy, but
+		 * that’s OK as it’s only an optimisation. */
+		if (g_atomic_pointer_get (&parallel_data->error) != NULL)
+			break;
+
+		if (g_cancellable_set_error_if_cancelled (parallel_data->cancellable, &local_error) ||
+		    !refine_app (parallel_data->self, app, parallel_data->flags,
+				 parallel_data->apps_by_id, parallel_data->apps_by_origin_and_id,
+				 &local_error))
+			break;
+	}
+
+	g_mutex_lock (&parallel_data->mutex);
+	if (parallel_data->error == NULL && local_error != NULL)
+		g_atomic_pointer_set (&parallel_data->error, g_steal_pointer (&local_error));
+	parallel_data->n_pending_chunks--;
+	g_cond_signal (&parallel_data->cond);
+	g_mutex_unlock (&parallel_data->mutex);
+
+	g_ptr_array_unref (chunk->apps);
+	g_free (chunk);
+}
+
+/* Run in @worker. The caller must hold @silo_lock as a reader for the whole
+ * call, so the silo can’t be rebuilt or invalidated while @refine_pool is
+ * using it. The threads in @refine_pool rely on that lock and never take
+ * @silo_lock themselves: a writer, such as gs_plugin_appstream_reload() on
+ * the main thread, may be waiting for it, and GLib doesn’t say whether new
+ * readers block behind a waiting writer, so taking it again could deadlock.
+ *
+ * XbSilo queries are thread-safe, and the apps are independent of each other,
+ * so this is equivalent to calling refine_app() on each of them in turn. */
+static gboolean
+refine_apps_parallel (GsPluginAppstream    *self,
+                      GPtrArray            *apps,
+                      GsPluginRefineFlags   flags,
+                      GHashTable           *apps_by_id,
+                      GHashTable           *apps_by_origin_and_id,
+                      GCancellable         *cancellable,
+                      GError              **error)
+{
+	RefineParallelData parallel_data = {
+		.self = self,
+		.flags = flags,
+		.apps_by_id = apps_by_id,
+		.apps_by_origin_and_id = apps_by_origin_and_id,
+		.cancellable = cancellable,
+		.n_pending_chunks = 0,
+		.error = NULL,
+	};
+
+	assert_in_worker (self);
+
+	if (self->refine_pool == NULL) {
+		self->refine_pool = g_thread_pool_new (refine_chunk_cb, NULL,
+						       CLAMP (g_get_num_processors (), 1, REFINE_MAX_THREADS),
+						       FALSE, NULL);
+	}
+
+	g_mutex_init (&parallel_data.mutex);
+	g_cond_init (&parallel_data.cond);
+
+	g_mutex_lock (&parallel_data.mutex);
+
+	for (guint i = 0; i < apps->len; i += REFINE_CHUNK_SIZE) {
+		RefineChunk *chunk = g_new0 (RefineChunk, 1);
+		guint n_apps = MIN (REFINE_CHUNK_SIZE, apps->len - i);
+
+		chunk->parallel_data = &parallel_data;
+		chunk->apps = g_ptr_array_new_full (n_apps, g_object_unref);
+		for (guint j = i; j < i + n_apps; j++)
+			g_ptr_array_add (chunk->apps, g_object_ref (g_ptr_array_index (apps, j)));
+
+		parallel_data.n_pending_chunks++;
+		g_thread_pool_push (self->refine_pool, chunk, NULL);
+	}
+
+	while (parallel_data.n_pending_chunks > 0)
+		g_cond_wait (&parallel_data.cond, &parallel_data.mutex);
+
+	g_mutex_unlock (&parallel_data.mutex);
+
+	g_mutex_clear (&parallel_data.mutex);
+	g_cond_clear (&parallel_data.cond);
+
+	if (parallel_data.error != NULL) {
+		g_propagate_error (error, g_steal_pointer (&parallel_data.error));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 /* Run in @worker. */
 static void
 refine_thread_cb (GTask        *task,
@@ -1168,8 +1363,8 @@ refine_thread_cb (GTask        *task,
 	GsPluginRefineData *data = task_data;
 	GsAppList *list = data->list;
 	GsPluginRefineFlags flags = data->flags;
-	gboolean found = FALSE;
 	g_autoptr(GsAppList) app_list = NULL;
+	g_autoptr(GPtrArray) apps_to_refine = NULL;
 	g_autoptr(GHashTable) apps_by_id = NULL;
 	g_autoptr(GHashTable) apps_by_origin_and_id = NULL;
 	g_autoptr(GPtrArray) components = NULL;
@@ -1251,6 +1446,8 @@ refine_thread_cb (GTask        *task,
 		g_ptr_array_add (comps, g_object_ref (component_node));
 	}
 
+	apps_to_refine = g_ptr_array_new_with_free_func (g_object_unref);
+
 	for (guint i = 0; i < gs_app_list_length (list); i++) {
 		GsApp *app = gs_app_list_index (list, i);
 
@@ -1262,13 +1459,21 @@ refine_thread_cb (GTask        *task,
 		if (gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD))
 			continue;
 
-		/* find by ID then fall back to package name */
-		if (!gs_plugin_refine_from_id (self, app, flags, apps_by_id, apps_by_origin_and_id, &found, &local_error)) {
+		g_ptr_array_add (apps_to_refine, g_object_ref (app));
+	}
+
+	/* Short lists aren’t worth the overhead of refining in parallel. */
+	if (apps_to_refine->len > REFINE_CHUNK_SIZE) {
+		if (!refine_apps_parallel (self, apps_to_refine, flags, apps_by_id, apps_by_origin_and_id,
+					   cancellable, &local_error)) {
 			g_task_return_error (task, g_steal_pointer (&local_error));
 			return;
 		}
-		if (!found) {
-			if (!gs_plugin_refine_from_pkgname (self, app, flags, &local_error)) {
+	} else {
+		for (guint i = 0; i < apps_to_refine->len; i++) {
+			GsApp *app = g_ptr_array_index (apps_to_refine, i);
+
+			if (!refine_app (self, app, flags, apps_by_id, apps_by_origin_and_id, &local_error)) {
 				g_task_return_error (task, g_steal_pointer (&local_error));
 				return;
 			}
@@ -1305,7 +1510,8 @@ gs_plugin_appstream_refine_finish (GsPlugin      *plugin,
 	return g_task_propagate_boolean (G_TASK (result), error);
 }
 
-/* Run in @worker. Silo must be valid */
+/* Run in @worker. Silo must be valid, and the caller must hold @silo_lock as
+ * a reader. */
 static gboolean
 refine_wildcard (GsPluginAppstream    *self,
                  GsApp                *app,
@@ -1317,15 +1523,12 @@ refine_wildcard (GsPluginAppstream    *self,
 {
 	const gchar *id;
 	GPtrArray *components;
-	g_autoptr(GRWLockReaderLocker) locker = NULL;
 
 	/* not enough info to find */
 	id = gs_app_get_id (app);
 	if (id == NULL)
 		return TRUE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
-
 	components = g_hash_table_lookup (apps_by_id, id);
 	if (components == NULL)
 		return TRUE;
@@ -65,6 +65,85 @@ gs_plugins_core_search_repo_name_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpint (gs_app_get_kind (app), ==, AS_COMPONENT_KIND_DESKTOP_APP);
 }
 
+static GsAppList *
+list_apps_for_keyword (GsPluginLoader *plugin_loader,
+                       const gchar    *keyword)
+{
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+	g_autoptr(GsAppQuery) query = NULL;
+	g_autoptr(GError) error = NULL;
+	const gchar *keywords[2] = { keyword, NULL };
+
+	query = gs_app_query_new ("keywords", keywords,
+				  "refine-flags", GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON,
+				  "dedupe-flags", GS_PLUGIN_JOB_DEDUPE_FLAGS_DEFAULT,
+				  NULL);
+	plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+
+	list = gs_plugin_loader_job_process (plugin_loader, plugin_job, NULL, &error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert_nonnull (list);
+
+	return g_steal_pointer (&list);
+}
+
+static GsApp *
+find_app_in_list (GsAppList   *list,
+                  const gchar *id)
+{
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		if (g_strcmp0 (gs_app_get_id (app), id) == 0)
+			return app;
+	}
+
+	return NULL;
+}
+
+static void
+gs_plugins_core_shared_instance_func (GsPluginLoader *plugin_loader)
+{
+	GsAppIdentityMap *identity_map = gs_plugin_loader_get_app_identity_map (plugin_loader);
+	GsAppIdentityMapStats stats_before, stats_after;
+	g_autoptr(GsAppList) list1 = NULL;
+	g_autoptr(GsAppList) list2 = NULL;
+	GsApp *app1, *app2;
+
+	/* drop all caches */
+	gs_utils_rmtree (g_getenv ("GS_SELF_TEST_CACHEDIR"), NULL);
+	gs_test_reinitialise_plugin_loader (plugin_loader, allowlist, NULL);
+
+	/* two jobs with different queries whose results overlap; the first
+	 * list is kept alive while the second job runs, as when the same app
+	 * is shown on two pages */
+	list1 = list_apps_for_keyword (plugin_loader, "yellow");
+	app1 = find_app_in_list (list1, "arachne.desktop");
+	g_assert_nonnull (app1);
+
+	gs_app_identity_map_get_stats (identity_map, &stats_before);
+
+	list2 = list_apps_for_keyword (plugin_loader, "test");
+	app2 = find_app_in_list (list2, "arachne.desktop");
+	g_assert_nonnull (app2);
+
+	gs_app_identity_map_get_stats (identity_map, &stats_after);
+
+	/* both jobs return the same instance, and the second job didn’t
+	 * refine it again */
+	g_assert_true (app1 == app2);
+	g_assert_cmpuint (stats_after.n_refines_saved, ==, stats_before.n_refines_saved + 1);
+
+	/* after a reload, the app is refined again */
+	gs_app_identity_map_invalidate (identity_map);
+	g_clear_object (&list2);
+	list2 = list_apps_for_keyword (plugin_loader, "test");
+	g_assert_true (find_app_in_list (list2, "arachne.desktop") == app1);
+	gs_app_identity_map_get_stats (identity_map, &stats_before);
+	g_assert_cmpuint (stats_before.n_refines_saved, ==, stats_after.n_refines_saved);
+}
+
 static void
 gs_plugins_core_os_release_func (GsPluginLoader *plugin_loader)
 {
@@ -262,6 +341,9 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/core/search-repo-name",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_core_search_repo_name_func);
+	g_test_add_data_func ("/gnome-software/plugins/core/shared-instance",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_core_shared_instance_func);
 	g_test_add_data_func ("/gnome-software/plugins/core/os-release",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_core_os_release_func);
@@ -0,0 +1,148 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <locale.h>
+
+#include "gnome-software-private.h"
+
+/* Test program which can be used to check the performance of refining a large
+ * number of apps with the appstream plugin. It generates a silo with
+ * `n_apps` synthetic components (5000 by default), and then refines the
+ * matching #GsApps: once as a single list, which the appstream plugin refines
+ * in parallel, and once split into lists which are short enough to be refined
+ * sequentially. The difference between the two shows how refining scales
+ * across the available CPUs. */
+
+/* Must match REFINE_CHUNK_SIZE in gs-plugin-appstream.c */
+#define SEQUENTIAL_LIST_SIZE 200
+
+static gchar *
+generate_appstream_xml (guint n_apps)
+{
+	g_autoptr(GString) xml = g_string_new ("<?xml version=\"1.0\"?>\n"
+					       "<components origin=\"profile\" version=\"0.9\">\n");
+
+	for (guint i = 0; i < n_apps; i++) {
+		g_string_append_printf (xml,
+					"  <component type=\"desktop\">\n"
+					"    <id>org.example.App%u</id>\n"
+					"    <name>App %u</name>\n"
+					"    <summary>Synthetic app number %u</summary>\n"
+					"    <description><p>This is app %u, which does nothing.</p></description>\n"
+					"    <project_license>GPL-2.0-or-later</project_license>\n"
+					"    <url type=\"homepage\">https://example.org/app%u</url>\n"
+					"    <icon type=\"stock\">system-file-manager</icon>\n"
+					"    <categories><category>Utility</category></categories>\n"
+					"    <keywords><keyword>synthetic</keyword><keyword>app%u</keyword></keywords>\n"
+					"    <pkgname>app%u</pkgname>\n"
+					"    <releases><release version=\"1.%u\" timestamp=\"1700000000\"/></releases>\n"
+					"  </component>\n",
+					i, i, i, i, i, i, i, i);
+	}
+
+	g_string_append (xml, "</components>\n");
+
+	return g_string_free (g_steal_pointer (&xml), FALSE);
+}
+
+static GsAppList *
+create_app_list (guint first,
+                 guint n_apps)
+{
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+
+	for (guint i = first; i < first + n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		g_autoptr(GsApp) app = gs_app_new (id);
+		gs_app_list_add (list, app);
+	}
+
+	return g_steal_pointer (&list);
+}
+
+static gint64
+refine_lists (GsPluginLoader *plugin_loader,
+              guint           n_apps,
+              guint           list_size)
+{
+	GsPluginRefineFlags flags = GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE |
+				    GS_PLUGIN_REFINE_FLAGS_REQUIRE_URL |
+				    GS_PLUGIN_REFINE_FLAGS_REQUIRE_DESCRIPTION |
+				    GS_PLUGIN_REFINE_FLAGS_REQUIRE_VERSION |
+				    GS_PLUGIN_REFINE_FLAGS_REQUIRE_CATEGORIES |
+				    GS_PLUGIN_REFINE_FLAGS_DISABLE_FILTERING;
+	gint64 begin_time = g_get_monotonic_time ();
+
+	for (guint i = 0; i < n_apps; i += list_size) {
+		g_autoptr(GsAppList) list = create_app_list (i, MIN (list_size, n_apps - i));
+		g_autoptr(GsPluginJob) plugin_job = gs_plugin_job_refine_new (list, flags);
+		g_autoptr(GError) local_error = NULL;
+
+		if (!gs_plugin_loader_job_action (plugin_loader, plugin_job, NULL, &local_error))
+			g_error ("Failed to refine apps: %s", local_error->message);
+	}
+
+	return g_get_monotonic_time () - begin_time;
+}
+
+int
+main (int argc, char **argv)
+{
+	const gchar * const allowlist[] = { "appstream", NULL };
+	guint n_apps = 5000;
+	g_autofree gchar *tmp_root = NULL;
+	g_autofree gchar *xml = NULL;
+	g_autoptr(GsPluginLoader) plugin_loader = NULL;
+	g_autoptr(GSettings) settings = NULL;
+	g_autoptr(GError) local_error = NULL;
+	gint64 parallel_usecs, sequential_usecs;
+
+	setlocale (LC_ALL, "");
+
+	if (argc > 1)
+		n_apps = g_ascii_strtoull (argv[1], NULL, 10);
+	if (n_apps == 0) {
+		g_printerr ("Usage: %s [N-APPS]\n", argv[0]);
+		return 1;
+	}
+
+	g_setenv ("GSETTINGS_BACKEND", "memory", TRUE);
+	settings = g_settings_new ("org.gnome.software");
+	g_settings_set_string (settings, "review-server", "");
+
+	tmp_root = g_dir_make_tmp ("gnome-software-profile-appstream-XXXXXX", &local_error);
+	g_assert_no_error (local_error);
+	g_setenv ("GS_SELF_TEST_CACHEDIR", tmp_root, TRUE);
+
+	xml = generate_appstream_xml (n_apps);
+	g_setenv ("GS_SELF_TEST_APPSTREAM_XML", xml, TRUE);
+
+	plugin_loader = gs_plugin_loader_new (NULL, NULL);
+	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR);
+	if (!gs_plugin_loader_setup (plugin_loader, allowlist, NULL, NULL, &local_error))
+		g_error ("Failed to set up plugin loader: %s", local_error->message);
+
+	/* Warm up the silo so it isn’t included in the timings */
+	refine_lists (plugin_loader, 1, 1);
+
+	parallel_usecs = refine_lists (plugin_loader, n_apps, n_apps);
+	sequential_usecs = refine_lists (plugin_loader, n_apps, SEQUENTIAL_LIST_SIZE);
+
+	g_print ("Refining %u apps on %u CPUs:\n", n_apps, g_get_num_processors ());
+	g_print (" - in one list (parallel): %" G_GINT64_FORMAT "ms, %.1fμs per app\n",
+		 parallel_usecs / 1000, (gdouble) parallel_usecs / n_apps);
+	g_print (" - in lists of %u (sequential): %" G_GINT64_FORMAT "ms, %.1fμs per app\n",
+		 (guint) SEQUENTIAL_LIST_SIZE, sequential_usecs / 1000, (gdouble) sequential_usecs / n_apps);
+
+	gs_utils_rmtree (tmp_root, NULL);
+
+	return 0;
+}
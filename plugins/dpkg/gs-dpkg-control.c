@@ -0,0 +1,520 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Reads the control file of a binary package without running dpkg-deb.
+ *
+ * A .deb is an ar archive holding a `debian-binary` version file, then a
+ * `control.tar` member, then a `data.tar` member, each of the tarballs
+ * optionally compressed. See deb(5). Uncompressed and gzip-compressed control
+ * tarballs can always be read here, and xz- and zstd-compressed ones if
+ * liblzma and libzstd were available at build time. G_IO_ERROR_NOT_SUPPORTED
+ * is returned for the others, so the caller can fall back to dpkg-deb.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "gs-dpkg-control.h"
+
+#define AR_MAGIC "!<arch>\n"
+#define AR_HEADER_SIZE 60
+#define TAR_BLOCK_SIZE 512
+
+/* the control tarball only contains the package metadata and maintainer
+ * scripts, so anything bigger than this is not a real package */
+#define MAX_CONTROL_SIZE (16 * 1024 * 1024)
+
+/**
+ * gs_dpkg_control_parse:
+ * @text: contents of a control file
+ * @text_len: length of @text, in bytes
+ * @error: return location for a #GError
+ *
+ * Parse the fields of the first paragraph of a control file, as described in
+ * deb-control(5). Continuation lines are kept with their leading whitespace,
+ * separated from the first line of the field by a newline, so the
+ * `Description` field looks the same as it does in the output of
+ * `dpkg-deb --field`.
+ *
+ * Returns: (transfer full) (element-type utf8 utf8): the fields, keyed by
+ *   name
+ */
+GHashTable *
+gs_dpkg_control_parse (const gchar  *text,
+                       gsize         text_len,
+                       GError      **error)
+{
+	g_autoptr(GHashTable) fields = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_autofree gchar *key = NULL;
+	g_autoptr(GString) value = NULL;
+	g_auto(GStrv) lines = NULL;
+	g_autofree gchar *text_nul = g_strndup (text, text_len);
+
+	if (!g_utf8_validate (text_nul, -1, NULL)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Control file is not valid UTF-8");
+		return NULL;
+	}
+
+	lines = g_strsplit (text_nul, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		const gchar *line = lines[i];
+		const gchar *colon;
+
+		/* the end of the paragraph */
+		if (*line == '\0')
+			break;
+		if (*line == '#')
+			continue;
+
+		if (*line == ' ' || *line == '\t') {
+			if (value == NULL) {
+				g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Control file line %u continues no field", i + 1);
+				return NULL;
+			}
+			g_string_append_printf (value, "\n%s", line);
+			continue;
+		}
+
+		colon = strchr (line, ':');
+		if (colon == NULL || colon == line) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Control file line %u is not a field", i + 1);
+			return NULL;
+		}
+
+		if (key != NULL)
+			g_hash_table_replace (fields, g_steal_pointer (&key), g_string_free (g_steal_pointer (&value), FALSE));
+
+		key = g_strndup (line, colon - line);
+		value = g_string_new (colon + 1);
+		g_strstrip (key);
+		g_strstrip (value->str);
+		g_string_set_size (value, strlen (value->str));
+	}
+
+	if (key != NULL)
+		g_hash_table_replace (fields, g_steal_pointer (&key), g_string_free (g_steal_pointer (&value), FALSE));
+
+	return g_steal_pointer (&fields);
+}
+
+static gboolean
+read_exactly (GInputStream  *stream,
+              gpointer       buffer,
+              gsize          count,
+              GCancellable  *cancellable,
+              GError       **error)
+{
+	gsize bytes_read = 0;
+
+	if (!g_input_stream_read_all (stream, buffer, count, &bytes_read, cancellable, error))
+		return FALSE;
+	if (bytes_read != count) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package is truncated");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+skip_exactly (GInputStream  *stream,
+              gsize          count,
+              GCancellable  *cancellable,
+              GError       **error)
+{
+	while (count > 0) {
+		gssize skipped = g_input_stream_skip (stream, count, cancellable, error);
+		if (skipped < 0)
+			return FALSE;
+		if (skipped == 0) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Package is truncated");
+			return FALSE;
+		}
+		count -= skipped;
+	}
+
+	return TRUE;
+}
+
+/* Read the next ar member header, returning its name and size. */
+static gboolean
+read_ar_header (GInputStream  *stream,
+                gchar        **out_name,
+                gsize         *out_size,
+                GCancellable  *cancellable,
+                GError       **error)
+{
+	gchar header[AR_HEADER_SIZE];
+	g_autofree gchar *name = NULL;
+	g_autofree gchar *size_str = NULL;
+	guint64 size;
+
+	if (!read_exactly (stream, header, sizeof (header), cancellable, error))
+		return FALSE;
+	if (header[58] != '`' || header[59] != '\n') {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package has an invalid archive member header");
+		return FALSE;
+	}
+
+	/* GNU ar terminates names with a slash */
+	name = g_strndup (header, 16);
+	g_strchomp (name);
+	if (g_str_has_suffix (name, "/"))
+		name[strlen (name) - 1] = '\0';
+
+	size_str = g_strndup (header + 48, 10);
+	g_strstrip (size_str);
+	if (!g_ascii_string_to_unsigned (size_str, 10, 0, G_MAXSIZE, &size, NULL)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "Package member ‘%s’ has an invalid size", name);
+		return FALSE;
+	}
+
+	*out_name = g_steal_pointer (&name);
+	*out_size = size;
+
+	return TRUE;
+}
+
+static GBytes *
+decompress (GBytes        *compressed,
+            GConverter    *converter,
+            GCancellable  *cancellable,
+            GError       **error)
+{
+	g_autoptr(GInputStream) memory_stream = g_memory_input_stream_new_from_bytes (compressed);
+	g_autoptr(GInputStream) stream = g_converter_input_stream_new (memory_stream, converter);
+	g_autoptr(GByteArray) buffer = g_byte_array_new ();
+
+	while (TRUE) {
+		guint8 chunk[8192];
+		gssize n_read = g_input_stream_read (stream, chunk, sizeof (chunk), cancellable, error);
+
+		if (n_read < 0)
+			return NULL;
+		if (n_read == 0)
+			break;
+		if (buffer->len + n_read > MAX_CONTROL_SIZE) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Package control data is too big");
+			return NULL;
+		}
+		g_byte_array_append (buffer, chunk, n_read);
+	}
+
+	return g_byte_array_free_to_bytes (g_steal_pointer (&buffer));
+}
+
+#ifdef HAVE_LZMA
+static GBytes *
+decompress_xz (GBytes  *compressed,
+               GError **error)
+{
+	lzma_stream stream = LZMA_STREAM_INIT;
+	g_autoptr(GByteArray) buffer = g_byte_array_new ();
+	gsize compressed_len;
+	const guint8 *compressed_data = g_bytes_get_data (compressed, &compressed_len);
+	lzma_ret ret;
+
+	ret = lzma_stream_decoder (&stream, UINT64_MAX, 0);
+	if (ret != LZMA_OK) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     "Failed to set up xz decoder (error %u)", (guint) ret);
+		return NULL;
+	}
+
+	stream.next_in = compressed_data;
+	stream.avail_in = compressed_len;
+
+	do {
+		guint8 chunk[8192];
+
+		stream.next_out = chunk;
+		stream.avail_out = sizeof (chunk);
+
+		/* a truncated stream gives LZMA_BUF_ERROR rather than looping */
+		ret = lzma_code (&stream, LZMA_FINISH);
+		if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+			lzma_end (&stream);
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package control data is not valid xz (error %u)", (guint) ret);
+			return NULL;
+		}
+
+		g_byte_array_append (buffer, chunk, sizeof (chunk) - stream.avail_out);
+		if (buffer->len > MAX_CONTROL_SIZE) {
+			lzma_end (&stream);
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Package control data is too big");
+			return NULL;
+		}
+	} while (ret != LZMA_STREAM_END);
+
+	lzma_end (&stream);
+
+	return g_byte_array_free_to_bytes (g_steal_pointer (&buffer));
+}
+#endif  /* HAVE_LZMA */
+
+#ifdef HAVE_ZSTD
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ZSTD_DCtx, ZSTD_freeDCtx)
+
+static GBytes *
+decompress_zstd (GBytes  *compressed,
+                 GError **error)
+{
+	g_autoptr(ZSTD_DCtx) dctx = ZSTD_createDCtx ();
+	g_autoptr(GByteArray) buffer = g_byte_array_new ();
+	gsize compressed_len;
+	const guint8 *compressed_data = g_bytes_get_data (compressed, &compressed_len);
+	ZSTD_inBuffer input = { compressed_data, compressed_len, 0 };
+	gsize ret;
+
+	if (dctx == NULL) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "Failed to set up zstd decoder");
+		return NULL;
+	}
+
+	/* ret is zero once a whole frame has been decoded */
+	do {
+		guint8 chunk[8192];
+		ZSTD_outBuffer output = { chunk, sizeof (chunk), 0 };
+
+		ret = ZSTD_decompressStream (dctx, &output, &input);
+		if (ZSTD_isError (ret)) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package control data is not valid zstd: %s",
+				     ZSTD_getErrorName (ret));
+			return NULL;
+		}
+
+		g_byte_array_append (buffer, chunk, output.pos);
+		if (buffer->len > MAX_CONTROL_SIZE) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Package control data is too big");
+			return NULL;
+		}
+
+		/* all the input was used and the output wasn’t filled, but
+		 * the frame isn’t finished */
+		if (ret != 0 && input.pos == input.size && output.pos < output.size) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "Package control data is truncated");
+			return NULL;
+		}
+	} while (ret != 0);
+
+	return g_byte_array_free_to_bytes (g_steal_pointer (&buffer));
+}
+#endif  /* HAVE_ZSTD */
+
+static gboolean
+parse_tar_size (const gchar *field,
+                gsize        field_len,
+                gsize       *out_size)
+{
+	g_autofree gchar *str = g_strndup (field, field_len);
+	guint64 size;
+
+	g_strstrip (str);
+	if (!g_ascii_string_to_unsigned (str, 8, 0, G_MAXSIZE, &size, NULL))
+		return FALSE;
+
+	*out_size = size;
+	return TRUE;
+}
+
+/* Find the ./control file in an uncompressed tarball. */
+static gchar *
+find_control_in_tar (GBytes  *tar,
+                     gsize   *out_len,
+                     GError **error)
+{
+	gsize tar_len;
+	const gchar *data = g_bytes_get_data (tar, &tar_len);
+	gsize offset = 0;
+
+	while (offset + TAR_BLOCK_SIZE <= tar_len) {
+		const gchar *header = data + offset;
+		g_autofree gchar *name = NULL;
+		gsize size;
+		gchar typeflag = header[156];
+
+		/* an all-zero block marks the end of the archive */
+		if (header[0] == '\0')
+			break;
+
+		name = g_strndup (header, 100);
+		if (!parse_tar_size (header + 124, 12, &size) ||
+		    size > tar_len - offset - TAR_BLOCK_SIZE) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package control data has an invalid size for ‘%s’", name);
+			return NULL;
+		}
+
+		offset += TAR_BLOCK_SIZE;
+
+		if ((typeflag == '0' || typeflag == '\0') &&
+		    (g_str_equal (name, "./control") || g_str_equal (name, "control"))) {
+			*out_len = size;
+			return g_memdup2 (data + offset, size);
+		}
+
+		offset += (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+	}
+
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "Package has no control file");
+	return NULL;
+}
+
+/* @compression is the suffix of the control member name after
+ * `control.tar`, such as `.gz` */
+static gboolean
+compression_is_supported (const gchar *compression)
+{
+	if (*compression == '\0' || g_str_equal (compression, ".gz"))
+		return TRUE;
+#ifdef HAVE_LZMA
+	if (g_str_equal (compression, ".xz"))
+		return TRUE;
+#endif
+#ifdef HAVE_ZSTD
+	if (g_str_equal (compression, ".zst"))
+		return TRUE;
+#endif
+
+	return FALSE;
+}
+
+/**
+ * gs_dpkg_control_read_deb:
+ * @file: a binary package
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError
+ *
+ * Read and parse the control file from @file, which should be a .deb. This
+ * does blocking I/O, so should be called from a worker thread.
+ *
+ * If the control data in @file is compressed in a format which can’t be read
+ * here, %G_IO_ERROR_NOT_SUPPORTED is returned.
+ *
+ * Returns: (transfer full) (element-type utf8 utf8): the control fields, as
+ *   from gs_dpkg_control_parse()
+ */
+GHashTable *
+gs_dpkg_control_read_deb (GFile         *file,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+	g_autoptr(GFileInputStream) file_stream = NULL;
+	GInputStream *stream;
+	gchar magic[sizeof (AR_MAGIC) - 1];
+	g_autofree gchar *name = NULL;
+	gsize size;
+	g_autofree guint8 *member = NULL;
+	g_autoptr(GBytes) member_bytes = NULL;
+	g_autoptr(GBytes) tar = NULL;
+	g_autofree gchar *control = NULL;
+	gsize control_len = 0;
+	const gchar *compression;
+
+	file_stream = g_file_read (file, cancellable, error);
+	if (file_stream == NULL)
+		return NULL;
+	stream = G_INPUT_STREAM (file_stream);
+
+	if (!read_exactly (stream, magic, sizeof (magic), cancellable, error))
+		return NULL;
+	if (memcmp (magic, AR_MAGIC, sizeof (magic)) != 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package is not an ar archive");
+		return NULL;
+	}
+
+	/* debian-binary comes first; its contents are the format version */
+	if (!read_ar_header (stream, &name, &size, cancellable, error))
+		return NULL;
+	if (!g_str_equal (name, "debian-binary")) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "Package starts with ‘%s’ rather than debian-binary", name);
+		return NULL;
+	}
+	if (!skip_exactly (stream, size + (size % 2), cancellable, error))
+		return NULL;
+
+	/* then the control tarball */
+	g_clear_pointer (&name, g_free);
+	if (!read_ar_header (stream, &name, &size, cancellable, error))
+		return NULL;
+	if (!g_str_has_prefix (name, "control.tar")) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "Package has ‘%s’ rather than control data", name);
+		return NULL;
+	}
+
+	compression = name + strlen ("control.tar");
+	if (!compression_is_supported (compression)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     "Package control data compression ‘%s’ is not supported", compression);
+		return NULL;
+	}
+	if (size > MAX_CONTROL_SIZE) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "Package control data is too big");
+		return NULL;
+	}
+
+	member = g_malloc (size);
+	if (!read_exactly (stream, member, size, cancellable, error))
+		return NULL;
+	member_bytes = g_bytes_new_take (g_steal_pointer (&member), size);
+
+	if (*compression == '\0') {
+		tar = g_bytes_ref (member_bytes);
+	} else if (g_str_equal (compression, ".gz")) {
+		g_autoptr(GZlibDecompressor) decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+
+		tar = decompress (member_bytes, G_CONVERTER (decompressor), cancellable, error);
+#ifdef HAVE_LZMA
+	} else if (g_str_equal (compression, ".xz")) {
+		tar = decompress_xz (member_bytes, error);
+#endif
+#ifdef HAVE_ZSTD
+	} else if (g_str_equal (compression, ".zst")) {
+		tar = decompress_zstd (member_bytes, error);
+#endif
+	} else {
+		g_assert_not_reached ();
+	}
+
+	if (tar == NULL)
+		return NULL;
+
+	control = find_control_in_tar (tar, &control_len, error);
+	if (control == NULL)
+		return NULL;
+
+	return gs_dpkg_control_parse (control, control_len, error);
+}
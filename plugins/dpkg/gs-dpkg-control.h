@@ -0,0 +1,22 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+GHashTable	*gs_dpkg_control_parse		(const gchar	*text,
+						 gsize		 text_len,
+						 GError		**error);
+GHashTable	*gs_dpkg_control_read_deb	(GFile		*file,
+						 GCancellable	*cancellable,
+						 GError		**error);
+
+G_END_DECLS
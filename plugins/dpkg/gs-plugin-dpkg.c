@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <gnome-software.h>
 
+#include "gs-dpkg-control.h"
 #include "gs-plugin-dpkg.h"
 
 struct _GsPluginDpkg
@@ -37,9 +38,10 @@ gs_plugin_dpkg_init (GsPluginDpkg *self)
 static void get_content_type_cb (GObject      *source_object,
                                  GAsyncResult *result,
                                  gpointer      user_data);
-static void subprocess_communicate_cb (GObject      *source_object,
-                                       GAsyncResult *result,
-                                       gpointer      user_data);
+static void file_to_app_thread_cb (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable);
 
 static void
 gs_plugin_dpkg_file_to_app_async (GsPlugin *plugin,
@@ -65,9 +67,7 @@ get_content_type_cb (GObject      *source_object,
 {
 	GFile *file = G_FILE (source_object);
 	g_autoptr(GTask) task = G_TASK (g_steal_pointer (&user_data));
-	GCancellable *cancellable = g_task_get_cancellable (task);
 	g_autoptr(GError) local_error = NULL;
-	g_autoptr(GSubprocess) subprocess = NULL;
 	g_autofree gchar *content_type = NULL;
 	const gchar *mimetypes[] = {
 		"application/vnd.debian.binary-package",
@@ -82,96 +82,162 @@ get_content_type_cb (GObject      *source_object,
 		return;
 	}
 
-	/* exec sync */
+	g_task_run_in_thread (task, file_to_app_thread_cb);
+}
+
+/* Get the raw control file from dpkg-deb, for packages whose control data
+ * is compressed in a way gs_dpkg_control_read_deb() can’t handle. */
+static GHashTable *
+read_control_with_dpkg_deb (GFile         *file,
+                            GCancellable  *cancellable,
+                            GError       **error)
+{
+	g_autoptr(GSubprocess) subprocess = NULL;
+	g_autoptr(GBytes) stdout_buf = NULL;
+	const gchar *output;
+	gsize output_len;
+
 	subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
 				       G_SUBPROCESS_FLAGS_STDERR_SILENCE,
-				       &local_error,
+				       error,
 				       DPKG_DEB_BINARY,
-				       "--showformat=${Package}\\n"
-				       "${Version}\\n"
-				       "${License}\\n"
-				       "${Installed-Size}\\n"
-				       "${Homepage}\\n"
-				       "${Description}",
-				       "-W",
+				       "--field",
 				       g_file_peek_path (file),
 				       NULL);
+	if (subprocess == NULL)
+		return NULL;
 
-	if (subprocess == NULL) {
-		gs_utils_error_convert_gio (&local_error);
-		g_task_return_error (task, g_steal_pointer (&local_error));
-		return;
-	}
+	if (!g_subprocess_communicate (subprocess, NULL, cancellable, &stdout_buf, NULL, error) ||
+	    !g_subprocess_wait_check (subprocess, cancellable, error))
+		return NULL;
 
-	g_subprocess_communicate_async (subprocess, NULL, cancellable,
-					subprocess_communicate_cb, g_steal_pointer (&task));
+	output = g_bytes_get_data (stdout_buf, &output_len);
+	return gs_dpkg_control_parse (output, output_len, error);
 }
 
-static void
-subprocess_communicate_cb (GObject      *source_object,
-                           GAsyncResult *result,
-                           gpointer      user_data)
+static const gchar *
+get_field (GHashTable  *fields,
+           const gchar *key)
 {
-	GSubprocess *subprocess = G_SUBPROCESS (source_object);
-	g_autoptr(GTask) task = G_TASK (g_steal_pointer (&user_data));
-	GsPluginFileToAppData *data = g_task_get_task_data (task);
-	GsPluginDpkg *self = g_task_get_source_object (task);
-	g_autoptr(GsAppList) list = gs_app_list_new ();
-	g_autoptr(GError) local_error = NULL;
-	g_autoptr(GBytes) stdout_buf = NULL;
-	const char *output;
-	g_auto(GStrv) tokens = NULL;
-	g_autoptr(GsApp) app = NULL;
-	g_autoptr(GString) str = NULL;
+	const gchar *value = g_hash_table_lookup (fields, key);
+	return (value != NULL && *value != '\0') ? value : NULL;
+}
 
-	if (!g_subprocess_communicate_finish (subprocess, result, &stdout_buf, NULL, &local_error)) {
-		gs_utils_error_convert_gio (&local_error);
-		g_task_return_error (task, g_steal_pointer (&local_error));
-		return;
-	}
+static GsApp *
+app_new_from_control (GsPlugin    *plugin,
+                      GFile       *file,
+                      GHashTable  *fields,
+                      GError     **error)
+{
+	const gchar *package;
+	const gchar *value;
+	g_autoptr(GsApp) app = NULL;
 
-	/* parse output; assume it doesn’t contain any nul bytes */
-	output = g_bytes_get_data (stdout_buf, NULL);
-	tokens = g_strsplit (output, "\n", 0);
-	if (g_strv_length (tokens) < 6) {
-		g_task_return_new_error (task,
-					 GS_PLUGIN_ERROR,
-					 GS_PLUGIN_ERROR_NOT_SUPPORTED,
-					 "dpkg-deb output format incorrect:\n“%s”", output);
-		return;
+	package = get_field (fields, "Package");
+	if (package == NULL) {
+		g_set_error_literal (error,
+				     GS_PLUGIN_ERROR,
+				     GS_PLUGIN_ERROR_NOT_SUPPORTED,
+				     "package control file has no Package field");
+		return NULL;
 	}
 
 	/* create app */
 	app = gs_app_new (NULL);
 	gs_app_set_state (app, GS_APP_STATE_AVAILABLE_LOCAL);
-	gs_app_add_source (app, tokens[0]);
-	gs_app_set_name (app, GS_APP_QUALITY_LOWEST, tokens[0]);
-	gs_app_set_version (app, tokens[1]);
-	gs_app_set_license (app, GS_APP_QUALITY_LOWEST, tokens[2]);
-	gs_app_set_size_installed (app, GS_SIZE_TYPE_VALID, 1024 * g_ascii_strtoull (tokens[3], NULL, 10));
-	gs_app_set_url (app, AS_URL_KIND_HOMEPAGE, tokens[4]);
-	gs_app_set_summary (app, GS_APP_QUALITY_LOWEST, tokens[5]);
+	gs_app_add_source (app, package);
+	gs_app_set_name (app, GS_APP_QUALITY_LOWEST, package);
 	gs_app_set_kind (app, AS_COMPONENT_KIND_GENERIC);
 	gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_PACKAGE);
-	gs_app_set_local_file (app, data->file);
+	gs_app_set_local_file (app, file);
 	gs_app_set_metadata (app, "GnomeSoftware::Creator",
-			     gs_plugin_get_name (GS_PLUGIN (self)));
-
-	/* multiline text */
-	str = g_string_new ("");
-	for (guint i = 6; tokens[i] != NULL; i++) {
-		if (g_strcmp0 (tokens[i], " .") == 0) {
-			if (str->len > 0)
-				g_string_truncate (str, str->len - 1);
-			g_string_append (str, "\n");
-			continue;
+			     gs_plugin_get_name (plugin));
+
+	value = get_field (fields, "Version");
+	if (value != NULL)
+		gs_app_set_version (app, value);
+	value = get_field (fields, "License");
+	if (value != NULL)
+		gs_app_set_license (app, GS_APP_QUALITY_LOWEST, value);
+	value = get_field (fields, "Installed-Size");
+	if (value != NULL)
+		gs_app_set_size_installed (app, GS_SIZE_TYPE_VALID, 1024 * g_ascii_strtoull (value, NULL, 10));
+	value = get_field (fields, "Homepage");
+	if (value != NULL)
+		gs_app_set_url (app, AS_URL_KIND_HOMEPAGE, value);
+
+	/* the first line of the description is the synopsis, and the rest is
+	 * multiline text, with paragraphs separated by “ .” lines */
+	value = get_field (fields, "Description");
+	if (value != NULL) {
+		g_auto(GStrv) lines = g_strsplit (value, "\n", -1);
+		g_autoptr(GString) str = g_string_new ("");
+
+		gs_app_set_summary (app, GS_APP_QUALITY_LOWEST, lines[0]);
+
+		for (guint i = 1; lines[i] != NULL; i++) {
+			if (g_strcmp0 (lines[i], " .") == 0) {
+				if (str->len > 0)
+					g_string_truncate (str, str->len - 1);
+				g_string_append (str, "\n");
+				continue;
+			}
+			g_strstrip (lines[i]);
+			g_string_append_printf (str, "%s ", lines[i]);
 		}
-		g_strstrip (tokens[i]);
-		g_string_append_printf (str, "%s ", tokens[i]);
+		if (str->len > 0)
+			g_string_truncate (str, str->len - 1);
+		gs_app_set_description (app, GS_APP_QUALITY_LOWEST, str->str);
+	}
+
+	return g_steal_pointer (&app);
+}
+
+static void
+file_to_app_thread_cb (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+	GsPlugin *plugin = GS_PLUGIN (source_object);
+	GsPluginFileToAppData *data = task_data;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GHashTable) fields = NULL;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	/* read the control file directly, only falling back to spawning
+	 * dpkg-deb for compression formats which can’t be read in-process */
+	fields = gs_dpkg_control_read_deb (data->file, cancellable, &local_error);
+	if (fields == NULL &&
+	    g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+		g_debug ("falling back to %s: %s", DPKG_DEB_BINARY, local_error->message);
+		g_clear_error (&local_error);
+		fields = read_control_with_dpkg_deb (data->file, cancellable, &local_error);
+	}
+
+	if (fields == NULL) {
+		/* a corrupt package, or dpkg-deb failing to read it */
+		if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA) ||
+		    local_error->domain == G_SPAWN_EXIT_ERROR) {
+			g_task_return_new_error (task,
+						 GS_PLUGIN_ERROR,
+						 GS_PLUGIN_ERROR_NOT_SUPPORTED,
+						 "failed to read package control file: %s",
+						 local_error->message);
+			return;
+		}
+
+		gs_utils_error_convert_gio (&local_error);
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
+	}
+
+	app = app_new_from_control (plugin, data->file, fields, &local_error);
+	if (app == NULL) {
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
 	}
-	if (str->len > 0)
-		g_string_truncate (str, str->len - 1);
-	gs_app_set_description (app, GS_APP_QUALITY_LOWEST, str->str);
 
 	/* success */
 	gs_app_list_add (list, app);
@@ -8,10 +8,199 @@
 
 #include "config.h"
 
+#include <string.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "gnome-software-private.h"
 
+#include "gs-dpkg-control.h"
 #include "gs-test.h"
 
+/* Append an ar member to @deb, in the format used by dpkg. */
+static void
+append_ar_member (GString     *deb,
+                  const gchar *name,
+                  const gchar *data,
+                  gsize        data_len)
+{
+	g_string_append_printf (deb, "%-16s%-12s%-6s%-6s%-8s%-10" G_GSIZE_FORMAT "`\n",
+				name, "0", "0", "0", "100644", data_len);
+	g_string_append_len (deb, data, data_len);
+	if (data_len % 2 != 0)
+		g_string_append_c (deb, '\n');
+}
+
+/* Compress @data as the suffix @compression of a control member name says,
+ * leaving it uncompressed for formats which the test can’t produce. */
+static GBytes *
+compress_control_tar (const gchar *compression,
+                      GByteArray  *data)
+{
+#ifdef HAVE_LZMA
+	if (g_str_equal (compression, ".xz")) {
+		gsize out_size = lzma_stream_buffer_bound (data->len);
+		g_autofree guint8 *out = g_malloc (out_size);
+		gsize out_pos = 0;
+
+		g_assert_cmpint (lzma_easy_buffer_encode (6, LZMA_CHECK_CRC64, NULL,
+							  data->data, data->len,
+							  out, &out_pos, out_size), ==, LZMA_OK);
+		return g_bytes_new (out, out_pos);
+	}
+#endif
+#ifdef HAVE_ZSTD
+	if (g_str_equal (compression, ".zst")) {
+		gsize out_size = ZSTD_compressBound (data->len);
+		g_autofree guint8 *out = g_malloc (out_size);
+		gsize out_len;
+
+		out_len = ZSTD_compress (out, out_size, data->data, data->len, 3);
+		g_assert_false (ZSTD_isError (out_len));
+		return g_bytes_new (out, out_len);
+	}
+#endif
+
+	return g_bytes_new (data->data, data->len);
+}
+
+/* Build a minimal .deb in a temporary file, whose control member is a tarball
+ * containing @control, named `control.tar` with the suffix @compression. The
+ * caller must delete the file. */
+static GFile *
+build_deb (const gchar *compression,
+           const gchar *control)
+{
+	g_autoptr(GString) deb = g_string_new ("!<arch>\n");
+	g_autoptr(GByteArray) tar = g_byte_array_new ();
+	g_autoptr(GBytes) member = NULL;
+	g_autofree gchar *member_name = g_strconcat ("control.tar", compression, NULL);
+	gchar header[512] = { 0, };
+	gsize control_len = strlen (control);
+	g_autofree gchar *path = NULL;
+	g_autoptr(GError) error = NULL;
+	gint fd;
+
+	strcpy (header, "./control");
+	g_snprintf (header + 124, 12, "%011" G_GSIZE_MODIFIER "o", control_len);
+	header[156] = '0';
+	g_byte_array_append (tar, (const guint8 *) header, sizeof (header));
+	g_byte_array_append (tar, (const guint8 *) control, control_len);
+	g_byte_array_set_size (tar, (tar->len + 511) / 512 * 512 + 1024);
+	memset (tar->data + sizeof (header) + control_len, 0, tar->len - sizeof (header) - control_len);
+	member = compress_control_tar (compression, tar);
+
+	append_ar_member (deb, "debian-binary", "2.0\n", 4);
+	append_ar_member (deb, member_name, g_bytes_get_data (member, NULL), g_bytes_get_size (member));
+
+	fd = g_file_open_tmp ("gs-self-test-dpkg-XXXXXX.deb", &path, &error);
+	g_assert_no_error (error);
+	g_close (fd, NULL);
+	g_file_set_contents (path, deb->str, deb->len, &error);
+	g_assert_no_error (error);
+
+	return g_file_new_for_path (path);
+}
+
+/* Read the control fields from a .deb built by build_deb(), deleting it. */
+static GHashTable *
+read_built_deb (const gchar  *compression,
+                const gchar  *control,
+                GError      **error)
+{
+	g_autoptr(GFile) file = build_deb (compression, control);
+	g_autoptr(GHashTable) fields = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	fields = gs_dpkg_control_read_deb (file, NULL, error);
+
+	g_file_delete (file, NULL, &local_error);
+	g_assert_no_error (local_error);
+
+	return g_steal_pointer (&fields);
+}
+
+static void
+gs_plugins_dpkg_control_func (void)
+{
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GHashTable) fields = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* control.tar.gz, as built by dpkg-deb */
+	fn = gs_test_get_filename (TESTDATADIR, "chiron-1.1-1.deb");
+	g_assert (fn != NULL);
+	file = g_file_new_for_path (fn);
+	fields = gs_dpkg_control_read_deb (file, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (fields);
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Package"), ==, "chiron");
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Version"), ==, "1.1-1");
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Homepage"), ==, "http://127.0.0.1/");
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Description"), ==,
+			 "Single line synopsis\n"
+			 " This is the first\n"
+			 " paragraph in the example package\n"
+			 " control file.\n"
+			 " .\n"
+			 " This is the second paragraph.");
+	g_assert_null (g_hash_table_lookup (fields, "License"));
+	g_clear_pointer (&fields, g_hash_table_unref);
+	g_clear_object (&file);
+
+	/* uncompressed control.tar */
+	fields = read_built_deb ("", "Package: test\nVersion: 1\n\nPackage: ignored\n", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (fields);
+	g_assert_cmpuint (g_hash_table_size (fields), ==, 2);
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Package"), ==, "test");
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Version"), ==, "1");
+	g_clear_pointer (&fields, g_hash_table_unref);
+
+	/* control.tar.xz, the default for dpkg-deb */
+	fields = read_built_deb (".xz", "Package: test-xz\n", &error);
+#ifdef HAVE_LZMA
+	g_assert_no_error (error);
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Package"), ==, "test-xz");
+	g_clear_pointer (&fields, g_hash_table_unref);
+#else
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+	g_assert_null (fields);
+	g_clear_error (&error);
+#endif
+
+	/* control.tar.zst */
+	fields = read_built_deb (".zst", "Package: test-zst\n", &error);
+#ifdef HAVE_ZSTD
+	g_assert_no_error (error);
+	g_assert_cmpstr (g_hash_table_lookup (fields, "Package"), ==, "test-zst");
+	g_clear_pointer (&fields, g_hash_table_unref);
+#else
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+	g_assert_null (fields);
+	g_clear_error (&error);
+#endif
+
+	/* compression which has to be left to dpkg-deb */
+	fields = read_built_deb (".bz2", "Package: test\n", &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED);
+	g_assert_null (fields);
+	g_clear_error (&error);
+
+	/* malformed control files */
+	fields = gs_dpkg_control_parse (" continuation\n", strlen (" continuation\n"), &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert_null (fields);
+	g_clear_error (&error);
+}
+
 static void
 gs_plugins_dpkg_func (GsPluginLoader *plugin_loader)
 {
@@ -77,6 +266,8 @@ main (int argc, char **argv)
 	g_assert (ret);
 
 	/* plugin tests go here */
+	g_test_add_func ("/gnome-software/plugins/dpkg/control",
+			 gs_plugins_dpkg_control_func);
 	g_test_add_data_func ("/gnome-software/plugins/dpkg",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dpkg_func);
@@ -208,8 +208,11 @@ gs_plugins_dummy_key_colors_func (GsPluginLoader *plugin_loader)
 	g_autoptr(GsPluginJob) plugin_job = NULL;
 	g_autoptr(GError) error = NULL;
 
-	/* get the extra bits */
+	/* key colors are only calculated when refining */
 	app = gs_app_new ("chiron.desktop");
+	g_assert_null (gs_app_get_key_colors (app));
+
+	/* get the extra bits */
 	plugin_job = gs_plugin_job_refine_new_for_app (app, GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON);
 	ret = gs_plugin_loader_job_action (plugin_loader, plugin_job, NULL, &error);
 	gs_test_flush_main_context ();
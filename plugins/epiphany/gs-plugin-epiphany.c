@@ -353,6 +353,9 @@ gs_plugin_epiphany_init (GsPluginEpiphany *self)
 
 	/* prioritize over packages */
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_BETTER_THAN, "packagekit");
+
+	/* see gs_plugin_adopt_app() */
+	gs_plugin_add_adopt_component_kind (GS_PLUGIN (self), AS_COMPONENT_KIND_WEB_APP);
 }
 
 static void
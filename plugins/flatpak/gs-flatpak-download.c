@@ -0,0 +1,220 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Downloads apps for several flatpak installations at once, without
+ * deploying them. The transactions which deploy the apps are then run one
+ * installation after another, but as all their data has already been pulled
+ * they only have to deploy it, and apps in later installations don’t have to
+ * wait for the downloads in earlier ones.
+ */
+
+#include <config.h>
+
+#include "gs-flatpak-app.h"
+#include "gs-flatpak-download.h"
+
+/* State shared between the threads in the pool for one call to
+ * gs_flatpak_download_in_parallel(). */
+typedef struct {
+	GMutex mutex;
+	GError *saved_error;  /* (mutex mutex) (owned) (nullable) */
+	gboolean is_update;
+	GCancellable *cancellable;  /* (nullable) (unowned) */
+} ParallelDownloadData;
+
+typedef struct {
+	ParallelDownloadData *parallel_data;  /* (unowned) */
+	FlatpakInstallation *installation;  /* (owned) */
+	GsAppList *apps;  /* (owned) */
+} DownloadChunk;
+
+static void
+download_progress_changed_cb (FlatpakTransactionProgress *progress,
+                              gpointer                    user_data)
+{
+	GsApp *app = GS_APP (user_data);
+
+	gs_app_set_progress (app, flatpak_transaction_progress_get_progress (progress));
+}
+
+static void
+download_new_operation_cb (FlatpakTransaction          *transaction,
+                           FlatpakTransactionOperation *operation,
+                           FlatpakTransactionProgress  *progress,
+                           gpointer                     user_data)
+{
+	GHashTable *apps_by_ref = user_data;
+	GsApp *app;
+
+	app = g_hash_table_lookup (apps_by_ref, flatpak_transaction_operation_get_ref (operation));
+	if (app == NULL)
+		return;
+
+	flatpak_transaction_progress_set_update_frequency (progress, 500);
+	g_signal_connect_object (progress, "changed",
+				 G_CALLBACK (download_progress_changed_cb), app, 0);
+}
+
+/* Run in the pool. */
+static void
+download_chunk_cb (gpointer data,
+                   gpointer user_data)
+{
+	DownloadChunk *chunk = data;
+	ParallelDownloadData *parallel_data = chunk->parallel_data;
+	g_autoptr(FlatpakTransaction) transaction = NULL;
+	g_autoptr(GHashTable) apps_by_ref = NULL;
+	guint n_ops = 0;
+	g_autoptr(GError) local_error = NULL;
+
+	transaction = flatpak_transaction_new_for_installation (chunk->installation,
+								parallel_data->cancellable, &local_error);
+	if (transaction == NULL)
+		goto out;
+
+	/* Don’t ask for authentication from another thread; the deploy
+	 * transaction will do that if it’s needed. */
+	flatpak_transaction_set_no_interaction (transaction, TRUE);
+	flatpak_transaction_set_no_deploy (transaction, TRUE);
+	flatpak_transaction_add_default_dependency_sources (transaction);
+
+	apps_by_ref = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (guint i = 0; i < gs_app_list_length (chunk->apps); i++) {
+		GsApp *app = gs_app_list_index (chunk->apps, i);
+		g_autofree gchar *ref = gs_flatpak_app_get_ref_display (app);
+		gboolean added;
+		g_autoptr(GError) error_local = NULL;
+
+		if (parallel_data->is_update)
+			added = flatpak_transaction_add_update (transaction, ref, NULL, NULL, &error_local);
+		else
+			added = flatpak_transaction_add_install (transaction, gs_app_get_origin (app),
+								 ref, NULL, &error_local);
+
+		if (!added) {
+			g_debug ("Not downloading ‘%s’ in advance: %s", ref, error_local->message);
+			continue;
+		}
+
+		g_hash_table_insert (apps_by_ref, g_steal_pointer (&ref), app);
+		n_ops++;
+	}
+
+	if (n_ops == 0)
+		goto out;
+
+	g_signal_connect (transaction, "new-operation",
+			  G_CALLBACK (download_new_operation_cb), apps_by_ref);
+
+	flatpak_transaction_run (transaction, parallel_data->cancellable, &local_error);
+
+out:
+	if (local_error != NULL) {
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&parallel_data->mutex);
+		g_autoptr(GFile) path = flatpak_installation_get_path (chunk->installation);
+
+		g_prefix_error (&local_error, "Error downloading apps for ‘%s’: ",
+				g_file_peek_path (path));
+
+		if (parallel_data->saved_error == NULL)
+			parallel_data->saved_error = g_steal_pointer (&local_error);
+		else
+			g_debug ("%s", local_error->message);
+	}
+
+	g_object_unref (chunk->installation);
+	g_object_unref (chunk->apps);
+	g_free (chunk);
+}
+
+/**
+ * gs_flatpak_download_in_parallel:
+ * @apps_by_installation: (element-type FlatpakInstallation GsAppList): apps
+ *   to download, grouped by the installation they are for
+ * @is_update: %TRUE to download updates for installed apps, %FALSE to
+ *   download apps which are to be installed
+ * @max_parallel: maximum number of installations to download for at once
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError
+ *
+ * Download the apps in @apps_by_installation in parallel across their
+ * installations, without deploying them. This blocks until all the downloads
+ * have finished.
+ *
+ * Only normal refs from a remote can be downloaded in advance; bundles and
+ * flatpakrefs are skipped, and left to the deploy transaction.
+ *
+ * If downloading for any of the installations fails, the first error is
+ * returned once all the downloads have finished. The downloads for the other
+ * installations are not affected.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+gs_flatpak_download_in_parallel (GHashTable    *apps_by_installation,
+                                 gboolean       is_update,
+                                 guint          max_parallel,
+                                 GCancellable  *cancellable,
+                                 GError       **error)
+{
+	ParallelDownloadData parallel_data = {
+		.saved_error = NULL,
+		.is_update = is_update,
+		.cancellable = cancellable,
+	};
+	GThreadPool *pool;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_return_val_if_fail (apps_by_installation != NULL, FALSE);
+	g_return_val_if_fail (max_parallel > 0, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	pool = g_thread_pool_new (download_chunk_cb, NULL, max_parallel, FALSE, NULL);
+	g_mutex_init (&parallel_data.mutex);
+
+	g_hash_table_iter_init (&iter, apps_by_installation);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GsAppList *list = GS_APP_LIST (value);
+		g_autoptr(GsAppList) list_to_download = gs_app_list_new ();
+		DownloadChunk *chunk;
+
+		for (guint i = 0; i < gs_app_list_length (list); i++) {
+			GsApp *app = gs_app_list_index (list, i);
+
+			if (gs_flatpak_app_get_file_kind (app) != GS_FLATPAK_APP_FILE_KIND_REF &&
+			    gs_flatpak_app_get_file_kind (app) != GS_FLATPAK_APP_FILE_KIND_BUNDLE &&
+			    (is_update || gs_app_get_origin (app) != NULL))
+				gs_app_list_add (list_to_download, app);
+		}
+
+		if (gs_app_list_length (list_to_download) == 0)
+			continue;
+
+		chunk = g_new0 (DownloadChunk, 1);
+		chunk->parallel_data = &parallel_data;
+		chunk->installation = g_object_ref (FLATPAK_INSTALLATION (key));
+		chunk->apps = g_steal_pointer (&list_to_download);
+
+		g_thread_pool_push (pool, chunk, NULL);
+	}
+
+	/* wait for all the chunks to finish */
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_mutex_clear (&parallel_data.mutex);
+
+	if (parallel_data.saved_error != NULL) {
+		g_propagate_error (error, parallel_data.saved_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,22 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <flatpak.h>
+#include <gnome-software.h>
+
+G_BEGIN_DECLS
+
+gboolean	 gs_flatpak_download_in_parallel	(GHashTable	*apps_by_installation,
+							 gboolean	 is_update,
+							 guint		 max_parallel,
+							 GCancellable	*cancellable,
+							 GError		**error);
+
+G_END_DECLS
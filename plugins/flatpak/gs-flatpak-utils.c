@@ -270,3 +270,89 @@ gs_flatpak_app_set_packaging_info (GsApp *app)
 	gs_app_set_metadata (app, "GnomeSoftware::PackagingIcon", "package-flatpak-symbolic");
 	gs_app_set_metadata (app, "GnomeSoftware::packagename-title", _("App ID"));
 }
+
+/* Returns a table of the app refs in @refs, keyed by everything which changes
+ * when a ref is installed, updated, removed or switched to another remote. */
+static GHashTable *
+installed_app_refs_to_table (GPtrArray *refs)  /* (element-type FlatpakInstalledRef) */
+{
+	GHashTable *table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (guint i = 0; i < refs->len; i++) {
+		FlatpakInstalledRef *xref = g_ptr_array_index (refs, i);
+		g_autofree gchar *ref = NULL;
+
+		if (flatpak_ref_get_kind (FLATPAK_REF (xref)) != FLATPAK_REF_KIND_APP)
+			continue;
+
+		ref = flatpak_ref_format_ref (FLATPAK_REF (xref));
+		g_hash_table_insert (table,
+				     g_strdup_printf ("%s\n%s\n%s", ref,
+						      flatpak_ref_get_commit (FLATPAK_REF (xref)),
+						      flatpak_installed_ref_get_origin (xref)),
+				     xref);
+	}
+
+	return table;
+}
+
+/* Add the apps for the refs which are in @refs but not in @other_refs. */
+static void
+add_changed_refs_to_change (GsPluginChange   *change,
+                            AsComponentScope  scope,
+                            GHashTable       *refs,
+                            GHashTable       *other_refs)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init (&iter, refs);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		FlatpakInstalledRef *xref = value;
+		g_autofree gchar *unique_id = NULL;
+
+		if (g_hash_table_contains (other_refs, key))
+			continue;
+
+		unique_id = gs_utils_build_unique_id (scope,
+						      AS_BUNDLE_KIND_FLATPAK,
+						      flatpak_installed_ref_get_origin (xref),
+						      flatpak_ref_get_name (FLATPAK_REF (xref)),
+						      flatpak_ref_get_branch (FLATPAK_REF (xref)));
+		gs_plugin_change_add_unique_id (change, unique_id);
+	}
+}
+
+/**
+ * gs_flatpak_add_installed_refs_diff_to_change:
+ * @change: the change to add to
+ * @scope: the scope of the installation the refs are from
+ * @old_refs: (element-type FlatpakInstalledRef): the refs installed before
+ * @new_refs: (element-type FlatpakInstalledRef): the refs installed now
+ *
+ * Add the apps which were installed, updated, removed or moved to another
+ * remote between @old_refs and @new_refs to @change.
+ *
+ * Only app refs are added. The runtimes, extensions, `.Locale` and `.Debug`
+ * refs which are installed and updated along with almost every app are never
+ * shown as apps of their own, so listing them would only make the UI think
+ * it had to reload everything to find them.
+ */
+void
+gs_flatpak_add_installed_refs_diff_to_change (GsPluginChange   *change,
+                                              AsComponentScope  scope,
+                                              GPtrArray        *old_refs,
+                                              GPtrArray        *new_refs)
+{
+	g_autoptr(GHashTable) old_table = NULL;
+	g_autoptr(GHashTable) new_table = NULL;
+
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (change));
+	g_return_if_fail (old_refs != NULL);
+	g_return_if_fail (new_refs != NULL);
+
+	old_table = installed_app_refs_to_table (old_refs);
+	new_table = installed_app_refs_to_table (new_refs);
+	add_changed_refs_to_change (change, scope, old_table, new_table);
+	add_changed_refs_to_change (change, scope, new_table, old_table);
+}
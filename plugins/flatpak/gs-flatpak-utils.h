@@ -20,5 +20,10 @@ GsApp		*gs_flatpak_app_new_from_repo_file	(GFile		*file,
 							 GCancellable	*cancellable,
 							 GError		**error);
 void		 gs_flatpak_app_set_packaging_info	(GsApp		*app);
+void		 gs_flatpak_add_installed_refs_diff_to_change
+							(GsPluginChange	*change,
+							 AsComponentScope scope,
+							 GPtrArray	*old_refs,
+							 GPtrArray	*new_refs);
 
 G_END_DECLS
@@ -47,6 +47,7 @@ struct _GsFlatpak {
 	FlatpakInstallation	*installation_interactive;  /* (owned) */
 	GPtrArray		*installed_refs;  /* must be entirely replaced rather than updated internally */
 	GHashTable		*remotes_by_name;
+	GHashTable		*changed_app_ids;  /* (element-type utf8 utf8) (owned) (mutex installed_refs_mutex); set of unique IDs */
 	GMutex			 installed_refs_mutex;
 	GHashTable		*broken_remotes;
 	GMutex			 broken_remotes_mutex;
@@ -66,6 +67,7 @@ struct _GsFlatpak {
 	gboolean		 requires_full_rescan;
 	gint			 busy; /* (atomic) */
 	gboolean		 changed_while_busy;
+	GsSizeAccountant	*size_accountant;  /* (owned) (nullable) */
 };
 
 G_DEFINE_TYPE (GsFlatpak, gs_flatpak, G_TYPE_OBJECT)
@@ -590,41 +592,55 @@ gs_flatpak_create_app (GsFlatpak *self,
 		       GCancellable *cancellable)
 {
 	GsApp *app_cached;
+	GsApp *app_unpublished;  /* (unowned) */
+	g_autoptr(GsAppBuilder) builder = NULL;
 	g_autoptr(GsApp) app = NULL;
 
-	/* create a temp GsApp */
-	app = gs_app_new (flatpak_ref_get_name (xref));
-	gs_flatpak_set_metadata (self, app, xref);
+	/* create a temp GsApp, which can be filled in without locking until
+	 * it’s published */
+	builder = gs_app_builder_new (flatpak_ref_get_name (xref));
+	app_unpublished = gs_app_builder_get_app (builder);
+	gs_flatpak_set_metadata (self, app_unpublished, xref);
 	if (origin != NULL) {
-		gs_flatpak_set_app_origin (self, app, origin, xremote, interactive, cancellable);
+		gs_flatpak_set_app_origin (self, app_unpublished, origin, xremote, interactive, cancellable);
 
 		if (allow_cached && !(self->flags & GS_FLATPAK_FLAG_IS_TEMPORARY)) {
 			/* return the ref'd cached copy, only if the origin is known */
-			app_cached = gs_plugin_cache_lookup (self->plugin, gs_app_get_unique_id (app));
+			app_cached = gs_plugin_cache_lookup (self->plugin, gs_app_get_unique_id (app_unpublished));
 			if (app_cached != NULL)
 				return app_cached;
 		}
 	}
 
 	/* fallback values */
-	if (gs_flatpak_app_get_ref_kind (app) == FLATPAK_REF_KIND_RUNTIME) {
+	if (gs_flatpak_app_get_ref_kind (app_unpublished) == FLATPAK_REF_KIND_RUNTIME) {
 		g_autoptr(GIcon) icon = NULL;
-		gs_app_set_name (app, GS_APP_QUALITY_NORMAL,
+		gs_app_set_name (app_unpublished, GS_APP_QUALITY_NORMAL,
 				 flatpak_ref_get_name (FLATPAK_REF (xref)));
-		gs_app_set_summary (app, GS_APP_QUALITY_NORMAL,
+		gs_app_set_summary (app_unpublished, GS_APP_QUALITY_NORMAL,
 				    "Framework for applications");
-		gs_app_set_version (app, flatpak_ref_get_branch (FLATPAK_REF (xref)));
+		gs_app_set_version (app_unpublished, flatpak_ref_get_branch (FLATPAK_REF (xref)));
 		icon = g_themed_icon_new ("system-component-runtime");
-		gs_app_add_icon (app, icon);
+		gs_app_add_icon (app_unpublished, icon);
 	}
 
+	app = gs_app_builder_end (g_steal_pointer (&builder));
+
 	/* Don't add NULL origin apps to the cache. If the app is later set to
 	 * origin x the cache may return it as a match for origin y since the cache
 	 * hash table uses as_utils_data_id_equal() as the equal func and a NULL
 	 * origin becomes a "*" in gs_utils_build_unique_id().
+	 * The same goes for sharing the instance with other plugins.
 	 */
-	if (origin != NULL && allow_cached && !(self->flags & GS_FLATPAK_FLAG_IS_TEMPORARY))
-		gs_plugin_cache_add (self->plugin, NULL, app);
+	if (origin != NULL && allow_cached && !(self->flags & GS_FLATPAK_FLAG_IS_TEMPORARY)) {
+		g_autoptr(GsApp) app_interned = NULL;
+
+		/* another plugin, such as appstream, may already have created
+		 * this app, in which case share its instance */
+		app_interned = gs_plugin_intern_app (self->plugin, app);
+		gs_plugin_cache_add (self->plugin, NULL, app_interned);
+		return g_steal_pointer (&app_interned);
+	}
 
 	/* no existing match, just steal the temp object */
 	return g_steal_pointer (&app);
@@ -686,14 +702,77 @@ gs_flatpak_internal_data_changed (GsFlatpak *self)
 	self->requires_full_rescan = TRUE;
 }
 
+/* Run in a worker thread. Compares the installed refs from before the
+ * installation changed, in @task_data, with the current ones, so the UI only
+ * has to refresh the apps which were installed, updated or removed. */
+static void
+gs_flatpak_changed_diff_thread_cb (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+	GsFlatpak *self = GS_FLATPAK (source_object);
+	GPtrArray *old_refs = task_data;
+	g_autoptr(GPtrArray) new_refs = NULL;
+	g_autoptr(GsPluginChange) change = gs_plugin_change_new ();
+	g_autoptr(GError) local_error = NULL;
+
+	new_refs = flatpak_installation_list_installed_refs (gs_flatpak_get_installation (self, FALSE),
+							     cancellable, &local_error);
+	if (new_refs == NULL) {
+		g_debug ("Failed to list installed refs for %s: %s",
+			 gs_flatpak_get_id (self), local_error->message);
+		gs_plugin_reload (self->plugin);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	gs_flatpak_add_installed_refs_diff_to_change (change, self->scope, old_refs, new_refs);
+
+	/* the UI refines the changed apps, so make sure their state is looked
+	 * up again then, rather than kept from before the change */
+	g_mutex_lock (&self->installed_refs_mutex);
+	for (guint i = 0; i < gs_plugin_change_get_unique_ids (change)->len; i++) {
+		const gchar *unique_id = g_ptr_array_index (gs_plugin_change_get_unique_ids (change), i);
+		g_hash_table_add (self->changed_app_ids, g_strdup (unique_id));
+	}
+	g_mutex_unlock (&self->installed_refs_mutex);
+
+	/* no installed apps changed, so it was probably the remotes, or only
+	 * runtimes changed */
+	if (gs_plugin_change_is_empty (change))
+		gs_plugin_reload (self->plugin);
+	else
+		gs_plugin_reload_for_change (self->plugin, change);
+
+	g_task_return_boolean (task, TRUE);
+}
+
 static gboolean
 gs_flatpak_claim_changed_idle_cb (gpointer user_data)
 {
 	GsFlatpak *self = user_data;
+	g_autoptr(GPtrArray) old_refs = NULL;
+	g_autoptr(GTask) task = NULL;
+
+	/* keep the installed refs from before the change to find what changed */
+	g_mutex_lock (&self->installed_refs_mutex);
+	if (self->installed_refs != NULL)
+		old_refs = g_ptr_array_ref (self->installed_refs);
+	g_mutex_unlock (&self->installed_refs_mutex);
 
 	gs_flatpak_internal_data_changed (self);
 	gs_plugin_cache_invalidate (self->plugin);
-	gs_plugin_reload (self->plugin);
+
+	if (old_refs == NULL) {
+		gs_plugin_reload (self->plugin);
+		return G_SOURCE_REMOVE;
+	}
+
+	task = g_task_new (self, NULL, NULL, NULL);
+	g_task_set_source_tag (task, gs_flatpak_claim_changed_idle_cb);
+	g_task_set_task_data (task, g_steal_pointer (&old_refs), (GDestroyNotify) g_ptr_array_unref);
+	g_task_run_in_thread (task, gs_flatpak_changed_diff_thread_cb);
 
 	return G_SOURCE_REMOVE;
 }
@@ -1199,6 +1278,8 @@ gs_flatpak_rescan_appstream_store (GsFlatpak *self,
 		g_autoptr(GPtrArray) installed = NULL;
 		g_autoptr(XbNode) info_filename = NULL;
 
+		gs_appstream_warm_license_cache (self->silo);
+
 		self->silo_installed_by_desktopid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 
 		installed = xb_silo_query (self->silo, "/component[@type='desktop-application']/launchable[@type='desktop-id']", 0, NULL);
@@ -2404,6 +2485,14 @@ gs_flatpak_refine_app_state_unlocked (GsFlatpak *self,
 	g_autoptr(GPtrArray) installed_refs = NULL;
 	FlatpakInstallation *installation = gs_flatpak_get_installation (self, interactive);
 
+	/* apps which were installed, updated or removed outside of
+	 * gnome-software need their state looking up again */
+	if (!force_state_update && gs_app_get_unique_id (app) != NULL) {
+		g_mutex_lock (&self->installed_refs_mutex);
+		force_state_update = g_hash_table_remove (self->changed_app_ids, gs_app_get_unique_id (app));
+		g_mutex_unlock (&self->installed_refs_mutex);
+	}
+
 	/* already found */
 	if (!force_state_update &&
 	    gs_app_get_state (app) != GS_APP_STATE_UNKNOWN)
@@ -2935,15 +3024,62 @@ gs_flatpak_prune_addons_list (GsFlatpak *self,
 }
 
 static guint64
-gs_flatpak_get_app_directory_size (GsApp *app,
+gs_flatpak_get_app_directory_size (const gchar *app_id,
 				   const gchar *subdir_name,
 				   GCancellable *cancellable)
 {
 	g_autofree gchar *filename = NULL;
-	filename = g_build_filename (g_get_home_dir (), ".var", "app", gs_app_get_id (app), subdir_name, NULL);
+	filename = g_build_filename (g_get_home_dir (), ".var", "app", app_id, subdir_name, NULL);
 	return gs_utils_get_file_size (filename, NULL, NULL, cancellable);
 }
 
+/* Walks the app’s data directories, so this can be slow. Returns %FALSE if
+ * cancelled, in which case the sizes are incomplete. */
+static gboolean
+gs_flatpak_measure_app_data (const gchar *app_id,
+			     guint64 *size_user_data_out,
+			     guint64 *size_cache_data_out,
+			     GCancellable *cancellable)
+{
+	*size_cache_data_out = gs_flatpak_get_app_directory_size (app_id, "cache", cancellable);
+	*size_user_data_out = gs_flatpak_get_app_directory_size (app_id, "config", cancellable) +
+			      gs_flatpak_get_app_directory_size (app_id, "data", cancellable);
+
+	return !g_cancellable_is_cancelled (cancellable);
+}
+
+static void
+gs_flatpak_refine_app_data_size (GsFlatpak *self,
+				 GsApp *app,
+				 GCancellable *cancellable)
+{
+	guint64 size_user_data, size_cache_data;
+
+	if (gs_app_get_size_cache_data (app, NULL) == GS_SIZE_TYPE_VALID &&
+	    gs_app_get_size_user_data (app, NULL) == GS_SIZE_TYPE_VALID)
+		return;
+
+	/* use the last measurement if there is one; it’s kept up to date in
+	 * the background by gs_flatpak_refresh_app_sizes() */
+	if (self->size_accountant != NULL &&
+	    gs_size_accountant_apply (self->size_accountant, gs_app_get_id (app), app))
+		return;
+
+	if (!gs_flatpak_measure_app_data (gs_app_get_id (app), &size_user_data, &size_cache_data, cancellable)) {
+		gs_app_set_size_cache_data (app, GS_SIZE_TYPE_UNKNOWABLE, 0);
+		gs_app_set_size_user_data (app, GS_SIZE_TYPE_UNKNOWABLE, 0);
+		return;
+	}
+
+	if (self->size_accountant != NULL) {
+		gs_size_accountant_record (self->size_accountant, gs_app_get_id (app), size_user_data, size_cache_data);
+		gs_size_accountant_apply (self->size_accountant, gs_app_get_id (app), app);
+	} else {
+		gs_app_set_size_cache_data (app, GS_SIZE_TYPE_VALID, size_cache_data);
+		gs_app_set_size_user_data (app, GS_SIZE_TYPE_VALID, size_user_data);
+	}
+}
+
 static gboolean
 gs_plugin_refine_item_size (GsFlatpak *self,
 			    GsApp *app,
@@ -3508,18 +3644,7 @@ gs_flatpak_refine_app_unlocked (GsFlatpak *self,
 	if ((flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_SIZE_DATA) != 0 &&
 	    gs_app_is_installed (app) &&
 	    gs_app_get_kind (app) != AS_COMPONENT_KIND_RUNTIME) {
-		if (gs_app_get_size_cache_data (app, NULL) != GS_SIZE_TYPE_VALID)
-			gs_app_set_size_cache_data (app, GS_SIZE_TYPE_VALID,
-						    gs_flatpak_get_app_directory_size (app, "cache", cancellable));
-		if (gs_app_get_size_user_data (app, NULL) != GS_SIZE_TYPE_VALID)
-			gs_app_set_size_user_data (app, GS_SIZE_TYPE_VALID,
-						   gs_flatpak_get_app_directory_size (app, "config", cancellable) +
-						   gs_flatpak_get_app_directory_size (app, "data", cancellable));
-
-		if (g_cancellable_is_cancelled (cancellable)) {
-			gs_app_set_size_cache_data (app, GS_SIZE_TYPE_UNKNOWABLE, 0);
-			gs_app_set_size_user_data (app, GS_SIZE_TYPE_UNKNOWABLE, 0);
-		}
+		gs_flatpak_refine_app_data_size (self, app, cancellable);
 	}
 
 	/* origin-hostname */
@@ -4650,6 +4775,7 @@ gs_flatpak_finalize (GObject *object)
 	g_object_unref (self->installation_interactive);
 	g_clear_pointer (&self->installed_refs, g_ptr_array_unref);
 	g_clear_pointer (&self->remotes_by_name, g_hash_table_unref);
+	g_clear_pointer (&self->changed_app_ids, g_hash_table_unref);
 	g_mutex_clear (&self->installed_refs_mutex);
 	g_object_unref (self->plugin);
 	g_hash_table_unref (self->broken_remotes);
@@ -4659,6 +4785,7 @@ gs_flatpak_finalize (GObject *object)
 	g_mutex_clear (&self->app_silos_mutex);
 	g_clear_pointer (&self->remote_title, g_hash_table_unref);
 	g_mutex_clear (&self->remote_title_mutex);
+	g_clear_object (&self->size_accountant);
 
 	G_OBJECT_CLASS (gs_flatpak_parent_class)->finalize (object);
 }
@@ -4680,6 +4807,7 @@ gs_flatpak_init (GsFlatpak *self)
 	g_mutex_init (&self->installed_refs_mutex);
 	self->installed_refs = NULL;
 	self->remotes_by_name = NULL;
+	self->changed_app_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	g_mutex_init (&self->broken_remotes_mutex);
 	self->broken_remotes = g_hash_table_new_full (g_str_hash, g_str_equal,
 						      g_free, NULL);
@@ -4799,3 +4927,92 @@ gs_flatpak_purge_sync (GsFlatpak    *self,
 		return TRUE;
 	}
 }
+
+void
+gs_flatpak_set_size_accountant (GsFlatpak        *self,
+				GsSizeAccountant *size_accountant)
+{
+	g_return_if_fail (GS_IS_FLATPAK (self));
+	g_return_if_fail (size_accountant == NULL || GS_IS_SIZE_ACCOUNTANT (size_accountant));
+
+	g_set_object (&self->size_accountant, size_accountant);
+}
+
+/* Measure the data sizes of the apps in @list again, after they’ve been
+ * installed, updated or uninstalled, so that the recorded sizes stay current.
+ * This walks the apps’ data directories, so should be called from a worker
+ * thread. Cancellation leaves the previous records in place. */
+void
+gs_flatpak_refresh_app_sizes (GsFlatpak    *self,
+			      GsAppList    *list,
+			      GCancellable *cancellable)
+{
+	g_return_if_fail (GS_IS_FLATPAK (self));
+	g_return_if_fail (GS_IS_APP_LIST (list));
+
+	if (self->size_accountant == NULL)
+		return;
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		const gchar *app_id = gs_app_get_id (app);
+		guint64 size_user_data, size_cache_data;
+
+		if (app_id == NULL ||
+		    gs_app_get_kind (app) == AS_COMPONENT_KIND_RUNTIME ||
+		    gs_app_get_kind (app) == AS_COMPONENT_KIND_REPOSITORY)
+			continue;
+
+		if (!gs_app_is_installed (app)) {
+			gs_size_accountant_remove (self->size_accountant, app_id);
+			continue;
+		}
+
+		if (!gs_flatpak_measure_app_data (app_id, &size_user_data, &size_cache_data, cancellable))
+			break;
+
+		gs_size_accountant_record (self->size_accountant, app_id, size_user_data, size_cache_data);
+		gs_size_accountant_apply (self->size_accountant, app_id, app);
+	}
+
+	gs_size_accountant_save (self->size_accountant);
+}
+
+/* Measure again the apps whose recorded sizes are older than @max_age_secs,
+ * dropping records for apps whose data directory has gone, for example
+ * because they were uninstalled outside gnome-software. */
+void
+gs_flatpak_refresh_stale_app_sizes (GsFlatpak    *self,
+				    guint64       max_age_secs,
+				    GCancellable *cancellable)
+{
+	g_auto(GStrv) stale_keys = NULL;
+
+	g_return_if_fail (GS_IS_FLATPAK (self));
+
+	if (self->size_accountant == NULL)
+		return;
+
+	stale_keys = gs_size_accountant_dup_stale_keys (self->size_accountant, max_age_secs);
+	if (stale_keys[0] != NULL)
+		g_debug ("Measuring data sizes of %u flatpak apps", g_strv_length (stale_keys));
+
+	for (gsize i = 0; stale_keys[i] != NULL; i++) {
+		const gchar *app_id = stale_keys[i];
+		g_autofree gchar *app_dir = NULL;
+		guint64 size_user_data, size_cache_data;
+
+		app_dir = g_build_filename (g_get_home_dir (), ".var", "app", app_id, NULL);
+		if (!g_file_test (app_dir, G_FILE_TEST_IS_DIR)) {
+			gs_size_accountant_remove (self->size_accountant, app_id);
+			continue;
+		}
+
+		if (!gs_flatpak_measure_app_data (app_id, &size_user_data, &size_cache_data, cancellable))
+			break;
+
+		gs_size_accountant_record (self->size_accountant, app_id, size_user_data, size_cache_data);
+	}
+
+	gs_size_accountant_save (self->size_accountant);
+}
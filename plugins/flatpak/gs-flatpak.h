@@ -187,5 +187,14 @@ gboolean	gs_flatpak_get_busy		(GsFlatpak		*self);
 gboolean	gs_flatpak_purge_sync		(GsFlatpak              *self,
 						 GCancellable           *cancellable,
 						 GError                **error);
+void		gs_flatpak_set_size_accountant	(GsFlatpak		*self,
+						 GsSizeAccountant	*size_accountant);
+void		gs_flatpak_refresh_app_sizes	(GsFlatpak		*self,
+						 GsAppList		*list,
+						 GCancellable		*cancellable);
+void		gs_flatpak_refresh_stale_app_sizes
+						(GsFlatpak		*self,
+						 guint64		 max_age_secs,
+						 GCancellable		*cancellable);
 
 G_END_DECLS
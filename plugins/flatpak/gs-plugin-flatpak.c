@@ -33,6 +33,7 @@
 #include "gs-appstream.h"
 #include "gs-flatpak-app.h"
 #include "gs-flatpak.h"
+#include "gs-flatpak-download.h"
 #include "gs-flatpak-transaction.h"
 #include "gs-flatpak-utils.h"
 #include "gs-metered.h"
@@ -50,6 +51,16 @@
  */
 #define PURGE_TIMEOUT_SECONDS (60 * 60 * 2)
 
+/* Maximum number of installations to download updates for at once, before
+ * deploying them one installation at a time. Each download already uses
+ * several connections, so this bounds the number of connections in total. */
+#define MAX_PARALLEL_DOWNLOADS 2
+
+/* How old recorded app data sizes can get before they’re measured again when
+ * refreshing metadata. Sizes are also measured after every install and update,
+ * so this only catches apps whose data has grown while they were in use. */
+#define SIZE_DATA_MAX_AGE_SECONDS (60 * 60 * 24)
+
 struct _GsPluginFlatpak
 {
 	GsPlugin		 parent;
@@ -62,6 +73,9 @@ struct _GsPluginFlatpak
 
 	GCancellable		*purge_cancellable;
 	guint			 purge_timeout_id;
+
+	GsSizeAccountant	*size_accountant;  /* (owned) (nullable); shared by all installations */
+	GCancellable		*sizes_cancellable;  /* (owned) */
 };
 
 G_DEFINE_TYPE (GsPluginFlatpak, gs_plugin_flatpak, GS_TYPE_PLUGIN)
@@ -90,9 +104,12 @@ gs_plugin_flatpak_dispose (GObject *object)
 
 	g_cancellable_cancel (self->purge_cancellable);
 	g_assert (self->purge_timeout_id == 0);
+	g_cancellable_cancel (self->sizes_cancellable);
 
 	g_clear_pointer (&self->installations, g_ptr_array_unref);
+	g_clear_object (&self->size_accountant);
 	g_clear_object (&self->purge_cancellable);
+	g_clear_object (&self->sizes_cancellable);
 	g_clear_object (&self->worker);
 
 	G_OBJECT_CLASS (gs_plugin_flatpak_parent_class)->dispose (object);
@@ -104,6 +121,7 @@ gs_plugin_flatpak_init (GsPluginFlatpak *self)
 	GsPlugin *plugin = GS_PLUGIN (self);
 
 	self->installations = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	self->sizes_cancellable = g_cancellable_new ();
 
 	/* getting app properties from appstream is quicker */
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_AFTER, "appstream");
@@ -115,6 +133,9 @@ gs_plugin_flatpak_init (GsPluginFlatpak *self)
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_BETTER_THAN, "packagekit");
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_BETTER_THAN, "rpm-ostree");
 
+	/* see gs_plugin_adopt_app() */
+	gs_plugin_add_adopt_bundle_kind (plugin, AS_BUNDLE_KIND_FLATPAK);
+
 	/* set name of MetaInfo file */
 	gs_plugin_set_appstream_id (plugin, "org.gnome.Software.Plugin.Flatpak");
 
@@ -122,6 +143,69 @@ gs_plugin_flatpak_init (GsPluginFlatpak *self)
 	self->destdir_for_tests = g_getenv ("GS_SELF_TEST_FLATPAK_DATADIR");
 }
 
+typedef struct {
+	GsFlatpak *flatpak;  /* (owned) */
+	GsAppList *apps;  /* (owned) (nullable) */
+} RefreshSizesData;
+
+static void
+refresh_sizes_data_free (RefreshSizesData *data)
+{
+	g_clear_object (&data->flatpak);
+	g_clear_object (&data->apps);
+	g_free (data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (RefreshSizesData, refresh_sizes_data_free)
+
+/* Run in @worker. */
+static void
+refresh_sizes_thread_cb (GTask        *task,
+                         gpointer      source_object,
+                         gpointer      task_data,
+                         GCancellable *cancellable)
+{
+	GsPluginFlatpak *self = GS_PLUGIN_FLATPAK (source_object);
+	RefreshSizesData *data = task_data;
+
+	assert_in_worker (self);
+
+	if (data->apps != NULL)
+		gs_flatpak_refresh_app_sizes (data->flatpak, data->apps, cancellable);
+	else
+		gs_flatpak_refresh_stale_app_sizes (data->flatpak, SIZE_DATA_MAX_AGE_SECONDS, cancellable);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Measure the data sizes of @apps again, or of the apps whose records have
+ * gone stale if @apps is %NULL. Walking the apps’ data directories can take a
+ * while, so this is queued at low priority in @worker rather than done as part
+ * of the job which changed the apps; it then runs after that job has returned
+ * its result, and after any other jobs the user is waiting for. */
+static void
+queue_refresh_sizes (GsPluginFlatpak *self,
+                     GsFlatpak       *flatpak,
+                     GsAppList       *apps)
+{
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(RefreshSizesData) data = NULL;
+
+	if (self->size_accountant == NULL)
+		return;
+
+	data = g_new0 (RefreshSizesData, 1);
+	data->flatpak = g_object_ref (flatpak);
+	data->apps = (apps != NULL) ? gs_app_list_copy (apps) : NULL;
+
+	task = g_task_new (self, self->sizes_cancellable, NULL, NULL);
+	g_task_set_source_tag (task, queue_refresh_sizes);
+	g_task_set_task_data (task, g_steal_pointer (&data), (GDestroyNotify) refresh_sizes_data_free);
+
+	gs_worker_thread_queue (self->worker, G_PRIORITY_LOW,
+				refresh_sizes_thread_cb, g_steal_pointer (&task));
+}
+
 /* Run in @worker. */
 static void
 gs_plugin_flatpak_purge_thread_cb (GTask        *task,
@@ -218,6 +302,8 @@ gs_plugin_flatpak_add_installation (GsPluginFlatpak      *self,
 		return FALSE;
 	g_debug ("successfully set up %s", gs_flatpak_get_id (flatpak));
 
+	gs_flatpak_set_size_accountant (flatpak, self->size_accountant);
+
 	/* add objects that set up correctly */
 	g_ptr_array_add (self->installations, g_steal_pointer (&flatpak));
 	return TRUE;
@@ -314,6 +400,20 @@ setup_thread_cb (GTask        *task,
 	if (self->destdir_for_tests == NULL) {
 		g_autoptr(GError) error_local = NULL;
 		g_autoptr(FlatpakInstallation) installation = NULL;
+		g_autofree gchar *sizes_filename = NULL;
+
+		/* app data sizes are recorded here so they can be shown
+		 * without walking the data directories every time; not
+		 * having them only makes refining slower */
+		sizes_filename = gs_utils_get_cache_filename ("flatpak", "sizes.ini",
+							      GS_UTILS_CACHE_FLAG_WRITEABLE |
+							      GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+							      &error_local);
+		if (sizes_filename != NULL)
+			self->size_accountant = gs_size_accountant_new (sizes_filename);
+		else
+			g_debug ("Not recording app data sizes: %s", error_local->message);
+		g_clear_error (&error_local);
 
 		/* include the system installations */
 		if (self->has_system_helper) {
@@ -414,6 +514,7 @@ gs_plugin_flatpak_shutdown_async (GsPlugin            *plugin,
 
 	g_clear_handle_id (&self->purge_timeout_id, g_source_remove);
 	g_cancellable_cancel (self->purge_cancellable);
+	g_cancellable_cancel (self->sizes_cancellable);
 
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_source_tag (task, gs_plugin_flatpak_shutdown_async);
@@ -500,6 +601,12 @@ refresh_metadata_thread_cb (GTask        *task,
 			g_debug ("Failed to refresh metadata for '%s': %s", gs_flatpak_get_id (flatpak), local_error->message);
 	}
 
+	/* App data lives in the home directory whichever installation the app
+	 * is in, so only one installation needs to look at the records. Don’t
+	 * add to the time the user is waiting on an interactive refresh. */
+	if (!interactive && self->installations->len > 0)
+		queue_refresh_sizes (self, g_ptr_array_index (self->installations, 0), NULL);
+
 	g_task_return_boolean (task, TRUE);
 }
 
@@ -711,6 +818,11 @@ refine_thread_cb (GTask        *task,
 		}
 	}
 
+	/* save any data sizes which were measured while refining, once for
+	 * the whole list */
+	if (self->size_accountant != NULL)
+		gs_size_accountant_save (self->size_accountant);
+
 	g_task_return_boolean (task, TRUE);
 }
 
@@ -1049,6 +1161,53 @@ remove_schedule_entry (gpointer schedule_entry_handle)
 		g_warning ("Failed to remove schedule entry: %s", error_local->message);
 }
 
+/* Download the apps from @applist_by_flatpaks in parallel across their
+ * installations, without deploying them. The transactions for each
+ * installation are then run one after another as before, but as all their
+ * data has already been pulled they only have to deploy it.
+ *
+ * Errors are only logged, as the transaction which deploys the apps will
+ * download anything which is missing and report any errors properly.
+ *
+ * Run in @worker. */
+static void
+_download_in_parallel (GsPluginFlatpak *self,
+                       GHashTable      *applist_by_flatpaks,
+                       gboolean         is_update,
+                       gboolean         interactive,
+                       GCancellable    *cancellable)
+{
+	g_autoptr(GHashTable) apps_by_installation = NULL;
+	GHashTableIter iter;
+	gpointer key, value;
+	g_autoptr(GError) local_error = NULL;
+#ifdef HAVE_SYSPROF
+	gint64 begin_time_nsec G_GNUC_UNUSED = SYSPROF_CAPTURE_CURRENT_TIME;
+#endif
+
+	assert_in_worker (self);
+
+	/* Nothing to overlap. */
+	if (g_hash_table_size (applist_by_flatpaks) < 2)
+		return;
+
+	apps_by_installation = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						      g_object_unref, g_object_unref);
+
+	g_hash_table_iter_init (&iter, applist_by_flatpaks);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		FlatpakInstallation *installation = gs_flatpak_get_installation (GS_FLATPAK (key), interactive);
+		g_hash_table_insert (apps_by_installation, g_object_ref (installation), g_object_ref (value));
+	}
+
+	if (!gs_flatpak_download_in_parallel (apps_by_installation, is_update,
+					      MAX_PARALLEL_DOWNLOADS, cancellable,
+					      &local_error))
+		g_debug ("Error downloading apps in advance: %s", local_error->message);
+
+	GS_PROFILER_ADD_MARK (Flatpak, begin_time_nsec, "flatpak-download-in-parallel", NULL);
+}
+
 static void update_apps_thread_cb (GTask        *task,
                                    gpointer      source_object,
                                    gpointer      task_data,
@@ -1111,11 +1270,25 @@ update_apps_thread_cb (GTask        *task,
 	while (g_hash_table_iter_next (&iter, NULL, &value)) {
 		GsAppList *apps_for_installation = GS_APP_LIST (value);
 
-		for (guint i = 0; i < gs_app_list_length (apps_for_installation); i++) {
-			GsApp *app = gs_app_list_index (apps_for_installation, i);
+		gs_app_list_set_state_many (apps_for_installation, GS_APP_STATE_INSTALLING);
+	}
+
+	/* Download the updates for all installations at once, so the
+	 * transactions below only have to deploy them. */
+	if (!(data->flags & GS_PLUGIN_UPDATE_APPS_FLAGS_NO_DOWNLOAD) &&
+	    !(data->flags & GS_PLUGIN_UPDATE_APPS_FLAGS_NO_APPLY)) {
+		gpointer schedule_entry_handle = NULL;
 
-			gs_app_set_state (app, GS_APP_STATE_INSTALLING);
+		if (!interactive &&
+		    !gs_metered_block_app_list_on_download_scheduler (data->apps, &schedule_entry_handle, cancellable, &local_error)) {
+			g_warning ("Failed to block on download scheduler: %s",
+				   local_error->message);
+			g_clear_error (&local_error);
 		}
+
+		_download_in_parallel (self, applist_by_flatpaks, TRUE, interactive, cancellable);
+
+		remove_schedule_entry (schedule_entry_handle);
 	}
 
 	/* build and run transaction for each flatpak installation */
@@ -1305,6 +1478,9 @@ update_apps_thread_cb (GTask        *task,
 			}
 		}
 
+		/* keep the recorded data sizes of the updated apps current */
+		queue_refresh_sizes (self, flatpak, list_tmp);
+
 		gs_flatpak_set_busy (flatpak, FALSE);
 	}
 
@@ -1632,6 +1808,9 @@ uninstall_apps_thread_cb (GTask        *task,
 						  cancellable);
 		}
 
+		/* drop the recorded data sizes of the uninstalled apps */
+		queue_refresh_sizes (self, flatpak, list_tmp);
+
 		gs_flatpak_set_busy (flatpak, FALSE);
 	}
 
@@ -1747,11 +1926,26 @@ install_apps_thread_cb (GTask        *task,
 	while (g_hash_table_iter_next (&iter, NULL, &value)) {
 		GsAppList *apps_for_installation = GS_APP_LIST (value);
 
-		for (guint i = 0; i < gs_app_list_length (apps_for_installation); i++) {
-			GsApp *app = gs_app_list_index (apps_for_installation, i);
+		gs_app_list_set_state_many (apps_for_installation, GS_APP_STATE_INSTALLING);
+	}
 
-			gs_app_set_state (app, GS_APP_STATE_INSTALLING);
+	/* Download the apps for all installations at once, so the
+	 * transactions below only have to deploy them. */
+	if (!(data->flags & GS_PLUGIN_INSTALL_APPS_FLAGS_NO_DOWNLOAD) &&
+	    !(data->flags & GS_PLUGIN_INSTALL_APPS_FLAGS_NO_APPLY) &&
+	    gs_plugin_get_network_available (plugin)) {
+		gpointer schedule_entry_handle = NULL;
+
+		if (!interactive &&
+		    !gs_metered_block_app_list_on_download_scheduler (data->apps, &schedule_entry_handle, cancellable, &local_error)) {
+			g_warning ("Failed to block on download scheduler: %s",
+				   local_error->message);
+			g_clear_error (&local_error);
 		}
+
+		_download_in_parallel (self, applist_by_flatpaks, FALSE, interactive, cancellable);
+
+		remove_schedule_entry (schedule_entry_handle);
 	}
 
 	/* build and run transaction for each flatpak installation */
@@ -2023,6 +2217,9 @@ install_apps_thread_cb (GTask        *task,
 						  cancellable);
 		}
 
+		/* keep the recorded data sizes of the installed apps current */
+		queue_refresh_sizes (self, flatpak, list_tmp);
+
 		gs_flatpak_set_busy (flatpak, FALSE);
 	}
 
@@ -14,6 +14,8 @@
 #include "gnome-software-private.h"
 
 #include "gs-flatpak-app.h"
+#include "gs-flatpak-download.h"
+#include "gs-flatpak-utils.h"
 
 #include "gs-test.h"
 
@@ -1912,6 +1914,190 @@ gs_plugins_flatpak_runtime_extension_func (GsPluginLoader *plugin_loader)
 	g_assert_false (gs_app_is_installed (extension));
 }
 
+static FlatpakInstalledRef *
+changed_refs_test_new_ref (FlatpakRefKind  kind,
+                           const gchar    *name,
+                           const gchar    *commit)
+{
+	return g_object_new (FLATPAK_TYPE_INSTALLED_REF,
+			     "kind", kind,
+			     "name", name,
+			     "arch", flatpak_get_default_arch (),
+			     "branch", "master",
+			     "commit", commit,
+			     "origin", "test",
+			     NULL);
+}
+
+static void
+gs_plugins_flatpak_changed_refs_func (void)
+{
+	g_autoptr(GPtrArray) old_refs = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(GPtrArray) new_refs = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(GsPluginChange) change = gs_plugin_change_new ();
+	g_autoptr(GsApp) app = NULL;
+	GPtrArray *unique_ids;
+
+	/* an app is updated along with its locale extension and runtime, and
+	 * a debug extension is installed */
+	g_ptr_array_add (old_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_APP, "org.test.Chiron", "aaaa"));
+	g_ptr_array_add (old_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_RUNTIME, "org.test.Chiron.Locale", "bbbb"));
+	g_ptr_array_add (old_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_RUNTIME, "org.test.Runtime", "cccc"));
+	g_ptr_array_add (old_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_APP, "org.test.Unchanged", "dddd"));
+
+	g_ptr_array_add (new_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_APP, "org.test.Chiron", "eeee"));
+	g_ptr_array_add (new_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_RUNTIME, "org.test.Chiron.Locale", "ffff"));
+	g_ptr_array_add (new_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_RUNTIME, "org.test.Chiron.Debug", "0000"));
+	g_ptr_array_add (new_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_RUNTIME, "org.test.Runtime", "1111"));
+	g_ptr_array_add (new_refs, changed_refs_test_new_ref (FLATPAK_REF_KIND_APP, "org.test.Unchanged", "dddd"));
+
+	/* only the app is listed, so the installed page, which has a row for
+	 * it but never for the other refs, can update it in place rather than
+	 * reloading everything */
+	gs_flatpak_add_installed_refs_diff_to_change (change, AS_COMPONENT_SCOPE_USER, old_refs, new_refs);
+	g_assert_false (gs_plugin_change_is_empty (change));
+	unique_ids = gs_plugin_change_get_unique_ids (change);
+	g_assert_cmpuint (unique_ids->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (unique_ids, 0), ==, "user/flatpak/test/org.test.Chiron/master");
+
+	app = gs_flatpak_app_new ("org.test.Chiron");
+	gs_app_set_scope (app, AS_COMPONENT_SCOPE_USER);
+	gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_FLATPAK);
+	gs_app_set_origin (app, "test");
+	gs_app_set_branch (app, "master");
+	g_assert_true (gs_plugin_change_affects_app (change, app));
+
+	/* if only runtimes changed there are no apps to list */
+	g_clear_object (&change);
+	change = gs_plugin_change_new ();
+	g_ptr_array_remove_index (new_refs, 0);
+	g_ptr_array_insert (new_refs, 0, changed_refs_test_new_ref (FLATPAK_REF_KIND_APP, "org.test.Chiron", "aaaa"));
+	gs_flatpak_add_installed_refs_diff_to_change (change, AS_COMPONENT_SCOPE_USER, old_refs, new_refs);
+	g_assert_true (gs_plugin_change_is_empty (change));
+}
+
+static FlatpakInstallation *
+download_test_create_installation (const gchar *tmp_root,
+                                   const gchar *name,
+                                   const gchar *remote_name,
+                                   const gchar *repodir_fn)
+{
+	g_autofree gchar *path = g_build_filename (tmp_root, name, NULL);
+	g_autofree gchar *url = g_strdup_printf ("file://%s", repodir_fn);
+	g_autoptr(GFile) file = g_file_new_for_path (path);
+	g_autoptr(FlatpakInstallation) installation = NULL;
+	g_autoptr(FlatpakRemote) remote = NULL;
+	g_autoptr(GError) error = NULL;
+	gboolean ret;
+
+	installation = flatpak_installation_new_for_path (file, TRUE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (installation);
+
+	remote = flatpak_remote_new (remote_name);
+	flatpak_remote_set_url (remote, url);
+	flatpak_remote_set_gpg_verify (remote, FALSE);
+	ret = flatpak_installation_modify_remote (installation, remote, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	return g_steal_pointer (&installation);
+}
+
+static GsAppList *
+download_test_create_app_list (const gchar *origin)
+{
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GsApp) app = gs_flatpak_app_new ("org.test.Chiron");
+
+	gs_flatpak_app_set_ref_kind (app, FLATPAK_REF_KIND_APP);
+	gs_flatpak_app_set_ref_name (app, "org.test.Chiron");
+	gs_flatpak_app_set_ref_arch (app, flatpak_get_default_arch ());
+	gs_app_set_branch (app, "master");
+	gs_app_set_origin (app, origin);
+	gs_app_list_add (list, app);
+
+	return g_steal_pointer (&list);
+}
+
+static gboolean
+download_test_has_ref (FlatpakInstallation *installation,
+                       const gchar         *remote_name)
+{
+	g_autoptr(GFile) path = flatpak_installation_get_path (installation);
+	g_autofree gchar *ref_fn = NULL;
+
+	ref_fn = g_build_filename (g_file_peek_path (path), "repo", "refs", "remotes",
+				   remote_name, "app", "org.test.Chiron",
+				   flatpak_get_default_arch (), "master", NULL);
+
+	return g_file_test (ref_fn, G_FILE_TEST_IS_REGULAR);
+}
+
+static void
+gs_plugins_flatpak_download_in_parallel_func (void)
+{
+	g_autofree gchar *repodir_fn = NULL;
+	g_autofree gchar *missing_repodir_fn = NULL;
+	g_autofree gchar *tmp_root = NULL;
+	g_autoptr(FlatpakInstallation) installation1 = NULL;
+	g_autoptr(FlatpakInstallation) installation2 = NULL;
+	g_autoptr(FlatpakInstallation) installation3 = NULL;
+	g_autoptr(FlatpakInstallation) installation4 = NULL;
+	g_autoptr(GHashTable) apps_by_installation = NULL;
+	g_autoptr(GError) error = NULL;
+	gboolean ret;
+
+	/* no files to use */
+	repodir_fn = gs_test_get_filename (TESTDATADIR, "app-with-runtime/repo");
+	if (repodir_fn == NULL ||
+	    !g_file_test (repodir_fn, G_FILE_TEST_EXISTS)) {
+		g_test_skip ("no flatpak test repo");
+		return;
+	}
+
+	tmp_root = g_dir_make_tmp ("gnome-software-flatpak-download-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	/* two installations, each with its own remote serving the same repo */
+	installation1 = download_test_create_installation (tmp_root, "installation1", "test1", repodir_fn);
+	installation2 = download_test_create_installation (tmp_root, "installation2", "test2", repodir_fn);
+
+	apps_by_installation = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						      g_object_unref, g_object_unref);
+	g_hash_table_insert (apps_by_installation, g_object_ref (installation1),
+			     download_test_create_app_list ("test1"));
+	g_hash_table_insert (apps_by_installation, g_object_ref (installation2),
+			     download_test_create_app_list ("test2"));
+
+	/* both installations should have the app downloaded */
+	ret = gs_flatpak_download_in_parallel (apps_by_installation, FALSE, 2, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_true (download_test_has_ref (installation1, "test1"));
+	g_assert_true (download_test_has_ref (installation2, "test2"));
+
+	/* a remote which can’t be pulled from should fail the call, without
+	 * stopping the download for the other installation */
+	missing_repodir_fn = g_build_filename (tmp_root, "missing-repo", NULL);
+	installation3 = download_test_create_installation (tmp_root, "installation3", "broken", missing_repodir_fn);
+	installation4 = download_test_create_installation (tmp_root, "installation4", "test4", repodir_fn);
+
+	g_hash_table_remove_all (apps_by_installation);
+	g_hash_table_insert (apps_by_installation, g_object_ref (installation3),
+			     download_test_create_app_list ("broken"));
+	g_hash_table_insert (apps_by_installation, g_object_ref (installation4),
+			     download_test_create_app_list ("test4"));
+
+	ret = gs_flatpak_download_in_parallel (apps_by_installation, FALSE, 2, NULL, &error);
+	g_assert_nonnull (error);
+	g_assert_false (ret);
+	g_assert_false (download_test_has_ref (installation3, "broken"));
+	g_assert_true (download_test_has_ref (installation4, "test4"));
+
+	gs_utils_rmtree (tmp_root, NULL);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -2002,6 +2188,10 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/flatpak/repo{non-ascii}",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_flatpak_repo_non_ascii_func);
+	g_test_add_func ("/gnome-software/plugins/flatpak/changed-refs",
+			 gs_plugins_flatpak_changed_refs_func);
+	g_test_add_func ("/gnome-software/plugins/flatpak/download-in-parallel",
+			 gs_plugins_flatpak_download_in_parallel_func);
 	retval = g_test_run ();
 
 	/* Clean up. */
@@ -360,6 +360,24 @@ gs_fwupd_release_urgency_to_as_urgency_kind (FwupdReleaseUrgency urgency)
 	}
 }
 
+/* Convert an AppStream release description into the markup shown for the
+ * update; see gs_app_set_update_details_lazy(). */
+static gchar *
+gs_fwupd_app_convert_update_details (const gchar *description)
+{
+	g_autofree gchar *tmp = NULL;
+
+#if AS_CHECK_VERSION(1, 0, 0)
+	tmp = as_markup_convert (description, AS_MARKUP_KIND_TEXT, NULL);
+#else
+	tmp = as_markup_convert_simple (description, NULL);
+#endif
+	if (tmp == NULL)
+		return NULL;
+
+	return g_markup_escape_text (tmp, -1);
+}
+
 void
 gs_fwupd_app_set_from_release (GsApp *app, FwupdRelease *rel)
 {
@@ -395,14 +413,8 @@ gs_fwupd_app_set_from_release (GsApp *app, FwupdRelease *rel)
 		gs_fwupd_app_set_update_uri (app, uri);
 	}
 	if (fwupd_release_get_description (rel) != NULL) {
-		g_autofree gchar *tmp = NULL;
-#if AS_CHECK_VERSION(1, 0, 0)
-		tmp = as_markup_convert (fwupd_release_get_description (rel), AS_MARKUP_KIND_TEXT, NULL);
-#else
-		tmp = as_markup_convert_simple (fwupd_release_get_description (rel), NULL);
-#endif
-		if (tmp != NULL)
-			gs_app_set_update_details_text (app, tmp);
+		gs_app_set_update_details_lazy (app, fwupd_release_get_description (rel),
+						gs_fwupd_app_convert_update_details);
 	}
 	if (fwupd_release_get_detach_image (rel) != NULL) {
 		g_autoptr(AsScreenshot) ss = as_screenshot_new ();
@@ -82,8 +82,33 @@ struct _GsPluginPackagekit {
 
 	GHashTable		*cached_sources; /* (nullable) (owned) (element-type utf8 GsApp); sources by id, each value is weak reffed */
 	GMutex			 cached_sources_mutex;
+
+	GHashTable		*history_cache;  /* (owned) (element-type utf8 HistoryCacheEntry); package history by package name */
+	guint			 history_stamp;  /* bumped whenever the package database may have changed */
+	GMutex			 history_cache_mutex;
 };
 
+typedef struct {
+	guint		 stamp;  /* value of history_stamp when the history was fetched */
+	GVariant	*entries;  /* (owned) (nullable) (type aa{sv}); NULL if PackageKit has no history for the package */
+} HistoryCacheEntry;
+
+static void
+history_cache_entry_free (HistoryCacheEntry *entry)
+{
+	g_clear_pointer (&entry->entries, g_variant_unref);
+	g_free (entry);
+}
+
+/* Mark all the cached package history as out of date, after something
+ * changed the package database. Entries are refetched lazily. */
+static void
+gs_plugin_packagekit_invalidate_history (GsPluginPackagekit *self)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->history_cache_mutex);
+	self->history_stamp++;
+}
+
 G_DEFINE_TYPE (GsPluginPackagekit, gs_plugin_packagekit, GS_TYPE_PLUGIN)
 
 static void gs_plugin_packagekit_installed_changed_cb (PkControl *control, GsPlugin *plugin);
@@ -194,6 +219,11 @@ gs_plugin_packagekit_init (GsPluginPackagekit *self)
 
 	g_mutex_init (&self->cached_sources_mutex);
 
+	/* history */
+	g_mutex_init (&self->history_cache_mutex);
+	self->history_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, (GDestroyNotify) history_cache_entry_free);
+
 	/* need pkgname and ID */
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_AFTER, "appstream");
 
@@ -205,6 +235,10 @@ gs_plugin_packagekit_init (GsPluginPackagekit *self)
 
 	/* generic updates happen after PackageKit offline updates */
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_BEFORE, "generic-updates");
+
+	/* see gs_plugin_adopt_app() */
+	gs_plugin_add_adopt_bundle_kind (plugin, AS_BUNDLE_KIND_PACKAGE);
+	gs_plugin_add_adopt_component_kind (plugin, AS_COMPONENT_KIND_OPERATING_SYSTEM);
 }
 
 static void
@@ -260,6 +294,9 @@ gs_plugin_packagekit_finalize (GObject *object)
 	g_mutex_clear (&self->prepared_updates_mutex);
 	g_mutex_clear (&self->cached_sources_mutex);
 
+	g_hash_table_unref (self->history_cache);
+	g_mutex_clear (&self->history_cache_mutex);
+
 	G_OBJECT_CLASS (gs_plugin_packagekit_parent_class)->finalize (object);
 }
 
@@ -893,6 +930,7 @@ install_apps_remote_cb (GObject      *source_object,
 		gs_app_clear_source_ids (app);
 	}
 
+	gs_plugin_packagekit_invalidate_history (self);
 	finish_install_apps_install_op (task, NULL);
 }
 
@@ -948,6 +986,7 @@ install_apps_local_cb (GObject      *source_object,
 		gs_app_clear_source_ids (app);
 	}
 
+	gs_plugin_packagekit_invalidate_history (self);
 	finish_install_apps_install_op (task, NULL);
 }
 
@@ -1210,6 +1249,8 @@ uninstall_apps_remove_cb (GObject      *source_object,
 		gs_app_clear_source_ids (app);
 	}
 
+	gs_plugin_packagekit_invalidate_history (self);
+
 	/* Refine the apps so their state is up to date again. */
 	gs_plugin_packagekit_refine_async (GS_PLUGIN (self),
 					   data->apps_to_uninstall,
@@ -1761,24 +1802,23 @@ static void
 gs_plugin_packagekit_invoke_reload (GsPlugin *plugin)
 {
 	g_autoptr(GsAppList) list = gs_plugin_list_cached (plugin);
-	guint sz = gs_app_list_length (list);
-	for (guint i = 0; i < sz; i++) {
-		GsApp *app = gs_app_list_index (list, i);
-		/* to ensure the app states are refined */
-		gs_app_set_state (app, GS_APP_STATE_UNKNOWN);
-	}
+
+	/* to ensure the app states are refined */
+	gs_app_list_set_state_many (list, GS_APP_STATE_UNKNOWN);
 	gs_plugin_reload (plugin);
 }
 
 static void
 gs_plugin_packagekit_installed_changed_cb (PkControl *control, GsPlugin *plugin)
 {
+	gs_plugin_packagekit_invalidate_history (GS_PLUGIN_PACKAGEKIT (plugin));
 	gs_plugin_packagekit_invoke_reload (plugin);
 }
 
 static void
 gs_plugin_packagekit_updates_changed_cb (PkControl *control, GsPlugin *plugin)
 {
+	gs_plugin_packagekit_invalidate_history (GS_PLUGIN_PACKAGEKIT (plugin));
 	gs_plugin_updates_changed (plugin);
 }
 
@@ -1993,9 +2033,9 @@ gs_plugin_refine_requires_version (GsApp *app, GsPluginRefineFlags flags)
 static gboolean
 gs_plugin_refine_requires_update_details (GsApp *app, GsPluginRefineFlags flags)
 {
-	const gchar *tmp;
-	tmp = gs_app_get_update_details_markup (app);
-	if (tmp != NULL)
+	/* don’t use gs_app_get_update_details_markup() here, as that would
+	 * convert details which were set lazily */
+	if (gs_app_get_update_details_set (app))
 		return FALSE;
 	return (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_UPDATE_DETAILS) > 0;
 }
@@ -2948,6 +2988,7 @@ get_update_detail_cb (GObject      *source_object,
 	RefineData *data = g_task_get_task_data (refine_task);
 	g_autoptr(PkResults) results = NULL;
 	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GHashTable) details_by_package_id = NULL;
 	g_autoptr(GError) local_error = NULL;
 
 	results = pk_client_generic_finish (client, result, &local_error);
@@ -2957,27 +2998,36 @@ get_update_detail_cb (GObject      *source_object,
 		return;
 	}
 
-	/* set the update details for the update */
+	/* index the results, as an OS update can cover thousands of packages;
+	 * the first result for each package wins */
 	array = pk_results_get_update_detail_array (results);
+	details_by_package_id = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < array->len; i++) {
+		PkUpdateDetail *update_detail = g_ptr_array_index (array, i);
+		const gchar *package_id = pk_update_detail_get_package_id (update_detail);
+
+		if (package_id != NULL && !g_hash_table_contains (details_by_package_id, package_id))
+			g_hash_table_insert (details_by_package_id, (gpointer) package_id, update_detail);
+	}
+
+	/* set the update details for the update; they are only converted from
+	 * markdown when first displayed */
 	for (guint j = 0; j < gs_app_list_length (data->update_details_list); j++) {
 		GsApp *app = gs_app_list_index (data->update_details_list, j);
 		const gchar *package_id = gs_app_get_source_id_default (app);
+		PkUpdateDetail *update_detail;
+		const gchar *tmp;
 
-		for (guint i = 0; i < array->len; i++) {
-			const gchar *tmp;
-			g_autofree gchar *desc = NULL;
-			PkUpdateDetail *update_detail;
+		if (package_id == NULL)
+			continue;
 
-			/* right package? */
-			update_detail = g_ptr_array_index (array, i);
-			if (g_strcmp0 (package_id, pk_update_detail_get_package_id (update_detail)) != 0)
-				continue;
-			tmp = pk_update_detail_get_update_text (update_detail);
-			desc = gs_plugin_packagekit_fixup_update_description (tmp);
-			if (desc != NULL)
-				gs_app_set_update_details_markup (app, desc);
-			break;
-		}
+		update_detail = g_hash_table_lookup (details_by_package_id, package_id);
+		if (update_detail == NULL)
+			continue;
+
+		tmp = pk_update_detail_get_update_text (update_detail);
+		if (tmp != NULL)
+			gs_app_set_update_details_lazy (app, tmp, gs_plugin_packagekit_fixup_update_description);
 	}
 
 	refine_task_complete_operation (refine_task);
@@ -3306,6 +3356,7 @@ gs_plugin_packagekit_prepared_update_changed_cb (GFileMonitor      *monitor,
 	}
 
 	/* update UI */
+	gs_plugin_packagekit_invalidate_history (self);
 	gs_plugin_systemd_update_cache (self, NULL, NULL);
 	gs_plugin_updates_changed (GS_PLUGIN (self));
 }
@@ -3330,6 +3381,7 @@ gs_plugin_systemd_trigger_changed_cb (GFileMonitor *monitor,
 {
 	GsPluginPackagekit *self = GS_PLUGIN_PACKAGEKIT (user_data);
 
+	gs_plugin_packagekit_invalidate_history (self);
 	gs_plugin_packagekit_refresh_is_triggered (self, NULL);
 }
 
@@ -3502,6 +3554,56 @@ gs_plugin_packagekit_shutdown_finish (GsPlugin      *plugin,
 	return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/* Add the history in @entries to @app. If @entries is %NULL, PackageKit has no
+ * history for the package. */
+static void
+refine_app_history (GsPluginPackagekit *self,
+                    GsApp              *app,
+                    GVariant           *entries)
+{
+	GsPlugin *plugin = GS_PLUGIN (self);
+	GVariantIter iter;
+	GVariant *value;
+
+	if (entries == NULL) {
+		/* make up a fake entry as we know this package was at
+		 * least installed at some point in time */
+		if (gs_app_get_state (app) == GS_APP_STATE_INSTALLED) {
+			g_autoptr(GsApp) app_dummy = NULL;
+			app_dummy = gs_app_new (gs_app_get_id (app));
+			gs_plugin_packagekit_set_packaging_format (plugin, app);
+			gs_app_set_metadata (app_dummy, "GnomeSoftware::Creator",
+					     gs_plugin_get_name (plugin));
+			gs_app_set_install_date (app_dummy, GS_APP_INSTALL_DATE_UNKNOWN);
+			gs_app_set_kind (app_dummy, AS_COMPONENT_KIND_GENERIC);
+			gs_app_set_state (app_dummy, GS_APP_STATE_INSTALLED);
+			gs_app_set_version (app_dummy, gs_app_get_version (app));
+			gs_app_add_history (app, app_dummy);
+		}
+		gs_app_set_install_date (app, GS_APP_INSTALL_DATE_UNKNOWN);
+		return;
+	}
+
+	/* add history for application */
+	g_variant_iter_init (&iter, entries);
+	while ((value = g_variant_iter_next_value (&iter))) {
+		gs_plugin_packagekit_refine_add_history (app, value);
+		g_variant_unref (value);
+	}
+}
+
+typedef struct {
+	GsAppList	*list;  /* (owned) (not nullable); apps whose history is not cached */
+	guint		 stamp;  /* value of history_stamp when the query was started */
+} RefineHistoryData;
+
+static void
+refine_history_data_free (RefineHistoryData *data)
+{
+	g_clear_object (&data->list);
+	g_free (data);
+}
+
 static void refine_history_cb (GObject      *source_object,
                                GAsyncResult *result,
                                gpointer      user_data);
@@ -3516,19 +3618,56 @@ gs_plugin_packagekit_refine_history_async (GsPluginPackagekit  *self,
 	GsApp *app;
 	g_autofree const gchar **package_names = NULL;
 	g_autoptr(GTask) task = NULL;
+	RefineHistoryData *data;
 
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_source_tag (task, gs_plugin_packagekit_refine_history_async);
-	g_task_set_task_data (task, g_object_ref (list), (GDestroyNotify) g_object_unref);
 
-	/* get an array of package names */
-	package_names = g_new0 (const gchar *, gs_app_list_length (list) + 1);
+	data = g_new0 (RefineHistoryData, 1);
+	data->list = gs_app_list_new ();
+	g_task_set_task_data (task, data, (GDestroyNotify) refine_history_data_free);
+
+	/* use the cached history where it’s still current, and only ask
+	 * PackageKit about the rest */
 	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		HistoryCacheEntry *entry;
+		g_autoptr(GVariant) entries = NULL;
+		gboolean cached = FALSE;
+
 		app = gs_app_list_index (list, i);
+
+		g_mutex_lock (&self->history_cache_mutex);
+		data->stamp = self->history_stamp;
+		entry = g_hash_table_lookup (self->history_cache, gs_app_get_source_default (app));
+		if (entry != NULL && entry->stamp == self->history_stamp) {
+			cached = TRUE;
+			if (entry->entries != NULL)
+				entries = g_variant_ref (entry->entries);
+		}
+		g_mutex_unlock (&self->history_cache_mutex);
+
+		if (cached)
+			refine_app_history (self, app, entries);
+		else
+			gs_app_list_add (data->list, app);
+	}
+
+	if (gs_app_list_length (data->list) == 0) {
+		g_debug ("got history for %u packages from the cache", gs_app_list_length (list));
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	/* get an array of package names */
+	package_names = g_new0 (const gchar *, gs_app_list_length (data->list) + 1);
+	for (guint i = 0; i < gs_app_list_length (data->list); i++) {
+		app = gs_app_list_index (data->list, i);
 		package_names[i] = gs_app_get_source_default (app);
 	}
 
-	g_debug ("getting history for %u packages", gs_app_list_length (list));
+	g_debug ("getting history for %u packages (%u cached)",
+		 gs_app_list_length (data->list),
+		 gs_app_list_length (list) - gs_app_list_length (data->list));
 	g_dbus_connection_call (gs_plugin_get_system_bus_connection (GS_PLUGIN (self)),
 				"org.freedesktop.PackageKit",
 				"/org/freedesktop/PackageKit",
@@ -3551,12 +3690,9 @@ refine_history_cb (GObject      *source_object,
 	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	g_autoptr(GTask) task = g_steal_pointer (&user_data);
 	GsPluginPackagekit *self = g_task_get_source_object (task);
-	GsPlugin *plugin = GS_PLUGIN (self);
-	GsAppList *list = g_task_get_task_data (task);
-	gboolean ret;
+	RefineHistoryData *data = g_task_get_task_data (task);
+	GsAppList *list = data->list;
 	guint i = 0;
-	GVariantIter iter;
-	GVariant *value;
 	g_autoptr(GVariant) result_variant = NULL;
 	g_autoptr(GVariant) tuple = NULL;
 	g_autoptr(GError) error_local = NULL;
@@ -3610,35 +3746,23 @@ refine_history_cb (GObject      *source_object,
 	for (i = 0; i < gs_app_list_length (list); i++) {
 		g_autoptr(GVariant) entries = NULL;
 		GsApp *app = gs_app_list_index (list, i);
-		ret = g_variant_lookup (tuple,
-					gs_app_get_source_default (app),
-					"@aa{sv}",
-					&entries);
-		if (!ret) {
-			/* make up a fake entry as we know this package was at
-			 * least installed at some point in time */
-			if (gs_app_get_state (app) == GS_APP_STATE_INSTALLED) {
-				g_autoptr(GsApp) app_dummy = NULL;
-				app_dummy = gs_app_new (gs_app_get_id (app));
-				gs_plugin_packagekit_set_packaging_format (plugin, app);
-				gs_app_set_metadata (app_dummy, "GnomeSoftware::Creator",
-						     gs_plugin_get_name (plugin));
-				gs_app_set_install_date (app_dummy, GS_APP_INSTALL_DATE_UNKNOWN);
-				gs_app_set_kind (app_dummy, AS_COMPONENT_KIND_GENERIC);
-				gs_app_set_state (app_dummy, GS_APP_STATE_INSTALLED);
-				gs_app_set_version (app_dummy, gs_app_get_version (app));
-				gs_app_add_history (app, app_dummy);
-			}
-			gs_app_set_install_date (app, GS_APP_INSTALL_DATE_UNKNOWN);
-			continue;
+		const gchar *package_name = gs_app_get_source_default (app);
+
+		/* @entries is left as NULL if there’s no history */
+		g_variant_lookup (tuple, package_name, "@aa{sv}", &entries);
+
+		/* only cache the history if the package database hasn’t
+		 * changed since the query started */
+		g_mutex_lock (&self->history_cache_mutex);
+		if (data->stamp == self->history_stamp) {
+			HistoryCacheEntry *entry = g_new0 (HistoryCacheEntry, 1);
+			entry->stamp = data->stamp;
+			entry->entries = (entries != NULL) ? g_variant_ref (entries) : NULL;
+			g_hash_table_replace (self->history_cache, g_strdup (package_name), entry);
 		}
+		g_mutex_unlock (&self->history_cache_mutex);
 
-		/* add history for application */
-		g_variant_iter_init (&iter, entries);
-		while ((value = g_variant_iter_next_value (&iter))) {
-			gs_plugin_packagekit_refine_add_history (app, value);
-			g_variant_unref (value);
-		}
+		refine_app_history (self, app, entries);
 	}
 
 	g_task_return_boolean (task, TRUE);
@@ -0,0 +1,488 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <gnome-software.h>
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+#include "gs-plugin-replay.h"
+#include "gs-plugin-trace.h"
+
+/*
+ * SECTION:
+ * Serves the apps from a plugin trace recorded with
+ * `GS_PLUGIN_RECORD_TRACE=/path/to/trace`, so that the plugin loader, refine
+ * pipeline and UI can be benchmarked on any machine, without PackageKit,
+ * flatpak remotes, snapd, fwupd or whichever other services were used when
+ * recording.
+ *
+ * The plugin is only enabled if `GS_PLUGIN_REPLAY_TRACE` is set to the path
+ * of a trace. It should normally be used on its own, by also setting
+ * `GNOME_SOFTWARE_PLUGINS_ALLOWLIST=replay`.
+ *
+ * Calls are matched with recorded calls by their input, and take as long as
+ * the recorded calls did. List apps calls to different plugins ran in
+ * parallel, so a replayed one takes as long as the slowest of them. Refine
+ * calls to different plugins ran in sequence, so a replayed refine takes as
+ * long as the recorded per-app cost of each plugin, summed over the plugins
+ * and the apps being refined.
+ *
+ * The trace is loaded in a worker thread during setup, and is read-only
+ * afterwards, so no locking is needed.
+ */
+
+struct _GsPluginReplay
+{
+	GsPlugin	 parent;
+
+	gchar		*trace_path;  /* (owned) (nullable) */
+
+	/* Loaded from the trace in setup, and read-only afterwards. */
+	GHashTable	*apps;  /* (owned) (element-type utf8 JsonNode) unique ID → last recorded snapshot */
+	GHashTable	*list_apps_calls;  /* (owned) (element-type utf8 ReplayListAppsCall) query key → call */
+	GHashTable	*refine_costs;  /* (owned) (element-type utf8 gint64) unique ID → refine cost in µs */
+};
+
+G_DEFINE_TYPE (GsPluginReplay, gs_plugin_replay, GS_TYPE_PLUGIN)
+
+typedef struct {
+	GPtrArray *unique_ids;  /* (owned) (element-type utf8) */
+	GHashTable *unique_ids_set;  /* (owned) (element-type utf8 utf8) (nullable); unowned keys, only used while loading */
+	gint64 duration_usec;
+} ReplayListAppsCall;
+
+static void
+replay_list_apps_call_free (ReplayListAppsCall *call)
+{
+	g_ptr_array_unref (call->unique_ids);
+	g_clear_pointer (&call->unique_ids_set, g_hash_table_unref);
+	g_free (call);
+}
+
+static void
+gs_plugin_replay_init (GsPluginReplay *self)
+{
+	GsPlugin *plugin = GS_PLUGIN (self);
+
+	self->trace_path = g_strdup (g_getenv ("GS_PLUGIN_REPLAY_TRACE"));
+	if (self->trace_path == NULL) {
+		gs_plugin_set_enabled (plugin, FALSE);
+		g_debug ("disabling itself as GS_PLUGIN_REPLAY_TRACE is not set");
+		return;
+	}
+
+	self->apps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) json_node_unref);
+	self->list_apps_calls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) replay_list_apps_call_free);
+	self->refine_costs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+gs_plugin_replay_finalize (GObject *object)
+{
+	GsPluginReplay *self = GS_PLUGIN_REPLAY (object);
+
+	g_free (self->trace_path);
+	g_clear_pointer (&self->apps, g_hash_table_unref);
+	g_clear_pointer (&self->list_apps_calls, g_hash_table_unref);
+	g_clear_pointer (&self->refine_costs, g_hash_table_unref);
+
+	G_OBJECT_CLASS (gs_plugin_replay_parent_class)->finalize (object);
+}
+
+static void
+load_list_apps_call (GsPluginReplay *self,
+                     JsonObject     *object)
+{
+	const gchar *input = json_object_get_string_member_with_default (object, "input", "");
+	gint64 duration_usec = json_object_get_int_member_with_default (object, "duration-usec", 0);
+	JsonArray *apps = json_object_has_member (object, "apps") ? json_object_get_array_member (object, "apps") : NULL;
+	ReplayListAppsCall *call;
+
+	call = g_hash_table_lookup (self->list_apps_calls, input);
+	if (call == NULL) {
+		call = g_new0 (ReplayListAppsCall, 1);
+		call->unique_ids = g_ptr_array_new_with_free_func (g_free);
+		call->unique_ids_set = g_hash_table_new (g_str_hash, g_str_equal);
+		g_hash_table_insert (self->list_apps_calls, g_strdup (input), call);
+	}
+
+	/* plugins are queried in parallel, so the slowest one determines the
+	 * overall duration; and if the same query was recorded several times,
+	 * take the slowest to be conservative */
+	call->duration_usec = MAX (call->duration_usec, duration_usec);
+
+	for (guint i = 0; apps != NULL && i < json_array_get_length (apps); i++) {
+		const gchar *unique_id = json_array_get_string_element (apps, i);
+		gchar *unique_id_owned;
+
+		if (unique_id == NULL || g_hash_table_contains (call->unique_ids_set, unique_id))
+			continue;
+
+		unique_id_owned = g_strdup (unique_id);
+		g_ptr_array_add (call->unique_ids, unique_id_owned);
+		g_hash_table_add (call->unique_ids_set, unique_id_owned);
+	}
+}
+
+static void
+load_refine_call (JsonObject *object,
+                  GHashTable *plugin_app_costs)
+{
+	const gchar *plugin_name = json_object_get_string_member_with_default (object, "plugin", "");
+	gint64 duration_usec = json_object_get_int_member_with_default (object, "duration-usec", 0);
+	JsonArray *apps = json_object_has_member (object, "apps") ? json_object_get_array_member (object, "apps") : NULL;
+	guint n_apps = (apps != NULL) ? json_array_get_length (apps) : 0;
+	gint64 per_app_cost;
+
+	if (n_apps == 0)
+		return;
+
+	per_app_cost = duration_usec / n_apps;
+
+	for (guint i = 0; i < n_apps; i++) {
+		const gchar *unique_id = json_array_get_string_element (apps, i);
+		g_autofree gchar *key = NULL;
+		gint64 *cost;
+
+		if (unique_id == NULL)
+			continue;
+
+		key = g_strdup_printf ("%s\n%s", plugin_name, unique_id);
+		cost = g_hash_table_lookup (plugin_app_costs, key);
+		if (cost == NULL) {
+			cost = g_new0 (gint64, 1);
+			g_hash_table_insert (plugin_app_costs, g_steal_pointer (&key), cost);
+		}
+
+		*cost = MAX (*cost, per_app_cost);
+	}
+}
+
+static gboolean
+load_trace (GsPluginReplay  *self,
+            GCancellable    *cancellable,
+            GError         **error)
+{
+	g_autofree gchar *contents = NULL;
+	g_auto(GStrv) lines = NULL;
+	g_autoptr(JsonParser) parser = json_parser_new_immutable ();
+	g_autoptr(GHashTable) plugin_app_costs = NULL;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (!g_file_get_contents (self->trace_path, &contents, NULL, error)) {
+		gs_utils_error_convert_gio (error);
+		return FALSE;
+	}
+
+	/* plugin name + unique ID → per-app refine cost */
+	plugin_app_costs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	lines = g_strsplit (contents, "\n", -1);
+	g_clear_pointer (&contents, g_free);
+
+	for (gsize i = 0; lines[i] != NULL; i++) {
+		JsonNode *root;
+		JsonObject *object;
+		g_autoptr(GError) local_error = NULL;
+
+		if (lines[i][0] == '\0')
+			continue;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+			return FALSE;
+
+		if (!json_parser_load_from_data (parser, lines[i], -1, &local_error)) {
+			g_set_error (error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_INVALID_FORMAT,
+				     "Invalid plugin trace line %" G_GSIZE_FORMAT ": %s",
+				     i + 1, local_error->message);
+			return FALSE;
+		}
+
+		root = json_parser_get_root (parser);
+		if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root))
+			continue;
+		object = json_node_get_object (root);
+
+		if (json_object_has_member (object, "app")) {
+			JsonNode *app_node = json_object_get_member (object, "app");
+			g_autoptr(GsApp) app = gs_app_new (NULL);
+
+			/* work out the unique ID the same way as the recording
+			 * did, by building an app */
+			if (!gs_plugin_trace_app_apply_node (app, app_node, &local_error)) {
+				g_set_error (error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_INVALID_FORMAT,
+					     "Invalid app on plugin trace line %" G_GSIZE_FORMAT ": %s",
+					     i + 1, local_error->message);
+				return FALSE;
+			}
+
+			if (gs_app_get_unique_id (app) != NULL)
+				g_hash_table_replace (self->apps,
+						      g_strdup (gs_app_get_unique_id (app)),
+						      json_node_copy (app_node));
+		} else if (g_strcmp0 (json_object_get_string_member_with_default (object, "call", NULL),
+				      GS_PLUGIN_TRACE_CALL_LIST_APPS) == 0) {
+			load_list_apps_call (self, object);
+		} else if (g_strcmp0 (json_object_get_string_member_with_default (object, "call", NULL),
+				      GS_PLUGIN_TRACE_CALL_REFINE) == 0) {
+			load_refine_call (object, plugin_app_costs);
+		}
+	}
+
+	/* Sum the per-app refine costs over all the plugins which refined
+	 * each app, as refine calls to different plugins run in sequence. */
+	g_hash_table_iter_init (&iter, plugin_app_costs);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const gchar *unique_id = strchr (key, '\n') + 1;
+		const gint64 *plugin_cost = value;
+		gint64 *cost;
+
+		cost = g_hash_table_lookup (self->refine_costs, unique_id);
+		if (cost == NULL) {
+			cost = g_new0 (gint64, 1);
+			g_hash_table_insert (self->refine_costs, g_strdup (unique_id), cost);
+		}
+
+		*cost += *plugin_cost;
+	}
+
+	/* the sets were only needed for de-duplication while loading */
+	g_hash_table_iter_init (&iter, self->list_apps_calls);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		ReplayListAppsCall *call = value;
+		g_clear_pointer (&call->unique_ids_set, g_hash_table_unref);
+	}
+
+	g_debug ("Loaded plugin trace %s: %u apps, %u list-apps queries",
+		 self->trace_path,
+		 g_hash_table_size (self->apps),
+		 g_hash_table_size (self->list_apps_calls));
+
+	return TRUE;
+}
+
+static void
+setup_thread_cb (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+	GsPluginReplay *self = GS_PLUGIN_REPLAY (source_object);
+	g_autoptr(GError) local_error = NULL;
+
+	if (!load_trace (self, cancellable, &local_error))
+		g_task_return_error (task, g_steal_pointer (&local_error));
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static void
+gs_plugin_replay_setup_async (GsPlugin            *plugin,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+	g_autoptr(GTask) task = NULL;
+
+	task = g_task_new (plugin, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_plugin_replay_setup_async);
+
+	/* traces can be large, so parse them off the main thread */
+	g_task_run_in_thread (task, setup_thread_cb);
+}
+
+static gboolean
+gs_plugin_replay_setup_finish (GsPlugin      *plugin,
+                               GAsyncResult  *result,
+                               GError       **error)
+{
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Return the result of @task after @duration_usec, to replay the recorded
+ * latency of a call. */
+static void
+return_after_delay (GTask       *task,
+                    gint64       duration_usec,
+                    GSourceFunc  callback)
+{
+	g_autoptr(GSource) source = NULL;
+
+	if (duration_usec >= 1000)
+		source = g_timeout_source_new (duration_usec / 1000);
+	else
+		source = g_idle_source_new ();
+
+	g_task_attach_source (task, source, callback);
+}
+
+static GsApp *
+get_app_for_unique_id (GsPluginReplay *self,
+                       const gchar    *unique_id)
+{
+	GsPlugin *plugin = GS_PLUGIN (self);
+	JsonNode *app_node;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	/* return the same #GsApp each time, as real plugins do */
+	app = gs_plugin_cache_lookup (plugin, unique_id);
+	if (app != NULL)
+		return g_steal_pointer (&app);
+
+	app_node = g_hash_table_lookup (self->apps, unique_id);
+	if (app_node == NULL)
+		return NULL;
+
+	app = gs_app_new (NULL);
+	if (!gs_plugin_trace_app_apply_node (app, app_node, &local_error)) {
+		g_debug ("Failed to replay app %s: %s", unique_id, local_error->message);
+		return NULL;
+	}
+	gs_app_set_management_plugin (app, plugin);
+	gs_plugin_cache_add (plugin, unique_id, app);
+
+	return g_steal_pointer (&app);
+}
+
+static gboolean
+list_apps_return_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GsAppList *list = g_object_get_data (G_OBJECT (task), "list");
+
+	g_task_return_pointer (task, g_object_ref (list), g_object_unref);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gs_plugin_replay_list_apps_async (GsPlugin              *plugin,
+                                  GsAppQuery            *query,
+                                  GsPluginListAppsFlags  flags,
+                                  GCancellable          *cancellable,
+                                  GAsyncReadyCallback    callback,
+                                  gpointer               user_data)
+{
+	GsPluginReplay *self = GS_PLUGIN_REPLAY (plugin);
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autofree gchar *query_key = NULL;
+	ReplayListAppsCall *call;
+
+	task = gs_plugin_list_apps_data_new_task (plugin, query, flags, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_plugin_replay_list_apps_async);
+
+	query_key = (query != NULL) ? gs_plugin_trace_query_to_key (query) : g_strdup ("");
+	call = g_hash_table_lookup (self->list_apps_calls, query_key);
+
+	if (call == NULL) {
+		g_debug ("No recorded results for query ‘%s’", query_key);
+		g_task_return_pointer (task, g_steal_pointer (&list), g_object_unref);
+		return;
+	}
+
+	for (guint i = 0; i < call->unique_ids->len; i++) {
+		g_autoptr(GsApp) app = get_app_for_unique_id (self, g_ptr_array_index (call->unique_ids, i));
+
+		if (app != NULL)
+			gs_app_list_add (list, app);
+	}
+
+	g_object_set_data_full (G_OBJECT (task), "list", g_steal_pointer (&list), g_object_unref);
+	return_after_delay (task, call->duration_usec, list_apps_return_cb);
+}
+
+static GsAppList *
+gs_plugin_replay_list_apps_finish (GsPlugin      *plugin,
+                                   GAsyncResult  *result,
+                                   GError       **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static gboolean
+refine_return_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+
+	g_task_return_boolean (task, TRUE);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gs_plugin_replay_refine_async (GsPlugin            *plugin,
+                               GsAppList           *list,
+                               GsPluginRefineFlags  flags,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+	GsPluginReplay *self = GS_PLUGIN_REPLAY (plugin);
+	g_autoptr(GTask) task = NULL;
+	gint64 duration_usec = 0;
+
+	task = gs_plugin_refine_data_new_task (plugin, list, flags, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_plugin_replay_refine_async);
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		const gchar *unique_id = gs_app_get_unique_id (app);
+		JsonNode *app_node;
+		const gint64 *cost;
+		g_autoptr(GError) local_error = NULL;
+
+		if (unique_id == NULL)
+			continue;
+
+		app_node = g_hash_table_lookup (self->apps, unique_id);
+		if (app_node != NULL &&
+		    !gs_plugin_trace_app_apply_node (app, app_node, &local_error))
+			g_debug ("Failed to replay app %s: %s", unique_id, local_error->message);
+
+		cost = g_hash_table_lookup (self->refine_costs, unique_id);
+		if (cost != NULL)
+			duration_usec += *cost;
+	}
+
+	return_after_delay (task, duration_usec, refine_return_cb);
+}
+
+static gboolean
+gs_plugin_replay_refine_finish (GsPlugin      *plugin,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+gs_plugin_replay_class_init (GsPluginReplayClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GsPluginClass *plugin_class = GS_PLUGIN_CLASS (klass);
+
+	object_class->finalize = gs_plugin_replay_finalize;
+
+	plugin_class->setup_async = gs_plugin_replay_setup_async;
+	plugin_class->setup_finish = gs_plugin_replay_setup_finish;
+	plugin_class->list_apps_async = gs_plugin_replay_list_apps_async;
+	plugin_class->list_apps_finish = gs_plugin_replay_list_apps_finish;
+	plugin_class->refine_async = gs_plugin_replay_refine_async;
+	plugin_class->refine_finish = gs_plugin_replay_refine_finish;
+}
+
+GType
+gs_plugin_query_type (void)
+{
+	return GS_TYPE_PLUGIN_REPLAY;
+}
@@ -0,0 +1,228 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include "gnome-software-private.h"
+#include "gs-plugin-trace.h"
+
+#include "gs-test.h"
+
+/* How long the recorded list-apps call took */
+#define RECORDED_DURATION_USEC (100 * 1000)
+
+static GsAppQuery *
+create_installed_query (void)
+{
+	return gs_app_query_new ("is-installed", GS_APP_QUERY_TRISTATE_TRUE,
+				 "dedupe-flags", GS_PLUGIN_JOB_DEDUPE_FLAGS_DEFAULT,
+				 NULL);
+}
+
+/* Write a trace as the recorder in #GsPluginLoader would, containing one
+ * installed app returned by one list-apps call. */
+static gchar *
+write_trace (const gchar *tmp_root)
+{
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GsApp) addon = NULL;
+	g_autoptr(GsAppList) addons = NULL;
+	g_autoptr(AsScreenshot) screenshot = NULL;
+	g_autoptr(AsImage) image = NULL;
+	g_autoptr(GsAppQuery) query = NULL;
+	g_autoptr(JsonBuilder) builder = NULL;
+	g_autoptr(JsonNode) call_node = NULL;
+	g_autoptr(JsonNode) app_node = NULL;
+	g_autofree gchar *query_key = NULL;
+	g_autofree gchar *call_str = NULL;
+	g_autofree gchar *app_str = NULL;
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *trace_path = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	app = gs_app_new ("org.example.Replayed");
+	gs_app_set_kind (app, AS_COMPONENT_KIND_DESKTOP_APP);
+	gs_app_set_scope (app, AS_COMPONENT_SCOPE_SYSTEM);
+	gs_app_set_state (app, GS_APP_STATE_INSTALLED);
+	gs_app_set_name (app, GS_APP_QUALITY_NORMAL, "Replayed");
+	gs_app_set_summary (app, GS_APP_QUALITY_NORMAL, "An app from a trace");
+	gs_app_set_version (app, "1.2.3");
+	gs_app_set_size_installed (app, GS_SIZE_TYPE_VALID, 4096);
+	gs_app_add_category (app, "Utility");
+	gs_app_add_quirk (app, GS_APP_QUIRK_PROVENANCE);
+	gs_app_set_metadata_variant (app, "GnomeSoftware::Test", g_variant_new_uint32 (42));
+	gs_app_set_url (app, AS_URL_KIND_BUGTRACKER, "https://example.org/bugs");
+
+	screenshot = as_screenshot_new ();
+	image = as_image_new ();
+	as_image_set_url (image, "https://example.org/screenshot.png");
+	as_image_set_width (image, 1248);
+	as_image_set_height (image, 702);
+	as_screenshot_add_image (screenshot, image);
+	gs_app_add_screenshot (app, screenshot);
+
+	addon = gs_app_new ("org.example.Replayed.Addon");
+	gs_app_set_kind (addon, AS_COMPONENT_KIND_ADDON);
+	gs_app_set_name (addon, GS_APP_QUALITY_NORMAL, "Addon");
+	addons = gs_app_list_new ();
+	gs_app_list_add (addons, addon);
+	gs_app_add_addons (app, addons);
+
+	query = create_installed_query ();
+	query_key = gs_plugin_trace_query_to_key (query);
+
+	builder = json_builder_new ();
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "call");
+	json_builder_add_string_value (builder, GS_PLUGIN_TRACE_CALL_LIST_APPS);
+	json_builder_set_member_name (builder, "plugin");
+	json_builder_add_string_value (builder, "packagekit");
+	json_builder_set_member_name (builder, "input");
+	json_builder_add_string_value (builder, query_key);
+	json_builder_set_member_name (builder, "duration-usec");
+	json_builder_add_int_value (builder, RECORDED_DURATION_USEC);
+	json_builder_set_member_name (builder, "apps");
+	json_builder_begin_array (builder);
+	json_builder_add_string_value (builder, gs_app_get_unique_id (app));
+	json_builder_end_array (builder);
+	json_builder_end_object (builder);
+	call_node = json_builder_get_root (builder);
+	call_str = json_to_string (call_node, FALSE);
+
+	json_builder_reset (builder);
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "app");
+	json_builder_add_value (builder, gs_plugin_trace_app_to_node (app));
+	json_builder_end_object (builder);
+	app_node = json_builder_get_root (builder);
+	app_str = json_to_string (app_node, FALSE);
+
+	contents = g_strdup_printf ("%s\n%s\n", call_str, app_str);
+	trace_path = g_build_filename (tmp_root, "trace.jsonl", NULL);
+	g_file_set_contents (trace_path, contents, -1, &local_error);
+	g_assert_no_error (local_error);
+
+	return g_steal_pointer (&trace_path);
+}
+
+static void
+gs_plugins_replay_list_apps_func (GsPluginLoader *plugin_loader)
+{
+	GsApp *app;
+	guint64 size_bytes = 0;
+	gint64 begin_time_usec;
+	g_autoptr(GsAppQuery) query = NULL;
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GsAppList) addons = NULL;
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+	g_autoptr(GError) error = NULL;
+
+	query = create_installed_query ();
+	plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+
+	begin_time_usec = g_get_monotonic_time ();
+	list = gs_plugin_loader_job_process (plugin_loader, plugin_job, NULL, &error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert_nonnull (list);
+
+	/* the recorded latency is replayed */
+	g_assert_cmpint (g_get_monotonic_time () - begin_time_usec, >=, RECORDED_DURATION_USEC);
+
+	/* the recorded app is returned with its recorded properties */
+	g_assert_cmpint (gs_app_list_length (list), ==, 1);
+	app = gs_app_list_index (list, 0);
+	g_assert_cmpstr (gs_app_get_id (app), ==, "org.example.Replayed");
+	g_assert_cmpint (gs_app_get_kind (app), ==, AS_COMPONENT_KIND_DESKTOP_APP);
+	g_assert_cmpint (gs_app_get_state (app), ==, GS_APP_STATE_INSTALLED);
+	g_assert_cmpstr (gs_app_get_name (app), ==, "Replayed");
+	g_assert_cmpstr (gs_app_get_version (app), ==, "1.2.3");
+	g_assert_cmpint (gs_app_get_size_installed (app, &size_bytes), ==, GS_SIZE_TYPE_VALID);
+	g_assert_cmpuint (size_bytes, ==, 4096);
+	g_assert_true (gs_app_has_category (app, "Utility"));
+	g_assert_true (gs_app_has_quirk (app, GS_APP_QUIRK_PROVENANCE));
+	g_assert_cmpuint (g_variant_get_uint32 (gs_app_get_metadata_variant (app, "GnomeSoftware::Test")), ==, 42);
+	g_assert_cmpstr (gs_app_get_url (app, AS_URL_KIND_BUGTRACKER), ==, "https://example.org/bugs");
+	g_assert_cmpuint (gs_app_get_screenshots (app)->len, ==, 1);
+	addons = gs_app_dup_addons (app);
+	g_assert_nonnull (addons);
+	g_assert_cmpuint (gs_app_list_length (addons), ==, 1);
+	g_assert_cmpstr (gs_app_get_name (gs_app_list_index (addons, 0)), ==, "Addon");
+	g_assert_true (gs_app_has_management_plugin (app, gs_plugin_loader_find_plugin (plugin_loader, "replay")));
+}
+
+static void
+gs_plugins_replay_unrecorded_func (GsPluginLoader *plugin_loader)
+{
+	g_autoptr(GsAppQuery) query = NULL;
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* a query which wasn’t recorded returns nothing */
+	query = gs_app_query_new ("is-for-update", GS_APP_QUERY_TRISTATE_TRUE,
+				  NULL);
+	plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+	list = gs_plugin_loader_job_process (plugin_loader, plugin_job, NULL, &error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert_nonnull (list);
+	g_assert_cmpint (gs_app_list_length (list), ==, 0);
+}
+
+int
+main (int argc, char **argv)
+{
+	gboolean ret;
+	g_autofree gchar *tmp_root = NULL;
+	g_autofree gchar *trace_path = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsPluginLoader) plugin_loader = NULL;
+	const gchar * const allowlist[] = {
+		"replay",
+		NULL
+	};
+	int retval;
+
+	gs_test_init (&argc, &argv);
+
+	tmp_root = g_dir_make_tmp ("gnome-software-replay-test-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (tmp_root);
+
+	/* the trace has to be written before the plugin is loaded */
+	trace_path = write_trace (tmp_root);
+	g_setenv ("GS_PLUGIN_REPLAY_TRACE", trace_path, TRUE);
+
+	/* we can only load this once per process */
+	plugin_loader = gs_plugin_loader_new (NULL, NULL);
+	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR);
+	ret = gs_plugin_loader_setup (plugin_loader,
+				      allowlist,
+				      NULL,
+				      NULL,
+				      &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	/* plugin tests go here */
+	g_test_add_data_func ("/gnome-software/plugins/replay/list-apps",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_replay_list_apps_func);
+	g_test_add_data_func ("/gnome-software/plugins/replay/unrecorded",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_replay_unrecorded_func);
+	retval = g_test_run ();
+
+	/* Clean up. */
+	gs_utils_rmtree (tmp_root, NULL);
+
+	return retval;
+}
@@ -99,6 +99,23 @@ gs_plugin_repos_finalize (GObject *object)
 	G_OBJECT_CLASS (gs_plugin_repos_parent_class)->finalize (object);
 }
 
+/* Add the keys whose values differ between @table and @other_table, or which
+ * are missing from @other_table, to @change as origins. */
+static void
+add_changed_origins (GsPluginChange *change,
+                     GHashTable     *table,
+                     GHashTable     *other_table)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init (&iter, table);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_strcmp0 (value, g_hash_table_lookup (other_table, key)) != 0)
+			gs_plugin_change_add_origin (change, key);
+	}
+}
+
 /* Run in a worker thread; will take the mutex */
 static gboolean
 gs_plugin_repos_load (GsPluginRepos  *self,
@@ -110,6 +127,7 @@ gs_plugin_repos_load (GsPluginRepos  *self,
 	g_autoptr(GHashTable) new_filenames = NULL;
 	g_autoptr(GHashTable) new_urls = NULL;
 	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GsPluginChange) change = gs_plugin_change_new ();
 
 	new_filenames = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	new_urls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
@@ -170,6 +188,14 @@ gs_plugin_repos_load (GsPluginRepos  *self,
 	 * is held */
 	locker = g_mutex_locker_new (&self->mutex);
 
+	/* the repos for any apps which were refined with the old data */
+	if (self->fns != NULL && self->urls != NULL) {
+		add_changed_origins (change, self->fns, new_filenames);
+		add_changed_origins (change, new_filenames, self->fns);
+		add_changed_origins (change, self->urls, new_urls);
+		add_changed_origins (change, new_urls, self->urls);
+	}
+
 	g_clear_pointer (&self->fns, g_hash_table_unref);
 	self->fns = g_steal_pointer (&new_filenames);
 	g_clear_pointer (&self->urls, g_hash_table_unref);
@@ -177,6 +203,10 @@ gs_plugin_repos_load (GsPluginRepos  *self,
 
 	g_assert (self->fns != NULL && self->urls != NULL);
 
+	g_clear_pointer (&locker, g_mutex_locker_free);
+
+	gs_plugin_reload_for_change (GS_PLUGIN (self), change);
+
 	return TRUE;
 }
 
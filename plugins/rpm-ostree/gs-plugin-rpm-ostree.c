@@ -163,6 +163,10 @@ gs_plugin_rpm_ostree_init (GsPluginRpmOstree *self)
 
 	/* need pkgname */
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_RUN_AFTER, "appstream");
+
+	/* see gs_plugin_adopt_app() */
+	gs_plugin_add_adopt_bundle_kind (GS_PLUGIN (self), AS_BUNDLE_KIND_PACKAGE);
+	gs_plugin_add_adopt_component_kind (GS_PLUGIN (self), AS_COMPONENT_KIND_OPERATING_SYSTEM);
 }
 
 static void
@@ -149,6 +149,10 @@ gs_plugin_snap_init (GsPluginSnap *self)
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_BETTER_THAN, "packagekit");
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_RUN_BEFORE, "icons");
 
+	/* see gs_plugin_adopt_app() */
+	gs_plugin_add_adopt_bundle_kind (GS_PLUGIN (self), AS_BUNDLE_KIND_SNAP);
+	gs_plugin_add_adopt_id_prefix (GS_PLUGIN (self), "io.snapcraft.");
+
 	/* set name of MetaInfo file */
 	gs_plugin_set_appstream_id (GS_PLUGIN (self), "org.gnome.Software.Plugin.Snap");
 }
@@ -418,14 +422,18 @@ snap_to_app (GsPluginSnap *self, SnapdSnap *snap, const gchar *branch)
 	app = gs_plugin_cache_lookup (GS_PLUGIN (self), cache_id);
 	if (app == NULL) {
 		g_autofree gchar *appstream_id = NULL;
+		g_autoptr(GsApp) app_new = NULL;
 
 		appstream_id = get_appstream_id (snap);
-		app = gs_app_new (appstream_id);
-		gs_app_set_kind (app, snap_guess_component_kind (snap));
-		gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_SNAP);
-		gs_app_set_branch (app, branch);
-		gs_app_set_metadata (app, "snap::name", snapd_snap_get_name (snap));
-		gs_app_set_metadata (app, "GnomeSoftware::PackagingIcon", "package-snap-symbolic");
+		app_new = gs_app_new (appstream_id);
+		gs_app_set_kind (app_new, snap_guess_component_kind (snap));
+		gs_app_set_bundle_kind (app_new, AS_BUNDLE_KIND_SNAP);
+		gs_app_set_branch (app_new, branch);
+		gs_app_set_metadata (app_new, "snap::name", snapd_snap_get_name (snap));
+		gs_app_set_metadata (app_new, "GnomeSoftware::PackagingIcon", "package-snap-symbolic");
+
+		/* share the instance if another plugin already created it */
+		app = gs_plugin_intern_app (GS_PLUGIN (self), app_new);
 		gs_plugin_cache_add (GS_PLUGIN (self), cache_id, app);
 	}
 
@@ -141,6 +141,8 @@ gs_application_init (GsApplication *application)
 		  _("Show a local metainfo or appdata file"), _("FILENAME") },
 		{ "verbose", '\0', 0, G_OPTION_ARG_NONE, NULL,
 		  _("Enable verbose debugging output (from the running instance, if already running)"), NULL },
+		{ "debug-ring", '\0', 0, G_OPTION_ARG_NONE, NULL,
+		  _("Keep recent debugging output in memory and print it on SIGUSR1 (from the running instance, if already running)"), NULL },
 		{ "autoupdate", 0, 0, G_OPTION_ARG_NONE, NULL,
 		  _("Installs any pending updates in the background"), NULL },
 		{ "prefs", 0, 0, G_OPTION_ARG_NONE, NULL,
@@ -937,10 +939,20 @@ verbose_activated (GSimpleAction *action,
 	gs_debug_set_verbose (app->debug, TRUE);
 }
 
+static void
+debug_ring_activated (GSimpleAction *action,
+		      GVariant      *parameter,
+		      gpointer       data)
+{
+	GsApplication *app = GS_APPLICATION (data);
+	gs_debug_set_ring_buffer (app->debug, TRUE);
+}
+
 static GActionEntry actions[] = {
 	{ "about", about_activated, NULL, NULL, NULL },
 	{ "quit", quit_activated, NULL, NULL, NULL },
 	{ "verbose", verbose_activated, NULL, NULL, NULL },
+	{ "debug-ring", debug_ring_activated, NULL, NULL, NULL },
 	{ "nop", NULL, NULL, NULL }
 };
 
@@ -1280,6 +1292,12 @@ gs_application_handle_local_options (GApplication *app, GVariantDict *options)
 						NULL);
 	}
 
+	if (g_variant_dict_contains (options, "debug-ring")) {
+		g_action_group_activate_action (G_ACTION_GROUP (app),
+						"debug-ring",
+						NULL);
+	}
+
 	if (g_variant_dict_contains (options, "autoupdate")) {
 		g_action_group_activate_action (G_ACTION_GROUP (app),
 						"autoupdate",
@@ -387,7 +387,8 @@ gs_utils_set_key_colors_in_css (const gchar *css,
 	key_colors = gs_app_get_key_colors (app);
 
 	/* Do we not need to do any replacements? */
-	if (key_colors->len == 0 ||
+	if (key_colors == NULL ||
+	    key_colors->len == 0 ||
 	    g_strstr_len (css, -1, "@keycolor") == NULL)
 		return g_strdup (css);
 
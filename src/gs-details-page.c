@@ -1476,8 +1476,9 @@ gs_details_page_refresh_all (GsDetailsPage *self)
 		gtk_widget_set_tooltip_text (self->developer_verified_image, tooltip);
 	}
 
-	/* set version history */
-	version_history = gs_app_get_version_history (self->app);
+	/* set version history; only the latest release is shown here, and
+	 * whether there are more */
+	version_history = gs_app_get_latest_releases (self->app, 2);
 	if (version_history == NULL || version_history->len == 0) {
 		const gchar *version = gs_app_get_version_ui (self->app);
 		if (version == NULL || *version == '\0')
@@ -2185,6 +2186,31 @@ gs_details_page_reload (GsPage *page)
 	}
 }
 
+static gboolean
+gs_details_page_reload_for_change (GsPage         *page,
+                                   GsPluginChange *change)
+{
+	GsDetailsPage *self = GS_DETAILS_PAGE (page);
+	g_autoptr(GsAppList) addons = NULL;
+
+	if (self->app == NULL)
+		return FALSE;
+	if (gs_plugin_change_affects_app (change, self->app))
+		return FALSE;
+
+	/* the addons are shown on the page too */
+	addons = gs_app_dup_addons (self->app);
+	for (guint i = 0; addons != NULL && i < gs_app_list_length (addons); i++) {
+		if (gs_plugin_change_affects_app (change, gs_app_list_index (addons, i)))
+			return FALSE;
+	}
+
+	/* nothing to do if the change is for other apps */
+	g_debug ("Not reloading details page for unaffected app %s",
+		 gs_app_get_unique_id (self->app));
+	return TRUE;
+}
+
 static void
 origin_popover_row_activated_cb (GtkListBox *list_box,
                                  GtkListBoxRow *row,
@@ -2625,6 +2651,7 @@ gs_details_page_class_init (GsDetailsPageClass *klass)
 	page_class->app_removed = gs_details_page_app_removed;
 	page_class->switch_to = gs_details_page_switch_to;
 	page_class->reload = gs_details_page_reload;
+	page_class->reload_for_change = gs_details_page_reload_for_change;
 	page_class->setup = gs_details_page_setup;
 
 	/**
@@ -17,6 +17,8 @@
 #include "gs-installed-page.h"
 #include "gs-common.h"
 #include "gs-app-row.h"
+#include "gs-installed-tracker.h"
+#include "gs-profiler.h"
 #include "gs-utils.h"
 
 struct _GsInstalledPage
@@ -35,6 +37,11 @@ struct _GsInstalledPage
 	guint			 pending_apps_counter;
 	gboolean		 is_narrow;
 
+	GsInstalledTracker	*tracker;  /* (owned) */
+#ifdef HAVE_SYSPROF
+	gint64			 load_begin_time_nsec;
+#endif
+
 	GtkWidget		*group_install_in_progress;
 	GtkWidget		*group_install_apps;
 	GtkWidget		*group_install_system_apps;
@@ -69,6 +76,7 @@ static GsPluginRefineFlags gs_installed_page_get_refine_flags (GsInstalledPage *
 static void gs_installed_page_notify_state_changed_cb (GsApp *app,
 						       GParamSpec *pspec,
 						       GsInstalledPage *self);
+static gboolean filter_app_kinds_cb (GsApp *app, gpointer user_data);
 
 typedef enum {
 	GS_UPDATE_LIST_SECTION_INSTALLING_AND_REMOVING,
@@ -179,12 +187,14 @@ row_unrevealed (GObject *row, GParamSpec *pspec, gpointer data)
 }
 
 static void
-gs_installed_page_unreveal_row (GsAppRow *app_row)
+gs_installed_page_unreveal_row (GsInstalledPage *self,
+                                GsAppRow        *app_row)
 {
 	GsApp *app = gs_app_row_get_app (app_row);
 	if (app != NULL) {
 		g_signal_handlers_disconnect_matched (app, G_SIGNAL_MATCH_FUNC, 0, 0, NULL,
 						      G_CALLBACK (gs_installed_page_notify_state_changed_cb), NULL);
+		gs_installed_tracker_remove_app (self->tracker, app);
 	}
 
 	g_signal_connect (app_row, "unrevealed",
@@ -226,7 +236,7 @@ gs_installed_page_app_removed (GsPage *page, GsApp *app)
 	GsInstalledPage *self = GS_INSTALLED_PAGE (page);
 	GsAppRow *app_row = gs_installed_page_find_app_row (self, app);
 	if (app_row != NULL)
-		gs_installed_page_unreveal_row (app_row);
+		gs_installed_page_unreveal_row (self, app_row);
 }
 
 static void
@@ -305,7 +315,7 @@ gs_installed_page_notify_state_changed_cb (GsApp *app,
 	    state != GS_APP_STATE_UPDATABLE_LIVE &&
 	    state != GS_APP_STATE_PENDING_INSTALL &&
 	    state != GS_APP_STATE_PENDING_REMOVE)
-		gs_installed_page_unreveal_row (app_row);
+		gs_installed_page_unreveal_row (self, app_row);
 	else
 		gs_installed_page_maybe_move_app_row (self, app_row);
 }
@@ -344,6 +354,8 @@ gs_installed_page_add_app (GsInstalledPage *self, GsAppList *list, GsApp *app)
 	if (!gs_installed_page_is_actual_app (app))
 		return;
 
+	gs_installed_tracker_add_app (self->tracker, app);
+
 	app_row = g_object_new (GS_TYPE_APP_ROW,
 				"app", app,
 				"show-buttons", TRUE,
@@ -412,6 +424,14 @@ gs_installed_page_get_installed_cb (GObject *source_object,
 	list = gs_plugin_loader_job_process_finish (plugin_loader,
 						    res,
 						    &error);
+
+	GS_PROFILER_ADD_MARK_TAKE (InstalledPageLoad,
+				   self->load_begin_time_nsec,
+				   g_strdup ("installed-page-load"),
+				   g_strdup_printf ("%u full loads, %u incremental",
+						    gs_installed_tracker_get_n_full_loads (self->tracker),
+						    gs_installed_tracker_get_n_incremental_updates (self->tracker)));
+
 	if (list == NULL) {
 		if (!g_error_matches (error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_CANCELLED) &&
 		    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
@@ -423,6 +443,8 @@ gs_installed_page_get_installed_cb (GObject *source_object,
 		gs_installed_page_add_app (self, list, app);
 	}
 out:
+	gs_installed_tracker_end_load (self->tracker);
+
 	if (gs_app_list_length (pending) > 0) {
 		plugin_job = gs_plugin_job_refine_new (pending,
 						       gs_installed_page_get_refine_flags (self));
@@ -504,6 +526,11 @@ gs_installed_page_load (GsInstalledPage *self)
 	if (self->waiting)
 		return;
 	self->waiting = TRUE;
+	gs_installed_tracker_begin_load (self->tracker);
+
+#ifdef HAVE_SYSPROF
+	self->load_begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
+#endif
 
 	/* remove old entries */
 	gs_widget_remove_all (self->list_box_install_in_progress, gs_installed_page_remove_all_cb);
@@ -528,14 +555,137 @@ gs_installed_page_load (GsInstalledPage *self)
 	gtk_stack_set_visible_child_name (GTK_STACK (self->stack_install), "spinner");
 }
 
+static void
+gs_installed_page_apps_refined_cb (GObject      *source_object,
+                                   GAsyncResult *result,
+                                   gpointer      user_data)
+{
+	GsPluginLoader *plugin_loader = GS_PLUGIN_LOADER (source_object);
+	GsInstalledPage *self = GS_INSTALLED_PAGE (user_data);
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GError) error = NULL;
+
+	list = gs_plugin_loader_job_process_finish (plugin_loader, result, &error);
+	if (list == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+		    !g_error_matches (error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_CANCELLED))
+			g_warning ("failed to refine changed apps: %s", error->message);
+		return;
+	}
+
+	/* the page may have been reloaded in the meantime */
+	if (!self->cache_valid || self->waiting)
+		return;
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+
+		/* state changes have already moved or removed any existing
+		 * rows, so only newly installed apps need adding */
+		if (!gs_installed_tracker_has_app (self->tracker, app) &&
+		    gs_app_is_installed (app) &&
+		    filter_app_kinds_cb (app, NULL))
+			gs_installed_page_add_app (self, list, app);
+	}
+}
+
+/* Refine @apps with the page’s refine flags, then add rows for any which are
+ * installed but not shown yet, and remove rows for any which have gone. */
+static void
+gs_installed_page_refine_apps (GsInstalledPage *self,
+                               GsAppList       *apps)
+{
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+
+	if (gs_app_list_length (apps) == 0)
+		return;
+
+	plugin_job = gs_plugin_job_refine_new (apps, gs_installed_page_get_refine_flags (self));
+	gs_plugin_loader_job_process_async (self->plugin_loader, plugin_job,
+					    self->cancellable,
+					    gs_installed_page_apps_refined_cb,
+					    self);
+}
+
 static void
 gs_installed_page_reload (GsPage *page)
 {
 	GsInstalledPage *self = GS_INSTALLED_PAGE (page);
+
+	/* Partial reloads come through gs_installed_page_reload_for_change(),
+	 * so this is only reached when everything may have changed. */
+	g_debug ("Reloading installed page (%u full loads, %u incremental so far)",
+		 gs_installed_tracker_get_n_full_loads (self->tracker),
+		 gs_installed_tracker_get_n_incremental_updates (self->tracker));
 	gs_installed_page_invalidate (self);
 	gs_installed_page_load (self);
 }
 
+static gboolean
+gs_installed_page_reload_for_change (GsPage         *page,
+                                     GsPluginChange *change)
+{
+	GsInstalledPage *self = GS_INSTALLED_PAGE (page);
+	g_autoptr(GsAppList) apps = NULL;
+
+	if (!self->cache_valid || self->waiting)
+		return FALSE;
+
+	/* An app listed in the change which isn’t on the page may have just
+	 * been installed, and only a full reload will find it. Otherwise the
+	 * plugins which listed the apps will look up their state again when
+	 * they’re refined. */
+	apps = gs_installed_tracker_get_apps_for_change (self->tracker, change);
+	if (apps == NULL)
+		return FALSE;
+
+	g_debug ("Updating installed page in place for changed apps, refining %u apps "
+		 "(%u full loads, %u incremental so far)",
+		 gs_app_list_length (apps),
+		 gs_installed_tracker_get_n_full_loads (self->tracker),
+		 gs_installed_tracker_get_n_incremental_updates (self->tracker));
+	gs_installed_page_refine_apps (self, apps);
+
+	return TRUE;
+}
+
+static void
+gs_installed_page_job_started_cb (GsInstalledTracker *tracker,
+                                  GsAppList          *apps,
+                                  gpointer            user_data)
+{
+	GsInstalledPage *self = GS_INSTALLED_PAGE (user_data);
+
+	if (!self->cache_valid || self->waiting)
+		return;
+
+	/* show apps being installed in the in-progress section straight
+	 * away, rather than after the next reload */
+	for (guint i = 0; i < gs_app_list_length (apps); i++) {
+		GsApp *app = gs_app_list_index (apps, i);
+
+		if (!gs_installed_tracker_has_app (self->tracker, app) &&
+		    gs_installed_page_get_app_section (app) == GS_UPDATE_LIST_SECTION_INSTALLING_AND_REMOVING &&
+		    filter_app_kinds_cb (app, NULL))
+			gs_installed_page_add_app (self, apps, app);
+	}
+}
+
+static void
+gs_installed_page_job_finished_cb (GsInstalledTracker *tracker,
+                                   GsAppList          *apps,
+                                   gpointer            user_data)
+{
+	GsInstalledPage *self = GS_INSTALLED_PAGE (user_data);
+
+	if (!self->cache_valid || self->waiting)
+		return;
+
+	/* Refine all the apps from the job, whatever their state, as newly
+	 * installed apps need refining before they can be shown. */
+	gs_installed_page_refine_apps (self, apps);
+}
+
 static void
 gs_installed_page_switch_to (GsPage *page)
 {
@@ -663,32 +813,6 @@ gs_installed_page_sort_func (GtkListBoxRow *a,
 	return g_strcmp0 (key1, key2);
 }
 
-static gboolean
-gs_installed_page_has_app (GsInstalledPage *self,
-                           GsApp *app)
-{
-	GtkWidget *lists[] = {
-		self->list_box_install_in_progress,
-		self->list_box_install_apps,
-		self->list_box_install_system_apps,
-		self->list_box_install_addons,
-		self->list_box_install_web_apps,
-		NULL
-	};
-
-	for (gsize i = 0; lists[i]; i++) {
-		for (GtkWidget *child = gtk_widget_get_first_child (lists[i]);
-		     child != NULL;
-		     child = gtk_widget_get_next_sibling (child)) {
-			GsAppRow *app_row = GS_APP_ROW (child);
-			if (gs_app_row_get_app (app_row) == app)
-				return TRUE;
-		}
-	}
-
-	return FALSE;
-}
-
 static void
 gs_installed_page_add_pending_apps (GsInstalledPage *self,
 				    GsAppList *list,
@@ -720,7 +844,7 @@ gs_installed_page_add_pending_apps (GsInstalledPage *self,
 					     gs_app_get_cancellable (app));
 
 		++pending_apps_count;
-		if (!gs_installed_page_has_app (self, app))
+		if (!gs_installed_tracker_has_app (self->tracker, app))
 			gs_installed_page_add_app (self, list, app);
 	}
 
@@ -782,6 +906,12 @@ gs_installed_page_setup (GsPage *page,
 			  G_CALLBACK (gs_installed_page_pending_apps_changed_cb),
 			  self);
 
+	self->tracker = gs_installed_tracker_new (gs_plugin_loader_get_job_manager (plugin_loader));
+	g_signal_connect (self->tracker, "job-started",
+			  G_CALLBACK (gs_installed_page_job_started_cb), self);
+	g_signal_connect (self->tracker, "job-finished",
+			  G_CALLBACK (gs_installed_page_job_finished_cb), self);
+
 	self->cancellable = g_object_ref (cancellable);
 
 	/* setup installed */
@@ -860,6 +990,9 @@ gs_installed_page_dispose (GObject *object)
 	g_clear_object (&self->sizegroup_button_label);
 	g_clear_object (&self->sizegroup_button_image);
 
+	if (self->tracker != NULL)
+		g_signal_handlers_disconnect_by_data (self->tracker, self);
+	g_clear_object (&self->tracker);
 	g_clear_object (&self->plugin_loader);
 	g_clear_object (&self->cancellable);
 	g_clear_object (&self->settings);
@@ -881,6 +1014,7 @@ gs_installed_page_class_init (GsInstalledPageClass *klass)
 	page_class->app_removed = gs_installed_page_app_removed;
 	page_class->switch_to = gs_installed_page_switch_to;
 	page_class->reload = gs_installed_page_reload;
+	page_class->reload_for_change = gs_installed_page_reload_for_change;
 	page_class->setup = gs_installed_page_setup;
 
 	/**
@@ -0,0 +1,404 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-installed-tracker
+ * @short_description: Works out how to keep the installed page up to date
+ *
+ * A #GsInstalledTracker keeps track of which apps the installed page shows,
+ * and of the install and uninstall jobs in a #GsJobManager, so the page can
+ * update the affected rows in place rather than loading all the installed
+ * apps again after each change.
+ *
+ * The page calls gs_installed_tracker_begin_load() and
+ * gs_installed_tracker_end_load() around a full load, and
+ * gs_installed_tracker_add_app() and gs_installed_tracker_remove_app() as it
+ * adds and removes rows. While it’s loaded, #GsInstalledTracker::job-started
+ * and #GsInstalledTracker::job-finished are emitted for the apps of install
+ * and uninstall jobs, and gs_installed_tracker_get_apps_for_change() says
+ * which apps need refining for a #GsPluginChange, or that a full load is
+ * needed.
+ *
+ * It keeps count of the full loads and incremental updates, so they can be
+ * profiled and tested. It must only be used from the main thread.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "gnome-software-private.h"
+#include "gs-installed-tracker.h"
+
+struct _GsInstalledTracker
+{
+	GObject		 parent_instance;
+
+	GsJobManager	*job_manager;  /* (owned) */
+	guint		 install_watch_id;
+	guint		 uninstall_watch_id;
+
+	GHashTable	*apps;  /* (owned) (element-type GsApp); shown on the page */
+	gboolean	 loaded;
+
+	guint		 n_full_loads;
+	guint		 n_incremental_updates;
+};
+
+G_DEFINE_TYPE (GsInstalledTracker, gs_installed_tracker, G_TYPE_OBJECT)
+
+enum {
+	SIGNAL_JOB_STARTED,
+	SIGNAL_JOB_FINISHED,
+	SIGNAL_LAST
+};
+
+static guint signals [SIGNAL_LAST] = { 0 };
+
+static GsAppList *
+get_job_apps (GsPluginJob *job)
+{
+	if (GS_IS_PLUGIN_JOB_INSTALL_APPS (job))
+		return gs_plugin_job_install_apps_get_apps (GS_PLUGIN_JOB_INSTALL_APPS (job));
+	if (GS_IS_PLUGIN_JOB_UNINSTALL_APPS (job))
+		return gs_plugin_job_uninstall_apps_get_apps (GS_PLUGIN_JOB_UNINSTALL_APPS (job));
+	return NULL;
+}
+
+static void
+job_added_cb (GsJobManager *job_manager,
+              GsPluginJob  *job,
+              gpointer      user_data)
+{
+	GsInstalledTracker *self = GS_INSTALLED_TRACKER (user_data);
+	GsAppList *apps = get_job_apps (job);
+
+	if (self->loaded && apps != NULL)
+		g_signal_emit (self, signals[SIGNAL_JOB_STARTED], 0, apps);
+}
+
+static void
+job_removed_cb (GsJobManager *job_manager,
+                GsPluginJob  *job,
+                gpointer      user_data)
+{
+	GsInstalledTracker *self = GS_INSTALLED_TRACKER (user_data);
+	GsAppList *apps = get_job_apps (job);
+
+	if (self->loaded && apps != NULL)
+		g_signal_emit (self, signals[SIGNAL_JOB_FINISHED], 0, apps);
+}
+
+static void
+gs_installed_tracker_dispose (GObject *object)
+{
+	GsInstalledTracker *self = GS_INSTALLED_TRACKER (object);
+
+	if (self->job_manager != NULL) {
+		if (self->install_watch_id != 0)
+			gs_job_manager_remove_watch (self->job_manager, self->install_watch_id);
+		if (self->uninstall_watch_id != 0)
+			gs_job_manager_remove_watch (self->job_manager, self->uninstall_watch_id);
+		self->install_watch_id = 0;
+		self->uninstall_watch_id = 0;
+	}
+
+	g_clear_object (&self->job_manager);
+	g_clear_pointer (&self->apps, g_hash_table_unref);
+
+	G_OBJECT_CLASS (gs_installed_tracker_parent_class)->dispose (object);
+}
+
+static void
+gs_installed_tracker_class_init (GsInstalledTrackerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gs_installed_tracker_dispose;
+
+	/**
+	 * GsInstalledTracker::job-started:
+	 * @apps: the apps the job is for
+	 *
+	 * Emitted when an install or uninstall job is started while the
+	 * tracker is loaded. Any of @apps which are to be shown straight
+	 * away should be added with gs_installed_tracker_add_app().
+	 *
+	 * Since: 47
+	 */
+	signals [SIGNAL_JOB_STARTED] =
+		g_signal_new ("job-started",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, GS_TYPE_APP_LIST);
+
+	/**
+	 * GsInstalledTracker::job-finished:
+	 * @apps: the apps the job was for
+	 *
+	 * Emitted when an install or uninstall job finishes while the
+	 * tracker is loaded, whether or not it succeeded. @apps need
+	 * refining before their rows can be shown or updated.
+	 *
+	 * Since: 47
+	 */
+	signals [SIGNAL_JOB_FINISHED] =
+		g_signal_new ("job-finished",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, GS_TYPE_APP_LIST);
+}
+
+static void
+gs_installed_tracker_init (GsInstalledTracker *self)
+{
+	self->apps = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+}
+
+/**
+ * gs_installed_tracker_new:
+ * @job_manager: the #GsJobManager to watch for jobs
+ *
+ * Create a new #GsInstalledTracker, which is not loaded yet.
+ *
+ * Returns: (transfer full): a new #GsInstalledTracker
+ * Since: 47
+ */
+GsInstalledTracker *
+gs_installed_tracker_new (GsJobManager *job_manager)
+{
+	GsInstalledTracker *self;
+
+	g_return_val_if_fail (GS_IS_JOB_MANAGER (job_manager), NULL);
+
+	self = g_object_new (GS_TYPE_INSTALLED_TRACKER, NULL);
+	self->job_manager = g_object_ref (job_manager);
+	self->install_watch_id = gs_job_manager_add_watch (job_manager,
+							   NULL,
+							   GS_TYPE_PLUGIN_JOB_INSTALL_APPS,
+							   job_added_cb,
+							   job_removed_cb,
+							   self,
+							   NULL);
+	self->uninstall_watch_id = gs_job_manager_add_watch (job_manager,
+							     NULL,
+							     GS_TYPE_PLUGIN_JOB_UNINSTALL_APPS,
+							     job_added_cb,
+							     job_removed_cb,
+							     self,
+							     NULL);
+
+	return self;
+}
+
+/**
+ * gs_installed_tracker_begin_load:
+ * @self: a #GsInstalledTracker
+ *
+ * Forget the apps which are shown, as all of them are about to be loaded
+ * again. This counts as a full load.
+ *
+ * Since: 47
+ */
+void
+gs_installed_tracker_begin_load (GsInstalledTracker *self)
+{
+	g_return_if_fail (GS_IS_INSTALLED_TRACKER (self));
+
+	self->loaded = FALSE;
+	self->n_full_loads++;
+	g_hash_table_remove_all (self->apps);
+}
+
+/**
+ * gs_installed_tracker_end_load:
+ * @self: a #GsInstalledTracker
+ *
+ * Mark the apps added since gs_installed_tracker_begin_load() as being all
+ * the apps which are shown, so that changes can be handled incrementally
+ * from now on.
+ *
+ * Since: 47
+ */
+void
+gs_installed_tracker_end_load (GsInstalledTracker *self)
+{
+	g_return_if_fail (GS_IS_INSTALLED_TRACKER (self));
+
+	self->loaded = TRUE;
+}
+
+/**
+ * gs_installed_tracker_is_loaded:
+ * @self: a #GsInstalledTracker
+ *
+ * Get whether a full load has finished, and no other has begun since.
+ *
+ * Returns: %TRUE if the tracker is loaded
+ * Since: 47
+ */
+gboolean
+gs_installed_tracker_is_loaded (GsInstalledTracker *self)
+{
+	g_return_val_if_fail (GS_IS_INSTALLED_TRACKER (self), FALSE);
+
+	return self->loaded;
+}
+
+/**
+ * gs_installed_tracker_add_app:
+ * @self: a #GsInstalledTracker
+ * @app: a #GsApp which is now shown
+ *
+ * Record that @app is shown. Adding it again does nothing.
+ *
+ * Since: 47
+ */
+void
+gs_installed_tracker_add_app (GsInstalledTracker *self,
+                              GsApp              *app)
+{
+	g_return_if_fail (GS_IS_INSTALLED_TRACKER (self));
+	g_return_if_fail (GS_IS_APP (app));
+
+	g_hash_table_add (self->apps, g_object_ref (app));
+}
+
+/**
+ * gs_installed_tracker_remove_app:
+ * @self: a #GsInstalledTracker
+ * @app: a #GsApp which is no longer shown
+ *
+ * Record that @app is no longer shown, if it was.
+ *
+ * Since: 47
+ */
+void
+gs_installed_tracker_remove_app (GsInstalledTracker *self,
+                                 GsApp              *app)
+{
+	g_return_if_fail (GS_IS_INSTALLED_TRACKER (self));
+	g_return_if_fail (GS_IS_APP (app));
+
+	g_hash_table_remove (self->apps, app);
+}
+
+/**
+ * gs_installed_tracker_has_app:
+ * @self: a #GsInstalledTracker
+ * @app: a #GsApp
+ *
+ * Get whether @app itself, rather than another instance with the same unique
+ * ID, is shown.
+ *
+ * Returns: %TRUE if @app is shown
+ * Since: 47
+ */
+gboolean
+gs_installed_tracker_has_app (GsInstalledTracker *self,
+                              GsApp              *app)
+{
+	g_return_val_if_fail (GS_IS_INSTALLED_TRACKER (self), FALSE);
+	g_return_val_if_fail (GS_IS_APP (app), FALSE);
+
+	return g_hash_table_contains (self->apps, app);
+}
+
+/**
+ * gs_installed_tracker_get_apps_for_change:
+ * @self: a #GsInstalledTracker
+ * @change: a #GsPluginChange saying which apps changed
+ *
+ * Work out which of the shown apps need refining after @change. If this
+ * returns a list, that counts as an incremental update.
+ *
+ * A full load is needed if the tracker isn’t loaded, if @change affects all
+ * apps, or if it lists an app which isn’t shown, as that may have just been
+ * installed. Apps which are being installed by a job are normally shown by
+ * then, from the #GsInstalledTracker::job-started handler.
+ *
+ * Returns: (transfer full) (nullable): the shown apps affected by @change,
+ *   or %NULL if a full load is needed instead
+ * Since: 47
+ */
+GsAppList *
+gs_installed_tracker_get_apps_for_change (GsInstalledTracker *self,
+                                          GsPluginChange     *change)
+{
+	GPtrArray *unique_ids;
+	g_autoptr(GsAppList) shown = NULL;
+	g_autoptr(GsAppList) apps = NULL;
+	GHashTableIter iter;
+	gpointer key;
+
+	g_return_val_if_fail (GS_IS_INSTALLED_TRACKER (self), NULL);
+	g_return_val_if_fail (GS_IS_PLUGIN_CHANGE (change), NULL);
+
+	if (!self->loaded || gs_plugin_change_is_all (change))
+		return NULL;
+
+	shown = gs_app_list_new ();
+	g_hash_table_iter_init (&iter, self->apps);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		gs_app_list_add (shown, GS_APP (key));
+
+	unique_ids = gs_plugin_change_get_unique_ids (change);
+	for (guint i = 0; i < unique_ids->len; i++) {
+		if (gs_app_list_lookup (shown, g_ptr_array_index (unique_ids, i)) == NULL)
+			return NULL;
+	}
+
+	apps = gs_app_list_new ();
+	for (guint i = 0; i < gs_app_list_length (shown); i++) {
+		GsApp *app = gs_app_list_index (shown, i);
+
+		if (gs_plugin_change_affects_app (change, app))
+			gs_app_list_add (apps, app);
+	}
+
+	self->n_incremental_updates++;
+
+	return g_steal_pointer (&apps);
+}
+
+/**
+ * gs_installed_tracker_get_n_full_loads:
+ * @self: a #GsInstalledTracker
+ *
+ * Get the number of times gs_installed_tracker_begin_load() has been called.
+ *
+ * Returns: the number of full loads
+ * Since: 47
+ */
+guint
+gs_installed_tracker_get_n_full_loads (GsInstalledTracker *self)
+{
+	g_return_val_if_fail (GS_IS_INSTALLED_TRACKER (self), 0);
+
+	return self->n_full_loads;
+}
+
+/**
+ * gs_installed_tracker_get_n_incremental_updates:
+ * @self: a #GsInstalledTracker
+ *
+ * Get the number of changes which gs_installed_tracker_get_apps_for_change()
+ * could handle without a full load.
+ *
+ * Returns: the number of incremental updates
+ * Since: 47
+ */
+guint
+gs_installed_tracker_get_n_incremental_updates (GsInstalledTracker *self)
+{
+	g_return_val_if_fail (GS_IS_INSTALLED_TRACKER (self), 0);
+
+	return self->n_incremental_updates;
+}
@@ -0,0 +1,42 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "gs-app-list.h"
+#include "gs-job-manager.h"
+#include "gs-plugin-change.h"
+
+G_BEGIN_DECLS
+
+#define GS_TYPE_INSTALLED_TRACKER (gs_installed_tracker_get_type ())
+
+G_DECLARE_FINAL_TYPE (GsInstalledTracker, gs_installed_tracker, GS, INSTALLED_TRACKER, GObject)
+
+GsInstalledTracker	*gs_installed_tracker_new		(GsJobManager		*job_manager);
+
+void		 gs_installed_tracker_begin_load		(GsInstalledTracker	*self);
+void		 gs_installed_tracker_end_load			(GsInstalledTracker	*self);
+gboolean	 gs_installed_tracker_is_loaded			(GsInstalledTracker	*self);
+
+void		 gs_installed_tracker_add_app			(GsInstalledTracker	*self,
+								 GsApp			*app);
+void		 gs_installed_tracker_remove_app		(GsInstalledTracker	*self,
+								 GsApp			*app);
+gboolean	 gs_installed_tracker_has_app			(GsInstalledTracker	*self,
+								 GsApp			*app);
+
+GsAppList	*gs_installed_tracker_get_apps_for_change	(GsInstalledTracker	*self,
+								 GsPluginChange		*change);
+
+guint		 gs_installed_tracker_get_n_full_loads		(GsInstalledTracker	*self);
+guint		 gs_installed_tracker_get_n_incremental_updates	(GsInstalledTracker	*self);
+
+G_END_DECLS
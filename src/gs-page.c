@@ -25,6 +25,7 @@ typedef struct
 	GtkWidget		*header_start_widget;
 	GtkWidget		*header_end_widget;
 	gboolean		 is_active;
+	gboolean		 reload_pending;
 } GsPagePrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (GsPage, gs_page, GTK_TYPE_WIDGET)
@@ -862,6 +863,13 @@ gs_page_switch_to (GsPage *page)
 	GsPageClass *klass = GS_PAGE_GET_CLASS (page);
 	GsPagePrivate *priv = gs_page_get_instance_private (page);
 	priv->is_active = TRUE;
+
+	/* catch up on a reload which was deferred while the page was hidden;
+	 * this comes first so that switch_to() sees the load in progress
+	 * rather than starting its own */
+	if (priv->reload_pending)
+		gs_page_reload (page);
+
 	if (klass->switch_to != NULL)
 		klass->switch_to (page);
 }
@@ -908,12 +916,73 @@ void
 gs_page_reload (GsPage *page)
 {
 	GsPageClass *klass;
+	GsPagePrivate *priv = gs_page_get_instance_private (page);
 	g_return_if_fail (GS_IS_PAGE (page));
+	priv->reload_pending = FALSE;
 	klass = GS_PAGE_GET_CLASS (page);
 	if (klass->reload != NULL)
 		klass->reload (page);
 }
 
+/**
+ * gs_page_reload_for_change:
+ * @page: a #GsPage
+ * @change: a #GsPluginChange saying which apps changed
+ *
+ * Reload @page after the apps in @change have changed. Pages which can work
+ * out that they only need to refresh some of their content implement
+ * #GsPageClass.reload_for_change; for any others, or if that can’t handle
+ * @change, this falls back to gs_page_reload().
+ *
+ * Since: 47
+ */
+void
+gs_page_reload_for_change (GsPage         *page,
+                           GsPluginChange *change)
+{
+	GsPageClass *klass;
+
+	g_return_if_fail (GS_IS_PAGE (page));
+	g_return_if_fail (GS_IS_PLUGIN_CHANGE (change));
+
+	klass = GS_PAGE_GET_CLASS (page);
+	if (gs_plugin_change_is_all (change) ||
+	    klass->reload_for_change == NULL ||
+	    !klass->reload_for_change (page, change))
+		gs_page_reload (page);
+}
+
+/**
+ * gs_page_reload_when_active:
+ * @page: a #GsPage
+ * @change: a #GsPluginChange saying which apps changed
+ *
+ * Reload @page for @change if it is currently active. Otherwise, mark it as
+ * needing a full reload and defer that until the next time it is switched
+ * to, so that hidden pages don’t run jobs to refresh content nobody is
+ * looking at.
+ *
+ * Returns: %TRUE if the page was reloaded now, %FALSE if the reload was
+ *   deferred
+ * Since: 47
+ */
+gboolean
+gs_page_reload_when_active (GsPage         *page,
+                            GsPluginChange *change)
+{
+	GsPagePrivate *priv = gs_page_get_instance_private (page);
+
+	g_return_val_if_fail (GS_IS_PAGE (page), FALSE);
+
+	if (!priv->is_active) {
+		priv->reload_pending = TRUE;
+		return FALSE;
+	}
+
+	gs_page_reload_for_change (page, change);
+	return TRUE;
+}
+
 gboolean
 gs_page_setup (GsPage *page,
                GsShell *shell,
@@ -28,6 +28,8 @@ struct _GsPageClass
 	void		(*switch_to)		(GsPage		 *page);
 	void		(*switch_from)		(GsPage		 *page);
 	void		(*reload)		(GsPage		 *page);
+	gboolean	(*reload_for_change)	(GsPage		 *page,
+						 GsPluginChange	 *change);
 	gboolean	(*setup)		(GsPage		 *page,
 						 GsShell	*shell,
 						 GsPluginLoader	*plugin_loader,
@@ -60,6 +62,10 @@ void		 gs_page_switch_to			(GsPage		*page);
 void		 gs_page_switch_from			(GsPage		*page);
 void		 gs_page_scroll_up			(GsPage		*page);
 void		 gs_page_reload				(GsPage		*page);
+void		 gs_page_reload_for_change		(GsPage		*page,
+							 GsPluginChange	*change);
+gboolean	 gs_page_reload_when_active		(GsPage		*page,
+							 GsPluginChange	*change);
 gboolean	 gs_page_setup				(GsPage		*page,
 							 GsShell	*shell,
 							 GsPluginLoader	*plugin_loader,
@@ -11,7 +11,9 @@
 #include "gnome-software-private.h"
 
 #include "gs-css.h"
+#include "gs-installed-tracker.h"
 #include "gs-test.h"
+#include "gs-update-set.h"
 
 static void
 gs_css_func (void)
@@ -40,6 +42,185 @@ gs_css_func (void)
 	g_assert_cmpstr (tmp, ==, "color: white;");
 }
 
+static void
+gs_update_set_func (void)
+{
+	g_autoptr(GsUpdateSet) update_set = gs_update_set_new ();
+	g_autoptr(GsApp) related = gs_app_new ("related");
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	GsApp *app0;
+	const guint n_apps = 200;
+
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("app%u", i);
+		g_autoptr(GsApp) app = gs_app_new (id);
+		gs_app_set_state (app, GS_APP_STATE_UPDATABLE);
+		gs_app_set_size_download (app, GS_SIZE_TYPE_VALID, 1000);
+		gs_update_set_add_app (update_set, app);
+		gs_app_list_add (list, app);
+	}
+
+	/* adding the same app again does nothing */
+	gs_update_set_add_app (update_set, gs_app_list_index (list, 0));
+
+	g_assert_cmpuint (gs_update_set_get_n_apps (update_set), ==, n_apps);
+	g_assert_cmpuint (gs_update_set_get_n_updates (update_set), ==, n_apps);
+	g_assert_cmpuint (gs_update_set_get_n_busy (update_set), ==, 0);
+	g_assert_cmpuint (gs_update_set_get_n_downloaded (update_set), ==, 0);
+	g_assert_cmpuint (gs_update_set_get_download_size (update_set), ==, n_apps * 1000);
+
+	/* all the updates start downloading at once */
+	gs_app_list_set_state_many (list, GS_APP_STATE_DOWNLOADING);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (gs_update_set_get_n_busy (update_set), ==, n_apps);
+	g_assert_cmpuint (gs_update_set_get_n_updates (update_set), ==, n_apps);
+
+	/* half of them finish */
+	for (guint i = 0; i < n_apps; i += 2) {
+		GsApp *app = gs_app_list_index (list, i);
+		gs_app_set_size_download (app, GS_SIZE_TYPE_VALID, 0);
+		gs_app_set_state (app, GS_APP_STATE_UPDATABLE);
+	}
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (gs_update_set_get_n_busy (update_set), ==, n_apps / 2);
+	g_assert_cmpuint (gs_update_set_get_n_downloaded (update_set), ==, n_apps / 2);
+	g_assert_cmpuint (gs_update_set_get_download_size (update_set), ==, n_apps / 2 * 1000);
+
+	/* a downloaded app needs a dependency downloading after all */
+	app0 = gs_app_list_index (list, 0);
+	gs_app_set_state (related, GS_APP_STATE_AVAILABLE);
+	gs_app_set_size_download (related, GS_SIZE_TYPE_VALID, 500);
+	gs_app_add_related (app0, related);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (gs_update_set_get_n_downloaded (update_set), ==, n_apps / 2 - 1);
+	g_assert_cmpuint (gs_update_set_get_download_size (update_set), ==, n_apps / 2 * 1000 + 500);
+
+	/* which is then downloaded */
+	gs_app_set_size_download (related, GS_SIZE_TYPE_VALID, 0);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (gs_update_set_get_n_downloaded (update_set), ==, n_apps / 2);
+	g_assert_cmpuint (gs_update_set_get_download_size (update_set), ==, n_apps / 2 * 1000);
+
+	/* removing apps takes them out of the totals */
+	gs_update_set_remove_app (update_set, app0);
+	g_assert_cmpuint (gs_update_set_get_n_apps (update_set), ==, n_apps - 1);
+	g_assert_cmpuint (gs_update_set_get_n_downloaded (update_set), ==, n_apps / 2 - 1);
+
+	gs_update_set_remove_all (update_set);
+	g_assert_cmpuint (gs_update_set_get_n_apps (update_set), ==, 0);
+	g_assert_cmpuint (gs_update_set_get_n_updates (update_set), ==, 0);
+	g_assert_cmpuint (gs_update_set_get_n_busy (update_set), ==, 0);
+	g_assert_cmpuint (gs_update_set_get_n_downloaded (update_set), ==, 0);
+	g_assert_cmpuint (gs_update_set_get_download_size (update_set), ==, 0);
+}
+
+/* Show the apps from a job straight away, as the installed page does. */
+static void
+installed_tracker_job_started_cb (GsInstalledTracker *tracker,
+                                  GsAppList          *apps,
+                                  gpointer            user_data)
+{
+	guint *n_started = user_data;
+
+	for (guint i = 0; i < gs_app_list_length (apps); i++)
+		gs_installed_tracker_add_app (tracker, gs_app_list_index (apps, i));
+	(*n_started)++;
+}
+
+static void
+installed_tracker_job_finished_cb (GsInstalledTracker *tracker,
+                                   GsAppList          *apps,
+                                   gpointer            user_data)
+{
+	guint *n_finished = user_data;
+
+	(*n_finished)++;
+}
+
+static void
+gs_installed_tracker_func (void)
+{
+	g_autoptr(GsJobManager) job_manager = gs_job_manager_new ();
+	g_autoptr(GsInstalledTracker) tracker = gs_installed_tracker_new (job_manager);
+	g_autoptr(GsApp) installed_app = gs_app_new ("org.example.Installed");
+	g_autoptr(GsPluginChange) change_unknown = gs_plugin_change_new ();
+	g_autoptr(GsPluginChange) change_all = gs_plugin_change_new_all ();
+	guint n_started = 0, n_finished = 0;
+	const guint n_apps = 5;
+
+	g_signal_connect (tracker, "job-started",
+			  G_CALLBACK (installed_tracker_job_started_cb), &n_started);
+	g_signal_connect (tracker, "job-finished",
+			  G_CALLBACK (installed_tracker_job_finished_cb), &n_finished);
+
+	/* the page loads once when it’s first shown */
+	gs_installed_tracker_begin_load (tracker);
+	g_assert_false (gs_installed_tracker_is_loaded (tracker));
+	gs_app_set_state (installed_app, GS_APP_STATE_INSTALLED);
+	gs_installed_tracker_add_app (tracker, installed_app);
+	gs_installed_tracker_end_load (tracker);
+	g_assert_true (gs_installed_tracker_is_loaded (tracker));
+
+	/* several apps are then installed one after another, and each change
+	 * only needs the app which was installed refining */
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		g_autoptr(GsApp) app = gs_app_new (id);
+		g_autoptr(GsAppList) list = gs_app_list_new ();
+		g_autoptr(GsPluginJob) job = NULL;
+		g_autoptr(GsPluginChange) change = gs_plugin_change_new ();
+		g_autoptr(GsAppList) changed_apps = NULL;
+
+		gs_app_set_state (app, GS_APP_STATE_AVAILABLE);
+		gs_app_list_add (list, app);
+		job = gs_plugin_job_install_apps_new (list, GS_PLUGIN_INSTALL_APPS_FLAGS_NONE);
+
+		gs_job_manager_add_job (job_manager, job);
+		gs_test_flush_main_context ();
+		g_assert_true (gs_installed_tracker_has_app (tracker, app));
+
+		gs_app_set_state (app, GS_APP_STATE_INSTALLING);
+		gs_app_set_state (app, GS_APP_STATE_INSTALLED);
+		gs_plugin_change_add_unique_id (change, gs_app_get_unique_id (app));
+		changed_apps = gs_installed_tracker_get_apps_for_change (tracker, change);
+		g_assert_nonnull (changed_apps);
+		g_assert_cmpuint (gs_app_list_length (changed_apps), ==, 1);
+		g_assert_true (gs_app_list_index (changed_apps, 0) == app);
+
+		gs_job_manager_remove_job (job_manager, job);
+		gs_test_flush_main_context ();
+	}
+
+	g_assert_cmpuint (n_started, ==, n_apps);
+	g_assert_cmpuint (n_finished, ==, n_apps);
+	g_assert_cmpuint (gs_installed_tracker_get_n_full_loads (tracker), ==, 1);
+	g_assert_cmpuint (gs_installed_tracker_get_n_incremental_updates (tracker), ==, n_apps);
+
+	/* an app which isn’t shown, or a change to everything, needs a full
+	 * load to pick up */
+	gs_plugin_change_add_unique_id (change_unknown, "*/*/*/org.example.Unknown/*");
+	g_assert_null (gs_installed_tracker_get_apps_for_change (tracker, change_unknown));
+	g_assert_null (gs_installed_tracker_get_apps_for_change (tracker, change_all));
+	g_assert_cmpuint (gs_installed_tracker_get_n_incremental_updates (tracker), ==, n_apps);
+
+	/* jobs aren’t reported while loading */
+	gs_installed_tracker_begin_load (tracker);
+	g_assert_false (gs_installed_tracker_has_app (tracker, installed_app));
+	{
+		g_autoptr(GsAppList) list = gs_app_list_new ();
+		g_autoptr(GsPluginJob) job = NULL;
+
+		gs_app_list_add (list, installed_app);
+		job = gs_plugin_job_uninstall_apps_new (list, GS_PLUGIN_UNINSTALL_APPS_FLAGS_NONE);
+		gs_job_manager_add_job (job_manager, job);
+		gs_job_manager_remove_job (job_manager, job);
+		gs_test_flush_main_context ();
+	}
+	g_assert_cmpuint (n_started, ==, n_apps);
+	g_assert_cmpuint (n_finished, ==, n_apps);
+	g_assert_cmpuint (gs_installed_tracker_get_n_full_loads (tracker), ==, 2);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -47,6 +228,8 @@ main (int argc, char **argv)
 
 	/* tests go here */
 	g_test_add_func ("/gnome-software/src/css", gs_css_func);
+	g_test_add_func ("/gnome-software/src/update-set", gs_update_set_func);
+	g_test_add_func ("/gnome-software/src/installed-tracker", gs_installed_tracker_func);
 
 	return g_test_run ();
 }
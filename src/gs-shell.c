@@ -33,6 +33,7 @@
 #include "gs-extras-page.h"
 #include "gs-repos-dialog.h"
 #include "gs-prefs-dialog.h"
+#include "gs-profiler.h"
 #include "gs-toast.h"
 #include "gs-update-dialog.h"
 #include "gs-update-monitor.h"
@@ -78,6 +79,8 @@ struct _GsShell
 	AdwViewStack		*stack_loading;
 	AdwViewStack		*stack_main;
 	AdwViewStack		*stack_sub;
+	AdwToolbarView		*details_toolbar_view;
+	AdwWindowTitle		*details_title;
 	GsPage			*page;
 
 	GBinding		*sub_page_header_title_binding;
@@ -106,6 +109,16 @@ struct _GsShell
 	gint			 allocation_width;
 	guint			 allocation_changed_cb_id;
 
+	guint			 reload_id;
+	guint			 n_reload_signals;
+	GsPluginChange		*next_reload_change;  /* (owned) (nullable); from ::changed, for the next ::reload */
+	GsPluginChange		*reload_change;  /* (owned) (nullable); everything the pending reload is for */
+#ifdef HAVE_SYSPROF
+	gint64			 reload_begin_time_nsec;
+	gint64			 init_time_nsec;
+#endif
+	gint64			 init_time_usec;
+
 	GsPage			*pages[GS_SHELL_MODE_LAST];
 };
 
@@ -549,9 +562,11 @@ stack_notify_visible_child_cb (GObject    *object,
 	}
 
 	g_clear_object (&shell->sub_page_header_title_binding);
-	shell->sub_page_header_title_binding = g_object_bind_property (adw_view_stack_get_visible_child (shell->stack_sub), "title",
-								       shell->sub_page_header_title, "label",
-								       G_BINDING_SYNC_CREATE);
+	widget = adw_view_stack_get_visible_child (shell->stack_sub);
+	if (widget != NULL)
+		shell->sub_page_header_title_binding = g_object_bind_property (widget, "title",
+									       shell->sub_page_header_title, "label",
+									       G_BINDING_SYNC_CREATE);
 
 	/* refresh the updates bar when moving out of the loading mode, but only
 	 * if the Mogwai scheduler state is already known, to avoid spuriously
@@ -580,6 +595,123 @@ stack_notify_visible_child_cb (GObject    *object,
 	}
 }
 
+static void
+gs_shell_details_page_metainfo_loaded_cb (GtkWidget *details_page,
+					  GsApp *app,
+					  GsShell *self)
+{
+	g_return_if_fail (GS_IS_APP (app));
+	g_return_if_fail (GS_IS_SHELL (self));
+
+	/* If the user has manually loaded some metainfo to
+	 * preview, override the featured carousel with it too,
+	 * so they can see how it looks in the carousel. */
+	gs_overview_page_override_featured (GS_OVERVIEW_PAGE (self->pages[GS_SHELL_MODE_OVERVIEW]), app);
+}
+
+static void
+category_page_app_clicked_cb (GsCategoryPage *page,
+                              GsApp          *app,
+                              gpointer        user_data)
+{
+	GsShell *shell = GS_SHELL (user_data);
+
+	gs_shell_show_app (shell, app);
+}
+
+static void
+details_page_app_clicked_cb (GsDetailsPage *page,
+			     GsApp         *app,
+			     gpointer       user_data)
+{
+	GsShell *shell = GS_SHELL (user_data);
+
+	gs_shell_show_app (shell, app);
+}
+
+/* Get the page for @mode, constructing it first if needed. Only the loading
+ * page and the pages in the view switcher are built from the template, as
+ * they are needed for the first frame; the others are built and set up the
+ * first time they are navigated to, which for many users is never. */
+static GsPage *
+gs_shell_ensure_page (GsShell     *shell,
+                      GsShellMode  mode)
+{
+	GsPage *page = shell->pages[mode];
+	g_autoptr(GError) error = NULL;
+#ifdef HAVE_SYSPROF
+	gint64 begin_time_nsec G_GNUC_UNUSED = SYSPROF_CAPTURE_CURRENT_TIME;
+#endif
+
+	if (page != NULL)
+		return page;
+
+	switch (mode) {
+	case GS_SHELL_MODE_SEARCH:
+		page = GS_PAGE (gs_search_page_new ());
+		adw_view_stack_add_named (shell->stack_main, GTK_WIDGET (page), page_name[mode]);
+		break;
+	case GS_SHELL_MODE_CATEGORY:
+	case GS_SHELL_MODE_EXTRAS:
+		if (mode == GS_SHELL_MODE_CATEGORY) {
+			page = GS_PAGE (gs_category_page_new ());
+			g_signal_connect (page, "app-clicked",
+					  G_CALLBACK (category_page_app_clicked_cb), shell);
+		} else {
+			page = GS_PAGE (gs_extras_page_new ());
+		}
+
+		/* adding the first child changes the visible child of the
+		 * stack, which must not be mistaken for navigation */
+		g_signal_handlers_block_by_func (shell->stack_sub, stack_notify_visible_child_cb, shell);
+		adw_view_stack_add_named (shell->stack_sub, GTK_WIDGET (page), page_name[mode]);
+		g_signal_handlers_unblock_by_func (shell->stack_sub, stack_notify_visible_child_cb, shell);
+		break;
+	case GS_SHELL_MODE_DETAILS:
+		page = GS_PAGE (gs_details_page_new ());
+		g_object_bind_property (shell, "is-narrow",
+					page, "is-narrow",
+					G_BINDING_SYNC_CREATE);
+		g_object_bind_property (page, "title",
+					shell->details_title, "title",
+					G_BINDING_SYNC_CREATE);
+		g_signal_connect (page, "metainfo-loaded",
+				  G_CALLBACK (gs_shell_details_page_metainfo_loaded_cb), shell);
+		g_signal_connect (page, "app-clicked",
+				  G_CALLBACK (details_page_app_clicked_cb), shell);
+		adw_toolbar_view_set_content (shell->details_toolbar_view, GTK_WIDGET (page));
+
+		if (shell->plugin_loader != NULL)
+			gs_details_page_set_odrs_provider (GS_DETAILS_PAGE (page),
+							   gs_plugin_loader_get_odrs_provider (shell->plugin_loader));
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+
+	g_debug ("Constructed %s page on first use", page_name[mode]);
+
+	/* the page is owned by its container */
+	shell->pages[mode] = page;
+	g_object_add_weak_pointer (G_OBJECT (page), (gpointer *) &shell->pages[mode]);
+
+	/* pages built before gs_shell_setup() are set up there */
+	if (shell->plugin_loader != NULL &&
+	    !gs_page_setup (page, shell,
+			    shell->plugin_loader,
+			    shell->cancellable,
+			    &error)) {
+		g_warning ("Failed to setup panel: %s", error->message);
+	}
+
+	GS_PROFILER_ADD_MARK_TAKE (ShellPage,
+				   begin_time_nsec,
+				   g_strdup_printf ("construct-page:%s", page_name[mode]),
+				   NULL);
+
+	return page;
+}
+
 void
 gs_shell_change_mode (GsShell *shell,
 		      GsShellMode mode,
@@ -602,6 +734,9 @@ gs_shell_change_mode (GsShell *shell,
 		return;
 	}
 
+	/* the page has to exist before it’s made visible */
+	page = gs_shell_ensure_page (shell, mode);
+
 	adw_view_stack_set_visible_child_name (shell->stack_loading, "main");
 G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 	if (mode == GS_SHELL_MODE_DETAILS) {
@@ -618,8 +753,6 @@ G_GNUC_BEGIN_IGNORE_DEPRECATIONS
 G_GNUC_END_IGNORE_DEPRECATIONS
 
 	/* do any mode-specific actions */
-	page = shell->pages[mode];
-
 	if (mode == GS_SHELL_MODE_SEARCH) {
 		gs_search_page_set_text (GS_SEARCH_PAGE (page), data);
 		gtk_editable_set_text (GTK_EDITABLE (shell->entry_search), data);
@@ -833,28 +966,82 @@ gs_shell_back_button_cb (GtkWidget *widget, GsShell *shell)
 	gs_shell_go_back (shell);
 }
 
-static void
-gs_shell_reload_cb (GsPluginLoader *plugin_loader, GsShell *shell)
+/* how long to wait for further #GsPluginLoader::reload signals before acting
+ * on them; refreshes and installs tend to emit them in bursts */
+#define RELOAD_DEBOUNCE_MS 250
+
+static gboolean
+gs_shell_reload_timeout_cb (gpointer user_data)
 {
+	GsShell *shell = GS_SHELL (user_data);
+	guint n_pages = 0, n_reloaded = 0, n_deferred = 0, n_avoided;
+	g_autoptr(GsPluginChange) change = g_steal_pointer (&shell->reload_change);
+
+	shell->reload_id = 0;
+
 	for (gsize i = 0; i < G_N_ELEMENTS (shell->pages); i++) {
 		GsPage *page = shell->pages[i];
-		if (page != NULL)
-			gs_page_reload (page);
+		if (page == NULL)
+			continue;
+		n_pages++;
+
+		/* the updates page provides the counter shown in the view
+		 * switcher, so has to stay up to date even when hidden */
+		if (i == GS_SHELL_MODE_UPDATES) {
+			gs_page_reload_for_change (page, change);
+			n_reloaded++;
+		} else if (gs_page_reload_when_active (page, change)) {
+			n_reloaded++;
+		} else {
+			n_deferred++;
+		}
 	}
+
+	/* each signal used to reload every page; deferred pages will still
+	 * reload once when they’re next shown, so they aren’t avoided */
+	n_avoided = shell->n_reload_signals * n_pages - n_reloaded - n_deferred;
+	g_debug ("Coalesced %u reload signals: reloaded %u pages, deferred %u, avoided %u page reloads",
+		 shell->n_reload_signals, n_reloaded, n_deferred, n_avoided);
+	GS_PROFILER_ADD_MARK_TAKE (ShellReload,
+				   shell->reload_begin_time_nsec,
+				   g_strdup ("shell-reload"),
+				   g_strdup_printf ("%u signals, %u pages reloaded, %u deferred, %u reloads avoided",
+						    shell->n_reload_signals, n_reloaded, n_deferred, n_avoided));
+
+	shell->n_reload_signals = 0;
+
+	return G_SOURCE_REMOVE;
 }
 
 static void
-gs_shell_details_page_metainfo_loaded_cb (GtkWidget *details_page,
-					  GsApp *app,
-					  GsShell *self)
+gs_shell_changed_cb (GsPluginLoader *plugin_loader,
+                     GsPluginChange *change,
+                     GsShell        *shell)
 {
-	g_return_if_fail (GS_IS_APP (app));
-	g_return_if_fail (GS_IS_SHELL (self));
+	g_set_object (&shell->next_reload_change, change);
+}
 
-	/* If the user has manually loaded some metainfo to
-	 * preview, override the featured carousel with it too,
-	 * so they can see how it looks in the carousel. */
-	gs_overview_page_override_featured (GS_OVERVIEW_PAGE (self->pages[GS_SHELL_MODE_OVERVIEW]), app);
+static void
+gs_shell_reload_cb (GsPluginLoader *plugin_loader, GsShell *shell)
+{
+	g_autoptr(GsPluginChange) change = g_steal_pointer (&shell->next_reload_change);
+
+	/* a ::reload without a ::changed just before it is for everything */
+	if (change == NULL)
+		change = gs_plugin_change_new_all ();
+	if (shell->reload_change == NULL)
+		shell->reload_change = gs_plugin_change_new ();
+	gs_plugin_change_merge (shell->reload_change, change);
+
+	shell->n_reload_signals++;
+
+	if (shell->reload_id != 0)
+		return;
+
+#ifdef HAVE_SYSPROF
+	shell->reload_begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
+#endif
+	shell->reload_id = g_timeout_add (RELOAD_DEBOUNCE_MS, gs_shell_reload_timeout_cb, shell);
 }
 
 static gboolean
@@ -882,6 +1069,8 @@ overview_page_refresh_done (GsOverviewPage *overview_page, gpointer data)
 	g_signal_handlers_disconnect_by_func (overview_page, overview_page_refresh_done, data);
 
 	/* now that we're finished with the loading page, connect the reload signal handler */
+	g_signal_connect (shell->plugin_loader, "changed",
+	                  G_CALLBACK (gs_shell_changed_cb), shell);
 	g_signal_connect (shell->plugin_loader, "reload",
 	                  G_CALLBACK (gs_shell_reload_cb), shell);
 
@@ -913,6 +1102,8 @@ initial_refresh_done (GsLoadingPage *loading_page, gpointer data)
 	}
 
 	/* now that we're finished with the loading page, connect the reload signal handler */
+	g_signal_connect (shell->plugin_loader, "changed",
+	                  G_CALLBACK (gs_shell_changed_cb), shell);
 	g_signal_connect (shell->plugin_loader, "reload",
 	                  G_CALLBACK (gs_shell_reload_cb), shell);
 }
@@ -1090,6 +1281,17 @@ gs_shell_main_window_mapped_cb (GtkWidget *widget, GsShell *shell)
 #endif  /* HAVE_MOGWAI */
 }
 
+static void
+gs_shell_first_frame_cb (GdkFrameClock *frame_clock,
+                         GsShell       *shell)
+{
+	g_signal_handlers_disconnect_by_func (frame_clock, gs_shell_first_frame_cb, shell);
+
+	g_debug ("First frame painted %" G_GINT64_FORMAT "ms after the window was created",
+		 (g_get_monotonic_time () - shell->init_time_usec) / 1000);
+	GS_PROFILER_ADD_MARK (ShellFirstFrame, shell->init_time_nsec, "shell-first-frame", NULL);
+}
+
 static void
 gs_shell_main_window_realized_cb (GtkWidget *widget, GsShell *shell)
 {
@@ -1098,6 +1300,11 @@ gs_shell_main_window_realized_cb (GtkWidget *widget, GsShell *shell)
 	GdkDisplay *display;
 	GdkMonitor *monitor;
 
+	/* measure the time to the first frame, which is what the lazily
+	 * constructed pages are meant to reduce */
+	g_signal_connect_object (gtk_widget_get_frame_clock (widget), "after-paint",
+				 G_CALLBACK (gs_shell_first_frame_cb), shell, 0);
+
 	display = gtk_widget_get_display (GTK_WIDGET (shell));
 	surface = gtk_native_get_surface (GTK_NATIVE (shell));
 	monitor = gdk_display_get_monitor_at_surface (display, surface);
@@ -2176,26 +2383,6 @@ updates_page_notify_counter_cb (GObject    *obj,
 	adw_view_stack_page_set_needs_attention (stack_page, needs_attention);
 }
 
-static void
-category_page_app_clicked_cb (GsCategoryPage *page,
-                              GsApp          *app,
-                              gpointer        user_data)
-{
-	GsShell *shell = GS_SHELL (user_data);
-
-	gs_shell_show_app (shell, app);
-}
-
-static void
-details_page_app_clicked_cb (GsDetailsPage *page,
-			     GsApp         *app,
-			     gpointer       user_data)
-{
-	GsShell *shell = GS_SHELL (user_data);
-
-	gs_shell_show_app (shell, app);
-}
-
 void
 gs_shell_setup (GsShell *shell, GsPluginLoader *plugin_loader, GCancellable *cancellable)
 {
@@ -2233,7 +2420,8 @@ gs_shell_setup (GsShell *shell, GsPluginLoader *plugin_loader, GCancellable *can
 			  (GCallback) gs_shell_download_updates_changed_cb, shell);
 
 	odrs_provider = gs_plugin_loader_get_odrs_provider (shell->plugin_loader);
-	gs_details_page_set_odrs_provider (GS_DETAILS_PAGE (shell->pages[GS_SHELL_MODE_DETAILS]), odrs_provider);
+	if (shell->pages[GS_SHELL_MODE_DETAILS] != NULL)
+		gs_details_page_set_odrs_provider (GS_DETAILS_PAGE (shell->pages[GS_SHELL_MODE_DETAILS]), odrs_provider);
 
 	/* coldplug */
 	gs_shell_rescan_events (shell);
@@ -2313,7 +2501,7 @@ gs_shell_install (GsShell *shell, GsApp *app, GsShellInteraction interaction)
 	save_back_entry (shell);
 	gs_shell_change_mode (shell, GS_SHELL_MODE_DETAILS,
 			      (gpointer) app, TRUE);
-	gs_page_install_app (shell->pages[GS_SHELL_MODE_DETAILS], app, interaction, shell->cancellable);
+	gs_page_install_app (gs_shell_ensure_page (shell, GS_SHELL_MODE_DETAILS), app, interaction, shell->cancellable);
 }
 
 void
@@ -2321,7 +2509,7 @@ gs_shell_uninstall (GsShell *shell, GsApp *app)
 {
 	save_back_entry (shell);
 	gs_shell_change_mode (shell, GS_SHELL_MODE_DETAILS, (gpointer) app, TRUE);
-	gs_page_remove_app (shell->pages[GS_SHELL_MODE_DETAILS], app, shell->cancellable);
+	gs_page_remove_app (gs_shell_ensure_page (shell, GS_SHELL_MODE_DETAILS), app, shell->cancellable);
 }
 
 void
@@ -2370,7 +2558,7 @@ gs_shell_show_category (GsShell *shell, GsCategory *category)
 void gs_shell_show_extras_search (GsShell *shell, const gchar *mode, gchar **resources, const gchar *desktop_id, const gchar *ident)
 {
 	save_back_entry (shell);
-	gs_extras_page_search (GS_EXTRAS_PAGE (shell->pages[GS_SHELL_MODE_EXTRAS]), mode, resources, desktop_id, ident);
+	gs_extras_page_search (GS_EXTRAS_PAGE (gs_shell_ensure_page (shell, GS_SHELL_MODE_EXTRAS)), mode, resources, desktop_id, ident);
 	gs_shell_change_mode (shell, GS_SHELL_MODE_EXTRAS, NULL, TRUE);
 	gs_shell_activate (shell);
 }
@@ -2426,7 +2614,7 @@ void
 gs_shell_show_search_result (GsShell *shell, const gchar *id, const gchar *search)
 {
 	save_back_entry (shell);
-	gs_search_page_set_appid_to_show (GS_SEARCH_PAGE (shell->pages[GS_SHELL_MODE_SEARCH]), id);
+	gs_search_page_set_appid_to_show (GS_SEARCH_PAGE (gs_shell_ensure_page (shell, GS_SHELL_MODE_SEARCH)), id);
 	gs_shell_change_mode (shell, GS_SHELL_MODE_SEARCH,
 			      (gpointer) search, TRUE);
 }
@@ -2500,6 +2688,9 @@ gs_shell_dispose (GObject *object)
 	GsShell *shell = GS_SHELL (object);
 
 	g_clear_object (&shell->sub_page_header_title_binding);
+	g_clear_handle_id (&shell->reload_id, g_source_remove);
+	g_clear_object (&shell->next_reload_change);
+	g_clear_object (&shell->reload_change);
 
 	if (shell->back_entry_stack != NULL) {
 		g_queue_free_full (shell->back_entry_stack, (GDestroyNotify) free_back_entry);
@@ -2642,6 +2833,8 @@ gs_shell_class_init (GsShellClass *klass)
 	gtk_widget_class_bind_template_child (widget_class, GsShell, stack_loading);
 	gtk_widget_class_bind_template_child (widget_class, GsShell, stack_main);
 	gtk_widget_class_bind_template_child (widget_class, GsShell, stack_sub);
+	gtk_widget_class_bind_template_child (widget_class, GsShell, details_toolbar_view);
+	gtk_widget_class_bind_template_child (widget_class, GsShell, details_title);
 	gtk_widget_class_bind_template_child (widget_class, GsShell, updates_paused_banner);
 	gtk_widget_class_bind_template_child (widget_class, GsShell, search_button);
 	gtk_widget_class_bind_template_child (widget_class, GsShell, entry_search);
@@ -2657,10 +2850,6 @@ gs_shell_class_init (GsShellClass *klass)
 	gtk_widget_class_bind_template_child_full (widget_class, "updates_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_UPDATES]));
 	gtk_widget_class_bind_template_child_full (widget_class, "installed_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_INSTALLED]));
 	gtk_widget_class_bind_template_child_full (widget_class, "loading_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_LOADING]));
-	gtk_widget_class_bind_template_child_full (widget_class, "search_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_SEARCH]));
-	gtk_widget_class_bind_template_child_full (widget_class, "details_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_DETAILS]));
-	gtk_widget_class_bind_template_child_full (widget_class, "category_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_CATEGORY]));
-	gtk_widget_class_bind_template_child_full (widget_class, "extras_page", FALSE, G_STRUCT_OFFSET (GsShell, pages[GS_SHELL_MODE_EXTRAS]));
 
 	gtk_widget_class_bind_template_callback (widget_class, gs_shell_main_window_mapped_cb);
 	gtk_widget_class_bind_template_callback (widget_class, gs_shell_main_window_realized_cb);
@@ -2672,13 +2861,10 @@ gs_shell_class_init (GsShellClass *klass)
 	gtk_widget_class_bind_template_callback (widget_class, gs_shell_back_button_cb);
 	gtk_widget_class_bind_template_callback (widget_class, gs_overview_page_button_cb);
 	gtk_widget_class_bind_template_callback (widget_class, updates_page_notify_counter_cb);
-	gtk_widget_class_bind_template_callback (widget_class, category_page_app_clicked_cb);
 	gtk_widget_class_bind_template_callback (widget_class, search_bar_search_mode_enabled_changed_cb);
 	gtk_widget_class_bind_template_callback (widget_class, search_changed_handler);
 	gtk_widget_class_bind_template_callback (widget_class, stack_notify_visible_child_cb);
 	gtk_widget_class_bind_template_callback (widget_class, initial_refresh_done);
-	gtk_widget_class_bind_template_callback (widget_class, gs_shell_details_page_metainfo_loaded_cb);
-	gtk_widget_class_bind_template_callback (widget_class, details_page_app_clicked_cb);
 
 	gtk_widget_class_add_binding_action (widget_class, GDK_KEY_q, GDK_CONTROL_MASK, "window.close", NULL);
 }
@@ -2686,13 +2872,14 @@ gs_shell_class_init (GsShellClass *klass)
 static void
 gs_shell_init (GsShell *shell)
 {
-	g_type_ensure (GS_TYPE_CATEGORY_PAGE);
-	g_type_ensure (GS_TYPE_DETAILS_PAGE);
-	g_type_ensure (GS_TYPE_EXTRAS_PAGE);
+	shell->init_time_usec = g_get_monotonic_time ();
+#ifdef HAVE_SYSPROF
+	shell->init_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
+#endif
+
 	g_type_ensure (GS_TYPE_INSTALLED_PAGE);
 	g_type_ensure (GS_TYPE_LOADING_PAGE);
 	g_type_ensure (GS_TYPE_OVERVIEW_PAGE);
-	g_type_ensure (GS_TYPE_SEARCH_PAGE);
 	g_type_ensure (GS_TYPE_UPDATES_PAGE);
 	g_type_ensure (GS_TYPE_UPDATES_PAUSED_BANNER);
 
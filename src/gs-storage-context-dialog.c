@@ -39,6 +39,7 @@
 #include "gs-common.h"
 #include "gs-context-dialog-row.h"
 #include "gs-lozenge.h"
+#include "gs-size-accountant.h"
 #include "gs-storage-context-dialog.h"
 
 struct _GsStorageContextDialog
@@ -51,6 +52,7 @@ struct _GsStorageContextDialog
 	GtkSizeGroup		*lozenge_size_group;
 	GtkWidget		*lozenge;
 	GtkLabel		*title;
+	AdwPreferencesGroup	*sizes_group;
 	GtkListBox		*sizes_list;
 	GtkLabel		*manage_storage_label;
 };
@@ -115,6 +117,7 @@ update_sizes_list (GsStorageContextDialog *self)
 	gboolean is_markup = FALSE;
 
 	gs_widget_remove_all (GTK_WIDGET (self->sizes_list), (GsRemoveFunc) gtk_list_box_remove);
+	adw_preferences_group_set_description (self->sizes_group, NULL);
 
 	/* UI state is undefined if app is not set. */
 	if (self->app == NULL)
@@ -155,6 +158,23 @@ update_sizes_list (GsStorageContextDialog *self)
 			title_size_bytes += size_cache_data_bytes;
 			cache_row_added = TRUE;
 		}
+
+		/* The user and cache data sizes may come from an earlier
+		 * measurement, rather than being measured now, so say when. */
+		if (size_user_data_type == GS_SIZE_TYPE_VALID ||
+		    size_cache_data_type == GS_SIZE_TYPE_VALID) {
+			GVariant *measured = gs_app_get_metadata_variant (self->app, GS_SIZE_ACCOUNTANT_MEASURED_METADATA);
+			g_autofree gchar *measured_ago = NULL;
+			g_autofree gchar *measured_str = NULL;
+
+			if (measured != NULL)
+				measured_ago = gs_utils_time_to_string ((gint64) g_variant_get_uint64 (measured));
+			if (measured_ago != NULL) {
+				/* Translators: The placeholder is a relative time, such as ‘3 hours ago’ or ‘Just now’. */
+				measured_str = g_strdup_printf (_("Data sizes last measured: %s"), measured_ago);
+				adw_preferences_group_set_description (self->sizes_group, measured_str);
+			}
+		}
 	} else {
 		guint64 size_download_bytes, size_download_dependencies_bytes;
 		GsSizeType size_download_type, size_download_dependencies_type;
@@ -342,6 +362,7 @@ gs_storage_context_dialog_class_init (GsStorageContextDialogClass *klass)
 	gtk_widget_class_bind_template_child (widget_class, GsStorageContextDialog, lozenge_size_group);
 	gtk_widget_class_bind_template_child (widget_class, GsStorageContextDialog, lozenge);
 	gtk_widget_class_bind_template_child (widget_class, GsStorageContextDialog, title);
+	gtk_widget_class_bind_template_child (widget_class, GsStorageContextDialog, sizes_group);
 	gtk_widget_class_bind_template_child (widget_class, GsStorageContextDialog, sizes_list);
 	gtk_widget_class_bind_template_child (widget_class, GsStorageContextDialog, manage_storage_label);
 
@@ -0,0 +1,493 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-update-set
+ * @short_description: A list of updates with running totals
+ *
+ * A #GsUpdateSet is a #GsAppList of updates which keeps count of how many of
+ * them are busy or downloaded, and of how much is left to download, so that those can be read without looking at every app and its
+ * related apps each time.
+ *
+ * The totals are kept up to date by watching the #GsApp:state and download
+ * size properties of the apps and of their related apps, and
+ * #GsUpdateSet::changed is emitted whenever any of them changes. The totals
+ * are updated before the list from gs_update_set_get_list() is notified of
+ * a change to one of its apps, so they can be read from its
+ * #GsAppList::app-state-changed and #GsAppList::apps-state-changed handlers.
+ *
+ * Apps must be added and removed using the #GsUpdateSet methods, not by
+ * modifying the list from gs_update_set_get_list() directly. It must only be
+ * used from the main thread.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "gs-update-set.h"
+
+typedef enum {
+	ENTRY_FLAG_NONE		= 0,
+	ENTRY_FLAG_UPDATE	= 1 << 0,
+	ENTRY_FLAG_BUSY		= 1 << 1,
+	ENTRY_FLAG_DOWNLOADED	= 1 << 2,
+} EntryFlags;
+
+typedef struct {
+	GsUpdateSet	*self;  /* (unowned) */
+	GsApp		*app;  /* (owned) */
+	GPtrArray	*related;  /* (owned) (element-type GsApp); watched related apps */
+	EntryFlags	 flags;
+	guint64		 download_size;
+} Entry;
+
+struct _GsUpdateSet
+{
+	GObject		 parent_instance;
+
+	GsAppList	*list;  /* (owned) */
+	GHashTable	*entries;  /* (owned) (element-type GsApp Entry) */
+
+	guint		 n_updates;
+	guint		 n_busy;
+	guint		 n_downloaded;
+	guint64		 download_size;
+};
+
+G_DEFINE_TYPE (GsUpdateSet, gs_update_set, G_TYPE_OBJECT)
+
+enum {
+	SIGNAL_CHANGED,
+	SIGNAL_LAST
+};
+
+static guint signals [SIGNAL_LAST] = { 0 };
+
+static void entry_app_notify_cb (GsApp *app, GParamSpec *pspec, gpointer user_data);
+
+static void
+entry_watch_app (Entry *entry,
+                 GsApp *app)
+{
+	g_signal_connect (app, "notify::state",
+			  G_CALLBACK (entry_app_notify_cb), entry);
+	g_signal_connect (app, "notify::size-download",
+			  G_CALLBACK (entry_app_notify_cb), entry);
+	g_signal_connect (app, "notify::size-download-dependencies",
+			  G_CALLBACK (entry_app_notify_cb), entry);
+}
+
+static void
+entry_unwatch_related (Entry *entry)
+{
+	for (guint i = 0; i < entry->related->len; i++)
+		g_signal_handlers_disconnect_by_data (g_ptr_array_index (entry->related, i), entry);
+	g_ptr_array_set_size (entry->related, 0);
+}
+
+/* The download size of an app’s dependencies depends on its related apps, so
+ * watch those too, and keep watching the right ones as they’re changed. */
+static void
+entry_sync_related (Entry *entry)
+{
+	GsAppList *related = gs_app_get_related (entry->app);
+	gboolean same = (gs_app_list_length (related) == entry->related->len);
+
+	for (guint i = 0; same && i < entry->related->len; i++)
+		same = (gs_app_list_index (related, i) == g_ptr_array_index (entry->related, i));
+	if (same)
+		return;
+
+	entry_unwatch_related (entry);
+	for (guint i = 0; i < gs_app_list_length (related); i++) {
+		GsApp *app = gs_app_list_index (related, i);
+		g_ptr_array_add (entry->related, g_object_ref (app));
+		entry_watch_app (entry, app);
+	}
+}
+
+static EntryFlags
+entry_compute (Entry   *entry,
+               guint64 *out_download_size)
+{
+	GsApp *app = entry->app;
+	GsAppState state = gs_app_get_state (app);
+	EntryFlags flags = ENTRY_FLAG_NONE;
+	guint64 download_size = 0;
+
+	if (gs_app_is_updatable (app) ||
+	    state == GS_APP_STATE_INSTALLING ||
+	    state == GS_APP_STATE_DOWNLOADING)
+		flags |= ENTRY_FLAG_UPDATE;
+	if (state == GS_APP_STATE_INSTALLING ||
+	    state == GS_APP_STATE_REMOVING ||
+	    state == GS_APP_STATE_DOWNLOADING)
+		flags |= ENTRY_FLAG_BUSY;
+
+	if (gs_app_is_downloaded (app)) {
+		flags |= ENTRY_FLAG_DOWNLOADED;
+	} else {
+		guint64 size_bytes = 0;
+
+		/* count what is known about, as the UI does for a single app */
+		if (!gs_app_has_quirk (app, GS_APP_QUIRK_IS_PROXY) &&
+		    gs_app_get_size_download (app, &size_bytes) == GS_SIZE_TYPE_VALID)
+			download_size += size_bytes;
+		if (gs_app_get_size_download_dependencies (app, &size_bytes) == GS_SIZE_TYPE_VALID)
+			download_size += size_bytes;
+	}
+
+	*out_download_size = download_size;
+	return flags;
+}
+
+static void
+update_count (guint      *count,
+              EntryFlags  old_flags,
+              EntryFlags  new_flags,
+              EntryFlags  flag)
+{
+	if ((old_flags & flag) && !(new_flags & flag))
+		(*count)--;
+	else if (!(old_flags & flag) && (new_flags & flag))
+		(*count)++;
+}
+
+/* Replace @entry’s contribution to the totals with @new_flags and
+ * @new_download_size. Returns %TRUE if anything changed. */
+static gboolean
+entry_set_contribution (Entry      *entry,
+                        EntryFlags  new_flags,
+                        guint64     new_download_size)
+{
+	GsUpdateSet *self = entry->self;
+
+	if (entry->flags == new_flags && entry->download_size == new_download_size)
+		return FALSE;
+
+	update_count (&self->n_updates, entry->flags, new_flags, ENTRY_FLAG_UPDATE);
+	update_count (&self->n_busy, entry->flags, new_flags, ENTRY_FLAG_BUSY);
+	update_count (&self->n_downloaded, entry->flags, new_flags, ENTRY_FLAG_DOWNLOADED);
+	self->download_size = self->download_size - entry->download_size + new_download_size;
+
+	entry->flags = new_flags;
+	entry->download_size = new_download_size;
+
+	return TRUE;
+}
+
+static gboolean
+entry_update (Entry *entry)
+{
+	EntryFlags flags;
+	guint64 download_size;
+
+	entry_sync_related (entry);
+	flags = entry_compute (entry, &download_size);
+
+	return entry_set_contribution (entry, flags, download_size);
+}
+
+static void
+entry_app_notify_cb (GsApp      *app,
+                     GParamSpec *pspec,
+                     gpointer    user_data)
+{
+	Entry *entry = user_data;
+
+	if (entry_update (entry))
+		g_signal_emit (entry->self, signals[SIGNAL_CHANGED], 0);
+}
+
+static void
+entry_free (Entry *entry)
+{
+	/* take the entry out of the totals; the set is being disposed of or
+	 * has already emitted #GsUpdateSet::changed for this */
+	entry_set_contribution (entry, ENTRY_FLAG_NONE, 0);
+
+	entry_unwatch_related (entry);
+	g_signal_handlers_disconnect_by_data (entry->app, entry);
+	g_ptr_array_unref (entry->related);
+	g_object_unref (entry->app);
+	g_free (entry);
+}
+
+static void
+gs_update_set_dispose (GObject *object)
+{
+	GsUpdateSet *self = GS_UPDATE_SET (object);
+
+	g_clear_pointer (&self->entries, g_hash_table_unref);
+	g_clear_object (&self->list);
+
+	G_OBJECT_CLASS (gs_update_set_parent_class)->dispose (object);
+}
+
+static void
+gs_update_set_class_init (GsUpdateSetClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gs_update_set_dispose;
+
+	/**
+	 * GsUpdateSet::changed:
+	 *
+	 * Emitted when any of the totals changes.
+	 *
+	 * Since: 47
+	 */
+	signals [SIGNAL_CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+static void
+gs_update_set_init (GsUpdateSet *self)
+{
+	self->list = gs_app_list_new ();
+	self->entries = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) entry_free);
+}
+
+/**
+ * gs_update_set_new:
+ *
+ * Create a new empty #GsUpdateSet.
+ *
+ * Returns: (transfer full): a new #GsUpdateSet
+ * Since: 47
+ */
+GsUpdateSet *
+gs_update_set_new (void)
+{
+	return g_object_new (GS_TYPE_UPDATE_SET, NULL);
+}
+
+/**
+ * gs_update_set_new_for_list:
+ * @list: a #GsAppList
+ *
+ * Create a new #GsUpdateSet containing the apps in @list. @list is not
+ * modified, and later changes to it are not reflected in the set.
+ *
+ * Returns: (transfer full): a new #GsUpdateSet
+ * Since: 47
+ */
+GsUpdateSet *
+gs_update_set_new_for_list (GsAppList *list)
+{
+	GsUpdateSet *self;
+
+	g_return_val_if_fail (GS_IS_APP_LIST (list), NULL);
+
+	self = gs_update_set_new ();
+	for (guint i = 0; i < gs_app_list_length (list); i++)
+		gs_update_set_add_app (self, gs_app_list_index (list, i));
+
+	return self;
+}
+
+/**
+ * gs_update_set_get_list:
+ * @self: a #GsUpdateSet
+ *
+ * Get the list of apps in the set. This must not be modified, but its flags
+ * may be changed.
+ *
+ * Returns: (transfer none): the apps
+ * Since: 47
+ */
+GsAppList *
+gs_update_set_get_list (GsUpdateSet *self)
+{
+	g_return_val_if_fail (GS_IS_UPDATE_SET (self), NULL);
+
+	return self->list;
+}
+
+/**
+ * gs_update_set_add_app:
+ * @self: a #GsUpdateSet
+ * @app: a #GsApp
+ *
+ * Add @app to the set, unless gs_app_list_add() considers it to be a
+ * duplicate of an app which is already in the set.
+ *
+ * Since: 47
+ */
+void
+gs_update_set_add_app (GsUpdateSet *self,
+                       GsApp       *app)
+{
+	Entry *entry;
+	guint old_length;
+
+	g_return_if_fail (GS_IS_UPDATE_SET (self));
+	g_return_if_fail (GS_IS_APP (app));
+
+	if (g_hash_table_contains (self->entries, app))
+		return;
+
+	/* watch the app before the list does, so that the totals are up to
+	 * date by the time the list emits its signals */
+	entry = g_new0 (Entry, 1);
+	entry->self = self;
+	entry->app = g_object_ref (app);
+	entry->related = g_ptr_array_new_with_free_func (g_object_unref);
+	entry_watch_app (entry, app);
+
+	old_length = gs_app_list_length (self->list);
+	gs_app_list_add (self->list, app);
+	if (gs_app_list_length (self->list) == old_length) {
+		entry_free (entry);
+		return;
+	}
+
+	g_hash_table_insert (self->entries, app, entry);
+
+	entry_update (entry);
+	g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
+}
+
+/**
+ * gs_update_set_remove_app:
+ * @self: a #GsUpdateSet
+ * @app: a #GsApp
+ *
+ * Remove @app from the set, if it’s in it.
+ *
+ * Since: 47
+ */
+void
+gs_update_set_remove_app (GsUpdateSet *self,
+                          GsApp       *app)
+{
+	g_return_if_fail (GS_IS_UPDATE_SET (self));
+	g_return_if_fail (GS_IS_APP (app));
+
+	if (!g_hash_table_remove (self->entries, app))
+		return;
+
+	gs_app_list_remove (self->list, app);
+	g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
+}
+
+/**
+ * gs_update_set_remove_all:
+ * @self: a #GsUpdateSet
+ *
+ * Remove all the apps from the set.
+ *
+ * Since: 47
+ */
+void
+gs_update_set_remove_all (GsUpdateSet *self)
+{
+	g_return_if_fail (GS_IS_UPDATE_SET (self));
+
+	if (g_hash_table_size (self->entries) == 0)
+		return;
+
+	g_hash_table_remove_all (self->entries);
+	gs_app_list_remove_all (self->list);
+	g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
+}
+
+/**
+ * gs_update_set_get_n_apps:
+ * @self: a #GsUpdateSet
+ *
+ * Get the number of apps in the set.
+ *
+ * Returns: the number of apps
+ * Since: 47
+ */
+guint
+gs_update_set_get_n_apps (GsUpdateSet *self)
+{
+	g_return_val_if_fail (GS_IS_UPDATE_SET (self), 0);
+
+	return g_hash_table_size (self->entries);
+}
+
+/**
+ * gs_update_set_get_n_updates:
+ * @self: a #GsUpdateSet
+ *
+ * Get the number of apps which are updatable, or which are being downloaded
+ * or installed.
+ *
+ * Returns: the number of pending updates
+ * Since: 47
+ */
+guint
+gs_update_set_get_n_updates (GsUpdateSet *self)
+{
+	g_return_val_if_fail (GS_IS_UPDATE_SET (self), 0);
+
+	return self->n_updates;
+}
+
+/**
+ * gs_update_set_get_n_busy:
+ * @self: a #GsUpdateSet
+ *
+ * Get the number of apps which are being downloaded, installed or removed.
+ *
+ * Returns: the number of busy apps
+ * Since: 47
+ */
+guint
+gs_update_set_get_n_busy (GsUpdateSet *self)
+{
+	g_return_val_if_fail (GS_IS_UPDATE_SET (self), 0);
+
+	return self->n_busy;
+}
+
+/**
+ * gs_update_set_get_n_downloaded:
+ * @self: a #GsUpdateSet
+ *
+ * Get the number of apps for which gs_app_is_downloaded() is %TRUE.
+ *
+ * Returns: the number of downloaded apps
+ * Since: 47
+ */
+guint
+gs_update_set_get_n_downloaded (GsUpdateSet *self)
+{
+	g_return_val_if_fail (GS_IS_UPDATE_SET (self), 0);
+
+	return self->n_downloaded;
+}
+
+/**
+ * gs_update_set_get_download_size:
+ * @self: a #GsUpdateSet
+ *
+ * Get the total known download size of the apps which are not downloaded
+ * yet, including their dependencies. Apps whose size is not known are not
+ * counted.
+ *
+ * Returns: the download size, in bytes
+ * Since: 47
+ */
+guint64
+gs_update_set_get_download_size (GsUpdateSet *self)
+{
+	g_return_val_if_fail (GS_IS_UPDATE_SET (self), 0);
+
+	return self->download_size;
+}
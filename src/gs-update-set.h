@@ -0,0 +1,37 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Foundation, Inc.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "gs-app-list.h"
+
+G_BEGIN_DECLS
+
+#define GS_TYPE_UPDATE_SET (gs_update_set_get_type ())
+
+G_DECLARE_FINAL_TYPE (GsUpdateSet, gs_update_set, GS, UPDATE_SET, GObject)
+
+GsUpdateSet	*gs_update_set_new			(void);
+GsUpdateSet	*gs_update_set_new_for_list		(GsAppList	*list);
+
+GsAppList	*gs_update_set_get_list			(GsUpdateSet	*self);
+void		 gs_update_set_add_app			(GsUpdateSet	*self,
+							 GsApp		*app);
+void		 gs_update_set_remove_app		(GsUpdateSet	*self,
+							 GsApp		*app);
+void		 gs_update_set_remove_all		(GsUpdateSet	*self);
+
+guint		 gs_update_set_get_n_apps		(GsUpdateSet	*self);
+guint		 gs_update_set_get_n_updates		(GsUpdateSet	*self);
+guint		 gs_update_set_get_n_busy		(GsUpdateSet	*self);
+guint		 gs_update_set_get_n_downloaded		(GsUpdateSet	*self);
+guint64		 gs_update_set_get_download_size	(GsUpdateSet	*self);
+
+G_END_DECLS
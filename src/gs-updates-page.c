@@ -176,15 +176,10 @@ static guint
 _get_num_updates (GsUpdatesPage *self)
 {
 	guint count = 0;
-	g_autoptr(GsAppList) apps = _get_all_apps (self);
-
-	for (guint i = 0; i < gs_app_list_length (apps); ++i) {
-		GsApp *app = gs_app_list_index (apps, i);
-		if (gs_app_is_updatable (app) ||
-		    gs_app_get_state (app) == GS_APP_STATE_INSTALLING ||
-		    gs_app_get_state (app) == GS_APP_STATE_DOWNLOADING)
-			++count;
-	}
+
+	/* each app is only ever in one section */
+	for (guint i = 0; i < GS_UPDATES_SECTION_KIND_LAST; i++)
+		count += gs_update_set_get_n_updates (gs_updates_section_get_update_set (self->sections[i]));
 	return count;
 }
 
@@ -36,7 +36,8 @@ struct _GsUpdatesSection
 	GtkWidget		*section_header;
 	GtkWidget		*title;
 
-	GsAppList		*list;
+	GsUpdateSet		*update_set;
+	GsAppList		*list;  /* (owned); the list of update_set */
 	GsUpdatesSectionKind	 kind;
 	GCancellable		*cancellable;
 	GsPage			*page; /* (transfer none) */
@@ -62,6 +63,12 @@ gs_updates_section_get_list (GsUpdatesSection *self)
 	return self->list;
 }
 
+GsUpdateSet *
+gs_updates_section_get_update_set (GsUpdatesSection *self)
+{
+	return self->update_set;
+}
+
 static gboolean
 _listbox_keynav_failed_cb (GsUpdatesSection *self, GtkDirectionType direction, GtkListBox *listbox)
 {
@@ -108,7 +115,7 @@ _row_unrevealed_cb (GObject *row, GParamSpec *pspec, gpointer data)
 	g_return_if_fail (GS_IS_UPDATES_SECTION (widget));
 	self = GS_UPDATES_SECTION (widget);
 
-	gs_app_list_remove (self->list, gs_app_row_get_app (GS_APP_ROW (row)));
+	gs_update_set_remove_app (self->update_set, gs_app_row_get_app (GS_APP_ROW (row)));
 
 	gtk_list_box_remove (GTK_LIST_BOX (self->listbox), GTK_WIDGET (row));
 
@@ -145,7 +152,7 @@ gs_updates_section_add_app (GsUpdatesSection *self, GsApp *app)
 			  G_CALLBACK (_app_row_button_clicked_cb),
 			  self);
 	gtk_list_box_append (GTK_LIST_BOX (self->listbox), app_row);
-	gs_app_list_add (self->list, app);
+	gs_update_set_add_app (self->update_set, app);
 
 	gs_app_row_set_size_groups (GS_APP_ROW (app_row),
 				    self->sizegroup_name,
@@ -166,7 +173,7 @@ gs_updates_section_remove_all (GsUpdatesSection *self)
 	GtkWidget *child;
 	while ((child = gtk_widget_get_first_child (self->listbox)) != NULL)
 		gtk_list_box_remove (GTK_LIST_BOX (self->listbox), child);
-	gs_app_list_remove_all (self->list);
+	gs_update_set_remove_all (self->update_set);
 	gtk_widget_set_visible (GTK_WIDGET (self), FALSE);
 	g_clear_object (&self->cancellable);
 }
@@ -242,33 +249,8 @@ _reboot_failed_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 static gboolean
 _all_offline_updates_downloaded (GsUpdatesSection *self)
 {
-	/* use the download size to figure out what is downloaded and what not */
-	for (guint i = 0; i < gs_app_list_length (self->list); i++) {
-		GsApp *app = gs_app_list_index (self->list, i);
-		if (!gs_app_is_downloaded (app))
-			return FALSE;
-	}
-
-	return TRUE;
-}
-
-static guint
-gs_updates_section_count_busy_apps (GsUpdatesSection *self)
-{
-	guint ii, busy = 0;
-
-	for (ii = 0; ii < gs_app_list_length (self->list); ii++) {
-		GsApp *app = gs_app_list_index (self->list, ii);
-		GsAppState state = gs_app_get_state (app);
-
-		if (state == GS_APP_STATE_INSTALLING ||
-		    state == GS_APP_STATE_REMOVING ||
-		    state == GS_APP_STATE_DOWNLOADING) {
-			busy++;
-		}
-	}
-
-	return busy;
+	return gs_update_set_get_n_downloaded (self->update_set) ==
+	       gs_update_set_get_n_apps (self->update_set);
 }
 
 /* Hide progress buttons in the stack pages, to avoid gdk_frame_clock_paint_idle()
@@ -304,7 +286,7 @@ _update_buttons (GsUpdatesSection *self)
 	}
 
 	len = gs_app_list_length (self->list);
-	busy = gs_updates_section_count_busy_apps (self);
+	busy = gs_update_set_get_n_busy (self->update_set);
 
 	gtk_widget_set_sensitive (self->button_update, busy == 0 || busy < len);
 
@@ -581,6 +563,7 @@ gs_updates_section_dispose (GObject *object)
 
 	g_clear_object (&self->cancellable);
 	g_clear_object (&self->list);
+	g_clear_object (&self->update_set);
 	g_clear_object (&self->plugin_loader);
 	g_clear_object (&self->sizegroup_name);
 	g_clear_object (&self->sizegroup_button_label);
@@ -675,14 +658,12 @@ gs_updates_section_progress_notify_cb (GsAppList *list,
 }
 
 static void
-gs_updates_section_app_state_changed_cb (GsAppList *list,
-					 GsApp *in_app,
-					 GsUpdatesSection *self)
+gs_updates_section_update_busy (GsUpdatesSection *self)
 {
 	guint busy, len;
 
 	len = gs_app_list_length (self->list);
-	busy = gs_updates_section_count_busy_apps (self);
+	busy = gs_update_set_get_n_busy (self->update_set);
 
 	if (busy == len && busy > 0 && self->cancellable == NULL) {
 		/* this will show the "Cancel" button, instead of "Update All" */
@@ -694,6 +675,30 @@ gs_updates_section_app_state_changed_cb (GsAppList *list,
 	_update_buttons (self);
 }
 
+static void
+gs_updates_section_app_state_changed_cb (GsAppList *list,
+					 GsApp *in_app,
+					 GsUpdatesSection *self)
+{
+	gs_updates_section_update_busy (self);
+}
+
+static void
+gs_updates_section_apps_state_changed_cb (GsAppList *list,
+					  GsUpdatesSection *self)
+{
+	gs_updates_section_update_busy (self);
+}
+
+static void
+gs_updates_section_update_set_changed_cb (GsUpdateSet *update_set,
+					  GsUpdatesSection *self)
+{
+	/* the offline sections switch between "Download" and "Restart &
+	 * Update" as the updates get downloaded */
+	_update_buttons (self);
+}
+
 static void
 gs_updates_section_init (GsUpdatesSection *self)
 {
@@ -701,7 +706,8 @@ gs_updates_section_init (GsUpdatesSection *self)
 
 	gtk_widget_init_template (GTK_WIDGET (self));
 
-	self->list = gs_app_list_new ();
+	self->update_set = gs_update_set_new ();
+	self->list = g_object_ref (gs_update_set_get_list (self->update_set));
 	gs_app_list_add_flag (self->list,
 			      GS_APP_LIST_FLAG_WATCH_APPS |
 			      GS_APP_LIST_FLAG_WATCH_APPS_ADDONS |
@@ -773,6 +779,14 @@ gs_updates_section_new (GsUpdatesSectionKind kind,
 		g_signal_connect_object (self->list, "app-state-changed",
 					 G_CALLBACK (gs_updates_section_app_state_changed_cb),
 					 self, 0);
+		g_signal_connect_object (self->list, "apps-state-changed",
+					 G_CALLBACK (gs_updates_section_apps_state_changed_cb),
+					 self, 0);
+	} else if (self->kind == GS_UPDATES_SECTION_KIND_OFFLINE_FIRMWARE ||
+		   self->kind == GS_UPDATES_SECTION_KIND_OFFLINE) {
+		g_signal_connect_object (self->update_set, "changed",
+					 G_CALLBACK (gs_updates_section_update_set_changed_cb),
+					 self, 0);
 	}
 
 	return self;
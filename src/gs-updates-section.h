@@ -14,6 +14,7 @@
 #include "gs-app-list.h"
 #include "gs-plugin-loader.h"
 #include "gs-page.h"
+#include "gs-update-set.h"
 
 G_BEGIN_DECLS
 
@@ -33,6 +34,7 @@ GsUpdatesSection	*gs_updates_section_new			(GsUpdatesSectionKind	 kind,
 								 GsPluginLoader		*plugin_loader,
 								 GsPage			*page);
 GsAppList		*gs_updates_section_get_list		(GsUpdatesSection	*self);
+GsUpdateSet		*gs_updates_section_get_update_set	(GsUpdatesSection	*self);
 void			 gs_updates_section_add_app		(GsUpdatesSection	*self,
 								 GsApp			*app);
 void			 gs_updates_section_remove_all		(GsUpdatesSection	*self);